@@ -4,5 +4,5 @@
 
 USER_OBJS :=
 
-LIBS := -lPocoFoundation -lPocoXML -lPocoJSON -lPocoUtil -lPocoNet -lPocoCrypto -lPocoNetSSL -lPocoZip
+LIBS := -lPocoFoundation -lPocoXML -lPocoJSON -lPocoUtil -lPocoNet -lPocoCrypto -lPocoNetSSL -lPocoZip -lcrypto
 
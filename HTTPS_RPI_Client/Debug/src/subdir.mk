@@ -7,24 +7,103 @@ C_SRCS += \
 ../src/rs232.c 
 
 CPP_SRCS += \
-../src/HTTPS_ARM_Client.cpp 
+../../common/src/AEAD.cpp \
+../src/AsyncClient.cpp \
+../src/AsyncConnection.cpp \
+../../common/src/ChunkedUpload.cpp \
+../../common/src/CipherBenchmark.cpp \
+../src/DiscoveryResponder.cpp \
+../../common/src/ECIESCipher.cpp \
+../src/EventLoop.cpp \
+../src/EventRing.cpp \
+../../common/src/FaultProxy.cpp \
+../src/FileUploader.cpp \
+../src/HTTPS_ARM_Client.cpp \
+../src/ModemLineMonitor.cpp \
+../src/NetworkBenchmark.cpp \
+../../common/src/PerThreadRSACipher.cpp \
+../../common/src/PipelineBenchmark.cpp \
+../src/RemoteConfig.cpp \
+../src/RuleEngine.cpp \
+../src/SealPool.cpp \
+../src/SensorFlow.cpp \
+../src/SerialCounters.cpp \
+../src/SerialFlow.cpp \
+../../common/src/SeriesCodec.cpp \
+../src/ServiceDiscovery.cpp \
+../../common/src/SignedBatch.cpp 
 
 OBJS += \
+./src/AEAD.o \
+./src/AsyncClient.o \
+./src/AsyncConnection.o \
+./src/ChunkedUpload.o \
+./src/CipherBenchmark.o \
+./src/DiscoveryResponder.o \
+./src/ECIESCipher.o \
+./src/EventLoop.o \
+./src/EventRing.o \
+./src/FaultProxy.o \
+./src/FileUploader.o \
 ./src/HTTPS_ARM_Client.o \
-./src/rs232.o 
+./src/ModemLineMonitor.o \
+./src/NetworkBenchmark.o \
+./src/PerThreadRSACipher.o \
+./src/PipelineBenchmark.o \
+./src/RemoteConfig.o \
+./src/rs232.o \
+./src/RuleEngine.o \
+./src/SealPool.o \
+./src/SensorFlow.o \
+./src/SerialCounters.o \
+./src/SerialFlow.o \
+./src/SeriesCodec.o \
+./src/ServiceDiscovery.o \
+./src/SignedBatch.o 
 
 C_DEPS += \
 ./src/rs232.d 
 
 CPP_DEPS += \
-./src/HTTPS_ARM_Client.d 
+./src/AEAD.d \
+./src/AsyncClient.d \
+./src/AsyncConnection.d \
+./src/ChunkedUpload.d \
+./src/CipherBenchmark.d \
+./src/DiscoveryResponder.d \
+./src/ECIESCipher.d \
+./src/EventLoop.d \
+./src/EventRing.d \
+./src/FaultProxy.d \
+./src/FileUploader.d \
+./src/HTTPS_ARM_Client.d \
+./src/ModemLineMonitor.d \
+./src/NetworkBenchmark.d \
+./src/PerThreadRSACipher.d \
+./src/PipelineBenchmark.d \
+./src/RemoteConfig.d \
+./src/RuleEngine.d \
+./src/SealPool.d \
+./src/SensorFlow.d \
+./src/SerialCounters.d \
+./src/SerialFlow.d \
+./src/SeriesCodec.d \
+./src/ServiceDiscovery.d \
+./src/SignedBatch.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
 src/%.o: ../src/%.cpp
 	@echo 'Building file: $<'
 	@echo 'Invoking: Cross G++ Compiler'
-	armv5l-isp20-linux-gnueabi-g++ -I"/home/aravind/workspace_new/HTTPS_ARM_Client/include" -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	armv5l-isp20-linux-gnueabi-g++ -I"/home/aravind/workspace_new/HTTPS_ARM_Client/include" -I"../../common/src" -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+src/%.o: ../../common/src/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: Cross G++ Compiler'
+	armv5l-isp20-linux-gnueabi-g++ -I"/home/aravind/workspace_new/HTTPS_ARM_Client/include" -I"../../common/src" -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
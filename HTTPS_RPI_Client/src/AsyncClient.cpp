@@ -0,0 +1,1453 @@
+//
+// AsyncClient.cpp
+//
+// Implementation of the AsyncClient class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "AsyncClient.h"
+#include "AEAD.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
+#include <iostream>
+#include <errno.h>
+#include <unistd.h>
+
+
+namespace
+{
+	Poco::Timespan retryAfter(const Poco::Net::HTTPResponse& response)
+		/// Returns the Retry-After of a long poll the server did not
+		/// hold because it holds too many, zero if there is none.
+	{
+		int seconds = 0;
+		if (!Poco::NumberParser::tryParse(response.get("Retry-After", "0"), seconds) || seconds < 0) seconds = 0;
+		return Poco::Timespan(seconds, 0);
+	}
+}
+
+
+class AsyncClient::ConfigPoller: public AsyncTask
+	/// Long-polls the server for configuration changes and passes them
+	/// to the AsyncClient.
+{
+public:
+	explicit ConfigPoller(AsyncClient& client):
+		AsyncTask(client._loop),
+		_client(client),
+		_connection(client._uri.getHost(), client._uri.getPort(), client._pContext),
+		_io(AsyncConnection::IO_DONE),
+		_reused(false),
+		_retry(false)
+	{
+	}
+
+protected:
+	void resume();
+	void error(const Poco::Exception& exc);
+
+private:
+	void awaitIO(AsyncConnection::IO io, const Poco::Timespan& timeout)
+	{
+		if (io == AsyncConnection::IO_WANT_READ)
+			awaitReadable(_connection.sockfd(), timeout);
+		else
+			awaitWritable(_connection.sockfd(), timeout);
+	}
+
+	AsyncClient& _client;
+	AsyncConnection _connection;
+	AsyncConnection::IO _io;
+	bool _reused;
+	bool _retry;
+	Poco::Timespan _retryAfter;
+
+	friend class AsyncClient;
+};
+
+
+void AsyncClient::ConfigPoller::resume()
+{
+	ASYNC_BEGIN
+	if (_retry)
+		ASYNC_AWAIT(sleep(_client._retryDelay));
+	_retry = false;
+	for (;;)
+	{
+		_reused = _connection.connected();
+		while ((_io = _connection.connect()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io, _client._timeout));
+		{
+			const RemoteConfig& config = _client._remoteConfig;
+			std::string path("/config?epoch=" + config.epoch() + "&version=" + Poco::NumberFormatter::format(config.version()) + "&wait=" + Poco::NumberFormatter::format(_client._configWait.totalSeconds()));
+			Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, path, Poco::Net::HTTPMessage::HTTP_1_1);
+			_connection.prepare(request, std::string());
+		}
+		while ((_io = _connection.send()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io, _client._timeout));
+		// the server holds the request until there is a change
+		while ((_io = _connection.receive()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io, _client._timeout + _client._configWait));
+
+		if (!_client.configured(_connection.response(), _connection.body())) break;
+		_retryAfter = retryAfter(_connection.response());
+		if (_retryAfter > 0)
+			ASYNC_AWAIT(sleep(_retryAfter));
+	}
+	_connection.close();
+	ASYNC_END
+}
+
+
+void AsyncClient::ConfigPoller::error(const Poco::Exception& exc)
+{
+	std::cerr << "Configuration: " << exc.displayText() << std::endl;
+	_connection.close();
+	// as with the Uploaders, a kept-alive connection closed by the
+	// server is retried at once, and a rejected update is not asked
+	// for again before the retry delay
+	_retry = !_reused || !dynamic_cast<const Poco::Net::NetException*>(&exc);
+	_reused = false;
+	restart();
+	yield();
+}
+
+
+class AsyncClient::CommandPoller: public AsyncTask
+	/// Long-polls the server for commands and writes them to the
+	/// serial port.
+{
+public:
+	CommandPoller(AsyncClient& client, const std::string& deviceId, const std::string& deviceKey, int fd, const Poco::Timespan& wait):
+		AsyncTask(client._loop),
+		_client(client),
+		_connection(client._uri.getHost(), client._uri.getPort(), client._pContext),
+		_deviceId(deviceId),
+		_deviceKey(deviceKey),
+		_sequence(0),
+		_fd(fd),
+		_wait(wait),
+		_io(AsyncConnection::IO_DONE),
+		_reused(false),
+		_retry(false),
+		_writing(false),
+		_written(0),
+		_last(0)
+	{
+	}
+
+protected:
+	void resume();
+	void error(const Poco::Exception& exc);
+
+private:
+	typedef std::pair<Poco::UInt32, std::string> Command;
+
+	void awaitIO(AsyncConnection::IO io, const Poco::Timespan& timeout)
+	{
+		if (io == AsyncConnection::IO_WANT_READ)
+			awaitReadable(_connection.sockfd(), timeout);
+		else
+			awaitWritable(_connection.sockfd(), timeout);
+	}
+
+	bool received(const Poco::Net::HTTPResponse& response, const std::string& body);
+		/// Queues the commands of a response. Returns false if the
+		/// server has no command channel.
+
+	bool write();
+		/// Writes the current command as far as the port takes it.
+		/// Returns false if it has to wait for the port.
+
+	void written(bool ok);
+		/// Records the result of the current command.
+
+	static std::string join(const std::vector<Poco::UInt32>& ids);
+
+	AsyncClient& _client;
+	AsyncConnection _connection;
+	std::string _deviceId;
+	std::string _deviceKey;
+	Poco::UInt64 _sequence;
+	int _fd;
+	Poco::Timespan _wait;
+	AsyncConnection::IO _io;
+	bool _reused;
+	bool _retry;
+	std::deque<Command> _commands;
+	bool _writing;
+	std::string::size_type _written;
+	Poco::Timestamp _started;
+	std::vector<Poco::UInt32> _done;
+	std::vector<Poco::UInt32> _failed;
+	std::string _epoch;
+	Poco::UInt32 _last;
+	Poco::Timespan _retryAfter;
+
+	friend class AsyncClient;
+};
+
+
+void AsyncClient::CommandPoller::resume()
+{
+	ASYNC_BEGIN
+	if (_retry)
+		ASYNC_AWAIT(sleep(_client._retryDelay));
+	_retry = false;
+	for (;;)
+	{
+		// the commands are written before the next poll, which
+		// reports them
+		while (!_commands.empty())
+		{
+			_writing = true;
+			_written = 0;
+			_started.update();
+			while (!write())
+				ASYNC_AWAIT(awaitWritable(_fd, _client._timeout));
+			written(_written == _commands.front().second.size());
+		}
+
+		_reused = _connection.connected();
+		while ((_io = _connection.connect()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io, _client._timeout));
+		{
+			// the time in milliseconds, but growing with every poll, so
+			// that the server can refuse a poll sent again
+			Poco::UInt64 now = static_cast<Poco::UInt64>(Poco::Timestamp().epochMicroseconds()/1000);
+			_sequence = now > _sequence ? now : _sequence + 1;
+			std::string deviceId;
+			Poco::URI::encode(_deviceId, "&=+?#", deviceId);
+			std::string sequence(Poco::NumberFormatter::format(_sequence));
+			std::string done(join(_done));
+			std::string failed(join(_failed));
+			std::string path("/commands?device=" + deviceId + "&seq=" + sequence + "&wait=" + Poco::NumberFormatter::format(_wait.totalSeconds()));
+			if (!done.empty()) path += "&done=" + done;
+			if (!failed.empty()) path += "&failed=" + failed;
+			Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, path, Poco::Net::HTTPMessage::HTTP_1_1);
+			request.set("Authorization", "HMAC " + AEAD::toHex(AEAD::hmac(_deviceKey, _deviceId + "\n" + sequence + "\n" + done + "\n" + failed)));
+			_connection.prepare(request, std::string());
+		}
+		while ((_io = _connection.send()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io, _client._timeout));
+		// the server holds the request until there is a command
+		while ((_io = _connection.receive()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io, _client._timeout + _wait));
+
+		// the server has the results once it has answered
+		_done.clear();
+		_failed.clear();
+		if (!received(_connection.response(), _connection.body())) break;
+		// the results of commands received are reported at once
+		_retryAfter = retryAfter(_connection.response());
+		if (_retryAfter > 0 && _commands.empty())
+			ASYNC_AWAIT(sleep(_retryAfter));
+	}
+	_connection.close();
+	ASYNC_END
+}
+
+
+void AsyncClient::CommandPoller::error(const Poco::Exception& exc)
+{
+	if (_writing)
+	{
+		std::cerr << "Command " << _commands.front().first << ": " << exc.displayText() << std::endl;
+		written(false);
+		restart();
+		yield();
+		return;
+	}
+	std::cerr << "Commands: " << exc.displayText() << std::endl;
+	_connection.close();
+	// as with the ConfigPoller
+	_retry = !_reused || !dynamic_cast<const Poco::Net::NetException*>(&exc);
+	_reused = false;
+	restart();
+	yield();
+}
+
+
+bool AsyncClient::CommandPoller::received(const Poco::Net::HTTPResponse& response, const std::string& body)
+{
+	if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED)
+		return true;
+	if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_NOT_FOUND)
+	{
+		std::cerr << "Commands: the server has no command channel" << std::endl;
+		return false;
+	}
+	if (response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK)
+		throw Poco::Net::HTTPException("Command poll failed", Poco::NumberFormatter::format(static_cast<int>(response.getStatus())) + " " + response.getReason());
+
+	// the ids start again when the server restarts
+	std::string epoch(response.get("X-Command-Epoch"));
+	if (epoch != _epoch)
+	{
+		_epoch = epoch;
+		_last = 0;
+	}
+	std::string::size_type pos = 0;
+	while (pos < body.size())
+	{
+		std::string::size_type end = body.find('\n', pos);
+		if (end == std::string::npos) end = body.size();
+		std::string::size_type space = body.find(' ', pos);
+		if (space == std::string::npos || space > end || (end - space - 1) % 2 != 0)
+			throw Poco::DataException("Invalid command", body.substr(pos, end - pos));
+		Command command(Poco::NumberParser::parseUnsigned(body.substr(pos, space - pos)), std::string());
+		for (std::string::size_type i = space + 1; i < end; i += 2)
+		{
+			command.second += static_cast<char>(Poco::NumberParser::parseHex(body.substr(i, 2)));
+		}
+		// a command sent again, as its result did not reach the
+		// server, is not written again
+		if (command.first <= _last)
+			_done.push_back(command.first);
+		else
+			_commands.push_back(command);
+		pos = end + 1;
+	}
+	return true;
+}
+
+
+bool AsyncClient::CommandPoller::write()
+{
+	const std::string& data = _commands.front().second;
+	while (_written < data.size())
+	{
+		ssize_t n = ::write(_fd, data.data() + _written, data.size() - _written);
+		if (n > 0)
+			_written += n;
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else
+			return !(n < 0 && errno == EAGAIN);
+	}
+	return true;
+}
+
+
+void AsyncClient::CommandPoller::written(bool ok)
+{
+	const Command& command = _commands.front();
+	std::cout << "Command " << command.first << " (" << command.second.size() << " bytes) " << (ok ? "written" : "failed") << " in " << _started.elapsed() << " us" << std::endl;
+	(ok ? _done : _failed).push_back(command.first);
+	_last = command.first;
+	_commands.pop_front();
+	_writing = false;
+}
+
+
+std::string AsyncClient::CommandPoller::join(const std::vector<Poco::UInt32>& ids)
+{
+	std::string s;
+	for (std::vector<Poco::UInt32>::const_iterator it = ids.begin(); it != ids.end(); ++it)
+	{
+		if (!s.empty()) s += ',';
+		s += Poco::NumberFormatter::format(*it);
+	}
+	return s;
+}
+
+
+class AsyncClient::DrainController: public AsyncTask
+	/// Adapts the number of Uploaders while a backlog drains.
+{
+public:
+	explicit DrainController(AsyncClient& client):
+		AsyncTask(client._loop),
+		_client(client)
+	{
+	}
+
+protected:
+	void resume()
+	{
+		ASYNC_BEGIN
+		do
+		{
+			ASYNC_AWAIT(sleep(Poco::Timespan(DRAIN_INTERVAL, 0)));
+		}
+		while (_client.adapt());
+		ASYNC_END
+	}
+
+private:
+	AsyncClient& _client;
+};
+
+
+class AsyncClient::RuleFlusher: public AsyncTask
+	/// Uploads the summaries of the RuleEngine.
+{
+public:
+	explicit RuleFlusher(AsyncClient& client):
+		AsyncTask(client._loop),
+		_client(client)
+	{
+	}
+
+protected:
+	void resume()
+	{
+		ASYNC_BEGIN
+		for (;;)
+		{
+			ASYNC_AWAIT(sleep(Poco::Timespan(RULE_FLUSH_INTERVAL, 0)));
+			_client.flushRules();
+		}
+		ASYNC_END
+	}
+
+private:
+	AsyncClient& _client;
+};
+
+
+class AsyncClient::BatchFlusher: public AsyncTask
+	/// Queues a batch that has not filled up within the batch window.
+{
+public:
+	explicit BatchFlusher(AsyncClient& client):
+		AsyncTask(client._loop),
+		_client(client)
+	{
+	}
+
+protected:
+	void resume()
+	{
+		ASYNC_BEGIN
+		for (;;)
+		{
+			if (_client._batch.batch.empty())
+				ASYNC_AWAIT(suspend());
+			else if (_client._batchStarted.elapsed() < _client._batchWindow.totalMicroseconds())
+				ASYNC_AWAIT(sleep(Poco::Timespan(_client._batchWindow.totalMicroseconds() - _client._batchStarted.elapsed())));
+			else
+				_client.flushBatch();
+		}
+		ASYNC_END
+	}
+
+private:
+	AsyncClient& _client;
+};
+
+
+struct AsyncClient::SealJob: public SealPool::Job
+	/// A message the SealPool seals.
+{
+	Message message;
+};
+
+
+class AsyncClient::SealCollector: public AsyncTask
+	/// Waits for the SealPool while it seals messages, and queues
+	/// them for upload.
+{
+public:
+	explicit SealCollector(AsyncClient& client):
+		AsyncTask(client._loop),
+		_client(client)
+	{
+	}
+
+protected:
+	void resume()
+	{
+		ASYNC_BEGIN
+		for (;;)
+		{
+			if (_client._sealing == 0)
+				ASYNC_AWAIT(suspend());
+			else
+				ASYNC_AWAIT(awaitReadable(_client._pSealPool->fd()));
+			_client.collect();
+		}
+		ASYNC_END
+	}
+
+private:
+	AsyncClient& _client;
+};
+
+
+class AsyncClient::Discoverer: public AsyncTask
+	/// Finds the server with DNS-SD, and again when its TTL expires or
+	/// the AsyncClient cannot connect to it.
+{
+public:
+	Discoverer(AsyncClient& client, const std::string& type, const Poco::Net::SocketAddress& address, const std::string& cachePath, const Poco::Timespan& timeout):
+		AsyncTask(client._loop),
+		_client(client),
+		_discovery(type, address),
+		_cachePath(cachePath),
+		_timeout(timeout),
+		_retry(false)
+	{
+	}
+
+protected:
+	void resume()
+	{
+		ASYNC_BEGIN
+		if (_retry)
+			ASYNC_AWAIT(sleep(_client._retryDelay));
+		_retry = false;
+		for (;;)
+		{
+			// the server found last is kept until it expires, or
+			// until rediscover() wakes the task
+			if (_client._discovered.valid())
+				ASYNC_AWAIT(suspend(Poco::Timespan(_client._discovered.expires - Poco::Timestamp())));
+			_discovery.query();
+			_deadline = Poco::Clock() + _timeout.totalMicroseconds();
+			while (!_discovery.receive(_instance))
+			{
+				// other services' answers arrive on the mDNS group too
+				if (_deadline <= Poco::Clock())
+					throw Poco::TimeoutException("No answer for " + _discovery.service());
+				ASYNC_AWAIT(awaitReadable(_discovery.fd(), Poco::Timespan(_deadline - Poco::Clock())));
+			}
+			_client.moveTo(_instance);
+			_client.discovered();
+			ServiceDiscovery::save(_cachePath, _instance);
+		}
+		ASYNC_END
+	}
+
+	void error(const Poco::Exception& exc)
+	{
+		std::cerr << "Discovery: " << exc.displayText() << std::endl;
+		_client.discovered();
+		_retry = true;
+		restart();
+		yield();
+	}
+
+private:
+	AsyncClient& _client;
+	ServiceDiscovery _discovery;
+	ServiceDiscovery::Instance _instance;
+	std::string _cachePath;
+	Poco::Timespan _timeout;
+	Poco::Clock _deadline;
+	bool _retry;
+};
+
+
+AsyncClient::Uploader::Uploader(AsyncClient& client, int id):
+	AsyncTask(client._loop),
+	_client(client),
+	_id(id),
+	_connection(client._uri.getHost(), client._uri.getPort(), client._pContext),
+	_io(AsyncConnection::IO_DONE),
+	_hasMessage(false),
+	_reused(false),
+	_retry(false)
+{
+}
+
+
+AsyncClient::Uploader::~Uploader()
+{
+}
+
+
+void AsyncClient::Uploader::resume()
+{
+	ASYNC_BEGIN
+	if (_retry)
+		ASYNC_AWAIT(sleep(_client._retryDelay));
+	_retry = false;
+	for (;;)
+	{
+		while (!_hasMessage)
+		{
+			_hasMessage = _client.next(_message, *this);
+			if (!_hasMessage) ASYNC_AWAIT(suspend());
+		}
+
+		_reused = _connection.connected();
+		while ((_io = _connection.connect()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io));
+
+		{
+			std::string path(_client._uri.getPathAndQuery());
+			Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_POST, path.empty() ? "/" : path, Poco::Net::HTTPMessage::HTTP_1_1);
+			if (_message.sealed)
+			{
+				for (Poco::Net::NameValueCollection::ConstIterator it = _message.headers.begin(); it != _message.headers.end(); ++it)
+				{
+					request.set(it->first, it->second);
+				}
+				_connection.prepare(request, _message.body);
+			}
+			else
+			{
+				request.set("X-Sequence", Poco::NumberFormatter::format(_message.sequence));
+				std::string body(_message.batch.empty() ? _client._seal(_message.text, request) : _client._sealBatch(_message.batch, request));
+				_connection.prepare(request, body);
+			}
+		}
+		while ((_io = _connection.send()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io));
+		while ((_io = _connection.receive()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io));
+
+		_client.acknowledged(*this, _message.text, _connection.response(), _connection.body());
+		_client.release(_message);
+		++_client._delivered;
+		_hasMessage = false;
+	}
+	ASYNC_END
+}
+
+
+void AsyncClient::Uploader::error(const Poco::Exception& exc)
+{
+	_client.failed(*this, exc);
+	_client.throttle();
+	if (!_reused) _client.rediscover();
+	_connection.close();
+	if (_hasMessage)
+	{
+		_client.requeue(_message);
+		_hasMessage = false;
+	}
+	// a kept-alive connection the server has closed in the meantime
+	// is retried at once, anything else after the retry delay
+	_retry = !_reused;
+	_reused = false;
+	restart();
+	yield();
+}
+
+
+void AsyncClient::Uploader::awaitIO(AsyncConnection::IO io)
+{
+	if (io == AsyncConnection::IO_WANT_READ)
+		awaitReadable(_connection.sockfd(), _client._timeout);
+	else
+		awaitWritable(_connection.sockfd(), _client._timeout);
+}
+
+
+AsyncClient::SerialReader::SerialReader(AsyncClient& client, int fd):
+	AsyncTask(client._loop),
+	_fd(fd),
+	_byte(0),
+	_flow(SerialFlow<Poster>::create(Poster(client)))
+{
+}
+
+
+AsyncClient::SerialReader::~SerialReader()
+{
+}
+
+
+void AsyncClient::SerialReader::resume()
+{
+	ASYNC_BEGIN
+	for (;;)
+	{
+		ASYNC_AWAIT(awaitReadable(_fd));
+		while (::read(_fd, &_byte, 1) == 1)
+		{
+			_flow.push(_byte);
+		}
+	}
+	ASYNC_END
+}
+
+
+AsyncClient::SensorReader::SensorReader(AsyncClient& client, int fd, const Poco::Timespan& window, bool raw, std::size_t maxPoints):
+	AsyncTask(client._loop),
+	_fd(fd),
+	_window(window),
+	_flow(SensorFlow<Poster>::create(Poster(client), window.totalMilliseconds(), raw, maxPoints))
+{
+}
+
+
+AsyncClient::SensorReader::~SensorReader()
+{
+}
+
+
+void AsyncClient::SensorReader::resume()
+{
+	ASYNC_BEGIN
+	for (;;)
+	{
+		// the timeout passes on the windows of channels gone quiet
+		ASYNC_AWAIT(awaitReadable(_fd, _window));
+		ssize_t n;
+		while ((n = ::read(_fd, _buffer, sizeof(_buffer))) > 0)
+		{
+			_flow.push(_buffer, static_cast<std::size_t>(n));
+		}
+		expire();
+	}
+	ASYNC_END
+}
+
+
+void AsyncClient::SensorReader::error(const Poco::Exception& exc)
+{
+	if (!dynamic_cast<const Poco::TimeoutException*>(&exc))
+	{
+		AsyncTask::error(exc);
+		return;
+	}
+	expire();
+	restart();
+	yield();
+}
+
+
+void AsyncClient::SensorReader::expire()
+{
+	_flow.next().next().expire(Poco::Timestamp().epochMicroseconds()/1000);
+}
+
+
+AsyncClient::RingReader::RingReader(AsyncClient& client, EventRing& ring):
+	AsyncTask(client._loop),
+	_client(client),
+	_ring(ring)
+{
+	_message.pReader = this;
+	_message.end = 0;
+	_message.sealed = false;
+	_message.urgent = false;
+}
+
+
+AsyncClient::RingReader::~RingReader()
+{
+}
+
+
+void AsyncClient::RingReader::acknowledged(Poco::UInt32 end)
+{
+	std::deque<std::pair<Poco::UInt32, bool> >::iterator it = _unreleased.begin();
+	while (it != _unreleased.end() && it->first != end) ++it;
+	if (it != _unreleased.end()) it->second = true;
+
+	bool release = false;
+	while (!_unreleased.empty() && _unreleased.front().second)
+	{
+		end = _unreleased.front().first;
+		_unreleased.pop_front();
+		release = true;
+	}
+	if (release) _ring.release(end);
+}
+
+
+void AsyncClient::RingReader::resume()
+{
+	ASYNC_BEGIN
+	_ring.rewind();
+	for (;;)
+	{
+		_ring.drain();
+		// while the queue is full, the messages wait in the ring
+		while (!_client.full() && _ring.read(_message.text, _message.end))
+		{
+			_unreleased.push_back(std::make_pair(_message.end, false));
+			_client.post(_message);
+		}
+		if (_client.full())
+			ASYNC_AWAIT(sleep(_client._retryDelay));
+		else
+			ASYNC_AWAIT(awaitReadable(_ring.doorbell()));
+	}
+	ASYNC_END
+}
+
+
+AsyncClient::ModemLineReader::ModemLineReader(AsyncClient& client, ModemLineMonitor& monitor):
+	AsyncTask(client._loop),
+	_client(client),
+	_monitor(monitor)
+{
+}
+
+
+AsyncClient::ModemLineReader::~ModemLineReader()
+{
+}
+
+
+void AsyncClient::ModemLineReader::resume()
+{
+	ASYNC_BEGIN
+	for (;;)
+	{
+		ASYNC_AWAIT(awaitReadable(_monitor.fd()));
+		_monitor.drain();
+		while (_monitor.next(_event))
+		{
+			_client.post(ModemLineMonitor::format(_event));
+		}
+	}
+	ASYNC_END
+}
+
+
+AsyncClient::SerialCounterReader::SerialCounterReader(AsyncClient& client, SerialCounters& counters, const Poco::Timespan& interval):
+	AsyncTask(client._loop),
+	_client(client),
+	_counters(counters),
+	_interval(interval)
+{
+}
+
+
+AsyncClient::SerialCounterReader::~SerialCounterReader()
+{
+}
+
+
+void AsyncClient::SerialCounterReader::resume()
+{
+	ASYNC_BEGIN
+	for (;;)
+	{
+		_messages.clear();
+		if (!_counters.poll(_messages))
+		{
+			std::cerr << "No serial counters for " << _counters.port() << std::endl;
+			break;
+		}
+		for (std::vector<std::string>::const_iterator it = _messages.begin(); it != _messages.end(); ++it)
+		{
+			_client.post(*it);
+		}
+		ASYNC_AWAIT(sleep(_interval));
+	}
+	ASYNC_END
+}
+
+
+AsyncClient::AsyncClient(const Poco::URI& uri, Poco::Net::Context::Ptr pContext, Seal seal, int connections):
+	_uri(uri),
+	_pContext(pContext),
+	_seal(seal),
+	_timeout(30, 0),
+	_retryDelay(5, 0),
+	_pRules(0),
+	_sealBatch(0),
+	_batchSize(0),
+	_sealing(0),
+	_maxQueued(DEFAULT_MAX_QUEUED),
+	_overflowed(0),
+	_discovering(false),
+	_connections(connections),
+	_maxConnections(connections),
+	_active(connections),
+	_drainBacklog(0),
+	_draining(false),
+	_direction(1),
+	_slowStart(false),
+	_delivered(0),
+	_lastRate(0),
+	_sequence(0)
+{
+	for (int i = 0; i < connections; ++i)
+	{
+		_uploaders.push_back(new Uploader(*this, i));
+		_uploaders.back()->start();
+	}
+}
+
+
+AsyncClient::~AsyncClient()
+{
+}
+
+
+void AsyncClient::readSerial(int fd)
+{
+	_readers.push_back(new SerialReader(*this, fd));
+	_readers.back()->start();
+}
+
+
+void AsyncClient::readSensors(int fd, const Poco::Timespan& window, bool raw, std::size_t maxPoints)
+{
+	_sensorReaders.push_back(new SensorReader(*this, fd, window, raw, maxPoints));
+	_sensorReaders.back()->start();
+}
+
+
+void AsyncClient::readRing(EventRing& ring)
+{
+	_ringReaders.push_back(new RingReader(*this, ring));
+	_ringReaders.back()->start();
+}
+
+
+void AsyncClient::readModemLines(ModemLineMonitor& monitor)
+{
+	_lineReaders.push_back(new ModemLineReader(*this, monitor));
+	_lineReaders.back()->start();
+}
+
+
+void AsyncClient::watchSerialCounters(SerialCounters& counters, const Poco::Timespan& interval)
+{
+	_counterReaders.push_back(new SerialCounterReader(*this, counters, interval));
+	_counterReaders.back()->start();
+}
+
+
+void AsyncClient::post(const std::string& message)
+{
+	Message m;
+	m.text = message;
+	m.pReader = 0;
+	m.end = 0;
+	m.sealed = false;
+	m.urgent = false;
+	post(m);
+}
+
+
+void AsyncClient::post(const Message& message)
+{
+	if (!_pRules)
+	{
+		submit(message);
+		return;
+	}
+	switch (_pRules->decide(message.text))
+	{
+	case RuleEngine::DECISION_DROP:
+		release(message);
+		break;
+	case RuleEngine::DECISION_ESCALATE:
+		{
+			Message m(message);
+			m.urgent = true;
+			submit(m);
+		}
+		break;
+	default:
+		submit(message);
+		break;
+	}
+}
+
+
+void AsyncClient::flushRules()
+{
+	std::vector<std::string> summaries;
+	_pRules->flush(summaries);
+	for (std::vector<std::string>::const_iterator it = summaries.begin(); it != summaries.end(); ++it)
+	{
+		Message m;
+		m.text = *it;
+		m.pReader = 0;
+		m.end = 0;
+		m.sealed = false;
+		m.urgent = false;
+		submit(m);
+	}
+}
+
+
+void AsyncClient::submit(const Message& message)
+{
+	if (_batchSize > 0 && !message.urgent)
+		addToBatch(message);
+	else if (_pSealPool)
+	{
+		SealJob* pJob = new SealJob;
+		pJob->message = message;
+		pJob->message.sequence = _sequence++;
+		pJob->message.text.swap(pJob->Job::message);
+		pJob->headers.set("X-Sequence", Poco::NumberFormatter::format(pJob->message.sequence));
+		_pSealPool->submit(pJob);
+		++_sealing;
+		_pSealCollector->wake();
+	}
+	else
+	{
+		Message m(message);
+		m.sequence = _sequence++;
+		enqueue(m);
+	}
+}
+
+
+void AsyncClient::enqueue(const Message& message)
+{
+	if (full())
+	{
+		// the oldest message is dropped, so that the latest states
+		// are uploaded when the server can be reached again
+		std::deque<Message>::iterator it = _queue.begin();
+		while (it != _queue.end() && it->urgent) ++it;
+		if (it == _queue.end() && !message.urgent)
+		{
+			release(message);
+			++_overflowed;
+			return;
+		}
+		if (it != _queue.end())
+		{
+			release(*it);
+			_overflowed += it->batch.empty() ? 1 : it->batch.size();
+			_queue.erase(it);
+		}
+		if (_overflowed == 1)
+			std::cerr << "Queue full, dropping the oldest messages" << std::endl;
+	}
+	if (message.urgent)
+	{
+		// after the other escalated messages
+		std::deque<Message>::iterator it = _queue.begin();
+		while (it != _queue.end() && it->urgent) ++it;
+		_queue.insert(it, message);
+	}
+	else _queue.push_back(message);
+	if (_drainBacklog > 0 && !_draining && _queue.size() > _drainBacklog)
+	{
+		_draining = true;
+		_direction = 1;
+		_slowStart = true;
+		_delivered = 0;
+		_lastRate = 0;
+		_pDrainController->start();
+	}
+	wakeIdle();
+}
+
+
+void AsyncClient::addToBatch(const Message& message)
+{
+	if (_batch.batch.empty())
+	{
+		_batchStarted.update();
+		_pBatchFlusher->wake();
+	}
+	else _batch.text += '\n';
+	_batch.text += message.text;
+	_batch.batch.push_back(message.text);
+	if (message.pReader) _batch.ends.push_back(std::make_pair(message.pReader, message.end));
+	if (_batch.batch.size() >= _batchSize) flushBatch();
+}
+
+
+void AsyncClient::flushBatch()
+{
+	if (_batch.batch.empty()) return;
+	_batch.sequence = _sequence++;
+	enqueue(_batch);
+	_batch.text.clear();
+	_batch.batch.clear();
+	_batch.ends.clear();
+}
+
+
+void AsyncClient::release(const Message& message)
+{
+	if (message.pReader) message.pReader->acknowledged(message.end);
+	for (std::vector<std::pair<RingReader*, Poco::UInt32> >::const_iterator it = message.ends.begin(); it != message.ends.end(); ++it)
+	{
+		it->first->acknowledged(it->second);
+	}
+}
+
+
+void AsyncClient::collect()
+{
+	_pSealPool->drain();
+	while (SealJob* pJob = static_cast<SealJob*>(_pSealPool->collect()))
+	{
+		--_sealing;
+		Message& m = pJob->message;
+		m.text.swap(pJob->Job::message);
+		// a message that could not be sealed is sealed again by the
+		// Uploader, which reports the error
+		m.sealed = pJob->sealed;
+		m.body.swap(pJob->body);
+		m.headers = pJob->headers;
+		enqueue(m);
+		delete pJob;
+	}
+}
+
+
+void AsyncClient::run()
+{
+	_loop.run();
+}
+
+
+void AsyncClient::stop()
+{
+	_loop.stop();
+}
+
+
+void AsyncClient::setTimeout(const Poco::Timespan& timeout)
+{
+	_timeout = timeout;
+}
+
+
+void AsyncClient::setRetryDelay(const Poco::Timespan& delay)
+{
+	_retryDelay = delay;
+}
+
+
+void AsyncClient::setAddress(const Poco::Net::SocketAddress& address)
+{
+	for (std::vector<Poco::SharedPtr<Uploader> >::iterator it = _uploaders.begin(); it != _uploaders.end(); ++it)
+	{
+		(*it)->_connection.setAddress(address);
+	}
+	if (_pConfigPoller) _pConfigPoller->_connection.setAddress(address);
+	if (_pCommandPoller) _pCommandPoller->_connection.setAddress(address);
+}
+
+
+void AsyncClient::pollConfig(const std::string& path, const Poco::Timespan& wait)
+{
+	_configPath = path;
+	_configWait = wait;
+	_localURI = _uri;
+	_localTimeout = _timeout;
+	_localRetryDelay = _retryDelay;
+	try
+	{
+		if (_remoteConfig.load(path))
+		{
+			configure(_remoteConfig.values());
+			std::cout << "Configuration version " << _remoteConfig.version() << " from " << path << std::endl;
+		}
+	}
+	catch (Poco::Exception& exc)
+	{
+		// the server sends the whole configuration again
+		std::cerr << "Configuration: " << exc.displayText() << std::endl;
+		_remoteConfig = RemoteConfig();
+	}
+	_pConfigPoller = new ConfigPoller(*this);
+	_pConfigPoller->start();
+}
+
+
+void AsyncClient::receiveCommands(const std::string& deviceId, const std::string& deviceKey, int fd, const Poco::Timespan& wait)
+{
+	_pCommandPoller = new CommandPoller(*this, deviceId, deviceKey, fd, wait);
+	_pCommandPoller->start();
+}
+
+
+void AsyncClient::setRules(RuleEngine& rules)
+{
+	_pRules = &rules;
+	if (!_pRuleFlusher)
+	{
+		_pRuleFlusher = new RuleFlusher(*this);
+		_pRuleFlusher->start();
+	}
+}
+
+
+bool AsyncClient::next(Message& message, Uploader& uploader)
+{
+	if (_queue.empty() || uploader.id() >= _active || _discovering)
+	{
+		_idle.push_back(&uploader);
+		return false;
+	}
+	message = _queue.front();
+	_queue.pop_front();
+	if (_overflowed > 0 && _queue.size() < _maxQueued/2)
+	{
+		// reported once the backlog has drained to half the limit
+		Message m;
+		m.text = "!!!!...QUEUE OVERFLOW dropped=" + Poco::NumberFormatter::format(_overflowed) + "...!!!!";
+		m.pReader = 0;
+		m.end = 0;
+		m.sealed = false;
+		m.urgent = false;
+		_overflowed = 0;
+		std::cerr << "Queue drained, " << m.text << std::endl;
+		submit(m);
+	}
+	return true;
+}
+
+
+void AsyncClient::requeue(const Message& message)
+{
+	_queue.push_front(message);
+	wakeIdle();
+}
+
+
+void AsyncClient::acknowledged(const Uploader& uploader, const std::string& message, const Poco::Net::HTTPResponse& response, const std::string& body)
+{
+	std::cout << "\nMessage from Client (upload " << uploader.id() << "):\n" << message << std::endl;
+	if (response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK)
+		std::cout << response.getStatus() << " " << response.getReason() << std::endl;
+	std::cout << body << std::endl;
+}
+
+
+void AsyncClient::failed(const Uploader& uploader, const Poco::Exception& exc)
+{
+	std::cerr << "Upload " << uploader.id() << ": " << exc.displayText() << std::endl;
+}
+
+
+void AsyncClient::configure(const RemoteConfig::Map& values)
+{
+	Poco::Timespan timeout(_localTimeout);
+	Poco::Timespan retryDelay(_localRetryDelay);
+	Poco::URI uri(_localURI);
+	for (RemoteConfig::Map::const_iterator it = values.begin(); it != values.end(); ++it)
+	{
+		if (it->first == "client.async.timeout" || it->first == "client.async.retryDelay")
+		{
+			int seconds = Poco::NumberParser::parse(it->second);
+			if (seconds <= 0) throw Poco::InvalidArgumentException(it->first, it->second);
+			(it->first == "client.async.timeout" ? timeout : retryDelay) = Poco::Timespan(seconds, 0);
+		}
+		else if (it->first == "client.uri")
+		{
+			uri = Poco::URI(it->second);
+			if (uri.getHost().empty()) throw Poco::InvalidArgumentException(it->first, it->second);
+		}
+	}
+	if (uri.getHost() != _uri.getHost() || uri.getPort() != _uri.getPort())
+	{
+		// resolves the host, so that an unknown one is rejected here,
+		// unless it is the server found by discovery
+		Poco::Net::SocketAddress address;
+		if (!_discovered.address.empty() && uri.getHost() == _discovered.host() && uri.getPort() == _discovered.port)
+			address = Poco::Net::SocketAddress(_discovered.address, _discovered.port);
+		else
+			address = Poco::Net::SocketAddress(uri.getHost(), uri.getPort());
+		for (std::vector<Poco::SharedPtr<Uploader> >::iterator it = _uploaders.begin(); it != _uploaders.end(); ++it)
+		{
+			(*it)->_connection.setServer(uri.getHost(), address);
+		}
+		if (_pConfigPoller) _pConfigPoller->_connection.setServer(uri.getHost(), address);
+		if (_pCommandPoller) _pCommandPoller->_connection.setServer(uri.getHost(), address);
+	}
+	_uri = uri;
+	_timeout = timeout;
+	_retryDelay = retryDelay;
+}
+
+
+bool AsyncClient::configured(const Poco::Net::HTTPResponse& response, const std::string& body)
+{
+	if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_NOT_MODIFIED)
+		return true;
+	if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_NOT_FOUND)
+	{
+		std::cerr << "Configuration: the server does not push configuration" << std::endl;
+		return false;
+	}
+	if (response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK)
+		throw Poco::Net::HTTPException("Configuration poll failed", Poco::NumberFormatter::format(static_cast<int>(response.getStatus())) + " " + response.getReason());
+
+	std::string epoch(response.get("X-Config-Epoch"));
+	Poco::UInt32 version = Poco::NumberParser::parseUnsigned(response.get("X-Config-Version"));
+	std::string delta(response.get("X-Config-Delta"));
+	bool full = delta == "full";
+	if (!full && (epoch != _remoteConfig.epoch() || Poco::NumberParser::parseUnsigned(delta) != _remoteConfig.version()))
+		throw Poco::DataException("Configuration update for another version", delta);
+
+	RemoteConfig::Map values(_remoteConfig.apply(body, full));
+	configure(values);
+	_remoteConfig.commit(epoch, version, values);
+	std::cout << "Configuration version " << version << " applied (" << body.size() << " bytes)" << std::endl;
+	_remoteConfig.save(_configPath);
+	return true;
+}
+
+
+void AsyncClient::setDrain(int maxConnections, std::size_t backlog)
+{
+	for (int i = static_cast<int>(_uploaders.size()); i < maxConnections; ++i)
+	{
+		_uploaders.push_back(new Uploader(*this, i));
+		_uploaders.back()->start();
+	}
+	if (!_pDrainController) _pDrainController = new DrainController(*this);
+	_maxConnections = maxConnections > _connections ? maxConnections : _connections;
+	_drainBacklog = backlog;
+}
+
+
+void AsyncClient::discover(const std::string& type, const Poco::Net::SocketAddress& address, const std::string& cachePath, const Poco::Timespan& timeout)
+{
+	ServiceDiscovery::Instance instance;
+	if (ServiceDiscovery::load(cachePath, instance) && instance.valid())
+		moveTo(instance);
+	else
+		_discovering = true;
+	_pDiscoverer = new Discoverer(*this, type, address, cachePath, timeout);
+	_pDiscoverer->start();
+}
+
+
+void AsyncClient::moveTo(const ServiceDiscovery::Instance& instance)
+{
+	bool moved = instance.host() != _discovered.host() || instance.address != _discovered.address || instance.port != _discovered.port;
+	_discovered = instance;
+	if (!moved) return;
+	// removing client.uri on the server goes back to this server
+	_localURI.setHost(instance.host());
+	_localURI.setPort(instance.port);
+	if (_remoteConfig.values().count("client.uri")) return;
+
+	Poco::Net::SocketAddress address(instance.address, instance.port);
+	for (std::vector<Poco::SharedPtr<Uploader> >::iterator it = _uploaders.begin(); it != _uploaders.end(); ++it)
+	{
+		(*it)->_connection.setServer(instance.host(), address);
+	}
+	if (_pConfigPoller) _pConfigPoller->_connection.setServer(instance.host(), address);
+	if (_pCommandPoller) _pCommandPoller->_connection.setServer(instance.host(), address);
+	_uri.setHost(instance.host());
+	_uri.setPort(instance.port);
+	std::cout << "Server " << instance.name << " at " << address.toString() << " (TTL " << instance.ttl << " s)" << std::endl;
+}
+
+
+void AsyncClient::rediscover()
+{
+	if (_pDiscoverer) _pDiscoverer->wake();
+}
+
+
+void AsyncClient::discovered()
+{
+	if (_discovering)
+	{
+		_discovering = false;
+		std::size_t n = _queue.size();
+		while (n-- > 0 && wakeIdle())
+		{
+		}
+	}
+}
+
+
+void AsyncClient::setMaxQueued(std::size_t maxQueued)
+{
+	_maxQueued = maxQueued;
+}
+
+
+void AsyncClient::setBatch(SealBatch seal, std::size_t size, const Poco::Timespan& window)
+{
+	_sealBatch = seal;
+	_batchSize = size;
+	_batchWindow = window;
+	_batch.pReader = 0;
+	_batch.end = 0;
+	_batch.sealed = false;
+	_batch.urgent = false;
+	if (!_pBatchFlusher)
+	{
+		_pBatchFlusher = new BatchFlusher(*this);
+		_pBatchFlusher->start();
+	}
+}
+
+
+void AsyncClient::setSealThreads(int threads, const std::vector<int>& cpus)
+{
+	if (threads <= 0) return;
+	_pSealPool = new SealPool(_seal, threads, cpus);
+	_pSealCollector = new SealCollector(*this);
+	_pSealCollector->start();
+}
+
+
+bool AsyncClient::adapt()
+{
+	double rate = static_cast<double>(_delivered)/DRAIN_INTERVAL;
+	_delivered = 0;
+	if (_queue.empty())
+	{
+		_active = _connections;
+		_draining = false;
+		std::cout << "Backlog drained" << std::endl;
+		return false;
+	}
+
+	// nothing to measure while the server cannot be reached
+	if (rate == 0) return true;
+
+	// hill climbing on the throughput: the number doubles until a
+	// step does not help by more than the noise, then moves by one,
+	// and a step that did not help is taken back
+	if (rate <= _lastRate*1.05)
+	{
+		_direction = -_direction;
+		_slowStart = false;
+	}
+	_lastRate = rate;
+	int active = _slowStart ? 2*_active : _active + _direction;
+	if (active < _connections) active = _connections;
+	if (active > _maxConnections) active = _maxConnections;
+	if (active != _active)
+	{
+		_active = active;
+		std::cout << "Draining " << _queue.size() << " messages over " << _active << " connections (" << rate << " messages/s)" << std::endl;
+	}
+	std::size_t n = _queue.size();
+	while (n-- > 0 && wakeIdle())
+	{
+	}
+	return true;
+}
+
+
+void AsyncClient::throttle()
+{
+	if (_draining)
+	{
+		_active = _active/2 > _connections ? _active/2 : _connections;
+		_direction = 1;
+		_slowStart = true;
+		_lastRate = 0;
+	}
+}
+
+
+bool AsyncClient::wakeIdle()
+{
+	for (std::deque<Uploader*>::iterator it = _idle.begin(); it != _idle.end(); ++it)
+	{
+		if ((*it)->id() < _active)
+		{
+			Uploader* pUploader = *it;
+			_idle.erase(it);
+			pUploader->wake();
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,623 @@
+//
+// AsyncClient.h
+//
+// Definition of the AsyncClient class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef AsyncClient_INCLUDED
+#define AsyncClient_INCLUDED
+
+
+#include "EventLoop.h"
+#include "AsyncConnection.h"
+#include "SerialFlow.h"
+#include "SensorFlow.h"
+#include "RemoteConfig.h"
+#include "EventRing.h"
+#include "SealPool.h"
+#include "ServiceDiscovery.h"
+#include "ModemLineMonitor.h"
+#include "SerialCounters.h"
+#include "RuleEngine.h"
+#include "Poco/Net/HTTPRequest.h"
+#include "Poco/Net/Context.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Clock.h"
+#include "Poco/Timespan.h"
+#include "Poco/URI.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+
+class AsyncClient
+	/// The asynchronous client runtime: a SerialReader task turns the
+	/// bytes from the UART into messages (or a SensorReader turns
+	/// numeric readings into window summaries and compressed series,
+	/// or a RingReader takes them from the acquisition process), a
+	/// ModemLineReader does the same
+	/// for the changes of the modem status lines, a SerialCounterReader
+	/// uploads the kernel counters of the serial port, and a number of
+	/// Uploader tasks seal the messages and post them, each over its
+	/// own keep-alive connection, all on one EventLoop and one thread.
+	///
+	/// While one upload waits for its connection or its
+	/// acknowledgement, the next message is captured, sealed and sent
+	/// on another connection, so a single-core board is kept busy
+	/// instead of blocking in each request.
+	///
+	/// On a board with more cores, setSealThreads() moves the sealing
+	/// to worker threads.
+{
+public:
+	typedef std::string (*Seal)(const std::string& message, Poco::Net::HTTPRequest& request);
+		/// Encrypts or signs a message and sets the request headers
+		/// that describe the payload. Returns the request body.
+
+	typedef std::string (*SealBatch)(const std::vector<std::string>& messages, Poco::Net::HTTPRequest& request);
+		/// Signs a batch of messages as one payload (see setBatch())
+		/// and sets the request headers. Returns the request body.
+
+	class RingReader;
+
+private:
+	struct Message
+	{
+		std::string text;
+		RingReader* pReader;   /// the RingReader the message came from, or null
+		Poco::UInt32 end;      /// the end of the message in the EventRing
+		Poco::UInt32 sequence; /// the X-Sequence of the message
+		bool sealed;           /// true if body and headers have been sealed by the SealPool
+		bool urgent;           /// escalated by the RuleEngine, uploaded before the others
+		std::vector<std::string> batch;  /// the messages of a batch, sealed together
+		std::vector<std::pair<RingReader*, Poco::UInt32> > ends;  /// the EventRing ends of the messages of a batch
+		std::string body;
+		Poco::Net::NameValueCollection headers;
+	};
+
+public:
+	class Uploader: public AsyncTask
+		/// Takes messages from the queue of the AsyncClient, one at
+		/// a time, seals and posts them and waits for the
+		/// acknowledgement. Connects when it gets its first message
+		/// and after errors, after which the failed message is queued
+		/// again.
+	{
+	public:
+		Uploader(AsyncClient& client, int id);
+		~Uploader();
+
+		int id() const;
+
+	protected:
+		void resume();
+		void error(const Poco::Exception& exc);
+
+	private:
+		void awaitIO(AsyncConnection::IO io);
+
+		AsyncClient& _client;
+		int _id;
+		AsyncConnection _connection;
+		AsyncConnection::IO _io;
+		Message _message;
+		bool _hasMessage;
+		bool _reused;
+		bool _retry;
+
+		friend class AsyncClient;
+	};
+
+	class Poster
+		/// The sink of the SerialFlow: queues the messages with post().
+	{
+	public:
+		explicit Poster(AsyncClient& client);
+
+		void push(const std::string& message);
+		void flush();
+
+	private:
+		AsyncClient* _pClient;
+	};
+
+	class SerialReader: public AsyncTask
+		/// Reads the UART and passes the bytes through a SerialFlow,
+		/// which queues a message when the board reports a state
+		/// different from the last one.
+	{
+	public:
+		SerialReader(AsyncClient& client, int fd);
+		~SerialReader();
+
+	protected:
+		void resume();
+
+	private:
+		int _fd;
+		unsigned char _byte;
+		SerialFlow<Poster>::Type _flow;
+	};
+
+	class SensorReader: public AsyncTask
+		/// Reads numeric readings from the UART and passes them through
+		/// a SensorFlow.
+	{
+	public:
+		SensorReader(AsyncClient& client, int fd, const Poco::Timespan& window, bool raw, std::size_t maxPoints);
+		~SensorReader();
+
+	protected:
+		void resume();
+		void error(const Poco::Exception& exc);
+
+	private:
+		void expire();
+
+		int _fd;
+		Poco::Timespan _window;
+		char _buffer[256];
+		SensorFlow<Poster>::Type _flow;
+	};
+
+	class RingReader: public AsyncTask
+		/// Queues the messages the acquisition process writes to an
+		/// EventRing, and releases them from the ring, in the order
+		/// of the ring, once the server has acknowledged them. The
+		/// messages an uploader has not delivered when it stops or
+		/// crashes are read again by the next one.
+	{
+	public:
+		RingReader(AsyncClient& client, EventRing& ring);
+		~RingReader();
+
+		void acknowledged(Poco::UInt32 end);
+			/// Marks the message ending at the given position as
+			/// delivered, and releases the delivered messages at the
+			/// start of the ring.
+
+	protected:
+		void resume();
+
+	private:
+		AsyncClient& _client;
+		EventRing& _ring;
+		Message _message;
+		std::deque<std::pair<Poco::UInt32, bool> > _unreleased;
+	};
+
+	class ModemLineReader: public AsyncTask
+		/// Queues a message for every event of a ModemLineMonitor.
+	{
+	public:
+		ModemLineReader(AsyncClient& client, ModemLineMonitor& monitor);
+		~ModemLineReader();
+
+	protected:
+		void resume();
+
+	private:
+		AsyncClient& _client;
+		ModemLineMonitor& _monitor;
+		ModemLineMonitor::Event _event;
+	};
+
+	class SerialCounterReader: public AsyncTask
+		/// Polls SerialCounters periodically and queues their messages.
+	{
+	public:
+		SerialCounterReader(AsyncClient& client, SerialCounters& counters, const Poco::Timespan& interval);
+		~SerialCounterReader();
+
+	protected:
+		void resume();
+
+	private:
+		AsyncClient& _client;
+		SerialCounters& _counters;
+		Poco::Timespan _interval;
+		std::vector<std::string> _messages;
+	};
+
+	AsyncClient(const Poco::URI& uri, Poco::Net::Context::Ptr pContext, Seal seal, int connections);
+		/// Creates the AsyncClient with the given number of Uploader
+		/// tasks. pContext may be null for plain HTTP.
+
+	virtual ~AsyncClient();
+		/// Destroys the AsyncClient.
+
+	void readSerial(int fd);
+		/// Adds a SerialReader for the given (non-blocking) descriptor.
+
+	void readSensors(int fd, const Poco::Timespan& window, bool raw, std::size_t maxPoints);
+		/// Adds a SensorReader for the given (non-blocking) descriptor,
+		/// instead of a SerialReader, for a UART that sends numeric
+		/// readings: every window, the minimum, maximum, average and
+		/// last reading of each channel are queued, and with raw, the
+		/// readings as a compressed series of up to maxPoints points
+		/// (see SeriesEncoder).
+
+	void readRing(EventRing& ring);
+		/// Adds a RingReader for the given EventRing, instead of
+		/// reading the UART in this process.
+
+	void readModemLines(ModemLineMonitor& monitor);
+		/// Adds a ModemLineReader for the events of the given monitor,
+		/// which the caller starts.
+
+	void watchSerialCounters(SerialCounters& counters, const Poco::Timespan& interval);
+		/// Adds a SerialCounterReader that polls the given counters
+		/// every interval. It stops if the driver has no counters.
+
+	void post(const std::string& message);
+		/// Queues a message and wakes an idle Uploader.
+
+	void run();
+		/// Runs the EventLoop until stop() is called, or until the
+		/// queue is empty and no SerialReader, RingReader or
+		/// ModemLineReader is running.
+
+	void stop();
+		/// Makes run() return.
+
+	std::size_t pending() const;
+		/// Returns the number of queued messages, including those
+		/// being sealed or batched.
+
+	void setMaxQueued(std::size_t maxQueued);
+		/// Limits the number of messages queued for upload, 10000 by
+		/// default, so that an outage cannot use up the memory. When
+		/// the queue is full, the oldest message that is not escalated
+		/// is dropped for a new one, and RingReaders leave the
+		/// messages in the EventRing until there is room again. Once
+		/// the queue has drained to half the limit, the number of
+		/// dropped messages is uploaded as
+		/// "!!!!...QUEUE OVERFLOW dropped=N...!!!!".
+
+	bool full() const;
+		/// Returns true if the queue has reached its limit.
+
+	EventLoop& loop();
+		/// Returns the EventLoop, for running further tasks on it.
+
+	void setTimeout(const Poco::Timespan& timeout);
+		/// Sets the timeout for connecting, sending and receiving.
+		/// The default is 30 seconds.
+
+	const Poco::Timespan& getTimeout() const;
+		/// Returns the timeout for connecting, sending and receiving.
+
+	void setRetryDelay(const Poco::Timespan& delay);
+		/// Sets the delay before an Uploader reconnects after an
+		/// error. The default is 5 seconds.
+
+	const Poco::Timespan& getRetryDelay() const;
+		/// Returns the delay before an Uploader reconnects.
+
+	void setAddress(const Poco::Net::SocketAddress& address);
+		/// Makes the Uploaders connect to the given address instead
+		/// of the host of the URI, for example to a FaultProxy.
+
+	void pollConfig(const std::string& path, const Poco::Timespan& wait);
+		/// Applies the configuration pushed earlier and saved in the
+		/// given file, if any, and starts a task that long-polls the
+		/// server for changes (see RemoteConfig) over its own
+		/// keep-alive connection, each poll held by the server for up
+		/// to wait. Every change is applied with configure() as a
+		/// whole, or not at all, and saved to the file.
+		///
+		/// Removing a key on the server restores the setting the
+		/// client had when pollConfig() was called. If the server
+		/// does not push configuration (404), the task ends. A poll
+		/// the server does not hold, because it holds too many, is
+		/// repeated after its Retry-After.
+
+	void receiveCommands(const std::string& deviceId, const std::string& deviceKey, int fd, const Poco::Timespan& wait);
+		/// Starts a task that long-polls the server for the commands
+		/// queued for the device (see the server's CommandQueue) over
+		/// its own keep-alive connection, each poll held by the server
+		/// for up to wait, and writes them, in order, to the given
+		/// (non-blocking) descriptor of the serial port. A command not
+		/// written within the timeout has failed. The results are
+		/// reported with the next poll, which follows at once.
+		///
+		/// Every poll is authenticated with an HMAC of the device's
+		/// psk key over the device id, a sequence taken from the
+		/// clock, and the ids reported; the server refuses it (403)
+		/// if the clock is off by more than its maximum skew.
+		///
+		/// If the server has no command channel (404), the task ends.
+		/// A poll the server does not hold is repeated after its
+		/// Retry-After, as with pollConfig().
+
+	void setRules(RuleEngine& rules);
+		/// Passes every message through the given RuleEngine before it
+		/// is sealed: suppressed, rate limited and aggregated messages
+		/// are dropped (and released from the EventRing), escalated
+		/// ones are uploaded before the queued ones. A task flushes
+		/// the summaries of the rate limits and aggregates every
+		/// second.
+
+	const RemoteConfig& remoteConfig() const;
+		/// Returns the configuration pushed by the server.
+
+	void setDrain(int maxConnections, std::size_t backlog);
+		/// Enables the drain mode: when more than backlog messages are
+		/// queued, for example after an outage, up to maxConnections
+		/// Uploaders post them in parallel, instead of the number
+		/// given to the constructor.
+		///
+		/// The number in use is adapted every second: it doubles while
+		/// the messages acknowledged per second increase, then keeps
+		/// moving by one in the direction that increases them. It is
+		/// halved when an upload fails, and doubles again from there. When the queue is empty the client
+		/// goes back to the number given to the constructor.
+		///
+		/// Every message is numbered in X-Sequence when it is queued,
+		/// so that the server can put messages posted in parallel, or
+		/// again after a failure, back into order.
+
+	void discover(const std::string& type, const Poco::Net::SocketAddress& address, const std::string& cachePath, const Poco::Timespan& timeout);
+		/// Finds the server with DNS-SD (see ServiceDiscovery) instead
+		/// of the host and port of the URI, asking the given address,
+		/// usually the mDNS group.
+		///
+		/// The server found is kept in the given file until its TTL
+		/// expires: a client started in the meantime uses it at once,
+		/// without a query. A task on the EventLoop queries again when
+		/// the TTL expires, and at once when an upload cannot connect,
+		/// and moves the Uploaders to the server it finds. A query not
+		/// answered within the timeout is repeated after the retry
+		/// delay; until then the last server found, or the host of the
+		/// URI, is kept. Without a server in the file, uploads wait
+		/// for the first query.
+		///
+		/// A server pushed with client.uri (see pollConfig()) takes
+		/// precedence over the one found.
+
+	void setBatch(SealBatch seal, std::size_t size, const Poco::Timespan& window);
+		/// Collects the messages into batches of up to size messages,
+		/// each uploaded as one request sealed with the given function,
+		/// so that sign mode signs, and the server verifies, once per
+		/// batch instead of once per message. A batch is queued when it
+		/// is full, or window after its first message.
+		///
+		/// Escalated messages are not batched. Batches are sealed by
+		/// the Uploaders, not by the SealPool.
+
+	void setSealThreads(int threads, const std::vector<int>& cpus);
+		/// Seals the messages on the given number of worker threads
+		/// (see SealPool), bound to the given CPUs if cpus is not
+		/// empty, instead of on the EventLoop thread before each
+		/// upload. The seal function must be thread-safe.
+		///
+		/// Messages are queued for upload as they are sealed, which
+		/// may be out of order; their X-Sequence is assigned before.
+
+protected:
+	virtual void acknowledged(const Uploader& uploader, const std::string& message, const Poco::Net::HTTPResponse& response, const std::string& body);
+		/// Reports a message that has been posted and the response.
+		/// The default implementation prints them.
+
+	virtual void failed(const Uploader& uploader, const Poco::Exception& exc);
+		/// Reports an upload that failed and will be retried. The
+		/// default implementation prints the error.
+
+	virtual void configure(const RemoteConfig::Map& values);
+		/// Applies pushed configuration values. Checks all values
+		/// before it changes anything, and throws a Poco::Exception
+		/// if one is invalid.
+		///
+		/// The default implementation applies client.async.timeout and
+		/// client.async.retryDelay (seconds) and client.uri, which
+		/// moves the Uploaders to another server with their next
+		/// message. Other keys are ignored.
+
+private:
+	class ConfigPoller;
+	class CommandPoller;
+	class RuleFlusher;
+	class BatchFlusher;
+	class DrainController;
+	class SealCollector;
+	class Discoverer;
+	struct SealJob;
+
+	enum
+	{
+		DEFAULT_MAX_QUEUED = 10000,
+		DRAIN_INTERVAL = 1, /// seconds between adaptations in the drain mode
+		RULE_FLUSH_INTERVAL = 1 /// seconds between flushes of the RuleEngine
+	};
+
+	bool adapt();
+		/// Adapts the number of Uploaders in the drain mode. Returns
+		/// false when the backlog is drained.
+
+	void throttle();
+		/// Halves the number of Uploaders in the drain mode after a
+		/// failed upload.
+
+	bool configured(const Poco::Net::HTTPResponse& response, const std::string& body);
+		/// Applies a response to a configuration poll. Returns false if
+		/// the server does not push configuration.
+
+	void post(const Message& message);
+		/// Applies the rules to a message and submits it.
+
+	void submit(const Message& message);
+		/// Numbers a message and seals or queues it.
+
+	void enqueue(const Message& message);
+		/// Queues a message for upload and wakes an idle Uploader.
+
+	void addToBatch(const Message& message);
+		/// Adds a message to the current batch, and queues the batch
+		/// when it is full.
+
+	void flushBatch();
+		/// Numbers the current batch and queues it.
+
+	void release(const Message& message);
+		/// Releases a delivered or dropped message (all messages of a
+		/// batch) from the EventRing it came from.
+
+	void flushRules();
+		/// Submits the summaries of the RuleEngine.
+
+	void collect();
+		/// Queues the messages the SealPool has sealed.
+
+	void moveTo(const ServiceDiscovery::Instance& instance);
+		/// Moves the Uploaders to a server found by the Discoverer.
+
+	void rediscover();
+		/// Makes the Discoverer query again, after a failed connection.
+
+	void discovered();
+		/// Lets the Uploaders start after the first query.
+
+	bool next(Message& message, Uploader& uploader);
+		/// Takes the next message from the queue. If there is none,
+		/// the uploader is put on the idle list and false is returned.
+
+	void requeue(const Message& message);
+		/// Puts a message that could not be posted back at the front
+		/// of the queue.
+
+	bool wakeIdle();
+		/// Wakes an idle Uploader that may take messages. Returns
+		/// false if there is none.
+
+	EventLoop _loop;
+	Poco::URI _uri;
+	Poco::Net::Context::Ptr _pContext;
+	Seal _seal;
+	Poco::Timespan _timeout;
+	Poco::Timespan _retryDelay;
+	std::deque<Message> _queue;
+	std::vector<Poco::SharedPtr<Uploader> > _uploaders;
+	std::vector<Poco::SharedPtr<SerialReader> > _readers;
+	std::vector<Poco::SharedPtr<SensorReader> > _sensorReaders;
+	std::vector<Poco::SharedPtr<RingReader> > _ringReaders;
+	std::vector<Poco::SharedPtr<ModemLineReader> > _lineReaders;
+	std::vector<Poco::SharedPtr<SerialCounterReader> > _counterReaders;
+	std::deque<Uploader*> _idle;
+	Poco::SharedPtr<ConfigPoller> _pConfigPoller;
+	Poco::SharedPtr<CommandPoller> _pCommandPoller;
+	RuleEngine* _pRules;
+	Poco::SharedPtr<RuleFlusher> _pRuleFlusher;
+	SealBatch _sealBatch;
+	std::size_t _batchSize;
+	Poco::Timespan _batchWindow;
+	Message _batch;
+	Poco::Clock _batchStarted;
+	Poco::SharedPtr<BatchFlusher> _pBatchFlusher;
+	Poco::SharedPtr<DrainController> _pDrainController;
+	Poco::SharedPtr<SealPool> _pSealPool;
+	Poco::SharedPtr<SealCollector> _pSealCollector;
+	std::size_t _sealing;
+	std::size_t _maxQueued;
+	std::size_t _overflowed;
+	Poco::SharedPtr<Discoverer> _pDiscoverer;
+	ServiceDiscovery::Instance _discovered;
+	bool _discovering;
+	int _connections;
+	int _maxConnections;
+	int _active;
+	std::size_t _drainBacklog;
+	bool _draining;
+	int _direction;
+	bool _slowStart;
+	int _delivered;
+	double _lastRate;
+	Poco::UInt32 _sequence;
+	RemoteConfig _remoteConfig;
+	std::string _configPath;
+	Poco::Timespan _configWait;
+	Poco::URI _localURI;
+	Poco::Timespan _localTimeout;
+	Poco::Timespan _localRetryDelay;
+
+	friend class Uploader;
+	friend class SerialReader;
+	friend class SensorReader;
+	friend class RingReader;
+	friend class ModemLineReader;
+	friend class SerialCounterReader;
+	friend class ConfigPoller;
+	friend class CommandPoller;
+	friend class RuleFlusher;
+	friend class BatchFlusher;
+	friend class DrainController;
+	friend class SealCollector;
+	friend class Discoverer;
+};
+
+
+//
+// inlines
+//
+inline AsyncClient::Poster::Poster(AsyncClient& client):
+	_pClient(&client)
+{
+}
+
+
+inline void AsyncClient::Poster::push(const std::string& message)
+{
+	_pClient->post(message);
+}
+
+
+inline void AsyncClient::Poster::flush()
+{
+}
+
+
+inline int AsyncClient::Uploader::id() const
+{
+	return _id;
+}
+
+
+inline std::size_t AsyncClient::pending() const
+{
+	return _queue.size() + _sealing + _batch.batch.size();
+}
+
+
+inline bool AsyncClient::full() const
+{
+	return _maxQueued > 0 && _queue.size() >= _maxQueued;
+}
+
+
+inline EventLoop& AsyncClient::loop()
+{
+	return _loop;
+}
+
+
+inline const Poco::Timespan& AsyncClient::getTimeout() const
+{
+	return _timeout;
+}
+
+
+inline const Poco::Timespan& AsyncClient::getRetryDelay() const
+{
+	return _retryDelay;
+}
+
+
+inline const RemoteConfig& AsyncClient::remoteConfig() const
+{
+	return _remoteConfig;
+}
+
+
+#endif // AsyncClient_INCLUDED
@@ -0,0 +1,213 @@
+//
+// AsyncConnection.cpp
+//
+// Implementation of the AsyncConnection class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "AsyncConnection.h"
+#include "Poco/Net/SecureStreamSocket.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/Exception.h"
+#include <sstream>
+#include <errno.h>
+
+
+AsyncConnection::AsyncConnection(const std::string& host, Poco::UInt16 port, Poco::Net::Context::Ptr pContext):
+	_host(host),
+	_port(port),
+	_address(host, port),
+	_pContext(pContext),
+	_state(STATE_CLOSED),
+	_moved(false),
+	_sent(0),
+	_buffer(BUFFER_SIZE),
+	_headerLength(0)
+{
+}
+
+
+AsyncConnection::~AsyncConnection()
+{
+	close();
+}
+
+
+AsyncConnection::IO AsyncConnection::connect()
+{
+	// an idle keep-alive connection has nothing to read unless the
+	// server has closed it, and is not used after setServer()
+	if (_state == STATE_OPEN && (_moved || _socket.poll(Poco::Timespan(0), Poco::Net::Socket::SELECT_READ | Poco::Net::Socket::SELECT_ERROR)))
+		close();
+	if (_state == STATE_CLOSED)
+	{
+		_moved = false;
+		_socket = Poco::Net::StreamSocket();
+		_socket.connectNB(_address);
+		_state = STATE_CONNECTING;
+		return IO_WANT_WRITE;
+	}
+	if (_state == STATE_CONNECTING)
+	{
+		int error = _socket.impl()->socketError();
+		if (error != 0)
+		{
+			close();
+			throw Poco::Net::NetException("Cannot connect to " + _address.toString(), error);
+		}
+		_socket.setNoDelay(true);
+		if (!_pContext)
+		{
+			_state = STATE_OPEN;
+			return IO_DONE;
+		}
+		_socket = Poco::Net::SecureStreamSocket::attach(_socket, _host, _pContext, _pSession);
+		_state = STATE_HANDSHAKING;
+	}
+	if (_state == STATE_HANDSHAKING)
+	{
+		Poco::Net::SecureStreamSocket socket(_socket);
+		int rc = socket.completeHandshake();
+		if (rc != 1) return result(rc);
+		socket.verifyPeerCertificate();
+		_pSession = socket.currentSession();
+		_state = STATE_OPEN;
+	}
+	return IO_DONE;
+}
+
+
+void AsyncConnection::prepare(Poco::Net::HTTPRequest& request, const std::string& body)
+{
+	request.setHost(_host, _port);
+	request.setKeepAlive(true);
+	request.setContentLength(static_cast<std::streamsize>(body.size()));
+	std::ostringstream ostr;
+	request.write(ostr);
+	_out = ostr.str();
+	_out += body;
+	_sent = 0;
+}
+
+
+AsyncConnection::IO AsyncConnection::send()
+{
+	while (_sent < _out.size())
+	{
+		int n;
+		try
+		{
+			n = _socket.sendBytes(_out.data() + _sent, static_cast<int>(_out.size() - _sent));
+		}
+		catch (Poco::IOException& exc)
+		{
+			// a non-blocking plain socket reports a full send buffer
+			// as an exception
+			if (exc.code() != EAGAIN && exc.code() != EWOULDBLOCK) throw;
+			return IO_WANT_WRITE;
+		}
+		if (n < 0) return result(n);
+		_sent += n;
+	}
+	return IO_DONE;
+}
+
+
+AsyncConnection::IO AsyncConnection::receive()
+{
+	for (;;)
+	{
+		if (parse())
+		{
+			if (!_response.getKeepAlive()) close();
+			return IO_DONE;
+		}
+		int n = _socket.receiveBytes(&_buffer[0], static_cast<int>(_buffer.size()));
+		if (n < 0) return result(n);
+		if (n == 0)
+		{
+			if (_headerLength > 0 && !_response.hasContentLength())
+			{
+				// the body of a response without Content-Length
+				// ends with the connection
+				_body.assign(_in, _headerLength, std::string::npos);
+				_in.clear();
+				_headerLength = 0;
+				close();
+				return IO_DONE;
+			}
+			close();
+			throw Poco::Net::ConnectionResetException("Connection closed by server");
+		}
+		_in.append(&_buffer[0], n);
+	}
+}
+
+
+void AsyncConnection::setServer(const std::string& host, Poco::UInt16 port)
+{
+	setServer(host, Poco::Net::SocketAddress(host, port));
+}
+
+
+void AsyncConnection::setServer(const std::string& host, const Poco::Net::SocketAddress& address)
+{
+	_address = address;
+	_host = host;
+	_port = address.port();
+	_pSession = 0;
+	_moved = true;
+}
+
+
+void AsyncConnection::close()
+{
+	if (_state != STATE_CLOSED)
+	{
+		try
+		{
+			_socket.close();
+		}
+		catch (Poco::Exception&)
+		{
+		}
+		_state = STATE_CLOSED;
+	}
+	_in.clear();
+	_headerLength = 0;
+}
+
+
+bool AsyncConnection::parse()
+{
+	if (_headerLength == 0)
+	{
+		std::string::size_type pos = _in.find("\r\n\r\n");
+		if (pos == std::string::npos)
+		{
+			if (_in.size() > MAX_HEADER_SIZE) throw Poco::Net::MessageException("Response header too long");
+			return false;
+		}
+		_headerLength = pos + 4;
+		std::istringstream istr(_in.substr(0, _headerLength));
+		_response.clear();
+		_response.read(istr);
+		if (_response.getChunkedTransferEncoding())
+			throw Poco::Net::MessageException("Chunked responses are not supported");
+	}
+	if (!_response.hasContentLength()) return false;
+	std::size_t length = static_cast<std::size_t>(_response.getContentLength64());
+	if (_in.size() - _headerLength < length) return false;
+	_body.assign(_in, _headerLength, length);
+	_in.erase(0, _headerLength + length);
+	_headerLength = 0;
+	return true;
+}
+
+
+AsyncConnection::IO AsyncConnection::result(int rc) const
+{
+	return rc == Poco::Net::SecureStreamSocket::ERR_SSL_WANT_WRITE ? IO_WANT_WRITE : IO_WANT_READ;
+}
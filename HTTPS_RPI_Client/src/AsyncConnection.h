@@ -0,0 +1,175 @@
+//
+// AsyncConnection.h
+//
+// Definition of the AsyncConnection class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef AsyncConnection_INCLUDED
+#define AsyncConnection_INCLUDED
+
+
+#include "Poco/Net/StreamSocket.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Net/HTTPRequest.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/Context.h"
+#include "Poco/Net/Session.h"
+#include <string>
+#include <vector>
+
+
+class AsyncConnection
+	/// A non-blocking HTTP/1.1 keep-alive client connection, over TLS
+	/// if a Context is given, for use by an AsyncTask.
+	///
+	/// connect(), send() and receive() do as much as they can without
+	/// blocking and return IO_DONE, or what the socket has to become
+	/// ready for before they are called again:
+	///
+	///     while ((_io = _connection.send()) != AsyncConnection::IO_DONE)
+	///         ASYNC_AWAIT(awaitIO(_io));
+	///
+	/// The TLS session is kept and offered again when the connection is
+	/// re-established, which saves the full handshake on reconnects if
+	/// the Context has the session cache enabled.
+{
+public:
+	enum IO
+	{
+		IO_DONE,
+		IO_WANT_READ,
+		IO_WANT_WRITE
+	};
+
+	enum
+	{
+		BUFFER_SIZE     = 4096,
+		MAX_HEADER_SIZE = 16384
+	};
+
+	AsyncConnection(const std::string& host, Poco::UInt16 port, Poco::Net::Context::Ptr pContext);
+		/// Creates the AsyncConnection. The host name is resolved
+		/// here, the connection is established by connect().
+		/// pContext may be null for plain HTTP.
+
+	~AsyncConnection();
+		/// Destroys the AsyncConnection and closes the socket.
+
+	IO connect();
+		/// Establishes the TCP connection and performs the TLS
+		/// handshake and the certificate validation. Returns IO_DONE
+		/// at once if the connection is open and has not been closed
+		/// by the server.
+
+	void prepare(Poco::Net::HTTPRequest& request, const std::string& body);
+		/// Sets the Host, Content-Length and Connection headers of the
+		/// request and assembles request and body for send().
+
+	IO send();
+		/// Sends the request given to prepare(), as one write if the
+		/// socket takes all of it.
+
+	IO receive();
+		/// Receives a response. On IO_DONE, response() and body() hold
+		/// it, and the connection is closed if the server did not
+		/// keep it alive.
+
+	void close();
+		/// Closes the connection. The next connect() opens a new one.
+
+	void setAddress(const Poco::Net::SocketAddress& address);
+		/// Connects to the given address instead of the host, for
+		/// example to a FaultProxy in front of it. The host name is
+		/// still used for the Host header and the TLS certificate.
+		/// Takes effect with the next connection.
+
+	void setServer(const std::string& host, Poco::UInt16 port);
+		/// Makes the next connect() connect to another server, closing
+		/// the connection to the current one if it is open. A request
+		/// in progress is completed with the current server. Replaces
+		/// an address given to setAddress().
+
+	void setServer(const std::string& host, const Poco::Net::SocketAddress& address);
+		/// Like setServer() above, but connects to the given address
+		/// without looking up the host name, which is still used for
+		/// the Host header and the TLS certificate.
+
+	bool connected() const;
+		/// Returns true if the connection is open.
+
+	int sockfd() const;
+		/// Returns the socket descriptor to wait for.
+
+	const Poco::Net::HTTPResponse& response() const;
+		/// Returns the response received last.
+
+	const std::string& body() const;
+		/// Returns the body of the response received last.
+
+private:
+	enum State
+	{
+		STATE_CLOSED,
+		STATE_CONNECTING,
+		STATE_HANDSHAKING,
+		STATE_OPEN
+	};
+
+	bool parse();
+	IO result(int rc) const;
+
+	std::string _host;
+	Poco::UInt16 _port;
+	Poco::Net::SocketAddress _address;
+	Poco::Net::Context::Ptr _pContext;
+	Poco::Net::Session::Ptr _pSession;
+	Poco::Net::StreamSocket _socket;
+	State _state;
+	bool _moved;
+	std::string _out;
+	std::size_t _sent;
+	std::vector<char> _buffer;
+	std::string _in;
+	std::size_t _headerLength;
+	Poco::Net::HTTPResponse _response;
+	std::string _body;
+};
+
+
+//
+// inlines
+//
+inline void AsyncConnection::setAddress(const Poco::Net::SocketAddress& address)
+{
+	_address = address;
+}
+
+
+inline bool AsyncConnection::connected() const
+{
+	return _state == STATE_OPEN;
+}
+
+
+inline int AsyncConnection::sockfd() const
+{
+	return _socket.impl()->sockfd();
+}
+
+
+inline const Poco::Net::HTTPResponse& AsyncConnection::response() const
+{
+	return _response;
+}
+
+
+inline const std::string& AsyncConnection::body() const
+{
+	return _body;
+}
+
+
+#endif // AsyncConnection_INCLUDED
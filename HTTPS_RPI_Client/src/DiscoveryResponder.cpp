@@ -0,0 +1,180 @@
+//
+// DiscoveryResponder.cpp
+//
+// Implementation of the DiscoveryResponder class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "DiscoveryResponder.h"
+#include "Poco/Net/IPAddress.h"
+#include "Poco/Exception.h"
+#include "Poco/String.h"
+
+
+namespace
+{
+	void appendUInt16(std::string& s, Poco::UInt16 n)
+	{
+		s += static_cast<char>(n >> 8);
+		s += static_cast<char>(n & 0xFF);
+	}
+
+	void appendRecord(std::string& s, const std::string& owner, Poco::UInt16 type, bool unique, Poco::UInt32 ttl, const std::string& data)
+	{
+		s += ServiceDiscovery::encodeName(owner);
+		appendUInt16(s, type);
+		// the cache-flush bit marks the records only this host has
+		appendUInt16(s, unique ? 0x8001 : 0x0001);
+		appendUInt16(s, static_cast<Poco::UInt16>(ttl >> 16));
+		appendUInt16(s, static_cast<Poco::UInt16>(ttl & 0xFFFF));
+		appendUInt16(s, static_cast<Poco::UInt16>(data.size()));
+		s += data;
+	}
+}
+
+
+DiscoveryResponder::DiscoveryResponder(const Poco::Net::SocketAddress& address, const std::string& type, const ServiceDiscovery::Instance& instance):
+	_socket(address),
+	_service(type + ".local"),
+	_instance(instance),
+	_stopped(false),
+	_queries(0)
+{
+}
+
+
+DiscoveryResponder::~DiscoveryResponder()
+{
+	try
+	{
+		stop();
+	}
+	catch (...)
+	{
+		poco_unexpected();
+	}
+}
+
+
+void DiscoveryResponder::start()
+{
+	_stopped = false;
+	_thread.start(*this);
+}
+
+
+void DiscoveryResponder::stop()
+{
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_stopped = true;
+	}
+	if (_thread.isRunning()) _thread.join();
+}
+
+
+Poco::Net::SocketAddress DiscoveryResponder::address() const
+{
+	return _socket.address();
+}
+
+
+void DiscoveryResponder::setInstance(const ServiceDiscovery::Instance& instance)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_instance = instance;
+}
+
+
+int DiscoveryResponder::queries() const
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _queries;
+}
+
+
+void DiscoveryResponder::run()
+{
+	char buffer[1500];
+	for (;;)
+	{
+		{
+			Poco::FastMutex::ScopedLock lock(_mutex);
+			if (_stopped) break;
+		}
+		if (!_socket.poll(Poco::Timespan(0, 100000), Poco::Net::Socket::SELECT_READ)) continue;
+		ServiceDiscovery::Instance instance;
+		{
+			Poco::FastMutex::ScopedLock lock(_mutex);
+			instance = _instance;
+		}
+
+		Poco::Net::SocketAddress sender;
+		int n = _socket.receiveFrom(buffer, sizeof(buffer), sender);
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(buffer);
+		if (n < 12 || (p[2] & 0x80) != 0 || ((p[4] << 8) | p[5]) == 0) continue;
+		try
+		{
+			std::size_t pos = 12;
+			std::string name(Poco::toLower(ServiceDiscovery::readName(buffer, n, pos)));
+			if (pos + 4 > static_cast<std::size_t>(n)) continue;
+			Poco::UInt16 type = static_cast<Poco::UInt16>((p[pos] << 8) | p[pos + 1]);
+			if ((type == ServiceDiscovery::TYPE_PTR && name == Poco::toLower(_service)) ||
+			    (type == ServiceDiscovery::TYPE_A && name == Poco::toLower(instance.target)))
+			{
+				std::string response(encodeResponse(static_cast<Poco::UInt16>((p[0] << 8) | p[1]), _service, instance, type));
+				_socket.sendTo(response.data(), static_cast<int>(response.size()), sender);
+				Poco::FastMutex::ScopedLock lock(_mutex);
+				++_queries;
+			}
+		}
+		catch (Poco::DataFormatException&)
+		{
+		}
+	}
+}
+
+
+std::string DiscoveryResponder::encodeResponse(Poco::UInt16 id, const std::string& service, const ServiceDiscovery::Instance& instance, Poco::UInt16 type)
+{
+	Poco::Net::IPAddress ip(instance.address);
+	std::string address(reinterpret_cast<const char*>(ip.addr()), 4);
+
+	std::string r;
+	appendUInt16(r, id);
+	appendUInt16(r, 0x8400); // a response, authoritative
+	appendUInt16(r, 0);
+	appendUInt16(r, 1);
+	appendUInt16(r, 0);
+	if (type == ServiceDiscovery::TYPE_A)
+	{
+		appendUInt16(r, 0);
+		appendRecord(r, instance.target, ServiceDiscovery::TYPE_A, true, instance.ttl, address);
+		return r;
+	}
+
+	appendUInt16(r, 3);
+	appendRecord(r, service, ServiceDiscovery::TYPE_PTR, false, instance.ttl, ServiceDiscovery::encodeName(instance.name));
+
+	std::string srv;
+	appendUInt16(srv, 0);
+	appendUInt16(srv, 0);
+	appendUInt16(srv, instance.port);
+	srv += ServiceDiscovery::encodeName(instance.target);
+	appendRecord(r, instance.name, ServiceDiscovery::TYPE_SRV, true, instance.ttl, srv);
+
+	std::string txt;
+	for (Poco::Net::NameValueCollection::ConstIterator it = instance.properties.begin(); it != instance.properties.end(); ++it)
+	{
+		std::string entry(it->first + "=" + it->second);
+		if (entry.size() > 255) throw Poco::InvalidArgumentException("TXT entry too long", it->first);
+		txt += static_cast<char>(entry.size());
+		txt += entry;
+	}
+	if (txt.empty()) txt += '\0';
+	appendRecord(r, instance.name, ServiceDiscovery::TYPE_TXT, true, instance.ttl, txt);
+	appendRecord(r, instance.target, ServiceDiscovery::TYPE_A, true, instance.ttl, address);
+	return r;
+}
@@ -0,0 +1,79 @@
+//
+// DiscoveryResponder.h
+//
+// Definition of the DiscoveryResponder class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef DiscoveryResponder_INCLUDED
+#define DiscoveryResponder_INCLUDED
+
+
+#include "ServiceDiscovery.h"
+#include "Poco/Net/DatagramSocket.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Mutex.h"
+#include <string>
+
+
+class DiscoveryResponder: public Poco::Runnable
+	/// Answers the DNS-SD queries of a ServiceDiscovery for one
+	/// service instance, by unicast, on its own thread: a stand-in for
+	/// the mDNS responder (Avahi) of the server, for testing discovery
+	/// on a machine or network without one.
+	///
+	/// A query for the service type is answered with the PTR record and,
+	/// as additional records, the SRV, TXT and A records of the
+	/// instance, as an mDNS responder does. A query for the A record of
+	/// the target is answered with that record only.
+{
+public:
+	DiscoveryResponder(const Poco::Net::SocketAddress& address, const std::string& type, const ServiceDiscovery::Instance& instance);
+		/// Creates the DiscoveryResponder on the given address (port
+		/// 0 for any free one), for the given instance of the service
+		/// type. The name of the instance is the part before the
+		/// type, and its TTL is used for all records.
+
+	~DiscoveryResponder();
+		/// Stops the DiscoveryResponder.
+
+	void start();
+		/// Starts answering.
+
+	void stop();
+		/// Stops answering.
+
+	Poco::Net::SocketAddress address() const;
+		/// Returns the address the DiscoveryResponder answers on.
+
+	void setInstance(const ServiceDiscovery::Instance& instance);
+		/// Replaces the instance, for example to move the server.
+
+	int queries() const;
+		/// Returns the number of queries answered.
+
+	void run();
+		/// The thread.
+
+	static std::string encodeResponse(Poco::UInt16 id, const std::string& service, const ServiceDiscovery::Instance& instance, Poco::UInt16 type);
+		/// Returns the response to a question of the given type.
+
+private:
+	DiscoveryResponder(const DiscoveryResponder&);
+	DiscoveryResponder& operator = (const DiscoveryResponder&);
+
+	Poco::Net::DatagramSocket _socket;
+	std::string _service;
+	ServiceDiscovery::Instance _instance;
+	Poco::Thread _thread;
+	mutable Poco::FastMutex _mutex;
+	bool _stopped;
+	int _queries;
+};
+
+
+#endif // DiscoveryResponder_INCLUDED
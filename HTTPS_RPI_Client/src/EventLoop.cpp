@@ -0,0 +1,250 @@
+//
+// EventLoop.cpp
+//
+// Implementation of the EventLoop and AsyncTask classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "EventLoop.h"
+#include <vector>
+#include <errno.h>
+#include <poll.h>
+
+
+AsyncTask::AsyncTask(EventLoop& loop):
+	_line(0),
+	_loop(loop),
+	_done(false),
+	_suspended(false)
+{
+}
+
+
+AsyncTask::~AsyncTask()
+{
+	_loop.cancel(this);
+}
+
+
+void AsyncTask::start()
+{
+	_line = 0;
+	_done = false;
+	_suspended = false;
+	_loop.schedule(this, EventLoop::WAIT_READY, -1, 0);
+}
+
+
+void AsyncTask::error(const Poco::Exception& exc)
+{
+	finish();
+	exc.rethrow();
+}
+
+
+void AsyncTask::awaitReadable(int fd, const Poco::Timespan& timeout)
+{
+	_loop.schedule(this, EventLoop::WAIT_READ, fd, timeout);
+}
+
+
+void AsyncTask::awaitWritable(int fd, const Poco::Timespan& timeout)
+{
+	_loop.schedule(this, EventLoop::WAIT_WRITE, fd, timeout);
+}
+
+
+void AsyncTask::sleep(const Poco::Timespan& interval)
+{
+	_loop.schedule(this, EventLoop::WAIT_TIMER, -1, interval);
+}
+
+
+void AsyncTask::suspend()
+{
+	_loop.cancel(this);
+	_suspended = true;
+}
+
+
+void AsyncTask::suspend(const Poco::Timespan& timeout)
+{
+	_loop.schedule(this, EventLoop::WAIT_TIMER, -1, timeout);
+	_suspended = true;
+}
+
+
+void AsyncTask::yield()
+{
+	_loop.schedule(this, EventLoop::WAIT_READY, -1, 0);
+}
+
+
+void AsyncTask::wake()
+{
+	if (_suspended)
+	{
+		_suspended = false;
+		_loop.schedule(this, EventLoop::WAIT_READY, -1, 0);
+	}
+}
+
+
+void AsyncTask::restart()
+{
+	_line = 0;
+}
+
+
+void AsyncTask::finish()
+{
+	_done = true;
+	_loop.cancel(this);
+}
+
+
+EventLoop::EventLoop():
+	_stopped(false)
+{
+}
+
+
+EventLoop::~EventLoop()
+{
+}
+
+
+void EventLoop::run()
+{
+	_stopped = false;
+	while (!_stopped && (!_ready.empty() || !_waits.empty()))
+	{
+		std::vector<pollfd> fds;
+		for (WaitMap::const_iterator it = _waits.begin(); it != _waits.end(); ++it)
+		{
+			if (it->second.type == WAIT_READ || it->second.type == WAIT_WRITE)
+			{
+				pollfd pfd;
+				pfd.fd = it->second.fd;
+				pfd.events = it->second.type == WAIT_READ ? POLLIN : POLLOUT;
+				pfd.revents = 0;
+				fds.push_back(pfd);
+			}
+		}
+		int rc = ::poll(fds.empty() ? 0 : &fds[0], fds.size(), _ready.empty() ? pollTimeout() : 0);
+		if (rc < 0 && errno != EINTR) throw Poco::SystemException("poll() failed");
+
+		// POLLERR and POLLHUP wake the task too, so that its next
+		// read or write reports the error
+		Poco::Clock now;
+		std::size_t i = 0;
+		WaitMap::iterator it = _waits.begin();
+		while (it != _waits.end())
+		{
+			bool polled = it->second.type == WAIT_READ || it->second.type == WAIT_WRITE;
+			bool ready = polled && rc > 0 && fds[i].revents != 0;
+			if (polled) ++i;
+			if (ready || (it->second.hasDeadline && it->second.deadline <= now))
+			{
+				it->second.timedOut = !ready && it->second.type != WAIT_TIMER;
+				_ready.push_back(it->second);
+				_waits.erase(it++);
+			}
+			else ++it;
+		}
+		runReady();
+	}
+}
+
+
+void EventLoop::stop()
+{
+	_stopped = true;
+}
+
+
+void EventLoop::schedule(AsyncTask* pTask, WaitType type, int fd, const Poco::Timespan& timeout)
+{
+	cancel(pTask);
+	Wait wait;
+	wait.pTask = pTask;
+	wait.type = type;
+	wait.fd = fd;
+	// a timer is always due, at once if its timeout is not positive;
+	// for a descriptor, 0 means no timeout
+	wait.hasDeadline = type == WAIT_TIMER || (type != WAIT_READY && timeout.totalMicroseconds() > 0);
+	if (wait.hasDeadline) wait.deadline = Poco::Clock() + (timeout.totalMicroseconds() > 0 ? timeout.totalMicroseconds() : 0);
+	wait.timedOut = false;
+	if (type == WAIT_READY)
+		_ready.push_back(wait);
+	else
+		_waits[pTask] = wait;
+}
+
+
+void EventLoop::cancel(AsyncTask* pTask)
+{
+	_waits.erase(pTask);
+	std::deque<Wait>::iterator it = _ready.begin();
+	while (it != _ready.end())
+	{
+		if (it->pTask == pTask)
+			it = _ready.erase(it);
+		else
+			++it;
+	}
+	pTask->_suspended = false;
+}
+
+
+void EventLoop::runReady()
+{
+	// tasks that yield or become ready while this runs wait for the
+	// next iteration, so that they cannot starve the file descriptors
+	std::size_t n = _ready.size();
+	while (n-- > 0 && !_ready.empty() && !_stopped)
+	{
+		Wait wait = _ready.front();
+		_ready.pop_front();
+		resume(wait);
+	}
+}
+
+
+int EventLoop::pollTimeout() const
+{
+	bool hasDeadline = false;
+	Poco::Clock deadline;
+	for (WaitMap::const_iterator it = _waits.begin(); it != _waits.end(); ++it)
+	{
+		if (it->second.hasDeadline && (!hasDeadline || it->second.deadline < deadline))
+		{
+			deadline = it->second.deadline;
+			hasDeadline = true;
+		}
+	}
+	if (!hasDeadline) return -1;
+	Poco::Clock::ClockDiff diff = deadline - Poco::Clock();
+	return diff > 0 ? static_cast<int>((diff + 999)/1000) : 0;
+}
+
+
+void EventLoop::resume(const Wait& wait)
+{
+	wait.pTask->_suspended = false;
+	if (wait.timedOut)
+	{
+		wait.pTask->error(Poco::TimeoutException("Timeout waiting for socket"));
+		return;
+	}
+	try
+	{
+		wait.pTask->resume();
+	}
+	catch (Poco::Exception& exc)
+	{
+		wait.pTask->error(exc);
+	}
+}
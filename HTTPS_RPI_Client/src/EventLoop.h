@@ -0,0 +1,213 @@
+//
+// EventLoop.h
+//
+// Definition of the EventLoop and AsyncTask classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef EventLoop_INCLUDED
+#define EventLoop_INCLUDED
+
+
+#include "Poco/Clock.h"
+#include "Poco/Exception.h"
+#include "Poco/Timespan.h"
+#include <deque>
+#include <map>
+
+
+class EventLoop;
+
+
+class AsyncTask
+	/// A stackless coroutine run by an EventLoop.
+	///
+	/// resume() runs the task until it has to wait for a file
+	/// descriptor, a timer or another task, registers the wait with
+	/// one of the await functions and returns. The EventLoop calls
+	/// resume() again when the wait is over. The ASYNC_BEGIN,
+	/// ASYNC_AWAIT and ASYNC_END macros let resume() be written as
+	/// straight-line code:
+	///
+	///     void resume()
+	///     {
+	///         ASYNC_BEGIN
+	///         for (;;)
+	///         {
+	///             ASYNC_AWAIT(awaitReadable(_fd));
+	///             ...
+	///         }
+	///         ASYNC_END
+	///     }
+	///
+	/// Like any stackless coroutine, resume() does not keep local
+	/// variables across an ASYNC_AWAIT, so state lives in members,
+	/// and ASYNC_AWAIT must not be used inside a switch or a try block.
+{
+public:
+	AsyncTask(EventLoop& loop);
+		/// Creates the AsyncTask. It does not run until start()
+		/// is called.
+
+	virtual ~AsyncTask();
+		/// Destroys the AsyncTask and cancels its wait.
+
+	void start();
+		/// Schedules the task to run from the beginning.
+
+	bool done() const;
+		/// Returns true if the task has run to its end.
+
+	EventLoop& loop() const;
+		/// Returns the EventLoop of the task.
+
+	void wake();
+		/// Schedules a suspended task to run. Does nothing if the
+		/// task is not suspended.
+
+protected:
+	virtual void resume() = 0;
+		/// Runs the task up to its next wait or its end.
+
+	virtual void error(const Poco::Exception& exc);
+		/// Called by the EventLoop if resume() throws. The default
+		/// implementation ends the task and rethrows the exception,
+		/// which stops EventLoop::run().
+
+	void awaitReadable(int fd, const Poco::Timespan& timeout = 0);
+		/// Resumes the task when fd can be read. If the timeout (if
+		/// not 0) expires first, error() is called instead with a
+		/// Poco::TimeoutException.
+
+	void awaitWritable(int fd, const Poco::Timespan& timeout = 0);
+		/// Resumes the task when fd can be written. If the timeout (if
+		/// not 0) expires first, error() is called instead with a
+		/// Poco::TimeoutException.
+
+	void sleep(const Poco::Timespan& interval);
+		/// Resumes the task after the given interval. An interval of
+		/// 0 or less resumes it in the next iteration of the loop.
+
+	void suspend();
+		/// Resumes the task when another task calls wake() for it.
+
+	void suspend(const Poco::Timespan& timeout);
+		/// Resumes the task when another task calls wake() for it, or
+		/// after the timeout. A timeout of 0 or less resumes it in
+		/// the next iteration of the loop.
+
+	void yield();
+		/// Resumes the task after the tasks that are ready now.
+
+	void restart();
+		/// Lets the next resume() run the task from the beginning.
+		/// Usually called from error().
+
+	void finish();
+		/// Ends the task. Called by ASYNC_END.
+
+	int _line;
+		/// The resumption point, maintained by the ASYNC_ macros.
+
+private:
+	AsyncTask(const AsyncTask&);
+	AsyncTask& operator = (const AsyncTask&);
+
+	EventLoop& _loop;
+	bool _done;
+	bool _suspended;
+
+	friend class EventLoop;
+};
+
+
+#define ASYNC_BEGIN \
+	switch (_line) { case 0:
+
+#define ASYNC_AWAIT(wait) \
+	do { _line = __LINE__; wait; return; case __LINE__:; } while (0)
+
+#define ASYNC_END \
+	} _line = -1; finish();
+
+
+class EventLoop
+	/// Runs AsyncTasks on the calling thread, with poll() for the
+	/// file descriptors they wait for.
+	///
+	/// While one task waits for the network, another can read the
+	/// serial port or encrypt a message, so capture, encryption and
+	/// several uploads overlap on one thread without locking.
+	///
+	/// Deadlines are kept on the monotonic Poco::Clock, so that a step
+	/// of the system time, as NTP makes on a board without an RTC,
+	/// neither fires all timers at once nor holds them back.
+{
+public:
+	EventLoop();
+		/// Creates the EventLoop.
+
+	~EventLoop();
+		/// Destroys the EventLoop. The tasks are not owned by it.
+
+	void run();
+		/// Runs the tasks until none of them waits for anything or
+		/// stop() is called.
+
+	void stop();
+		/// Makes run() return after the current iteration.
+
+protected:
+	enum WaitType
+	{
+		WAIT_READY,
+		WAIT_READ,
+		WAIT_WRITE,
+		WAIT_TIMER
+	};
+
+	struct Wait
+	{
+		AsyncTask* pTask;
+		WaitType type;
+		int fd;
+		Poco::Clock deadline;
+		bool hasDeadline;
+		bool timedOut;
+	};
+
+	void schedule(AsyncTask* pTask, WaitType type, int fd, const Poco::Timespan& timeout);
+	void cancel(AsyncTask* pTask);
+	void runReady();
+	int pollTimeout() const;
+	void resume(const Wait& wait);
+
+private:
+	typedef std::map<AsyncTask*, Wait> WaitMap;
+
+	WaitMap _waits;
+	std::deque<Wait> _ready;
+	bool _stopped;
+
+	friend class AsyncTask;
+};
+
+
+//
+// inlines
+//
+inline bool AsyncTask::done() const
+{
+	return _done;
+}
+
+
+inline EventLoop& AsyncTask::loop() const
+{
+	return _loop;
+}
+
+
+#endif // EventLoop_INCLUDED
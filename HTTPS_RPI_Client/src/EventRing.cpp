@@ -0,0 +1,181 @@
+//
+// EventRing.cpp
+//
+// Implementation of the EventRing class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "EventRing.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/Process.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+void EventRing::Writer::push(const std::string& message)
+{
+	if (!_pRing->push(message))
+		std::cerr << "Event ring full, " << _pRing->dropped() << " messages dropped" << std::endl;
+}
+
+
+EventRing::EventRing(const std::string& path, Poco::UInt32 capacity):
+	_memory(prepare(path, capacity), Poco::SharedMemory::AM_WRITE),
+	_pHeader(reinterpret_cast<Header*>(_memory.begin())),
+	_pData(_memory.begin() + HEADER_SIZE),
+	_capacity(0),
+	_read(0),
+	_doorbell(-1)
+{
+	std::size_t size = _memory.end() - _memory.begin();
+	if (size < HEADER_SIZE || _pHeader->magic != MAGIC || size != HEADER_SIZE + static_cast<std::size_t>(_pHeader->capacity))
+		throw Poco::DataFormatException("Not an event ring", path);
+	_capacity = _pHeader->capacity;
+	_read = _pHeader->tail;
+
+	// opened for reading and writing, so that neither process blocks
+	// or sees the end of the FIFO while the other is not running
+	std::string bell(path + ".bell");
+	if (::mkfifo(bell.c_str(), 0600) != 0 && errno != EEXIST)
+		throw Poco::CreateFileException(bell);
+	_doorbell = ::open(bell.c_str(), O_RDWR | O_NONBLOCK);
+	if (_doorbell < 0)
+		throw Poco::OpenFileException(bell);
+}
+
+
+EventRing::~EventRing()
+{
+	if (_doorbell >= 0) ::close(_doorbell);
+}
+
+
+bool EventRing::push(const std::string& message)
+{
+	Poco::UInt32 size = 4 + ((static_cast<Poco::UInt32>(message.size()) + 3) & ~3u);
+	Poco::UInt32 head = _pHeader->head;
+	Poco::UInt32 tail = _pHeader->tail;
+	// the reader has released the space up to tail before it is
+	// written again
+	__sync_synchronize();
+	Poco::UInt32 offset = head & (_capacity - 1);
+	Poco::UInt32 skip = _capacity - offset < size ? _capacity - offset : 0;
+	if (message.size() > _capacity/2 || head - tail + skip + size > _capacity)
+	{
+		_pHeader->dropped = _pHeader->dropped + 1;
+		return false;
+	}
+	if (skip)
+	{
+		// a message does not wrap around, the reader skips to the start
+		Poco::UInt32 wrap = WRAP;
+		std::memcpy(_pData + offset, &wrap, 4);
+		head += skip;
+		offset = 0;
+	}
+	Poco::UInt32 length = static_cast<Poco::UInt32>(message.size());
+	std::memcpy(_pData + offset, &length, 4);
+	std::memcpy(_pData + offset + 4, message.data(), length);
+	// publish the message after its bytes
+	__sync_synchronize();
+	_pHeader->head = head + size;
+
+	// a full FIFO has woken the reader already
+	char c = 0;
+	ssize_t rc = ::write(_doorbell, &c, 1);
+	(void) rc;
+	return true;
+}
+
+
+bool EventRing::read(std::string& message, Poco::UInt32& end)
+{
+	Poco::UInt32 head = _pHeader->head;
+	// read the bytes of the messages published up to head
+	__sync_synchronize();
+	while (_read != head)
+	{
+		Poco::UInt32 offset = _read & (_capacity - 1);
+		Poco::UInt32 length;
+		std::memcpy(&length, _pData + offset, 4);
+		if (length == WRAP)
+		{
+			_read += _capacity - offset;
+			continue;
+		}
+		if (length > _capacity - offset - 4)
+			throw Poco::DataFormatException("Corrupt event ring");
+		message.assign(_pData + offset + 4, length);
+		_read += 4 + ((length + 3) & ~3u);
+		end = _read;
+		return true;
+	}
+	return false;
+}
+
+
+void EventRing::release(Poco::UInt32 end)
+{
+	// the messages are read before their space is given back
+	__sync_synchronize();
+	_pHeader->tail = end;
+}
+
+
+void EventRing::rewind()
+{
+	_read = _pHeader->tail;
+}
+
+
+void EventRing::drain()
+{
+	char buffer[64];
+	while (::read(_doorbell, buffer, sizeof(buffer)) > 0)
+	{
+	}
+}
+
+
+Poco::UInt32 EventRing::pending() const
+{
+	return _pHeader->head - _pHeader->tail;
+}
+
+
+Poco::File EventRing::prepare(const std::string& path, Poco::UInt32 capacity)
+{
+	if (capacity < 4096 || (capacity & (capacity - 1)) != 0)
+		throw Poco::InvalidArgumentException("The capacity of an event ring must be a power of two of at least 4096");
+	Poco::File file(path);
+	if (file.exists()) return file;
+
+	// the ring is initialized under another name and linked, so that
+	// the other process never maps a ring that is not initialized,
+	// and does not replace a ring the other process has created
+	std::string tmp(path + "." + Poco::NumberFormatter::format(Poco::Process::id()));
+	{
+		std::ofstream ostr(tmp.c_str(), std::ios::binary | std::ios::trunc);
+		char header[HEADER_SIZE] = {0};
+		Poco::UInt32 fields[2] = {MAGIC, capacity};
+		std::memcpy(header, fields, sizeof(fields));
+		ostr.write(header, HEADER_SIZE);
+		ostr.seekp(static_cast<std::streamoff>(HEADER_SIZE) + capacity - 1);
+		ostr.put('\0');
+		if (!ostr) throw Poco::WriteFileException(tmp);
+	}
+	int rc = ::link(tmp.c_str(), path.c_str());
+	int error = errno;
+	::unlink(tmp.c_str());
+	if (rc != 0 && error != EEXIST)
+		throw Poco::CreateFileException(path);
+	return file;
+}
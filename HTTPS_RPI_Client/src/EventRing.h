@@ -0,0 +1,156 @@
+//
+// EventRing.h
+//
+// Definition of the EventRing class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef EventRing_INCLUDED
+#define EventRing_INCLUDED
+
+
+#include "Poco/SharedMemory.h"
+#include "Poco/File.h"
+#include "Poco/Types.h"
+#include <string>
+
+
+class EventRing
+	/// A ring buffer of messages in a memory-mapped file, handing the
+	/// events of the acquisition process ("HTTPS_ARM_Client capture")
+	/// to the uploader process without locks, for one writer and one
+	/// reader.
+	///
+	/// The writer copies a message into the ring and then publishes it
+	/// by advancing the head. The reader reads messages from its own
+	/// position and releases them, by advancing the tail, only when
+	/// the server has acknowledged them. If the uploader crashes, the
+	/// messages after the tail are still in the file and are read
+	/// again by the next uploader; if the writer crashes in the middle
+	/// of a message, the message is not published. A full ring drops
+	/// new messages and counts them.
+	///
+	/// The file is best kept on a tmpfs such as /dev/shm, which keeps
+	/// it across restarts of both processes, but not of the system.
+	///
+	/// The writer wakes the reader through a FIFO next to the file
+	/// (<path>.bell), so that the reader can wait for it in an
+	/// EventLoop.
+{
+public:
+	class Writer
+		/// A sink for SerialFlow that writes the messages to the ring.
+	{
+	public:
+		explicit Writer(EventRing& ring);
+
+		void push(const std::string& message);
+		void flush();
+
+	private:
+		EventRing* _pRing;
+	};
+
+	enum
+	{
+		DEFAULT_CAPACITY = 1048576
+	};
+
+	EventRing(const std::string& path, Poco::UInt32 capacity = DEFAULT_CAPACITY);
+		/// Opens the ring in the given file, or creates it with the
+		/// given capacity in bytes, which must be a power of two.
+		/// Both processes open the ring the same way. Throws a
+		/// Poco::DataFormatException if the file is not a ring.
+
+	~EventRing();
+		/// Unmaps the ring. The file is kept.
+
+	bool push(const std::string& message);
+		/// Writes a message and wakes the reader. Returns false if
+		/// there is no room for it.
+
+	bool read(std::string& message, Poco::UInt32& end);
+		/// Reads the next message after the last one read, and its end
+		/// position for release(). Returns false if there is none.
+
+	void release(Poco::UInt32 end);
+		/// Releases the messages up to the given end position.
+
+	void rewind();
+		/// Makes read() start again at the first message not released.
+
+	int doorbell() const;
+		/// Returns the descriptor the reader waits for, readable when
+		/// the writer has pushed messages.
+
+	void drain();
+		/// Reads the pending wakeups from the doorbell.
+
+	Poco::UInt32 pending() const;
+		/// Returns the number of bytes published but not released.
+
+	Poco::UInt32 dropped() const;
+		/// Returns the number of messages dropped because the ring
+		/// was full.
+
+private:
+	struct Header
+	{
+		Poco::UInt32 magic;
+		Poco::UInt32 capacity;
+		volatile Poco::UInt32 head;
+		volatile Poco::UInt32 tail;
+		volatile Poco::UInt32 dropped;
+	};
+
+	enum
+	{
+		MAGIC       = 0x45524e47,
+		HEADER_SIZE = 64,
+		WRAP        = 0xFFFFFFFF
+	};
+
+	static Poco::File prepare(const std::string& path, Poco::UInt32 capacity);
+		/// Creates the file if it does not exist.
+
+	EventRing(const EventRing&);
+	EventRing& operator = (const EventRing&);
+
+	Poco::SharedMemory _memory;
+	Header* _pHeader;
+	char* _pData;
+	Poco::UInt32 _capacity;
+	Poco::UInt32 _read;
+	int _doorbell;
+};
+
+
+//
+// inlines
+//
+inline EventRing::Writer::Writer(EventRing& ring):
+	_pRing(&ring)
+{
+}
+
+
+inline void EventRing::Writer::flush()
+{
+}
+
+
+inline int EventRing::doorbell() const
+{
+	return _doorbell;
+}
+
+
+inline Poco::UInt32 EventRing::dropped() const
+{
+	return _pHeader->dropped;
+}
+
+
+#endif // EventRing_INCLUDED
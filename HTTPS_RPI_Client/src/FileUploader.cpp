@@ -0,0 +1,380 @@
+//
+// FileUploader.cpp
+//
+// Implementation of the FileUploader class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "FileUploader.h"
+#include "AsyncConnection.h"
+#include "ChunkedUpload.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/File.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
+#include <fstream>
+#include <iostream>
+
+
+class FileUploader::StatusQuery: public AsyncTask
+	/// Asks the server for the chunks it has, then starts the
+	/// ChunkSenders for the missing ones.
+{
+public:
+	StatusQuery(FileUploader& uploader, std::vector<ChunkSender*>& senders):
+		AsyncTask(uploader._loop),
+		_uploader(uploader),
+		_senders(senders),
+		_connection(uploader._uri.getHost(), uploader._uri.getPort(), uploader._pContext),
+		_io(AsyncConnection::IO_DONE),
+		_retry(false)
+	{
+	}
+
+protected:
+	void resume();
+	void error(const Poco::Exception& exc);
+
+private:
+	void awaitIO(AsyncConnection::IO io)
+	{
+		if (io == AsyncConnection::IO_WANT_READ)
+			awaitReadable(_connection.sockfd(), _uploader._timeout);
+		else
+			awaitWritable(_connection.sockfd(), _uploader._timeout);
+	}
+
+	FileUploader& _uploader;
+	std::vector<ChunkSender*>& _senders;
+	AsyncConnection _connection;
+	AsyncConnection::IO _io;
+	bool _retry;
+};
+
+
+class FileUploader::ChunkSender: public AsyncTask
+	/// Sends missing chunks, one at a time, over its own connection.
+{
+public:
+	explicit ChunkSender(FileUploader& uploader):
+		AsyncTask(uploader._loop),
+		_uploader(uploader),
+		_connection(uploader._uri.getHost(), uploader._uri.getPort(), uploader._pContext),
+		_io(AsyncConnection::IO_DONE),
+		_index(0),
+		_hasChunk(false),
+		_retry(false)
+	{
+	}
+
+protected:
+	void resume();
+	void error(const Poco::Exception& exc);
+
+private:
+	void awaitIO(AsyncConnection::IO io)
+	{
+		if (io == AsyncConnection::IO_WANT_READ)
+			awaitReadable(_connection.sockfd(), _uploader._timeout);
+		else
+			awaitWritable(_connection.sockfd(), _uploader._timeout);
+	}
+
+	FileUploader& _uploader;
+	AsyncConnection _connection;
+	AsyncConnection::IO _io;
+	std::size_t _index;
+	bool _hasChunk;
+	bool _retry;
+};
+
+
+void FileUploader::StatusQuery::resume()
+{
+	ASYNC_BEGIN
+	if (_retry)
+		ASYNC_AWAIT(sleep(_uploader._retryDelay));
+	_retry = false;
+
+	while ((_io = _connection.connect()) != AsyncConnection::IO_DONE)
+		ASYNC_AWAIT(awaitIO(_io));
+	{
+		Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_GET, ChunkedUpload::PATH + _uploader._id, Poco::Net::HTTPMessage::HTTP_1_1);
+		_connection.prepare(request, std::string());
+	}
+	while ((_io = _connection.send()) != AsyncConnection::IO_DONE)
+		ASYNC_AWAIT(awaitIO(_io));
+	while ((_io = _connection.receive()) != AsyncConnection::IO_DONE)
+		ASYNC_AWAIT(awaitIO(_io));
+
+	_connection.close();
+	if (_uploader.status(_connection.response()))
+	{
+		for (std::vector<ChunkSender*>::iterator it = _senders.begin(); it != _senders.end(); ++it)
+		{
+			(*it)->start();
+		}
+	}
+	ASYNC_END
+}
+
+
+void FileUploader::StatusQuery::error(const Poco::Exception& exc)
+{
+	_connection.close();
+	_uploader.failed(exc);
+	_retry = true;
+	restart();
+	yield();
+}
+
+
+void FileUploader::ChunkSender::resume()
+{
+	ASYNC_BEGIN
+	if (_retry)
+		ASYNC_AWAIT(sleep(_uploader._retryDelay));
+	_retry = false;
+	for (;;)
+	{
+		if (!_hasChunk)
+		{
+			_hasChunk = _uploader.next(_index);
+			if (!_hasChunk) break;
+		}
+
+		while ((_io = _connection.connect()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io));
+		{
+			std::string chunk(_uploader.readChunk(_index));
+			Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_PUT, ChunkedUpload::PATH + _uploader._id + "/" + Poco::NumberFormatter::format(_index), Poco::Net::HTTPMessage::HTTP_1_1);
+			_uploader.prepare(request);
+			request.set("X-Chunk-Hash", ChunkedUpload::sha256(chunk));
+			std::string body(_uploader._seal(chunk, request));
+			_connection.prepare(request, body);
+		}
+		while ((_io = _connection.send()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io));
+		while ((_io = _connection.receive()) != AsyncConnection::IO_DONE)
+			ASYNC_AWAIT(awaitIO(_io));
+
+		_hasChunk = false;
+		if (!_uploader.acknowledged(_connection.response())) break;
+	}
+	_connection.close();
+	ASYNC_END
+}
+
+
+void FileUploader::ChunkSender::error(const Poco::Exception& exc)
+{
+	_connection.close();
+	if (_hasChunk)
+	{
+		_uploader.requeue(_index);
+		_hasChunk = false;
+	}
+	_uploader.failed(exc);
+	_retry = true;
+	restart();
+	yield();
+}
+
+
+FileUploader::FileUploader(const Poco::URI& uri, Poco::Net::Context::Ptr pContext, Seal seal, const std::string& deviceId):
+	_uri(uri),
+	_pContext(pContext),
+	_seal(seal),
+	_deviceId(deviceId),
+	_connections(2),
+	_chunkSize(ChunkedUpload::DEFAULT_CHUNK_SIZE),
+	_timeout(30, 0),
+	_retryDelay(5, 0),
+	_maxRetries(10),
+	_size(0),
+	_uploadChunkSize(0),
+	_failures(0),
+	_pError(0)
+{
+}
+
+
+FileUploader::~FileUploader()
+{
+	delete _pError;
+}
+
+
+void FileUploader::setConnections(int connections)
+{
+	_connections = connections > 0 ? connections : 1;
+}
+
+
+void FileUploader::setChunkSize(std::size_t chunkSize)
+{
+	if (chunkSize < ChunkedUpload::MIN_CHUNK_SIZE || chunkSize > ChunkedUpload::MAX_CHUNK_SIZE)
+		throw Poco::InvalidArgumentException("Invalid chunk size");
+	_chunkSize = chunkSize;
+}
+
+
+void FileUploader::setTimeout(const Poco::Timespan& timeout)
+{
+	_timeout = timeout;
+}
+
+
+void FileUploader::setRetryDelay(const Poco::Timespan& delay)
+{
+	_retryDelay = delay;
+}
+
+
+void FileUploader::setMaxRetries(int retries)
+{
+	_maxRetries = retries;
+}
+
+
+FileUploader::Result FileUploader::upload(const std::string& path)
+{
+	_path = path;
+	_fileHash = ChunkedUpload::sha256File(path);
+	_size = Poco::File(path).getSize();
+	_id = ChunkedUpload::id(_deviceId, _fileHash);
+	_uploadChunkSize = _chunkSize;
+	_missing.clear();
+	_result.chunks = 0;
+	_result.resumed = 0;
+	_result.retries = 0;
+	_result.complete = false;
+	_failures = 0;
+	delete _pError;
+	_pError = 0;
+
+	std::vector<ChunkSender*> senders;
+	for (int i = 0; i < _connections; ++i)
+	{
+		senders.push_back(new ChunkSender(*this));
+	}
+	try
+	{
+		StatusQuery query(*this, senders);
+		query.start();
+		_loop.run();
+	}
+	catch (...)
+	{
+		for (std::vector<ChunkSender*>::iterator it = senders.begin(); it != senders.end(); ++it) delete *it;
+		throw;
+	}
+	for (std::vector<ChunkSender*>::iterator it = senders.begin(); it != senders.end(); ++it) delete *it;
+
+	if (_pError) _pError->rethrow();
+	return _result;
+}
+
+
+bool FileUploader::next(std::size_t& index)
+{
+	if (_missing.empty()) return false;
+	index = _missing.front();
+	_missing.pop_front();
+	return true;
+}
+
+
+void FileUploader::requeue(std::size_t index)
+{
+	_missing.push_front(index);
+	++_result.retries;
+}
+
+
+bool FileUploader::status(const Poco::Net::HTTPResponse& response)
+{
+	std::vector<bool> received;
+	if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_OK)
+	{
+		// continue with the chunk size the upload was started with
+		_uploadChunkSize = Poco::NumberParser::parseUnsigned(response.get("X-Chunk-Size"));
+		if (_uploadChunkSize < ChunkedUpload::MIN_CHUNK_SIZE || _uploadChunkSize > ChunkedUpload::MAX_CHUNK_SIZE)
+			throw Poco::DataException("Invalid chunk size from the server");
+		received = ChunkedUpload::parseRanges(response.get("X-Received", ""), ChunkedUpload::chunks(_size, _uploadChunkSize));
+		_result.complete = response.get("X-Upload-Complete", "") == "true";
+	}
+	else if (response.getStatus() == Poco::Net::HTTPResponse::HTTP_NOT_FOUND)
+	{
+		received.assign(ChunkedUpload::chunks(_size, _uploadChunkSize), false);
+	}
+	else
+	{
+		rejected(response);
+		return false;
+	}
+	_result.chunks = received.size();
+	for (std::size_t i = 0; i < received.size(); ++i)
+	{
+		if (received[i]) ++_result.resumed;
+		else if (!_result.complete) _missing.push_back(i);
+	}
+	return true;
+}
+
+
+bool FileUploader::acknowledged(const Poco::Net::HTTPResponse& response)
+{
+	if (response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK)
+	{
+		rejected(response);
+		return false;
+	}
+	_failures = 0;
+	if (response.get("X-Upload-Complete", "") == "true") _result.complete = true;
+	return true;
+}
+
+
+void FileUploader::failed(const Poco::Exception& exc)
+{
+	std::cerr << "Upload " << _id << ": " << exc.displayText() << std::endl;
+	if (++_failures > _maxRetries && !_pError)
+	{
+		_pError = exc.clone();
+		_loop.stop();
+	}
+}
+
+
+void FileUploader::rejected(const Poco::Net::HTTPResponse& response)
+{
+	if (!_pError)
+	{
+		_pError = new Poco::Net::HTTPException("Upload rejected", Poco::NumberFormatter::format(static_cast<int>(response.getStatus())) + " " + response.getReason());
+		_loop.stop();
+	}
+}
+
+
+std::string FileUploader::readChunk(std::size_t index) const
+{
+	std::size_t length = ChunkedUpload::chunkLength(_size, _uploadChunkSize, index);
+	std::string chunk(length, '\0');
+	std::ifstream istr(_path.c_str(), std::ios::binary);
+	istr.seekg(static_cast<std::streamoff>(static_cast<Poco::UInt64>(index)*_uploadChunkSize));
+	if (length > 0) istr.read(&chunk[0], static_cast<std::streamsize>(length));
+	if (!istr) throw Poco::ReadFileException(_path);
+	return chunk;
+}
+
+
+void FileUploader::prepare(Poco::Net::HTTPRequest& request) const
+{
+	request.set("X-Upload-Size", Poco::NumberFormatter::format(_size));
+	request.set("X-Chunk-Size", Poco::NumberFormatter::format(_uploadChunkSize));
+	request.set("X-File-Hash", _fileHash);
+}
@@ -0,0 +1,136 @@
+//
+// FileUploader.h
+//
+// Definition of the FileUploader class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef FileUploader_INCLUDED
+#define FileUploader_INCLUDED
+
+
+#include "EventLoop.h"
+#include "Poco/Net/HTTPRequest.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/Context.h"
+#include "Poco/Timespan.h"
+#include "Poco/Types.h"
+#include "Poco/URI.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+
+class FileUploader
+	/// Uploads a file, such as a log bundle or a sensor dump, to the
+	/// server in encrypted and hashed chunks (see ChunkedUpload).
+	///
+	/// upload() first asks the server which chunks it has, so that an
+	/// upload interrupted by the network, or by a restart of either
+	/// side, continues with the missing chunks. The chunks are then
+	/// sent over several keep-alive connections in parallel, as tasks
+	/// on an EventLoop like the AsyncClient's uploads. A chunk that
+	/// fails because of the network is sent again after the retry
+	/// delay; upload() gives up after a number of failures in a row.
+{
+public:
+	typedef std::string (*Seal)(const std::string& chunk, Poco::Net::HTTPRequest& request);
+		/// Encrypts a chunk and sets the request headers that describe
+		/// the encryption. Returns the request body.
+
+	struct Result
+	{
+		std::size_t chunks;    /// chunks of the file
+		std::size_t resumed;   /// chunks the server had already
+		int retries;           /// chunks sent again after a failure
+		bool complete;         /// the server has the complete file
+	};
+
+	FileUploader(const Poco::URI& uri, Poco::Net::Context::Ptr pContext, Seal seal, const std::string& deviceId);
+		/// Creates the FileUploader for the server at the given URI
+		/// (only host and port are used). pContext may be null for
+		/// plain HTTP.
+
+	~FileUploader();
+		/// Destroys the FileUploader.
+
+	void setConnections(int connections);
+		/// Sets the number of chunks in flight, each over its own
+		/// connection. The default is 2.
+
+	void setChunkSize(std::size_t chunkSize);
+		/// Sets the chunk size for new uploads, from
+		/// ChunkedUpload::MIN_CHUNK_SIZE to ChunkedUpload::MAX_CHUNK_SIZE.
+		/// The default is 64 KB.
+
+	void setTimeout(const Poco::Timespan& timeout);
+		/// Sets the timeout for connecting, sending and receiving.
+		/// The default is 30 seconds.
+
+	void setRetryDelay(const Poco::Timespan& delay);
+		/// Sets the delay before a failed chunk is sent again. The
+		/// default is 5 seconds.
+
+	void setMaxRetries(int retries);
+		/// Sets how many failures in a row upload() accepts before
+		/// it gives up. The default is 10.
+
+	Result upload(const std::string& path);
+		/// Uploads the file, or the part of it the server does not
+		/// have yet.
+		///
+		/// Throws a Poco::Net::HTTPException if the server rejects a
+		/// chunk, and the exception of the last failure if there are
+		/// too many failures in a row. Running upload() again later
+		/// resumes the upload.
+
+private:
+	class StatusQuery;
+	class ChunkSender;
+
+	bool next(std::size_t& index);
+	void requeue(std::size_t index);
+	bool status(const Poco::Net::HTTPResponse& response);
+		/// Takes the missing chunks from the response to the status
+		/// query. Returns false if the server rejected the query.
+
+	bool acknowledged(const Poco::Net::HTTPResponse& response);
+		/// Takes the response to a chunk. Returns false if the server
+		/// rejected the chunk.
+
+	void failed(const Poco::Exception& exc);
+	void rejected(const Poco::Net::HTTPResponse& response);
+		/// Ends the upload with an error.
+
+	std::string readChunk(std::size_t index) const;
+	void prepare(Poco::Net::HTTPRequest& request) const;
+
+	Poco::URI _uri;
+	Poco::Net::Context::Ptr _pContext;
+	Seal _seal;
+	std::string _deviceId;
+	int _connections;
+	std::size_t _chunkSize;
+	Poco::Timespan _timeout;
+	Poco::Timespan _retryDelay;
+	int _maxRetries;
+
+	EventLoop _loop;
+	std::string _path;
+	std::string _id;
+	std::string _fileHash;
+	Poco::UInt64 _size;
+	std::size_t _uploadChunkSize;
+	std::deque<std::size_t> _missing;
+	Result _result;
+	int _failures;
+	Poco::Exception* _pError;
+
+	friend class StatusQuery;
+	friend class ChunkSender;
+};
+
+
+#endif // FileUploader_INCLUDED
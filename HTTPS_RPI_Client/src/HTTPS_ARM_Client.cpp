@@ -42,6 +42,12 @@
 #include <iostream>
 #include <string>       // std::string
 #include <iostream>     // std::cout
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "sstream"     // std::istringstream
 #include "fstream"
 #include "Poco/StreamCopier.h"
@@ -50,6 +56,29 @@
 #include "Poco/Net/ServerSocket.h"
 #include "Poco/Net/StreamSocket.h"
 #include "Poco/Net/SocketStream.h"
+#include "Poco/Util/PropertyFileConfiguration.h"
+#include "Poco/AutoPtr.h"
+#include "Poco/File.h"
+#include "ECIESCipher.h"
+#include "CipherBenchmark.h"
+#include "AEAD.h"
+#include "SignedBatch.h"
+#include "AsyncClient.h"
+#include "PipelineBenchmark.h"
+#include "NetworkBenchmark.h"
+#include "FileUploader.h"
+#include "EventRing.h"
+#include "ServiceDiscovery.h"
+#include "DiscoveryResponder.h"
+#include "ModemLineMonitor.h"
+#include "SerialCounters.h"
+#include "RuleEngine.h"
+#include "Poco/StringTokenizer.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Mutex.h"
+#include "Poco/Stopwatch.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
 
 using namespace Poco;
 using namespace Poco::Net;
@@ -61,6 +90,8 @@ using Poco::StreamCopier;
 using Poco::Path;
 using Poco::URI;
 using Poco::Exception;
+using Poco::AutoPtr;
+using Poco::Util::PropertyFileConfiguration;
 
 void decrypt(void);
 
@@ -72,70 +103,93 @@ char z[80];
 	bdrate=115200;       /* 115200 baud */
   unsigned char read_buf='NULL',Copy_read_buf, Response[20];
 
+AutoPtr<PropertyFileConfiguration> pConfig;   /* HTTPS_ARM_Client.properties, empty if not present */
+SharedPtr<ECIESCipher> pECIES;                /* set if client.encryption = ecies */
+std::string deviceId, deviceKey;              /* set if client.encryption = psk */
+ECDSAKey::Ptr pSigningKey;                    /* set if client.encryption = sign */
+Poco::Crypto::Cipher::Ptr pRSACipher;         /* set if client.encryption = rsa */
+Poco::UInt64 sequence = 0;                    /* sign mode record sequence number */
+Poco::FastMutex sequenceMutex;
+Poco::UInt32 requestSequence = 0;             /* X-Sequence header, numbers the requests */
 
 
 
 
-bool doRequest(Poco::Net::HTTPSClientSession& session, Poco::Net::HTTPRequest& request, Poco::Net::HTTPResponse& response)
-{
-
-
-
-	std::cout << " "<< std::endl;
-	std::cout << " "<< std::endl;
-
-	std::ofstream myfile;
-	myfile.open ("input");
-	myfile << z << std::endl;
-	myfile.close();
 
-		    Poco::Crypto::CipherFactory& factory = Poco::Crypto::CipherFactory::defaultFactory();
-		    Poco::Crypto::Cipher* pCipher = factory.createCipher(Poco::Crypto::RSAKey("Publik.pem","",""));  /* Here v r encrypting the message with publickey "anyCertpub.pem". This file is extracted from server certificate file anyCert.pem through openssl */
-
-		    Poco::Crypto::CryptoTransform *pEncryptor = NULL;
+/* Numbers a signed record with the time in milliseconds, made to grow with every record, so that the
+   numbers keep growing when the client restarts and the server can refuse records sent again */
+Poco::UInt64 nextSequence()
+{
+	// the SealPool may seal on several threads at once
+	Poco::FastMutex::ScopedLock lock(sequenceMutex);
+	Poco::UInt64 now = static_cast<Poco::UInt64>(Poco::Timestamp().epochMicroseconds()/1000);
+	sequence = now > sequence ? now : sequence + 1;
+	return sequence;
+}
 
-		        pEncryptor = pCipher->createEncryptor();
-		        Poco::FileOutputStream sink("encrypted");
-		        Poco::Crypto::CryptoOutputStream encryptor(sink, pEncryptor);
-		        Poco::FileInputStream source("input");
-		        Poco::StreamCopier::copyStream(source, encryptor);
-		        // Always close output streams to flush all internal buffers
-		        encryptor.close();
-		        sink.close();
 
-		        std::ifstream in("encrypted", std::ios::binary|std::ios::in);
-		        	    if(!in.is_open())
-		        	       return false;
-		        	    std::string data;
-		        	    data.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
-		        	    in.close();
-		  		        request.setContentLength(data.length());
+/* Signs a batch of messages, one record each, with a single signature (client.encryption = sign) */
+std::string sealBatch(const std::vector<std::string>& messages, Poco::Net::HTTPRequest& request)
+{
+	SignedBatch batch;
+	for (std::vector<std::string>::const_iterator it = messages.begin(); it != messages.end(); ++it)
+	{
+		TelemetryRecord record;
+		record.sequence = nextSequence();
+		record.timestamp = Poco::Timestamp().epochMicroseconds()/1000;
+		record.payload = *it + "\n";
+		batch.add(record);
+	}
+	request.set("X-Encryption", "sign");
+	request.set("X-Device-Id", deviceId);
+	return batch.seal(deviceId, *pSigningKey);
+}
 
-		  		     	session.sendRequest(request)<<data<<std::endl;
-		  		     	data.clear();
 
-		  		     	std::cout << " "<< std::endl;
-		  		     	std::cout << " "<< std::endl;
+/* Encrypts (or signs) a message for the server and sets the request headers that describe it */
+std::string seal(const std::string& message, Poco::Net::HTTPRequest& request)
+{
+	std::string payload(message + "\n");
+	// the async client numbers the messages when it queues them
+	if (!request.has("X-Sequence"))
+		request.set("X-Sequence", Poco::NumberFormatter::format(requestSequence++));
 
-		  		     	std::cout << "\nMessage from Client:\n" << z << std::endl;
+	if (pECIES)
+	{
+		request.set("X-Encryption", "ecies");
+		return pECIES->encryptString(payload);
+	}
+	else if (!deviceKey.empty())
+	{
+		request.set("X-Encryption", "psk");
+		request.set("X-Device-Id", deviceId);
+		return AEAD::seal(deviceKey, payload, deviceId);
+	}
+	else if (pSigningKey)
+	{
+		return sealBatch(std::vector<std::string>(1, message), request);
+	}
+	else
+	{
+		/* Here v r encrypting the message with publickey "Publik.pem". This file is extracted from server certificate file anyCert.pem through openssl */
+		return pRSACipher->encryptString(payload);
+	}
+}
 
-		  		     	std::cout << " "<< std::endl;
-		  		     	std::cout << " "<< std::endl;
 
+bool doRequest(Poco::Net::HTTPSClientSession& session, Poco::Net::HTTPRequest& request, Poco::Net::HTTPResponse& response)
+{
 
 
-		        //decrypt();
 
-		        std::ofstream ofs;
-		        ofs.open("encrypted", std::ofstream::out|std::ofstream::trunc);
-		        ofs.close();
+	std::cout << " "<< std::endl;
+	std::cout << " "<< std::endl;
 
-		        std::ofstream ofs1;
-		        ofs1.open("input", std::ofstream::out|std::ofstream::trunc);
-		        ofs1.close();
+	std::string data(seal(z, request));
+	request.setContentLength(data.length());
+	session.sendRequest(request)<<data<<std::endl;
 
-		        std::remove("input");
-		        std::remove("encrypted");
+	std::cout << "\nMessage from Client:\n" << z << std::endl;
 
 
 	std::istream& rs = session.receiveResponse(response);
@@ -187,8 +241,425 @@ void decrypt()
 
 */
 
-int main()
+void loadConfiguration()
+{
+	if (Poco::File("HTTPS_ARM_Client.properties").exists())
+		pConfig = new PropertyFileConfiguration("HTTPS_ARM_Client.properties");
+	else
+		pConfig = new PropertyFileConfiguration;
+
+	std::string encryption(pConfig->getString("client.encryption", "rsa"));
+	if (encryption == "ecies")
+		pECIES = new ECIESCipher(pConfig->getString("client.ecies.publicKeyFile", "EccPublik.pem"));
+	else if (encryption == "psk")
+	{
+		deviceId = pConfig->getString("client.deviceId");
+		deviceKey = AEAD::readKeyFile(pConfig->getString("client.psk.keyFile", "device.key"));
+	}
+	else if (encryption == "sign")
+	{
+		deviceId = pConfig->getString("client.deviceId");
+		pSigningKey = new ECDSAKey("", pConfig->getString("client.sign.privateKeyFile", "ClientSign.pem"), pConfig->getString("client.sign.passphrase", "secret"));
+	}
+	else
+		pRSACipher = Poco::Crypto::CipherFactory::defaultFactory().createCipher(Poco::Crypto::RSAKey("Publik.pem","",""));
+}
+
+
+/* Measures the client side (encryption) cost of each mode on this board */
+int runBenchmark()
+{
+	CipherBenchmark benchmark(pConfig->getInt("client.benchmark.iterations", 1000), "!!!!...REMOTE SYNC TROUBLE...!!!!\n");
+	benchmark.add(new RSABenchmarkCase(Poco::Crypto::RSAKey("Publik.pem","",""), false));
+	benchmark.add(new ECIESBenchmarkCase(new ECIESCipher(pConfig->getString("client.ecies.publicKeyFile", "EccPublik.pem"))));
+	benchmark.add(new PSKBenchmarkCase("benchmark", AEAD::random(AEAD::KEY_SIZE)));
+	std::string signKeyFile(pConfig->getString("client.sign.privateKeyFile", "ClientSign.pem"));
+	if (Poco::File(signKeyFile).exists())
+	{
+		ECDSAKey::Ptr pKey = new ECDSAKey("", signKeyFile, pConfig->getString("client.sign.passphrase", "secret"));
+		benchmark.add(new SignBenchmarkCase("benchmark", pKey, ECDSAKey::Ptr(), 1));
+		benchmark.add(new SignBenchmarkCase("benchmark", pKey, ECDSAKey::Ptr(), 16));
+		benchmark.add(new SignBenchmarkCase("benchmark", pKey, ECDSAKey::Ptr(), 64));
+	}
+	benchmark.run(std::cout);
+	return 0;
+}
+
+
+/* Encrypts a chunk of a file upload; unlike seal() the data is binary. Sign mode does not encrypt, and rsa would
+   encrypt every chunk block by block with the public key, hundreds of RSA operations per chunk, so both are refused */
+std::string sealChunk(const std::string& chunk, Poco::Net::HTTPRequest& request)
+{
+	if (pECIES)
+	{
+		request.set("X-Encryption", "ecies");
+		return pECIES->encryptString(chunk);
+	}
+	else if (!deviceKey.empty())
+	{
+		request.set("X-Encryption", "psk");
+		request.set("X-Device-Id", deviceId);
+		return AEAD::seal(deviceKey, chunk, deviceId);
+	}
+	else
+	{
+		throw Poco::InvalidAccessException("File uploads need client.encryption = ecies or psk");
+	}
+}
+
+
+/* Uploads a file in chunks; running it again after an interruption sends only the chunks the server is missing */
+int runUpload(const std::string& path)
+{
+	if (!pECIES && deviceKey.empty())
+		throw Poco::InvalidAccessException("File uploads need client.encryption = ecies or psk");
+	SharedPtr<PrivateKeyPassphraseHandler> pConsoleHandler = new KeyConsoleHandler(false);
+	SharedPtr<InvalidCertificateHandler> pInvalidCertHandler = new ConsoleCertificateHandler(false);
+	Context::Ptr pContext = new Context(Context::CLIENT_USE, "", "", "rootcert.pem", Context::VERIFY_STRICT, 9, false, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+	pContext->enableSessionCache(true);
+	SSLManager::instance().initializeClient(pConsoleHandler, pInvalidCertHandler, pContext);
+
+	FileUploader uploader(URI(pConfig->getString("client.uri", "http://159.99.184.156:80")), pContext, sealChunk, pConfig->getString("client.deviceId", "pi-0001"));
+	uploader.setConnections(pConfig->getInt("client.upload.connections", 2));
+	uploader.setChunkSize(pConfig->getInt("client.upload.chunkSize", 65536));
+	uploader.setTimeout(Poco::Timespan(pConfig->getInt("client.async.timeout", 30), 0));
+	uploader.setRetryDelay(Poco::Timespan(pConfig->getInt("client.async.retryDelay", 5), 0));
+	uploader.setMaxRetries(pConfig->getInt("client.upload.maxRetries", 10));
+	FileUploader::Result result = uploader.upload(path);
+	std::cout << path << ": " << result.chunks << " chunks, " << result.resumed << " on the server before, "
+	          << result.retries << " sent again, " << (result.complete ? "complete" : "incomplete") << std::endl;
+	return result.complete ? 0 : 1;
+}
+
+
+/* Reads client.async.seal.cpus, a list of CPU numbers for the seal worker threads */
+std::vector<int> sealCPUs()
+{
+	std::vector<int> cpus;
+	StringTokenizer tokens(pConfig->getString("client.async.seal.cpus", ""), ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+	for (StringTokenizer::Iterator it = tokens.begin(); it != tokens.end(); ++it)
+	{
+		cpus.push_back(NumberParser::parse(*it));
+	}
+	return cpus;
+}
+
+
+/* Reads the rules named in client.rules, from client.rule.<name>.match, .action, .hours, .count and .interval (seconds) */
+void loadRules(RuleEngine& rules)
+{
+	StringTokenizer names(pConfig->getString("client.rules", ""), ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+	for (StringTokenizer::Iterator it = names.begin(); it != names.end(); ++it)
+	{
+		std::string prefix("client.rule." + *it + ".");
+		RuleEngine::Rule rule;
+		rule.name = *it;
+		rule.match = pConfig->getString(prefix + "match", "");
+		rule.action = RuleEngine::parseAction(pConfig->getString(prefix + "action", "pass"));
+		rule.hours = RuleEngine::parseHours(pConfig->getString(prefix + "hours", ""));
+		rule.count = pConfig->getInt(prefix + "count", 1);
+		rule.interval = Poco::Timespan(pConfig->getInt(prefix + "interval", 60), 0);
+		rules.add(rule);
+	}
+	rules.compile();
+}
+
+
+/* Captures, seals and uploads on one thread, with several uploads in flight (see AsyncClient) */
+int runAsync()
 {
+	bool ipc = pConfig->getBool("client.ipc.enable", false);
+	if(!ipc && RS232_OpenComport(cport_nr, bdrate))
+	{
+		printf("Can not open comport\n");
+		return(0);
+	}
+
+	SharedPtr<PrivateKeyPassphraseHandler> pConsoleHandler = new KeyConsoleHandler(false);
+	SharedPtr<InvalidCertificateHandler> pInvalidCertHandler = new ConsoleCertificateHandler(false);
+	Context::Ptr pContext = new Context(Context::CLIENT_USE, "", "", "rootcert.pem", Context::VERIFY_STRICT, 9, false, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+	pContext->enableSessionCache(true);
+	SSLManager::instance().initializeClient(pConsoleHandler, pInvalidCertHandler, pContext);
+
+	AsyncClient client(URI(pConfig->getString("client.uri", "http://159.99.184.156:80")), pContext, seal, pConfig->getInt("client.async.connections", 2));
+	client.setTimeout(Poco::Timespan(pConfig->getInt("client.async.timeout", 30), 0));
+	client.setRetryDelay(Poco::Timespan(pConfig->getInt("client.async.retryDelay", 5), 0));
+	client.setMaxQueued(pConfig->getInt("client.async.maxQueued", 10000));
+	if (pConfig->getInt("client.async.drain.connections", 0) > 0)
+		client.setDrain(pConfig->getInt("client.async.drain.connections", 0), pConfig->getInt("client.async.drain.backlog", 20));
+	client.setSealThreads(pConfig->getInt("client.async.seal.threads", 0), sealCPUs());
+	if (pSigningKey && pConfig->getInt("client.sign.batch.size", 16) > 1)
+		client.setBatch(sealBatch, pConfig->getInt("client.sign.batch.size", 16), Poco::Timespan(pConfig->getInt("client.sign.batch.window", 1), 0));
+	if (pConfig->getBool("client.discovery.enable", false))
+	{
+		try
+		{
+			client.discover(pConfig->getString("client.discovery.type", "_https-telemetry._tcp"), SocketAddress(pConfig->getString("client.discovery.address", "224.0.0.251:5353")),
+				pConfig->getString("client.discovery.cache", "server.cache"), Poco::Timespan(pConfig->getInt("client.discovery.timeout", 2), 0));
+		}
+		catch (Exception& exc)
+		{
+			std::cerr << "Discovery disabled: " << exc.displayText() << std::endl;
+		}
+	}
+	if (pConfig->getBool("client.config.push", false))
+		client.pollConfig(pConfig->getString("client.config.file", "remote.properties"), Poco::Timespan(pConfig->getInt("client.config.wait", 25), 0));
+	RuleEngine rules;
+	loadRules(rules);
+	if (!rules.empty())
+		client.setRules(rules);
+	SharedPtr<EventRing> pRing;
+	if (ipc)
+	{
+		pRing = new EventRing(pConfig->getString("client.ipc.file", "/dev/shm/HTTPS_ARM_Client.events"), pConfig->getInt("client.ipc.capacity", EventRing::DEFAULT_CAPACITY));
+		client.readRing(*pRing);
+		printf("Receiving data from the capture process, %u bytes pending\n", pRing->pending());
+	}
+	else if (pConfig->getString("client.serial.format", "sync") == "sensor")
+	{
+		client.readSensors(RS232_GetPortFd(cport_nr), Poco::Timespan(pConfig->getInt("client.sensor.window", 60), 0),
+			pConfig->getBool("client.sensor.raw", true), pConfig->getInt("client.sensor.maxPoints", 4096));
+		printf("Receiving sensor readings\n");
+	}
+	else
+	{
+		client.readSerial(RS232_GetPortFd(cport_nr));
+		printf("Receiving data\n");
+	}
+	SharedPtr<ModemLineMonitor> pLines;
+	int lines = ModemLineMonitor::parse(pConfig->getString("client.modemLines", ""));
+	if (!ipc && lines != 0)
+	{
+		pLines = new ModemLineMonitor(RS232_GetPortFd(cport_nr), lines);
+		client.readModemLines(*pLines);
+		pLines->start();
+	}
+	if (pConfig->getBool("client.commands.enable", true))
+	{
+		// the capture process reads the port, the commands are
+		// written with a descriptor of this process
+		// the polls are authenticated with the psk key, in any mode
+		std::string keyFile(pConfig->getString("client.psk.keyFile", "device.key"));
+		std::string key(!deviceKey.empty() ? deviceKey : Poco::File(keyFile).exists() ? AEAD::readKeyFile(keyFile) : std::string());
+		int fd = key.empty() ? -1 : ipc ? open(RS232_GetPortName(cport_nr), O_WRONLY | O_NOCTTY | O_NONBLOCK) : RS232_GetPortFd(cport_nr);
+		if (key.empty())
+			std::cerr << "Commands disabled: no device key in " << keyFile << std::endl;
+		else if (fd >= 0)
+			client.receiveCommands(pConfig->getString("client.deviceId", "pi-0001"), key, fd, Poco::Timespan(pConfig->getInt("client.commands.wait", 25), 0));
+		else
+			perror("Commands disabled");
+	}
+	SharedPtr<SerialCounters> pCounters;
+	int countersInterval = pConfig->getInt("client.serialCounters.interval", 1);
+	if (!ipc && countersInterval > 0)
+	{
+		pCounters = new SerialCounters(RS232_GetPortFd(cport_nr), RS232_GetPortName(cport_nr), Poco::Timespan(pConfig->getInt("client.serialCounters.report", 60), 0));
+		client.watchSerialCounters(*pCounters, Poco::Timespan(countersInterval, 0));
+	}
+	client.run();
+	return 0;
+}
+
+
+/* Runs the acquisition process: reads the UART and writes the state changes to the EventRing the uploader (client.ipc.enable) reads */
+int runCapture()
+{
+	if(RS232_OpenComport(cport_nr, bdrate))
+	{
+		printf("Can not open comport\n");
+		return(0);
+	}
+
+	int priority = pConfig->getInt("client.capture.priority", 0);
+	if (priority > 0)
+	{
+		struct sched_param param;
+		param.sched_priority = priority;
+		if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+			perror("sched_setscheduler");
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+			perror("mlockall");
+	}
+
+	EventRing ring(pConfig->getString("client.ipc.file", "/dev/shm/HTTPS_ARM_Client.events"), pConfig->getInt("client.ipc.capacity", EventRing::DEFAULT_CAPACITY));
+	EventRing::Writer writer(ring);
+	SerialFlow<EventRing::Writer>::Type flow(SerialFlow<EventRing::Writer>::create(writer));
+	struct pollfd fds[2];
+	fds[0].fd = RS232_GetPortFd(cport_nr);
+	fds[0].events = POLLIN;
+	int nfds = 1;
+
+	// the line events are written to the ring by this thread too, as
+	// the ring has a single writer
+	SharedPtr<ModemLineMonitor> pLines;
+	int lines = ModemLineMonitor::parse(pConfig->getString("client.modemLines", ""));
+	if (lines != 0)
+	{
+		pLines = new ModemLineMonitor(fds[0].fd, lines);
+		fds[1].fd = pLines->fd();
+		fds[1].events = POLLIN;
+		nfds = 2;
+		pLines->start();
+	}
+	SharedPtr<SerialCounters> pCounters;
+	std::vector<std::string> counterMessages;
+	Poco::Timestamp::TimeDiff countersInterval = static_cast<Poco::Timestamp::TimeDiff>(pConfig->getInt("client.serialCounters.interval", 1))*Poco::Timespan::SECONDS;
+	Poco::Timestamp countersPolled(0);
+	if (countersInterval > 0)
+		pCounters = new SerialCounters(fds[0].fd, RS232_GetPortName(cport_nr), Poco::Timespan(pConfig->getInt("client.serialCounters.report", 60), 0));
+	printf("Capturing data, %u bytes pending\n", ring.pending());
+	for (;;)
+	{
+		int timeout = -1;
+		if (pCounters)
+		{
+			Poco::Timestamp::TimeDiff left = countersInterval - countersPolled.elapsed();
+			if (left <= 0)
+			{
+				counterMessages.clear();
+				if (pCounters->poll(counterMessages, ring.dropped()))
+				{
+					for (std::vector<std::string>::const_iterator it = counterMessages.begin(); it != counterMessages.end(); ++it)
+					{
+						writer.push(*it);
+					}
+					countersPolled.update();
+					left = countersInterval;
+				}
+				else
+				{
+					fprintf(stderr, "No serial counters for %s\n", pCounters->port().c_str());
+					pCounters = 0;
+				}
+			}
+			if (pCounters) timeout = static_cast<int>((left + 999)/1000);
+		}
+		if (poll(fds, nfds, timeout) < 0 && errno != EINTR)
+		{
+			perror("poll");
+			return 1;
+		}
+		unsigned char byte;
+		while (read(fds[0].fd, &byte, 1) == 1)
+		{
+			flow.push(byte);
+		}
+		if (pLines)
+		{
+			ModemLineMonitor::Event event;
+			pLines->drain();
+			while (pLines->next(event))
+			{
+				writer.push(ModemLineMonitor::format(event));
+			}
+		}
+	}
+	return 0;
+}
+
+
+/* Looks up the server with DNS-SD once and prints the time it took; with client.discovery.standIn, a DiscoveryResponder answers for client.uri */
+int runDiscovery()
+{
+	std::string type(pConfig->getString("client.discovery.type", "_https-telemetry._tcp"));
+	SocketAddress address(pConfig->getString("client.discovery.address", "224.0.0.251:5353"));
+	SharedPtr<DiscoveryResponder> pStandIn;
+	if (pConfig->getBool("client.discovery.standIn", false))
+	{
+		URI uri(pConfig->getString("client.uri", "http://159.99.184.156:80"));
+		ServiceDiscovery::Instance instance;
+		instance.name = "HTTPS_Server." + type + ".local";
+		instance.target = "HTTPS_Server.local";
+		instance.address = SocketAddress(uri.getHost(), uri.getPort()).host().toString();
+		instance.port = uri.getPort();
+		instance.properties.set("host", uri.getHost());
+		instance.ttl = pConfig->getInt("client.discovery.standIn.ttl", 120);
+		pStandIn = new DiscoveryResponder(SocketAddress("127.0.0.1", 0), type, instance);
+		pStandIn->start();
+		address = pStandIn->address();
+	}
+
+	ServiceDiscovery discovery(type, address);
+	ServiceDiscovery::Instance instance;
+	Stopwatch sw;
+	sw.start();
+	discovery.query();
+	struct pollfd fd;
+	fd.fd = discovery.fd();
+	fd.events = POLLIN;
+	int timeout = pConfig->getInt("client.discovery.timeout", 2)*1000;
+	while (!discovery.receive(instance))
+	{
+		int left = timeout - static_cast<int>(sw.elapsed()/1000);
+		if (left <= 0 || poll(&fd, 1, left) < 0)
+		{
+			std::cerr << "No answer for " << discovery.service() << " from " << address.toString() << std::endl;
+			return 1;
+		}
+	}
+	std::cout << "Found " << instance.name << " at " << instance.address << ":" << instance.port << " (host " << instance.host() << ", TTL " << instance.ttl << " s) in "
+	          << sw.elapsed()/1000.0 << " ms" << std::endl;
+	ServiceDiscovery::save(pConfig->getString("client.discovery.cache", "server.cache"), instance);
+	return 0;
+}
+
+
+/* Runs the async client against client.uri through a FaultProxy, for each scenario in client.netbench.scenarios */
+int runNetworkBenchmark()
+{
+	SharedPtr<PrivateKeyPassphraseHandler> pConsoleHandler = new KeyConsoleHandler(false);
+	SharedPtr<InvalidCertificateHandler> pInvalidCertHandler = new ConsoleCertificateHandler(false);
+	Context::Ptr pContext = new Context(Context::CLIENT_USE, "", "", "rootcert.pem", Context::VERIFY_STRICT, 9, false, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+	pContext->enableSessionCache(true);
+	SSLManager::instance().initializeClient(pConsoleHandler, pInvalidCertHandler, pContext);
+
+	NetworkBenchmark benchmark(URI(pConfig->getString("client.uri", "http://159.99.184.156:80")), pContext, seal,
+		pConfig->getInt("client.async.connections", 2), pConfig->getInt("client.netbench.rate", 10));
+	benchmark.setTimeout(Poco::Timespan(pConfig->getInt("client.async.timeout", 30), 0));
+	benchmark.setRetryDelay(Poco::Timespan(pConfig->getInt("client.async.retryDelay", 5), 0));
+	benchmark.setRecoveryTimeout(Poco::Timespan(pConfig->getInt("client.netbench.recoveryTimeout", 120), 0));
+	if (pConfig->getInt("client.async.drain.connections", 0) > 0)
+		benchmark.setDrain(pConfig->getInt("client.async.drain.connections", 0), pConfig->getInt("client.async.drain.backlog", 20));
+	benchmark.setSealThreads(pConfig->getInt("client.async.seal.threads", 0), sealCPUs());
+	StringTokenizer scenarios(pConfig->getString("client.netbench.scenarios", "clean"), ",", StringTokenizer::TOK_TRIM | StringTokenizer::TOK_IGNORE_EMPTY);
+	for (StringTokenizer::Iterator it = scenarios.begin(); it != scenarios.end(); ++it)
+	{
+		benchmark.add(*it, FaultProxy::parse(pConfig->getString("client.netbench.scenario." + *it, "for=10")));
+	}
+	benchmark.run(std::cout);
+	return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		loadConfiguration();
+		if (argc > 1 && std::string(argv[1]) == "benchmark")
+			return runBenchmark();
+		if (argc > 1 && std::string(argv[1]) == "pipeline-benchmark")
+		{
+			PipelineBenchmark(pConfig->getInt("client.benchmark.pipelineEvents", 10000000)).run(std::cout);
+			return 0;
+		}
+		if (argc > 1 && std::string(argv[1]) == "network-benchmark")
+			return runNetworkBenchmark();
+		if (argc > 2 && std::string(argv[1]) == "upload")
+			return runUpload(argv[2]);
+		if (argc > 1 && std::string(argv[1]) == "capture")
+			return runCapture();
+		if (argc > 1 && std::string(argv[1]) == "discover")
+			return runDiscovery();
+		if (pConfig->getString("client.runtime", "blocking") == "async")
+			return runAsync();
+	}
+	catch (Exception& exc)
+	{
+		std::cerr << exc.displayText() << std::endl;
+		return 1;
+	}
+
 	while(1)
 	{
 
@@ -0,0 +1,247 @@
+//
+// ModemLineMonitor.cpp
+//
+// Implementation of the ModemLineMonitor class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ModemLineMonitor.h"
+#include "Poco/DateTimeFormat.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/String.h"
+#include "Poco/StringTokenizer.h"
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+
+namespace
+{
+	const int ALL_LINES = ModemLineMonitor::LINE_DCD | ModemLineMonitor::LINE_DSR | ModemLineMonitor::LINE_CTS | ModemLineMonitor::LINE_RI;
+}
+
+
+ModemLineMonitor::ModemLineMonitor(int fd, int lines):
+	_fd(fd),
+	_lines(lines & ALL_LINES),
+	_state(0),
+	_stopped(false)
+{
+	if (_lines == 0) throw Poco::InvalidArgumentException("No modem lines to watch");
+	if (::pipe(_pipe) != 0)
+		throw Poco::SystemException("Cannot create pipe");
+	::fcntl(_pipe[0], F_SETFL, O_NONBLOCK);
+	::fcntl(_pipe[1], F_SETFL, O_NONBLOCK);
+
+	// without SA_RESTART, so that the signal ends the ioctl
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = &ModemLineMonitor::interrupted;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGUSR2, &action, &_previous) != 0)
+	{
+		::close(_pipe[0]);
+		::close(_pipe[1]);
+		throw Poco::SystemException("Cannot install the SIGUSR2 handler");
+	}
+}
+
+
+ModemLineMonitor::~ModemLineMonitor()
+{
+	try
+	{
+		stop();
+	}
+	catch (...)
+	{
+		poco_unexpected();
+	}
+	// the thread has ended, so no signal of ours is pending any more
+	sigaction(SIGUSR2, &_previous, 0);
+	::close(_pipe[0]);
+	::close(_pipe[1]);
+}
+
+
+void ModemLineMonitor::start()
+{
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_stopped = false;
+	}
+	_thread.start(*this);
+}
+
+
+void ModemLineMonitor::stop()
+{
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_stopped = true;
+	}
+	// the thread may not be in the ioctl yet when the signal comes
+	while (_thread.isRunning())
+	{
+		pthread_kill(_thread.tid(), SIGUSR2);
+		if (_thread.tryJoin(10)) break;
+	}
+}
+
+
+bool ModemLineMonitor::next(Event& event)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	if (_events.empty()) return false;
+	event = _events.front();
+	_events.pop_front();
+	return true;
+}
+
+
+void ModemLineMonitor::drain()
+{
+	char buffer[64];
+	while (::read(_pipe[0], buffer, sizeof(buffer)) > 0)
+	{
+	}
+}
+
+
+void ModemLineMonitor::run()
+{
+	// the counters before the wait, so that the changes during it are
+	// counted even if a line is back to its state when we wake up
+	SerialCounters::Counts before;
+	bool counted = SerialCounters::read(_fd, before);
+	int state = 0;
+	if (::ioctl(_fd, TIOCMGET, &state) != 0)
+	{
+		std::cerr << "Cannot read the modem lines: " << strerror(errno) << std::endl;
+		return;
+	}
+	// the first report has all lines
+	_state = ~state & _lines;
+	report(state, 0, 0, Poco::Timestamp(), true);
+	while (!stopped())
+	{
+		if (::ioctl(_fd, TIOCMIWAIT, _lines) != 0)
+		{
+			if (errno == EINTR) continue;
+			std::cerr << "Cannot wait for the modem lines: " << strerror(errno) << std::endl;
+			return;
+		}
+		Poco::Timestamp time;
+		SerialCounters::Counts after;
+		if (::ioctl(_fd, TIOCMGET, &state) != 0) continue;
+		if (counted && SerialCounters::read(_fd, after))
+		{
+			report(state, &before, &after, time, false);
+			before = after;
+		}
+		else report(state, 0, 0, time, false);
+	}
+}
+
+
+bool ModemLineMonitor::stopped()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _stopped;
+}
+
+
+int ModemLineMonitor::changes(const SerialCounters::Counts& before, const SerialCounters::Counts& after, int line)
+{
+	// the counters wrap around
+	switch (line)
+	{
+	case LINE_DCD: return static_cast<int>(static_cast<unsigned>(after.dcd) - static_cast<unsigned>(before.dcd));
+	case LINE_DSR: return static_cast<int>(static_cast<unsigned>(after.dsr) - static_cast<unsigned>(before.dsr));
+	case LINE_CTS: return static_cast<int>(static_cast<unsigned>(after.cts) - static_cast<unsigned>(before.cts));
+	case LINE_RI:  return static_cast<int>(static_cast<unsigned>(after.rng) - static_cast<unsigned>(before.rng));
+	default:       return 0;
+	}
+}
+
+
+void ModemLineMonitor::report(int state, const SerialCounters::Counts* pBefore, const SerialCounters::Counts* pAfter, const Poco::Timestamp& time, bool first)
+{
+	int changed = (state ^ _state) & _lines;
+	_state = state;
+	bool queued = false;
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		for (int line = 1; line <= _lines; line <<= 1)
+		{
+			if ((_lines & line) == 0) continue;
+			int n = pBefore ? changes(*pBefore, *pAfter, line) : 0;
+			// a change the counter missed, or no counters
+			if (n <= 0 && (changed & line) != 0) n = 1;
+			if (n <= 0) continue;
+			Event event;
+			event.line = line;
+			event.on = (state & line) != 0;
+			event.changes = first ? 0 : n;
+			event.time = time;
+			_events.push_back(event);
+			queued = true;
+		}
+	}
+	if (!queued) return;
+	// a full pipe has woken the reader already
+	char c = 0;
+	ssize_t rc = ::write(_pipe[1], &c, 1);
+	(void) rc;
+}
+
+
+void ModemLineMonitor::interrupted(int)
+{
+}
+
+
+int ModemLineMonitor::parse(const std::string& lines)
+{
+	int mask = 0;
+	Poco::StringTokenizer names(lines, ",; ", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = names.begin(); it != names.end(); ++it)
+	{
+		std::string name(Poco::toUpper(*it));
+		if (name == "DCD" || name == "CD") mask |= LINE_DCD;
+		else if (name == "DSR") mask |= LINE_DSR;
+		else if (name == "CTS") mask |= LINE_CTS;
+		else if (name == "RI" || name == "RNG") mask |= LINE_RI;
+		else throw Poco::InvalidArgumentException("Unknown modem line", *it);
+	}
+	return mask;
+}
+
+
+std::string ModemLineMonitor::name(int line)
+{
+	switch (line)
+	{
+	case LINE_DCD: return "DCD";
+	case LINE_DSR: return "DSR";
+	case LINE_CTS: return "CTS";
+	case LINE_RI:  return "RI";
+	default:       return "?";
+	}
+}
+
+
+std::string ModemLineMonitor::format(const Event& event)
+{
+	std::string message("!!!!..." + name(event.line) + (event.on ? " ON " : " OFF ") + Poco::DateTimeFormatter::format(event.time, "%Y-%m-%dT%H:%M:%S.%F") + "Z");
+	if (event.changes > 1) message += " changes=" + Poco::NumberFormatter::format(event.changes);
+	return message + "...!!!!";
+}
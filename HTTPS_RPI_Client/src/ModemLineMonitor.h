@@ -0,0 +1,143 @@
+//
+// ModemLineMonitor.h
+//
+// Definition of the ModemLineMonitor class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ModemLineMonitor_INCLUDED
+#define ModemLineMonitor_INCLUDED
+
+
+#include "SerialCounters.h"
+#include "Poco/Mutex.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Timestamp.h"
+#include <deque>
+#include <string>
+#include <signal.h>
+#include <sys/ioctl.h>
+
+
+class ModemLineMonitor: public Poco::Runnable
+	/// Reports the changes of the modem status lines of a serial port
+	/// (DCD, DSR, CTS and RI), to which dry contact alarms can be
+	/// wired, as timestamped events.
+	///
+	/// A thread of its own blocks in the TIOCMIWAIT ioctl until one of
+	/// the lines changes, so detection takes no CPU time while nothing
+	/// happens, and reads the lines with TIOCMGET right after it wakes
+	/// up. The time of an event is taken then. When the thread has
+	/// queued events, a byte is written to a pipe, whose read end the
+	/// EventLoop (or the capture process) waits for, like the SealPool.
+	///
+	/// The state of each line is reported once when the monitor
+	/// starts. Changes are counted with the kernel's interrupt counters
+	/// (TIOCGICOUNT, see SerialCounters), read before and after each
+	/// wait, so that a line that changes several times between two
+	/// wakeups, a short pulse or a contact bouncing, is reported with
+	/// the number of its changes even if its state is the same as
+	/// before. Without counters only a changed state is reported. Most
+	/// UART drivers count only the trailing edge of RI; its other
+	/// changes show in its state.
+	///
+	/// The thread is stopped with SIGUSR2, whose handler the monitor
+	/// installs for its lifetime; the handler before it is restored
+	/// when the monitor is destroyed.
+	///
+	/// TIOCMIWAIT needs a serial driver that supports it (most UART
+	/// and USB serial drivers do, pseudo terminals do not); the thread
+	/// ends with an error message if the driver refuses it.
+{
+public:
+	enum Line
+	{
+		LINE_DCD = TIOCM_CAR,
+		LINE_DSR = TIOCM_DSR,
+		LINE_CTS = TIOCM_CTS,
+		LINE_RI  = TIOCM_RNG
+	};
+
+	struct Event
+	{
+		int line;
+		bool on;
+		int changes;         /// since the last event of the line, 0 for the first report
+		Poco::Timestamp time;
+	};
+
+	ModemLineMonitor(int fd, int lines);
+		/// Creates the ModemLineMonitor for the serial port with the
+		/// given descriptor and the given lines, a combination of
+		/// Line values.
+
+	~ModemLineMonitor();
+		/// Stops the ModemLineMonitor and restores the SIGUSR2
+		/// handler it replaced.
+
+	void start();
+		/// Starts the thread.
+
+	void stop();
+		/// Stops the thread, by interrupting the ioctl with SIGUSR2.
+
+	bool next(Event& event);
+		/// Takes the next event. Returns false if there is none.
+
+	int fd() const;
+		/// Returns the descriptor that becomes readable when there are
+		/// events. Read it empty with drain() before taking them.
+
+	void drain();
+		/// Reads the pending wakeups from fd().
+
+	void run();
+		/// The thread.
+
+	static int parse(const std::string& lines);
+		/// Returns the lines in a list such as "DCD, DSR". Throws a
+		/// Poco::InvalidArgumentException for unknown names.
+
+	static std::string name(int line);
+		/// Returns the name of a line, "DCD", "DSR", "CTS" or "RI".
+
+	static std::string format(const Event& event);
+		/// Returns the message for the server, for example
+		/// "!!!!...DCD ON 2024-05-01T12:00:00.123456Z...!!!!", with
+		/// " changes=<n>" after the time if the line changed more
+		/// than once.
+
+private:
+	static void interrupted(int signal);
+	static int changes(const SerialCounters::Counts& before, const SerialCounters::Counts& after, int line);
+	void report(int state, const SerialCounters::Counts* pBefore, const SerialCounters::Counts* pAfter, const Poco::Timestamp& time, bool first);
+	bool stopped();
+
+	ModemLineMonitor(const ModemLineMonitor&);
+	ModemLineMonitor& operator = (const ModemLineMonitor&);
+
+	int _fd;
+	int _lines;
+	int _state;
+	Poco::Thread _thread;
+	std::deque<Event> _events;
+	Poco::FastMutex _mutex;  /// guards _events and _stopped
+	bool _stopped;
+	int _pipe[2];
+	struct sigaction _previous;  /// the SIGUSR2 action before the monitor
+};
+
+
+//
+// inlines
+//
+inline int ModemLineMonitor::fd() const
+{
+	return _pipe[0];
+}
+
+
+#endif // ModemLineMonitor_INCLUDED
@@ -0,0 +1,291 @@
+//
+// NetworkBenchmark.cpp
+//
+// Implementation of the NetworkBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "NetworkBenchmark.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
+#include "Poco/Timestamp.h"
+#include <algorithm>
+#include <iomanip>
+
+
+namespace
+{
+	const std::string MESSAGE("!!!!...REMOTE SYNC TROUBLE...!!!! #");
+
+
+	struct Record
+		/// What happened to the events of a scenario.
+	{
+		Record():
+			delivered(0),
+			duplicates(0),
+			rejected(0),
+			failures(0)
+		{
+		}
+
+		bool drained() const
+		{
+			return delivered == posted.size();
+		}
+
+		std::vector<Poco::Timestamp> posted;
+		std::vector<bool> acknowledged;
+		std::vector<Poco::Timestamp::TimeDiff> latencies;
+		std::size_t delivered;
+		int duplicates;   /// acknowledged again after a retry
+		int rejected;     /// acknowledged with a status other than 200
+		int failures;     /// uploads that failed and were retried
+	};
+
+
+	class BenchmarkClient: public AsyncClient
+		/// Records the acknowledgements and failures instead of
+		/// printing them.
+	{
+	public:
+		BenchmarkClient(const Poco::URI& uri, Poco::Net::Context::Ptr pContext, Seal seal, int connections, Record& record):
+			AsyncClient(uri, pContext, seal, connections),
+			_record(record)
+		{
+		}
+
+	protected:
+		void acknowledged(const Uploader&, const std::string& message, const Poco::Net::HTTPResponse& response, const std::string&)
+		{
+			std::size_t id = Poco::NumberParser::parseUnsigned(message.substr(MESSAGE.size()));
+			if (id >= _record.posted.size()) return;
+			if (_record.acknowledged[id])
+			{
+				// the first acknowledgement was lost with its connection
+				++_record.duplicates;
+				return;
+			}
+			_record.acknowledged[id] = true;
+			++_record.delivered;
+			_record.latencies.push_back(_record.posted[id].elapsed());
+			if (response.getStatus() != Poco::Net::HTTPResponse::HTTP_OK) ++_record.rejected;
+		}
+
+		void failed(const Uploader&, const Poco::Exception&)
+		{
+			++_record.failures;
+		}
+
+	private:
+		Record& _record;
+	};
+
+
+	class ScenarioTask: public AsyncTask
+		/// Plays the script on the proxy and posts events at the
+		/// given rate while it plays, then waits until all events
+		/// are delivered or the recovery timeout expires.
+	{
+	public:
+		ScenarioTask(AsyncClient& client, FaultProxy& proxy, const FaultProxy::Script& script, Record& record, int rate, const Poco::Timespan& recoveryTimeout):
+			AsyncTask(client.loop()),
+			_client(client),
+			_proxy(proxy),
+			_script(script),
+			_record(record),
+			_interval(Poco::Timespan::SECONDS/(rate > 0 ? rate : 1)),
+			_recoveryTimeout(recoveryTimeout),
+			_phase(0),
+			_recovered(false)
+		{
+		}
+
+		bool recovered() const
+		{
+			return _recovered;
+		}
+
+		const Poco::Timespan& recovery() const
+		{
+			return _recovery;
+		}
+
+	protected:
+		void resume()
+		{
+			ASYNC_BEGIN
+			_next.update();
+			for (_phase = 0; _phase < _script.size(); ++_phase)
+			{
+				_proxy.setFaults(_script[_phase].faults);
+				_phaseEnd.update();
+				_phaseEnd += _script[_phase].duration.totalMicroseconds();
+				while (_next < _phaseEnd)
+				{
+					post();
+					_next += _interval;
+					ASYNC_AWAIT(sleep(Poco::Timespan(std::max<Poco::Timestamp::TimeDiff>(_next - Poco::Timestamp(), 0))));
+				}
+			}
+			_proxy.setFaults(FaultProxy::Faults());
+			_end.update();
+			while (!_record.drained() && !_end.isElapsed(_recoveryTimeout.totalMicroseconds()))
+				ASYNC_AWAIT(sleep(Poco::Timespan(10*Poco::Timespan::MILLISECONDS)));
+			_recovered = _record.drained();
+			_recovery = _end.elapsed();
+			_client.stop();
+			ASYNC_END
+		}
+
+	private:
+		void post()
+		{
+			std::size_t id = _record.posted.size();
+			_record.posted.push_back(Poco::Timestamp());
+			_record.acknowledged.push_back(false);
+			_client.post(MESSAGE + Poco::NumberFormatter::format(id));
+		}
+
+		AsyncClient& _client;
+		FaultProxy& _proxy;
+		const FaultProxy::Script& _script;
+		Record& _record;
+		Poco::Timestamp::TimeDiff _interval;
+		Poco::Timespan _recoveryTimeout;
+		std::size_t _phase;
+		Poco::Timestamp _next;
+		Poco::Timestamp _phaseEnd;
+		Poco::Timestamp _end;
+		bool _recovered;
+		Poco::Timespan _recovery;
+	};
+
+
+	std::string milliseconds(Poco::Timestamp::TimeDiff microseconds)
+	{
+		return Poco::NumberFormatter::format(static_cast<double>(microseconds)/1000, 1);
+	}
+
+
+	void printResult(std::ostream& ostr, const std::string& name, const Record& record, int resets, const ScenarioTask& task)
+	{
+		std::vector<Poco::Timestamp::TimeDiff> latencies(record.latencies);
+		std::sort(latencies.begin(), latencies.end());
+		Poco::Timestamp::TimeDiff sum = 0;
+		for (std::size_t i = 0; i < latencies.size(); ++i) sum += latencies[i];
+
+		ostr << std::left << std::setw(12) << name << std::right
+		     << std::setw(8) << record.posted.size()
+		     << std::setw(11) << record.delivered
+		     << std::setw(7) << record.duplicates
+		     << std::setw(8) << record.failures
+		     << std::setw(8) << resets;
+		if (latencies.empty())
+		{
+			ostr << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(9) << "-";
+		}
+		else
+		{
+			std::size_t n = latencies.size();
+			ostr << std::setw(9) << milliseconds(sum/static_cast<Poco::Timestamp::TimeDiff>(n))
+			     << std::setw(9) << milliseconds(latencies[(n - 1)*50/100])
+			     << std::setw(9) << milliseconds(latencies[(n - 1)*99/100])
+			     << std::setw(9) << milliseconds(latencies[n - 1]);
+		}
+		ostr << std::setw(13) << (task.recovered() ? milliseconds(task.recovery().totalMicroseconds()) : std::string("timeout"));
+		if (record.rejected > 0) ostr << "  (" << record.rejected << " rejected)";
+		ostr << std::endl;
+	}
+}
+
+
+NetworkBenchmark::NetworkBenchmark(const Poco::URI& uri, Poco::Net::Context::Ptr pContext, AsyncClient::Seal seal, int connections, int rate):
+	_uri(uri),
+	_pContext(pContext),
+	_seal(seal),
+	_connections(connections),
+	_rate(rate),
+	_timeout(30, 0),
+	_retryDelay(5, 0),
+	_recoveryTimeout(120, 0),
+	_drainConnections(0),
+	_drainBacklog(0),
+	_sealThreads(0)
+{
+}
+
+
+NetworkBenchmark::~NetworkBenchmark()
+{
+}
+
+
+void NetworkBenchmark::add(const std::string& name, const FaultProxy::Script& script)
+{
+	Scenario scenario;
+	scenario.name = name;
+	scenario.script = script;
+	_scenarios.push_back(scenario);
+}
+
+
+void NetworkBenchmark::setTimeout(const Poco::Timespan& timeout)
+{
+	_timeout = timeout;
+}
+
+
+void NetworkBenchmark::setRetryDelay(const Poco::Timespan& delay)
+{
+	_retryDelay = delay;
+}
+
+
+void NetworkBenchmark::setRecoveryTimeout(const Poco::Timespan& timeout)
+{
+	_recoveryTimeout = timeout;
+}
+
+
+void NetworkBenchmark::setDrain(int maxConnections, std::size_t backlog)
+{
+	_drainConnections = maxConnections;
+	_drainBacklog = backlog;
+}
+
+
+void NetworkBenchmark::setSealThreads(int threads, const std::vector<int>& cpus)
+{
+	_sealThreads = threads;
+	_sealCPUs = cpus;
+}
+
+
+void NetworkBenchmark::run(std::ostream& ostr)
+{
+	FaultProxy proxy(Poco::Net::SocketAddress("127.0.0.1", 0), Poco::Net::SocketAddress(_uri.getHost(), _uri.getPort()));
+	proxy.start();
+
+	ostr << "scenario      events  delivered  dupes  errors  resets   avg ms   p50 ms   p99 ms   max ms  recovery ms" << std::endl;
+	for (std::vector<Scenario>::const_iterator it = _scenarios.begin(); it != _scenarios.end(); ++it)
+	{
+		Record record;
+		int resets = proxy.resets();
+		BenchmarkClient client(_uri, _pContext, _seal, _connections, record);
+		client.setTimeout(_timeout);
+		client.setRetryDelay(_retryDelay);
+		if (_drainConnections > 0) client.setDrain(_drainConnections, _drainBacklog);
+		client.setSealThreads(_sealThreads, _sealCPUs);
+		client.setAddress(proxy.address());
+		ScenarioTask task(client, proxy, it->script, record, _rate, _recoveryTimeout);
+		task.start();
+		client.run();
+		printResult(ostr, it->name, record, proxy.resets() - resets, task);
+	}
+	proxy.stop();
+}
@@ -0,0 +1,92 @@
+//
+// NetworkBenchmark.h
+//
+// Definition of the NetworkBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef NetworkBenchmark_INCLUDED
+#define NetworkBenchmark_INCLUDED
+
+
+#include "AsyncClient.h"
+#include "FaultProxy.h"
+#include "Poco/Net/Context.h"
+#include "Poco/Timespan.h"
+#include "Poco/URI.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+class NetworkBenchmark
+	/// Posts events at a fixed rate with the AsyncClient through a
+	/// FaultProxy on the loopback interface, plays a script of network
+	/// faults for each scenario and measures how the client copes:
+	/// the latency of each event from being posted until it is
+	/// acknowledged (including the time it waits in the queue), and
+	/// the time it takes after the faults end until every event is
+	/// delivered (the backlog recovery time).
+	///
+	/// Each scenario starts with a new AsyncClient, so connection
+	/// reuse does not carry over from one scenario to the next.
+{
+public:
+	NetworkBenchmark(const Poco::URI& uri, Poco::Net::Context::Ptr pContext, AsyncClient::Seal seal, int connections, int rate);
+		/// Creates the NetworkBenchmark for the server at the given
+		/// URI, with the given number of uploads in flight and
+		/// events per second.
+
+	~NetworkBenchmark();
+		/// Destroys the NetworkBenchmark.
+
+	void add(const std::string& name, const FaultProxy::Script& script);
+		/// Adds a scenario.
+
+	void setTimeout(const Poco::Timespan& timeout);
+		/// Sets the timeout of the AsyncClient.
+
+	void setRetryDelay(const Poco::Timespan& delay);
+		/// Sets the retry delay of the AsyncClient.
+
+	void setRecoveryTimeout(const Poco::Timespan& timeout);
+		/// Sets how long to wait for the backlog to drain after the
+		/// faults end. The default is 120 seconds.
+
+	void setDrain(int maxConnections, std::size_t backlog);
+		/// Enables the drain mode of the AsyncClient (see
+		/// AsyncClient::setDrain()).
+
+	void setSealThreads(int threads, const std::vector<int>& cpus);
+		/// Makes the AsyncClient seal on worker threads (see
+		/// AsyncClient::setSealThreads()).
+
+	void run(std::ostream& ostr);
+		/// Runs all scenarios and writes one line of results for each.
+
+private:
+	struct Scenario
+	{
+		std::string name;
+		FaultProxy::Script script;
+	};
+
+	Poco::URI _uri;
+	Poco::Net::Context::Ptr _pContext;
+	AsyncClient::Seal _seal;
+	int _connections;
+	int _rate;
+	Poco::Timespan _timeout;
+	Poco::Timespan _retryDelay;
+	Poco::Timespan _recoveryTimeout;
+	int _drainConnections;
+	std::size_t _drainBacklog;
+	int _sealThreads;
+	std::vector<int> _sealCPUs;
+	std::vector<Scenario> _scenarios;
+};
+
+
+#endif // NetworkBenchmark_INCLUDED
@@ -0,0 +1,90 @@
+//
+// RemoteConfig.cpp
+//
+// Implementation of the RemoteConfig class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "RemoteConfig.h"
+#include "Poco/Exception.h"
+#include "Poco/File.h"
+#include "Poco/NumberParser.h"
+#include <fstream>
+#include <sstream>
+
+
+RemoteConfig::RemoteConfig():
+	_version(0)
+{
+}
+
+
+RemoteConfig::~RemoteConfig()
+{
+}
+
+
+RemoteConfig::Map RemoteConfig::apply(const std::string& update, bool full) const
+{
+	Map values;
+	if (!full) values = _values;
+	std::istringstream istr(update);
+	std::string line;
+	while (std::getline(istr, line))
+	{
+		if (line.empty()) continue;
+		if (line[0] == '-')
+		{
+			if (full) throw Poco::SyntaxException("Removed key in a full configuration update", line);
+			values.erase(line.substr(1));
+			continue;
+		}
+		std::string::size_type eq = line.find('=');
+		if (eq == 0 || eq == std::string::npos)
+			throw Poco::SyntaxException("Invalid configuration line", line);
+		values[line.substr(0, eq)] = line.substr(eq + 1);
+	}
+	return values;
+}
+
+
+void RemoteConfig::commit(const std::string& epoch, Poco::UInt32 version, const Map& values)
+{
+	_epoch = epoch;
+	_version = version;
+	_values = values;
+}
+
+
+bool RemoteConfig::load(const std::string& path)
+{
+	std::ifstream istr(path.c_str());
+	if (!istr) return false;
+	std::string epoch, version;
+	std::getline(istr, epoch);
+	std::getline(istr, version);
+	std::ostringstream values;
+	values << istr.rdbuf();
+	Poco::UInt32 v = Poco::NumberParser::parseUnsigned(version);
+	_values = apply(values.str(), true);
+	_epoch = epoch;
+	_version = v;
+	return true;
+}
+
+
+void RemoteConfig::save(const std::string& path) const
+{
+	{
+		std::ofstream ostr((path + ".tmp").c_str(), std::ios::trunc);
+		ostr << _epoch << "\n" << _version << "\n";
+		for (Map::const_iterator it = _values.begin(); it != _values.end(); ++it)
+		{
+			ostr << it->first << "=" << it->second << "\n";
+		}
+		if (!ostr) throw Poco::WriteFileException(path);
+	}
+	Poco::File(path + ".tmp").renameTo(path);
+}
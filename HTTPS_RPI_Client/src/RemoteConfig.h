@@ -0,0 +1,90 @@
+//
+// RemoteConfig.h
+//
+// Definition of the RemoteConfig class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef RemoteConfig_INCLUDED
+#define RemoteConfig_INCLUDED
+
+
+#include "Poco/Types.h"
+#include <map>
+#include <string>
+
+
+class RemoteConfig
+	/// The configuration the server pushes to the client (see the
+	/// server's ConfigStore): the values, and the epoch and version
+	/// they belong to, which the client sends with its next poll so
+	/// that the server answers with the changes only.
+	///
+	/// An update is one "key=value" line per changed key and one
+	/// "-key" line per removed key, or all keys for a full update.
+{
+public:
+	typedef std::map<std::string, std::string> Map;
+
+	RemoteConfig();
+		/// Creates an empty RemoteConfig with no version.
+
+	~RemoteConfig();
+		/// Destroys the RemoteConfig.
+
+	const std::string& epoch() const;
+		/// Returns the epoch of the server the values came from.
+
+	Poco::UInt32 version() const;
+		/// Returns the version of the values, 0 if there are none.
+
+	const Map& values() const;
+		/// Returns the values.
+
+	Map apply(const std::string& update, bool full) const;
+		/// Returns the values with the update applied, leaving this
+		/// RemoteConfig unchanged. Throws a Poco::SyntaxException if
+		/// a line is malformed.
+
+	void commit(const std::string& epoch, Poco::UInt32 version, const Map& values);
+		/// Replaces epoch, version and values.
+
+	bool load(const std::string& path);
+		/// Reads the configuration written by save(). Returns false if
+		/// the file does not exist.
+
+	void save(const std::string& path) const;
+		/// Writes the configuration to a new file and renames it, so
+		/// that a crash leaves the old one or the new one.
+
+private:
+	std::string _epoch;
+	Poco::UInt32 _version;
+	Map _values;
+};
+
+
+//
+// inlines
+//
+inline const std::string& RemoteConfig::epoch() const
+{
+	return _epoch;
+}
+
+
+inline Poco::UInt32 RemoteConfig::version() const
+{
+	return _version;
+}
+
+
+inline const RemoteConfig::Map& RemoteConfig::values() const
+{
+	return _values;
+}
+
+
+#endif // RemoteConfig_INCLUDED
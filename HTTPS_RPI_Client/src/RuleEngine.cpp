@@ -0,0 +1,227 @@
+//
+// RuleEngine.cpp
+//
+// Implementation of the RuleEngine class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "RuleEngine.h"
+#include "Poco/Ascii.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
+#include "Poco/String.h"
+#include "Poco/StringTokenizer.h"
+#include <string.h>
+#include <time.h>
+
+
+RuleEngine::Rule::Rule():
+	action(ACTION_PASS),
+	hours(ALL_HOURS),
+	count(1),
+	interval(60, 0)
+{
+}
+
+
+RuleEngine::RuleEngine()
+{
+}
+
+
+RuleEngine::~RuleEngine()
+{
+}
+
+
+void RuleEngine::add(const Rule& rule)
+{
+	if (rule.match.empty())
+		throw Poco::InvalidArgumentException("Rule without match", rule.name);
+	if (rule.count < 1 || (rule.action != ACTION_PASS && rule.action != ACTION_SUPPRESS && rule.interval <= 0))
+		throw Poco::InvalidArgumentException("Rule without count or interval", rule.name);
+	if (_rules.size() >= MAX_RULES)
+		throw Poco::InvalidArgumentException("Too many rules", rule.name);
+	_rules.push_back(rule);
+	_table.clear();
+}
+
+
+void RuleEngine::compile()
+{
+	_table.clear();
+	for (std::vector<Rule>::const_iterator it = _rules.begin(); it != _rules.end(); ++it)
+	{
+		if (it->match[it->match.size() - 1] != '*') row(it->match);
+	}
+}
+
+
+RuleEngine::Decision RuleEngine::decide(const std::string& message)
+{
+	Poco::Timestamp now;
+	time_t t = static_cast<time_t>(now.epochTime());
+	struct tm local;
+	localtime_r(&t, &local);
+	return decide(message, local.tm_hour, now);
+}
+
+
+RuleEngine::Decision RuleEngine::decide(const std::string& message, int hour, const Poco::Timestamp& now)
+{
+	if (_rules.empty()) return DECISION_SEND;
+
+	std::string type(this->type(message));
+	Row& row = this->row(type);
+	unsigned char r = row.rules[hour % 24];
+	if (r != row.current)
+	{
+		// the hour has brought another rule
+		close(type, row, now);
+		row.current = r;
+	}
+	if (r == NO_RULE) return DECISION_SEND;
+
+	const Rule& rule = _rules[r];
+	if (rule.action != ACTION_PASS && rule.action != ACTION_SUPPRESS && now - row.start >= rule.interval.totalMicroseconds())
+		close(type, row, now);
+	switch (rule.action)
+	{
+	case ACTION_SUPPRESS:
+		return DECISION_DROP;
+	case ACTION_RATE_LIMIT:
+		if (++row.count <= rule.count) return DECISION_SEND;
+		++row.dropped;
+		return DECISION_DROP;
+	case ACTION_AGGREGATE:
+		if (row.count++ == 0) row.first = now;
+		row.last = now;
+		return DECISION_DROP;
+	case ACTION_ESCALATE:
+		return ++row.count >= rule.count ? DECISION_ESCALATE : DECISION_SEND;
+	default:
+		return DECISION_SEND;
+	}
+}
+
+
+void RuleEngine::flush(std::vector<std::string>& messages, const Poco::Timestamp& now)
+{
+	for (Table::iterator it = _table.begin(); it != _table.end(); ++it)
+	{
+		Row& row = it->second;
+		if (row.current != NO_RULE && (row.count > 0 || row.dropped > 0) && now - row.start >= _rules[row.current].interval.totalMicroseconds())
+			close(it->first, row, now);
+	}
+	messages.insert(messages.end(), _summaries.begin(), _summaries.end());
+	_summaries.clear();
+}
+
+
+std::string RuleEngine::type(const std::string& message)
+{
+	std::string::size_type begin = message.find_first_not_of("!.");
+	if (begin == std::string::npos) return std::string();
+	std::string::size_type end = begin;
+	while (end < message.size() && (Poco::Ascii::isAlpha(message[end]) || message[end] == '_' || message[end] == ' ')) ++end;
+	while (end > begin && message[end - 1] == ' ') --end;
+	return message.substr(begin, end - begin);
+}
+
+
+RuleEngine::Action RuleEngine::parseAction(const std::string& action)
+{
+	if (action == "pass") return ACTION_PASS;
+	if (action == "suppress") return ACTION_SUPPRESS;
+	if (action == "ratelimit") return ACTION_RATE_LIMIT;
+	if (action == "aggregate") return ACTION_AGGREGATE;
+	if (action == "escalate") return ACTION_ESCALATE;
+	throw Poco::InvalidArgumentException("Unknown rule action", action);
+}
+
+
+Poco::UInt32 RuleEngine::parseHours(const std::string& hours)
+{
+	std::string list(Poco::trim(hours));
+	if (list.empty() || list == "*") return ALL_HOURS;
+
+	Poco::UInt32 mask = 0;
+	Poco::StringTokenizer tokens(list, ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = tokens.begin(); it != tokens.end(); ++it)
+	{
+		std::string::size_type dash = it->find('-');
+		unsigned from = Poco::NumberParser::parseUnsigned(Poco::trim(it->substr(0, dash)));
+		unsigned to = dash == std::string::npos ? (from + 1) % 24 : Poco::NumberParser::parseUnsigned(Poco::trim(it->substr(dash + 1)));
+		if (from > 23 || to > 24)
+			throw Poco::SyntaxException("Invalid hours", *it);
+		to %= 24;
+		// a range may wrap around midnight
+		unsigned hour = from;
+		do
+		{
+			mask |= 1u << hour;
+			hour = (hour + 1) % 24;
+		}
+		while (hour != to);
+	}
+	return mask;
+}
+
+
+RuleEngine::Row& RuleEngine::row(const std::string& type)
+{
+	Table::iterator it = _table.find(type);
+	if (it != _table.end()) return it->second;
+
+	Row row;
+	memset(row.rules, NO_RULE, sizeof(row.rules));
+	for (int hour = 0; hour < 24; ++hour)
+	{
+		for (std::size_t r = 0; r < _rules.size(); ++r)
+		{
+			if ((_rules[r].hours & (1u << hour)) && matches(_rules[r].match, type))
+			{
+				row.rules[hour] = static_cast<unsigned char>(r);
+				break;
+			}
+		}
+	}
+	row.current = NO_RULE;
+	row.count = 0;
+	row.dropped = 0;
+	return _table.insert(Table::value_type(type, row)).first->second;
+}
+
+
+void RuleEngine::close(const std::string& type, Row& row, const Poco::Timestamp& now)
+{
+	if (row.current != NO_RULE)
+	{
+		const Rule& rule = _rules[row.current];
+		if (rule.action == ACTION_RATE_LIMIT && row.dropped > 0)
+		{
+			_summaries.push_back("!!!!...RATE LIMITED " + type + " dropped=" + Poco::NumberFormatter::format(row.dropped) + "...!!!!");
+		}
+		else if (rule.action == ACTION_AGGREGATE && row.count > 0)
+		{
+			_summaries.push_back("!!!!...AGGREGATE " + type + " count=" + Poco::NumberFormatter::format(row.count) +
+				" first=" + Poco::DateTimeFormatter::format(row.first, "%Y-%m-%dT%H:%M:%S.%FZ") +
+				" last=" + Poco::DateTimeFormatter::format(row.last, "%Y-%m-%dT%H:%M:%S.%FZ") + "...!!!!");
+		}
+	}
+	row.start = now;
+	row.count = 0;
+	row.dropped = 0;
+}
+
+
+bool RuleEngine::matches(const std::string& pattern, const std::string& type)
+{
+	if (pattern[pattern.size() - 1] == '*')
+		return type.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0;
+	return pattern == type;
+}
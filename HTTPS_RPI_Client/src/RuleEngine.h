@@ -0,0 +1,172 @@
+//
+// RuleEngine.h
+//
+// Definition of the RuleEngine class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef RuleEngine_INCLUDED
+#define RuleEngine_INCLUDED
+
+
+#include "Poco/Timespan.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <map>
+#include <string>
+#include <vector>
+
+
+class RuleEngine
+	/// Decides, before a message is sealed, whether it is uploaded, so
+	/// that noisy sites send less while important changes go out at
+	/// once.
+	///
+	/// The type of a message is the leading words of its text made of
+	/// letters only, for example "REMOTE SYNC TROUBLE", "DCD ON" or
+	/// "SERIAL OVERRUN". A rule matches a type exactly, by prefix (a
+	/// pattern ending in '*') or all types ("*"), during some hours of
+	/// the day (local time), and has one of the actions:
+	///
+	///   - pass: the message is uploaded;
+	///   - suppress: the message is dropped;
+	///   - ratelimit: at most count messages of the type are uploaded
+	///     per interval; the number dropped is uploaded at the end of
+	///     the interval as "!!!!...RATE LIMITED <type> dropped=N...!!!!";
+	///   - aggregate: the messages of the type are counted, and one
+	///     "!!!!...AGGREGATE <type> count=N first=<time> last=<time>...!!!!"
+	///     is uploaded per interval instead;
+	///   - escalate: the message is uploaded before the queued ones
+	///     once count messages of the type have come within interval.
+	///
+	/// The first rule in the order they were added that matches the
+	/// type and the hour applies; messages no rule matches are
+	/// uploaded. compile() resolves the rules into a row of 24 rule
+	/// numbers, one per hour, for every type a rule names exactly, so
+	/// that decide() takes a map lookup and an index. The row of
+	/// another type is made the first time it is seen.
+	///
+	/// A RuleEngine is not thread-safe; the AsyncClient uses it on
+	/// its EventLoop thread.
+{
+public:
+	enum Action
+	{
+		ACTION_PASS,
+		ACTION_SUPPRESS,
+		ACTION_RATE_LIMIT,
+		ACTION_AGGREGATE,
+		ACTION_ESCALATE
+	};
+
+	enum Decision
+	{
+		DECISION_DROP,
+		DECISION_SEND,
+		DECISION_ESCALATE
+	};
+
+	struct Rule
+	{
+		Rule();
+
+		std::string name;
+		std::string match;     /// the type, a prefix ending in '*', or "*"
+		Action action;
+		Poco::UInt32 hours;    /// bit n set for the hour n to n+1
+		int count;
+		Poco::Timespan interval;
+	};
+
+	enum
+	{
+		ALL_HOURS = 0xFFFFFF,
+		MAX_RULES = 255
+	};
+
+	RuleEngine();
+		/// Creates a RuleEngine without rules.
+
+	~RuleEngine();
+		/// Destroys the RuleEngine.
+
+	void add(const Rule& rule);
+		/// Adds a rule after the others. Throws a
+		/// Poco::InvalidArgumentException if the rule is incomplete or
+		/// there are too many rules.
+
+	void compile();
+		/// Makes the decision table for the rules added.
+
+	bool empty() const;
+		/// Returns true if there are no rules.
+
+	Decision decide(const std::string& message);
+		/// Decides about a message at the current time.
+
+	Decision decide(const std::string& message, int hour, const Poco::Timestamp& now);
+		/// Decides about a message at the given hour of the day and
+		/// time.
+
+	void flush(std::vector<std::string>& messages, const Poco::Timestamp& now = Poco::Timestamp());
+		/// Appends the summaries of the rate limits and aggregates
+		/// whose interval has ended.
+
+	static std::string type(const std::string& message);
+		/// Returns the type of a message.
+
+	static Action parseAction(const std::string& action);
+		/// Parses "pass", "suppress", "ratelimit", "aggregate" or
+		/// "escalate". Throws a Poco::InvalidArgumentException
+		/// otherwise.
+
+	static Poco::UInt32 parseHours(const std::string& hours);
+		/// Parses a list of hours and ranges of hours, such as "22-6,
+		/// 12" (22:00 to 6:00, and 12:00 to 13:00). An empty list or
+		/// "*" is all day. Throws a Poco::SyntaxException if the list
+		/// is malformed.
+
+private:
+	enum
+	{
+		NO_RULE = 255
+	};
+
+	struct Row
+	{
+		unsigned char rules[24];
+		unsigned char current;    /// the rule the window belongs to
+		Poco::Timestamp start;    /// of the window
+		int count;                /// messages in the window
+		int dropped;              /// messages rate limited in the window
+		Poco::Timestamp first;    /// of the aggregated messages
+		Poco::Timestamp last;
+	};
+
+	typedef std::map<std::string, Row> Table;
+
+	Row& row(const std::string& type);
+	void close(const std::string& type, Row& row, const Poco::Timestamp& now);
+	static bool matches(const std::string& pattern, const std::string& type);
+
+	RuleEngine(const RuleEngine&);
+	RuleEngine& operator = (const RuleEngine&);
+
+	std::vector<Rule> _rules;
+	Table _table;
+	std::vector<std::string> _summaries;
+};
+
+
+//
+// inlines
+//
+inline bool RuleEngine::empty() const
+{
+	return _rules.empty();
+}
+
+
+#endif // RuleEngine_INCLUDED
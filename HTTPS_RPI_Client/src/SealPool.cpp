@@ -0,0 +1,154 @@
+//
+// SealPool.cpp
+//
+// Implementation of the SealPool class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SealPool.h"
+#include "Poco/Exception.h"
+#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+
+SealPool::Job::Job():
+	sealed(false),
+	done(false)
+{
+}
+
+
+SealPool::Job::~Job()
+{
+}
+
+
+SealPool::SealPool(Seal seal, int threads, const std::vector<int>& cpus):
+	_seal(seal),
+	_cpus(cpus),
+	_stopped(false),
+	_started(0)
+{
+	if (::pipe(_pipe) != 0)
+		throw Poco::SystemException("Cannot create pipe");
+	::fcntl(_pipe[0], F_SETFL, O_NONBLOCK);
+	::fcntl(_pipe[1], F_SETFL, O_NONBLOCK);
+	for (int i = 0; i < threads; ++i)
+	{
+		_threads.push_back(new Poco::Thread);
+		_threads.back()->start(*this);
+	}
+}
+
+
+SealPool::~SealPool()
+{
+	{
+		Poco::Mutex::ScopedLock lock(_mutex);
+		_stopped = true;
+		_ready.broadcast();
+	}
+	for (std::vector<Poco::SharedPtr<Poco::Thread> >::iterator it = _threads.begin(); it != _threads.end(); ++it)
+	{
+		(*it)->join();
+	}
+	for (std::deque<Job*>::iterator it = _submitted.begin(); it != _submitted.end(); ++it) delete *it;
+	::close(_pipe[0]);
+	::close(_pipe[1]);
+}
+
+
+void SealPool::submit(Job* pJob)
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	pJob->done = false;
+	_queue.push_back(pJob);
+	_submitted.push_back(pJob);
+	_ready.signal();
+}
+
+
+SealPool::Job* SealPool::collect()
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	if (_submitted.empty() || !_submitted.front()->done) return 0;
+	Job* pJob = _submitted.front();
+	_submitted.pop_front();
+	return pJob;
+}
+
+
+void SealPool::drain()
+{
+	char buffer[64];
+	while (::read(_pipe[0], buffer, sizeof(buffer)) > 0)
+	{
+	}
+}
+
+
+void SealPool::run()
+{
+	{
+		Poco::Mutex::ScopedLock lock(_mutex);
+		if (!_cpus.empty()) bind(_cpus[_started % _cpus.size()]);
+		++_started;
+	}
+	for (;;)
+	{
+		Job* pJob = 0;
+		{
+			Poco::Mutex::ScopedLock lock(_mutex);
+			while (_queue.empty() && !_stopped) _ready.wait(_mutex);
+			if (_stopped) return;
+			pJob = _queue.front();
+			_queue.pop_front();
+		}
+
+		// a job that cannot be sealed here is sealed again by the
+		// Uploader, which reports the error
+		try
+		{
+			Poco::Net::HTTPRequest request;
+			for (Poco::Net::NameValueCollection::ConstIterator it = pJob->headers.begin(); it != pJob->headers.end(); ++it)
+			{
+				request.set(it->first, it->second);
+			}
+			pJob->body = _seal(pJob->message, request);
+			pJob->headers.clear();
+			for (Poco::Net::NameValueCollection::ConstIterator it = request.begin(); it != request.end(); ++it)
+			{
+				pJob->headers.add(it->first, it->second);
+			}
+			pJob->sealed = true;
+		}
+		catch (Poco::Exception&)
+		{
+			pJob->sealed = false;
+		}
+
+		{
+			Poco::Mutex::ScopedLock lock(_mutex);
+			pJob->done = true;
+		}
+		// a full pipe has woken the EventLoop already
+		char c = 0;
+		ssize_t rc = ::write(_pipe[1], &c, 1);
+		(void) rc;
+	}
+}
+
+
+void SealPool::bind(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (::sched_setaffinity(0, sizeof(set), &set) != 0)
+		std::cerr << "Cannot bind seal worker to CPU " << cpu << ": " << errno << std::endl;
+}
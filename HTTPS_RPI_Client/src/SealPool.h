@@ -0,0 +1,126 @@
+//
+// SealPool.h
+//
+// Definition of the SealPool class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SealPool_INCLUDED
+#define SealPool_INCLUDED
+
+
+#include "Poco/Net/HTTPRequest.h"
+#include "Poco/Net/NameValueCollection.h"
+#include "Poco/Condition.h"
+#include "Poco/Mutex.h"
+#include "Poco/Runnable.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Thread.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+
+class SealPool: public Poco::Runnable
+	/// Worker threads that seal (encrypt or sign) messages for the
+	/// AsyncClient, so that the public key operations run on the other
+	/// cores of the board while the EventLoop thread keeps the
+	/// connections busy.
+	///
+	/// Jobs are submitted and collected on the EventLoop thread. When
+	/// a job is done, a byte is written to a pipe, whose read end the
+	/// EventLoop waits for.
+	///
+	/// The workers finish jobs in any order, but jobs are collected in
+	/// the order they were submitted: a job done early waits for those
+	/// submitted before it, so that the messages keep the order of
+	/// their sequence numbers in the upload queue.
+{
+public:
+	typedef std::string (*Seal)(const std::string& message, Poco::Net::HTTPRequest& request);
+
+	struct Job
+		/// A message to seal. The submitter may derive from Job to
+		/// carry its own data along.
+	{
+		Job();
+		virtual ~Job();
+
+		std::string message;
+		Poco::Net::NameValueCollection headers;  /// the request headers, before and after sealing
+		std::string body;                         /// the sealed message
+		bool sealed;                              /// false if the seal function threw
+
+	private:
+		bool done;
+		friend class SealPool;
+	};
+
+	SealPool(Seal seal, int threads, const std::vector<int>& cpus);
+		/// Starts the given number of worker threads. If cpus is not
+		/// empty, worker i is bound to the CPU cpus[i % cpus.size()].
+		///
+		/// The seal function is called on the worker threads, and must
+		/// be thread-safe.
+
+	~SealPool();
+		/// Stops the worker threads. Jobs not collected are deleted.
+
+	void submit(Job* pJob);
+		/// Queues a job for sealing. The SealPool owns it until it is
+		/// collected.
+
+	Job* collect();
+		/// Returns the next sealed job in the order of submission, or
+		/// null if it is not done yet.
+
+	int fd() const;
+		/// Returns the descriptor that becomes readable when jobs are
+		/// done. Read it empty with drain() before collecting.
+
+	void drain();
+		/// Reads the pending wakeups from fd().
+
+	int threads() const;
+		/// Returns the number of worker threads.
+
+	void run();
+		/// The worker thread.
+
+private:
+	static void bind(int cpu);
+
+	SealPool(const SealPool&);
+	SealPool& operator = (const SealPool&);
+
+	Seal _seal;
+	std::vector<int> _cpus;
+	std::vector<Poco::SharedPtr<Poco::Thread> > _threads;
+	std::deque<Job*> _queue;     /// the jobs waiting for a worker
+	std::deque<Job*> _submitted; /// all jobs not collected, in the order of submission
+	Poco::Mutex _mutex;
+	Poco::Condition _ready;
+	bool _stopped;
+	int _started;
+	int _pipe[2];
+};
+
+
+//
+// inlines
+//
+inline int SealPool::fd() const
+{
+	return _pipe[0];
+}
+
+
+inline int SealPool::threads() const
+{
+	return static_cast<int>(_threads.size());
+}
+
+
+#endif // SealPool_INCLUDED
@@ -0,0 +1,44 @@
+//
+// SensorFlow.cpp
+//
+// Implementation of the SensorFlow stages.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SensorFlow.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/NumberFormatter.h"
+
+
+SensorWindow::SensorWindow():
+	start(0),
+	count(0),
+	min(0),
+	max(0),
+	sum(0),
+	last(0)
+{
+}
+
+
+void SensorWindow::add(double value)
+{
+	if (count++ == 0 || value < min) min = value;
+	if (count == 1 || value > max) max = value;
+	sum += value;
+	last = value;
+}
+
+
+std::string SensorWindow::format(const std::string& channel) const
+{
+	return "!!!!...SENSOR " + channel +
+		" start=" + Poco::DateTimeFormatter::format(Poco::Timestamp(start*1000), "%Y-%m-%dT%H:%M:%S.%iZ") +
+		" n=" + Poco::NumberFormatter::format(count) +
+		" min=" + Poco::NumberFormatter::format(min) +
+		" max=" + Poco::NumberFormatter::format(max) +
+		" avg=" + Poco::NumberFormatter::format(count > 0 ? sum/count : 0) +
+		" last=" + Poco::NumberFormatter::format(last) + "...!!!!";
+}
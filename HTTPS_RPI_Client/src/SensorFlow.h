@@ -0,0 +1,197 @@
+//
+// SensorFlow.h
+//
+// Definition of the SensorFlow class template and its stages.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SensorFlow_INCLUDED
+#define SensorFlow_INCLUDED
+
+
+#include "Pipeline.h"
+#include "SeriesCodec.h"
+#include "Poco/NumberParser.h"
+#include "Poco/String.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <map>
+#include <string>
+
+
+struct Reading
+	/// A numeric reading of a channel.
+{
+	std::string channel;
+	Poco::Int64 time;     /// milliseconds since the epoch
+	double value;
+};
+
+
+struct SensorWindow
+	/// The statistics of the readings of a channel in a window.
+{
+	SensorWindow();
+
+	void add(double value);
+		/// Adds a reading.
+
+	std::string format(const std::string& channel) const;
+		/// Returns the message for the server,
+		/// "!!!!...SENSOR <channel> start=<time> n=<count> min=<min> max=<max> avg=<avg> last=<last>...!!!!".
+
+	Poco::Int64 start;
+	std::size_t count;
+	double min;
+	double max;
+	double sum;
+	double last;
+};
+
+
+template <class Next>
+class ReadingParser
+	/// Parses "<channel>=<value>" lines into Readings stamped with the
+	/// time they are parsed. Other lines are dropped.
+{
+public:
+	explicit ReadingParser(const Next& next = Next()):
+		_next(next)
+	{
+	}
+
+	void push(const std::string& line)
+	{
+		std::string::size_type eq = line.find('=');
+		if (eq == std::string::npos) return;
+		_reading.channel = Poco::trim(line.substr(0, eq));
+		if (_reading.channel.empty() || _reading.channel.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_.-") != std::string::npos) return;
+		if (!Poco::NumberParser::tryParseFloat(Poco::trim(line.substr(eq + 1)), _reading.value)) return;
+		_reading.time = Poco::Timestamp().epochMicroseconds()/1000;
+		_next.push(_reading);
+	}
+
+	void flush()
+	{
+		_next.flush();
+	}
+
+	Next& next()
+	{
+		return _next;
+	}
+
+private:
+	Reading _reading;
+	Next _next;
+};
+
+
+template <class Next>
+class Downsampler
+	/// Passes on, per channel and window, a message with the minimum,
+	/// maximum, average and last reading (see SensorWindow) and, if
+	/// raw is set, the readings themselves as a series message (see
+	/// SeriesEncoder). Windows are aligned to the epoch, so that those
+	/// of different devices line up. The series of a window is passed
+	/// on early when it reaches maxPoints.
+	///
+	/// A window is passed on with the first reading after it, or by
+	/// expire(), which the source calls while no readings come.
+{
+public:
+	Downsampler(Poco::Int64 window, bool raw, std::size_t maxPoints, const Next& next = Next()):
+		_window(window > 0 ? window : 1),
+		_raw(raw),
+		_maxPoints(maxPoints > 0 ? maxPoints : 1),
+		_next(next)
+	{
+	}
+
+	void push(const Reading& reading)
+	{
+		Channel& channel = _channels[reading.channel];
+		if (channel.window.count > 0 && reading.time >= channel.window.start + _window)
+			pass(reading.channel, channel);
+		if (channel.window.count == 0)
+			channel.window.start = reading.time - reading.time % _window;
+		channel.window.add(reading.value);
+		if (_raw)
+		{
+			channel.series.append(reading.time, reading.value);
+			if (channel.series.size() >= _maxPoints)
+				_next.push(channel.series.finish(reading.channel));
+		}
+	}
+
+	void expire(Poco::Int64 now)
+		/// Passes on the windows that have ended before now.
+	{
+		for (typename ChannelMap::iterator it = _channels.begin(); it != _channels.end(); ++it)
+		{
+			if (it->second.window.count > 0 && now >= it->second.window.start + _window)
+				pass(it->first, it->second);
+		}
+	}
+
+	void flush()
+		/// Passes on the open windows.
+	{
+		for (typename ChannelMap::iterator it = _channels.begin(); it != _channels.end(); ++it)
+		{
+			if (it->second.window.count > 0) pass(it->first, it->second);
+		}
+		_next.flush();
+	}
+
+	Next& next()
+	{
+		return _next;
+	}
+
+private:
+	struct Channel
+	{
+		SensorWindow window;
+		SeriesEncoder series;
+	};
+
+	typedef std::map<std::string, Channel> ChannelMap;
+
+	void pass(const std::string& name, Channel& channel)
+	{
+		_next.push(channel.window.format(name));
+		if (channel.series.size() > 0)
+			_next.push(channel.series.finish(name));
+		channel.window = SensorWindow();
+	}
+
+	Poco::Int64 _window;
+	bool _raw;
+	std::size_t _maxPoints;
+	ChannelMap _channels;
+	Next _next;
+};
+
+
+template <class Sink>
+struct SensorFlow
+	/// The pipeline from a UART that sends numeric readings, one
+	/// "<channel>=<value>" line each, to the uploads: the lines are
+	/// parsed and downsampled into window summaries and compressed
+	/// series, which are pushed to the Sink as std::strings.
+{
+	typedef Downsampler<Sink> Downsample;
+	typedef ReadingParser<Downsample> Parse;
+	typedef Framer<Parse> Type;
+
+	static Type create(const Sink& sink, Poco::Int64 window, bool raw, std::size_t maxPoints)
+	{
+		return Type('\n', Parse(Downsample(window, raw, maxPoints, sink)));
+	}
+};
+
+
+#endif // SensorFlow_INCLUDED
@@ -0,0 +1,116 @@
+//
+// SerialCounters.cpp
+//
+// Implementation of the SerialCounters class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SerialCounters.h"
+#include "Poco/NumberFormatter.h"
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <string.h>
+
+
+SerialCounters::Counts::Counts():
+	rx(0),
+	tx(0),
+	frame(0),
+	parity(0),
+	brk(0),
+	overrun(0),
+	bufferOverrun(0),
+	cts(0),
+	dsr(0),
+	rng(0),
+	dcd(0)
+{
+}
+
+
+SerialCounters::SerialCounters(int fd, const std::string& port, const Poco::Timespan& reportInterval):
+	_fd(fd),
+	_port(port),
+	_reportInterval(reportInterval),
+	_dropped(0),
+	_first(true)
+{
+}
+
+
+SerialCounters::~SerialCounters()
+{
+}
+
+
+bool SerialCounters::poll(std::vector<std::string>& messages, Poco::UInt32 dropped)
+{
+	Counts counts;
+	if (!read(counts)) return false;
+
+	if (!_first && (counts.overrun > _counts.overrun || counts.bufferOverrun > _counts.bufferOverrun))
+	{
+		messages.push_back("!!!!...SERIAL OVERRUN " + _port +
+			" overrun=+" + Poco::NumberFormatter::format(counts.overrun - _counts.overrun) +
+			" bufferOverrun=+" + Poco::NumberFormatter::format(counts.bufferOverrun - _counts.bufferOverrun) + "...!!!!");
+	}
+	_counts = counts;
+	if (_first || ((changed(_counts, _reported) || dropped != _dropped) && _reportTime.isElapsed(_reportInterval.totalMicroseconds())))
+	{
+		messages.push_back(metrics(dropped));
+		_reported = _counts;
+		_dropped = dropped;
+		_reportTime.update();
+		_first = false;
+	}
+	return true;
+}
+
+
+bool SerialCounters::read(Counts& counts) const
+{
+	return read(_fd, counts);
+}
+
+
+bool SerialCounters::read(int fd, Counts& counts)
+{
+	struct serial_icounter_struct icount;
+	memset(&icount, 0, sizeof(icount));
+	if (::ioctl(fd, TIOCGICOUNT, &icount) != 0) return false;
+	counts.rx = icount.rx;
+	counts.tx = icount.tx;
+	counts.frame = icount.frame;
+	counts.parity = icount.parity;
+	counts.brk = icount.brk;
+	counts.overrun = icount.overrun;
+	counts.bufferOverrun = icount.buf_overrun;
+	counts.cts = icount.cts;
+	counts.dsr = icount.dsr;
+	counts.rng = icount.rng;
+	counts.dcd = icount.dcd;
+	return true;
+}
+
+
+std::string SerialCounters::metrics(Poco::UInt32 dropped) const
+{
+	return "!!!!...SERIAL " + _port +
+		" rx=" + Poco::NumberFormatter::format(_counts.rx) +
+		" tx=" + Poco::NumberFormatter::format(_counts.tx) +
+		" frame=" + Poco::NumberFormatter::format(_counts.frame) +
+		" parity=" + Poco::NumberFormatter::format(_counts.parity) +
+		" break=" + Poco::NumberFormatter::format(_counts.brk) +
+		" overrun=" + Poco::NumberFormatter::format(_counts.overrun) +
+		" bufferOverrun=" + Poco::NumberFormatter::format(_counts.bufferOverrun) +
+		" dropped=" + Poco::NumberFormatter::format(dropped) + "...!!!!";
+}
+
+
+bool SerialCounters::changed(const Counts& a, const Counts& b)
+{
+	return a.rx != b.rx || a.tx != b.tx || a.frame != b.frame || a.parity != b.parity ||
+	       a.brk != b.brk || a.overrun != b.overrun || a.bufferOverrun != b.bufferOverrun;
+}
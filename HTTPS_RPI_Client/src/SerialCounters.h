@@ -0,0 +1,123 @@
+//
+// SerialCounters.h
+//
+// Definition of the SerialCounters class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SerialCounters_INCLUDED
+#define SerialCounters_INCLUDED
+
+
+#include "Poco/Timespan.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <string>
+#include <vector>
+
+
+class SerialCounters
+	/// The counters the kernel keeps for a serial port, read with the
+	/// TIOCGICOUNT ioctl: the bytes received and sent, and the receive
+	/// errors, framing and parity errors, breaks, overruns of the UART
+	/// FIFO and of the tty buffer.
+	///
+	/// They are uploaded as metrics messages, such as
+	///
+	///     !!!!...SERIAL /dev/ttyS4 rx=1042 tx=0 frame=0 parity=0 break=0 overrun=2 bufferOverrun=0 dropped=0...!!!!
+	///
+	/// when they have changed, at most once per report interval, so
+	/// that missing events can be put down to the line, the UART or
+	/// the client, and baud rates and buffers sized from the data;
+	/// dropped counts the messages the client dropped itself. An
+	/// overrun is uploaded at once as a warning,
+	///
+	///     !!!!...SERIAL OVERRUN /dev/ttyS4 overrun=+2 bufferOverrun=+0...!!!!
+	///
+	/// poll() reads the counters, one ioctl, and is called periodically
+	/// by the EventLoop or the capture process.
+{
+public:
+	struct Counts
+	{
+		Counts();
+
+		int rx;
+		int tx;
+		int frame;
+		int parity;
+		int brk;
+		int overrun;
+		int bufferOverrun;
+		int cts;            /// changes of the modem status lines
+		int dsr;
+		int rng;
+		int dcd;
+	};
+
+	SerialCounters(int fd, const std::string& port, const Poco::Timespan& reportInterval);
+		/// Creates the SerialCounters for the serial port with the
+		/// given descriptor and device name.
+
+	~SerialCounters();
+		/// Destroys the SerialCounters.
+
+	bool poll(std::vector<std::string>& messages, Poco::UInt32 dropped = 0);
+		/// Reads the counters and appends the messages to upload: an
+		/// overrun warning if the overrun counters have grown since
+		/// the last call, and the metrics if a counter or the number
+		/// of dropped messages has changed and the report interval has
+		/// passed. The first call reports the metrics. Returns false
+		/// if the driver has no counters.
+
+	bool read(Counts& counts) const;
+		/// Reads the counters. Returns false if the driver has none.
+
+	static bool read(int fd, Counts& counts);
+		/// Reads the counters of the serial port with the given
+		/// descriptor. Returns false if the driver has none.
+
+	const Counts& counts() const;
+		/// Returns the counters read by the last poll().
+
+	const std::string& port() const;
+		/// Returns the device name.
+
+	std::string metrics(Poco::UInt32 dropped) const;
+		/// Returns the metrics message for the last counters.
+
+private:
+	static bool changed(const Counts& a, const Counts& b);
+
+	SerialCounters(const SerialCounters&);
+	SerialCounters& operator = (const SerialCounters&);
+
+	int _fd;
+	std::string _port;
+	Poco::Timespan _reportInterval;
+	Counts _counts;
+	Counts _reported;
+	Poco::UInt32 _dropped;
+	Poco::Timestamp _reportTime;
+	bool _first;
+};
+
+
+//
+// inlines
+//
+inline const SerialCounters::Counts& SerialCounters::counts() const
+{
+	return _counts;
+}
+
+
+inline const std::string& SerialCounters::port() const
+{
+	return _port;
+}
+
+
+#endif // SerialCounters_INCLUDED
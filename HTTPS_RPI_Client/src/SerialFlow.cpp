@@ -0,0 +1,14 @@
+//
+// SerialFlow.cpp
+//
+// Implementation of the SerialFlow stages.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SerialFlow.h"
+
+
+const std::string SyncStateCodec::TROUBLE("!!!!...REMOTE SYNC TROUBLE...!!!!");
+const std::string SyncStateCodec::TROUBLE_CLEARED("!!!!...REMOTE SYNC TROUBLE CLEARED..!!!!");
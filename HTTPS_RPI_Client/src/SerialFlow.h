@@ -0,0 +1,59 @@
+//
+// SerialFlow.h
+//
+// Definition of the SerialFlow class template.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SerialFlow_INCLUDED
+#define SerialFlow_INCLUDED
+
+
+#include "Pipeline.h"
+#include <string>
+
+
+struct SyncStateFilter
+	/// Accepts the bytes the board sends for the sync state: '1' for
+	/// a remote sync trouble and '0' for its end.
+{
+	bool operator () (unsigned char c) const
+	{
+		return c == '1' || c == '0';
+	}
+};
+
+
+struct SyncStateCodec
+	/// Decodes a sync state byte into the message for the server.
+{
+	static const std::string TROUBLE;
+	static const std::string TROUBLE_CLEARED;
+
+	const std::string& operator () (unsigned char c) const
+	{
+		return c == '1' ? TROUBLE : TROUBLE_CLEARED;
+	}
+};
+
+
+template <class Sink>
+struct SerialFlow
+	/// The pipeline from the UART to the uploads: sync state bytes
+	/// are filtered, reported once per change and decoded into a
+	/// message, which is pushed to the Sink as a std::string.
+{
+	typedef Transform<SyncStateCodec, Sink> Decode;
+	typedef Debounce<unsigned char, Decode> Change;
+	typedef Filter<SyncStateFilter, Change> Type;
+
+	static Type create(const Sink& sink)
+	{
+		return Type(SyncStateFilter(), Change(Decode(SyncStateCodec(), sink)));
+	}
+};
+
+
+#endif // SerialFlow_INCLUDED
@@ -0,0 +1,303 @@
+//
+// ServiceDiscovery.cpp
+//
+// Implementation of the ServiceDiscovery class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ServiceDiscovery.h"
+#include "Poco/Net/IPAddress.h"
+#include "Poco/Net/MulticastSocket.h"
+#include "Poco/Exception.h"
+#include "Poco/File.h"
+#include "Poco/NumberParser.h"
+#include "Poco/String.h"
+#include "Poco/StringTokenizer.h"
+#include <fstream>
+
+
+const std::string ServiceDiscovery::MDNS_GROUP("224.0.0.251");
+
+
+ServiceDiscovery::Instance::Instance():
+	port(0),
+	ttl(0),
+	expires(0)
+{
+}
+
+
+std::string ServiceDiscovery::Instance::host() const
+{
+	return properties.get("host", target);
+}
+
+
+bool ServiceDiscovery::Instance::valid() const
+{
+	return !name.empty() && !target.empty() && !address.empty() && port != 0 && expires > Poco::Timestamp();
+}
+
+
+ServiceDiscovery::ServiceDiscovery(const std::string& type, const Poco::Net::SocketAddress& address):
+	_service(type + ".local"),
+	_address(address),
+	_id(0)
+{
+	if (address.host().toString() == MDNS_GROUP)
+	{
+		// shares the port with the mDNS daemon, and gets the answers
+		// it sends to the group
+		Poco::Net::MulticastSocket socket;
+		socket.bind(Poco::Net::SocketAddress(Poco::Net::IPAddress(), MDNS_PORT), true);
+		socket.joinGroup(address.host());
+		_socket = socket;
+	}
+	else
+	{
+		_socket.bind(Poco::Net::SocketAddress(Poco::Net::IPAddress(), 0));
+	}
+	_socket.setBlocking(false);
+}
+
+
+ServiceDiscovery::~ServiceDiscovery()
+{
+	try
+	{
+		_socket.close();
+	}
+	catch (Poco::Exception&)
+	{
+	}
+}
+
+
+void ServiceDiscovery::query()
+{
+	// multicast queries have ID 0 (RFC 6762, section 18.1)
+	Poco::UInt16 id = _address.port() == MDNS_PORT ? 0 : ++_id;
+	std::string q(encodeQuery(id, _service, TYPE_PTR));
+	_socket.sendTo(q.data(), static_cast<int>(q.size()), _address);
+	if (!_instance.target.empty() && _instance.address.empty())
+	{
+		q = encodeQuery(id, _instance.target, TYPE_A);
+		_socket.sendTo(q.data(), static_cast<int>(q.size()), _address);
+	}
+}
+
+
+bool ServiceDiscovery::receive(Instance& instance)
+{
+	char buffer[9000];
+	while (_socket.available() > 0)
+	{
+		Poco::Net::SocketAddress sender;
+		int n = _socket.receiveFrom(buffer, sizeof(buffer), sender);
+		if (n > 0) parse(buffer, n, _service, _instance);
+	}
+	if (_instance.name.empty() || _instance.target.empty() || _instance.address.empty() || _instance.port == 0)
+		return false;
+
+	_instance.expires = Poco::Timestamp() + static_cast<Poco::Timestamp::TimeDiff>(_instance.ttl)*Poco::Timespan::SECONDS;
+	instance = _instance;
+	_instance = Instance();
+	return true;
+}
+
+
+std::string ServiceDiscovery::encodeQuery(Poco::UInt16 id, const std::string& name, Poco::UInt16 type)
+{
+	std::string q;
+	q += static_cast<char>(id >> 8);
+	q += static_cast<char>(id & 0xFF);
+	q.append("\0\0\0\1\0\0\0\0\0\0", 10);
+	q += encodeName(name);
+	q += static_cast<char>(type >> 8);
+	q += static_cast<char>(type & 0xFF);
+	q.append("\0\1", 2);
+	return q;
+}
+
+
+bool ServiceDiscovery::parse(const char* data, std::size_t size, const std::string& service, Instance& instance)
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+	if (size < 12 || (p[2] & 0x80) == 0) return false;
+	int questions = (p[4] << 8) | p[5];
+	int records = ((p[6] << 8) | p[7]) + ((p[8] << 8) | p[9]) + ((p[10] << 8) | p[11]);
+	std::size_t pos = 12;
+	try
+	{
+		while (questions-- > 0)
+		{
+			readName(data, size, pos);
+			pos += 4;
+		}
+		std::string lservice(lower(service));
+		while (records-- > 0)
+		{
+			std::string owner(lower(readName(data, size, pos)));
+			if (pos + 10 > size) return false;
+			int type = (p[pos] << 8) | p[pos + 1];
+			Poco::UInt32 ttl = (static_cast<Poco::UInt32>(p[pos + 4]) << 24) | (p[pos + 5] << 16) | (p[pos + 6] << 8) | p[pos + 7];
+			std::size_t length = (p[pos + 8] << 8) | p[pos + 9];
+			pos += 10;
+			std::size_t end = pos + length;
+			if (end > size) return false;
+
+			bool used = false;
+			if (type == TYPE_PTR && owner == lservice)
+			{
+				std::size_t rpos = pos;
+				std::string name(readName(data, size, rpos));
+				if (ttl == 0)
+				{
+					// a goodbye: the instance is gone
+					if (lower(name) == lower(instance.name)) instance = Instance();
+				}
+				else if (instance.name.empty())
+				{
+					instance.name = name;
+					used = true;
+				}
+			}
+			else if (type == TYPE_SRV && !instance.name.empty() && owner == lower(instance.name) && length >= 6)
+			{
+				std::size_t rpos = pos + 6;
+				instance.port = static_cast<Poco::UInt16>((p[pos + 4] << 8) | p[pos + 5]);
+				instance.target = readName(data, size, rpos);
+				used = true;
+			}
+			else if (type == TYPE_TXT && !instance.name.empty() && owner == lower(instance.name))
+			{
+				std::size_t rpos = pos;
+				while (rpos < end)
+				{
+					std::size_t n = p[rpos++];
+					if (rpos + n > end) return false;
+					std::string entry(data + rpos, n);
+					rpos += n;
+					std::string::size_type eq = entry.find('=');
+					if (!entry.empty()) instance.properties.set(entry.substr(0, eq), eq == std::string::npos ? std::string() : entry.substr(eq + 1));
+				}
+			}
+			else if (type == TYPE_A && !instance.target.empty() && owner == lower(instance.target) && length == 4)
+			{
+				instance.address = Poco::Net::IPAddress(p + pos, 4).toString();
+				used = true;
+			}
+			if (used && ttl > 0 && (instance.ttl == 0 || ttl < instance.ttl)) instance.ttl = ttl;
+			pos = end;
+		}
+	}
+	catch (Poco::DataFormatException&)
+	{
+		return false;
+	}
+	return true;
+}
+
+
+std::string ServiceDiscovery::readName(const char* data, std::size_t size, std::size_t& pos)
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+	std::string name;
+	std::size_t at = pos;
+	bool jumped = false;
+	int jumps = 0;
+	for (;;)
+	{
+		if (at >= size) throw Poco::DataFormatException("Truncated DNS name");
+		std::size_t n = p[at];
+		if (n == 0)
+		{
+			if (!jumped) pos = at + 1;
+			return name;
+		}
+		if ((n & 0xC0) == 0xC0)
+		{
+			// a compression pointer
+			if (at + 1 >= size || ++jumps > 32) throw Poco::DataFormatException("Invalid DNS name");
+			if (!jumped) pos = at + 2;
+			jumped = true;
+			at = ((n & 0x3F) << 8) | p[at + 1];
+			continue;
+		}
+		if (at + 1 + n > size) throw Poco::DataFormatException("Truncated DNS name");
+		if (!name.empty()) name += '.';
+		name.append(data + at + 1, n);
+		at += 1 + n;
+	}
+}
+
+
+std::string ServiceDiscovery::encodeName(const std::string& name)
+{
+	std::string n;
+	Poco::StringTokenizer labels(name, ".", Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = labels.begin(); it != labels.end(); ++it)
+	{
+		if (it->size() > 63) throw Poco::InvalidArgumentException("DNS label too long", *it);
+		n += static_cast<char>(it->size());
+		n += *it;
+	}
+	n += '\0';
+	return n;
+}
+
+
+std::string ServiceDiscovery::lower(const std::string& name)
+{
+	return Poco::toLower(name);
+}
+
+
+bool ServiceDiscovery::load(const std::string& path, Instance& instance)
+{
+	std::ifstream istr(path.c_str());
+	if (!istr) return false;
+	try
+	{
+		Instance i;
+		std::string port, ttl, expires, line;
+		std::getline(istr, i.name);
+		std::getline(istr, i.target);
+		std::getline(istr, i.address);
+		std::getline(istr, port);
+		std::getline(istr, ttl);
+		std::getline(istr, expires);
+		i.port = static_cast<Poco::UInt16>(Poco::NumberParser::parseUnsigned(port));
+		i.ttl = Poco::NumberParser::parseUnsigned(ttl);
+		i.expires = Poco::Timestamp(Poco::NumberParser::parseUnsigned64(expires)*Poco::Timespan::SECONDS);
+		while (std::getline(istr, line))
+		{
+			std::string::size_type eq = line.find('=');
+			if (eq != std::string::npos) i.properties.set(line.substr(0, eq), line.substr(eq + 1));
+		}
+		instance = i;
+		return true;
+	}
+	catch (Poco::SyntaxException&)
+	{
+		return false;
+	}
+}
+
+
+void ServiceDiscovery::save(const std::string& path, const Instance& instance)
+{
+	{
+		std::ofstream ostr((path + ".tmp").c_str(), std::ios::trunc);
+		ostr << instance.name << "\n" << instance.target << "\n" << instance.address << "\n" << instance.port << "\n"
+		     << instance.ttl << "\n" << instance.expires.epochTime() << "\n";
+		for (Poco::Net::NameValueCollection::ConstIterator it = instance.properties.begin(); it != instance.properties.end(); ++it)
+		{
+			ostr << it->first << "=" << it->second << "\n";
+		}
+		if (!ostr) throw Poco::WriteFileException(path);
+	}
+	Poco::File(path + ".tmp").renameTo(path);
+}
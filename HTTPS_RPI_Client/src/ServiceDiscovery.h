@@ -0,0 +1,150 @@
+//
+// ServiceDiscovery.h
+//
+// Definition of the ServiceDiscovery class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ServiceDiscovery_INCLUDED
+#define ServiceDiscovery_INCLUDED
+
+
+#include "Poco/Net/DatagramSocket.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Net/NameValueCollection.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <string>
+
+
+class ServiceDiscovery
+	/// Finds the server on the local network with a DNS-SD query over
+	/// multicast DNS (RFC 6762, RFC 6763), as advertised by the
+	/// server's ServiceAdvertiser, without blocking: the socket is
+	/// non-blocking, so an EventLoop task sends a query, waits for
+	/// fd() and passes the responses to receive().
+	///
+	/// The result is the first instance of the service type, with the
+	/// target host and port from its SRV record, the IPv4 address of
+	/// the target, the TXT properties, and the shortest TTL of those
+	/// records, after which it expires. Results can be kept in a file
+	/// with save() and load(), so that a client that starts again
+	/// connects at once while the result has not expired.
+	///
+	/// Queries go to the mDNS group, 224.0.0.251:5353, from a socket
+	/// that shares port 5353 with a local mDNS daemon, so that the
+	/// answers come with their full TTL. Any other address is asked
+	/// by unicast, for example a DiscoveryResponder standing in for
+	/// the mDNS responder in tests.
+{
+public:
+	struct Instance
+	{
+		Instance();
+
+		std::string name;      /// the service instance, "<name>.<type>.local"
+		std::string target;    /// the host of the SRV record
+		std::string address;   /// the IPv4 address of the target
+		Poco::UInt16 port;
+		Poco::Net::NameValueCollection properties; /// the TXT record
+		Poco::UInt32 ttl;      /// seconds
+		Poco::Timestamp expires;
+
+		std::string host() const;
+			/// Returns the name to use for the Host header and the TLS
+			/// certificate: the "host" property, or the target.
+
+		bool valid() const;
+			/// Returns true if the instance is complete and has not
+			/// expired.
+	};
+
+	enum
+	{
+		MDNS_PORT = 5353,
+		TYPE_A    = 1,
+		TYPE_PTR  = 12,
+		TYPE_TXT  = 16,
+		TYPE_SRV  = 33
+	};
+
+	static const std::string MDNS_GROUP;
+		/// "224.0.0.251"
+
+	ServiceDiscovery(const std::string& type, const Poco::Net::SocketAddress& address);
+		/// Creates the ServiceDiscovery for the given service type,
+		/// for example "_https-telemetry._tcp", asking the given
+		/// address.
+
+	~ServiceDiscovery();
+		/// Closes the socket.
+
+	void query();
+		/// Asks for the instances of the service type, and for the
+		/// address of the target if an answer had none.
+
+	bool receive(Instance& instance);
+		/// Reads the responses that have arrived. Returns true and the
+		/// instance once it is complete.
+
+	int fd() const;
+		/// Returns the socket descriptor to wait for.
+
+	const std::string& service() const;
+		/// Returns the service name, "<type>.local".
+
+	static std::string encodeQuery(Poco::UInt16 id, const std::string& name, Poco::UInt16 type);
+		/// Returns a DNS query for one question.
+
+	static bool parse(const char* data, std::size_t size, const std::string& service, Instance& instance);
+		/// Adds the records of a DNS response about the given service
+		/// to the instance. Returns false if the data is not a
+		/// response or is malformed.
+
+	static bool load(const std::string& path, Instance& instance);
+		/// Reads an instance written by save(). Returns false if the
+		/// file does not exist or cannot be read.
+
+	static void save(const std::string& path, const Instance& instance);
+		/// Writes the instance to a new file and renames it.
+
+	static std::string readName(const char* data, std::size_t size, std::size_t& pos);
+		/// Reads a name, which may be compressed, from a DNS message
+		/// at pos, and moves pos past it. Throws a
+		/// Poco::DataFormatException if the name is malformed.
+
+	static std::string encodeName(const std::string& name);
+		/// Returns a name in DNS format, without compression.
+
+private:
+	static std::string lower(const std::string& name);
+
+	ServiceDiscovery(const ServiceDiscovery&);
+	ServiceDiscovery& operator = (const ServiceDiscovery&);
+
+	std::string _service;
+	Poco::Net::SocketAddress _address;
+	Poco::Net::DatagramSocket _socket;
+	Instance _instance;
+	Poco::UInt16 _id;
+};
+
+
+//
+// inlines
+//
+inline int ServiceDiscovery::fd() const
+{
+	return _socket.impl()->sockfd();
+}
+
+
+inline const std::string& ServiceDiscovery::service() const
+{
+	return _service;
+}
+
+
+#endif // ServiceDiscovery_INCLUDED
@@ -305,6 +305,28 @@ void RS232_disableRTS(int comport_number)
 }
 
 
+int RS232_GetPortFd(int comport_number)  /* the descriptor of an open port, for poll() and ioctl() */
+{
+  if((comport_number>29)||(comport_number<0))
+  {
+    return(-1);
+  }
+
+  return(Cport[comport_number]);
+}
+
+
+const char * RS232_GetPortName(int comport_number)  /* the device of a port, for messages */
+{
+  if((comport_number>29)||(comport_number<0))
+  {
+    return("");
+  }
+
+  return(comports[comport_number]);
+}
+
+
 #else         /* windows */
 
 
@@ -42,6 +42,11 @@ void RS232_disableDTR(int);
 void RS232_enableRTS(int);
 void RS232_disableRTS(int);
 
+#ifdef __linux__
+int RS232_GetPortFd(int);
+const char * RS232_GetPortName(int);
+#endif
+
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -4,20 +4,132 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 CPP_SRCS += \
-../src/App.cpp 
+../../common/src/AEAD.cpp \
+../src/ALPN.cpp \
+../src/ALPNConnectionFactory.cpp \
+../src/App.cpp \
+../src/BufferedServerRequest.cpp \
+../../common/src/ChunkedUpload.cpp \
+../../common/src/CipherBenchmark.cpp \
+../src/CommandQueue.cpp \
+../src/ConfigStore.cpp \
+../src/DeviceKeyStore.cpp \
+../src/DeviceSignatureKeys.cpp \
+../../common/src/ECIESCipher.cpp \
+../src/FastIngestRequest.cpp \
+../../common/src/FaultProxy.cpp \
+../src/FleetStatus.cpp \
+../src/HPACK.cpp \
+../src/Http1ServerSession.cpp \
+../src/Http2ServerSession.cpp \
+../src/Http2Session.cpp \
+../src/IngestPipeline.cpp \
+../src/LoadGenerator.cpp \
+../src/LongPollLimiter.cpp \
+../src/OpenSSLLocking.cpp \
+../../common/src/PerThreadRSACipher.cpp \
+../../common/src/PipelineBenchmark.cpp \
+../src/ReplayGuard.cpp \
+../src/ResponseBenchmark.cpp \
+../src/ResponseBuilder.cpp \
+../src/RSAKeyGenerator.cpp \
+../src/SequenceReorderer.cpp \
+../../common/src/SeriesCodec.cpp \
+../src/ServiceAdvertiser.cpp \
+../../common/src/SignedBatch.cpp \
+../src/SNI.cpp \
+../src/StaticAssets.cpp \
+../src/UploadStore.cpp 
 
 OBJS += \
-./src/App.o 
+./src/AEAD.o \
+./src/ALPN.o \
+./src/ALPNConnectionFactory.o \
+./src/App.o \
+./src/BufferedServerRequest.o \
+./src/ChunkedUpload.o \
+./src/CipherBenchmark.o \
+./src/CommandQueue.o \
+./src/ConfigStore.o \
+./src/DeviceKeyStore.o \
+./src/DeviceSignatureKeys.o \
+./src/ECIESCipher.o \
+./src/FastIngestRequest.o \
+./src/FaultProxy.o \
+./src/FleetStatus.o \
+./src/HPACK.o \
+./src/Http1ServerSession.o \
+./src/Http2ServerSession.o \
+./src/Http2Session.o \
+./src/IngestPipeline.o \
+./src/LoadGenerator.o \
+./src/LongPollLimiter.o \
+./src/OpenSSLLocking.o \
+./src/PerThreadRSACipher.o \
+./src/PipelineBenchmark.o \
+./src/ReplayGuard.o \
+./src/ResponseBenchmark.o \
+./src/ResponseBuilder.o \
+./src/RSAKeyGenerator.o \
+./src/SequenceReorderer.o \
+./src/SeriesCodec.o \
+./src/ServiceAdvertiser.o \
+./src/SignedBatch.o \
+./src/SNI.o \
+./src/StaticAssets.o \
+./src/UploadStore.o 
 
 CPP_DEPS += \
-./src/App.d 
+./src/AEAD.d \
+./src/ALPN.d \
+./src/ALPNConnectionFactory.d \
+./src/App.d \
+./src/BufferedServerRequest.d \
+./src/ChunkedUpload.d \
+./src/CipherBenchmark.d \
+./src/CommandQueue.d \
+./src/ConfigStore.d \
+./src/DeviceKeyStore.d \
+./src/DeviceSignatureKeys.d \
+./src/ECIESCipher.d \
+./src/FastIngestRequest.d \
+./src/FaultProxy.d \
+./src/FleetStatus.d \
+./src/HPACK.d \
+./src/Http1ServerSession.d \
+./src/Http2ServerSession.d \
+./src/Http2Session.d \
+./src/IngestPipeline.d \
+./src/LoadGenerator.d \
+./src/LongPollLimiter.d \
+./src/OpenSSLLocking.d \
+./src/PerThreadRSACipher.d \
+./src/PipelineBenchmark.d \
+./src/ReplayGuard.d \
+./src/ResponseBenchmark.d \
+./src/ResponseBuilder.d \
+./src/RSAKeyGenerator.d \
+./src/SequenceReorderer.d \
+./src/SeriesCodec.d \
+./src/ServiceAdvertiser.d \
+./src/SignedBatch.d \
+./src/SNI.d \
+./src/StaticAssets.d \
+./src/UploadStore.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
 src/%.o: ../src/%.cpp
 	@echo 'Building file: $<'
 	@echo 'Invoking: GCC C++ Compiler'
-	g++ -I"/home/aravind/workspace_new/Test_new_HTTPS/include" -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	g++ -I"/home/aravind/workspace_new/Test_new_HTTPS/include" -I"../../common/src" -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
+	@echo 'Finished building: $<'
+	@echo ' '
+
+src/%.o: ../../common/src/%.cpp
+	@echo 'Building file: $<'
+	@echo 'Invoking: GCC C++ Compiler'
+	g++ -I"/home/aravind/workspace_new/Test_new_HTTPS/include" -I"../../common/src" -O0 -g3 -Wall -c -fmessage-length=0 -MMD -MP -MF"$(@:%.o=%.d)" -MT"$(@:%.o=%.d)" -o "$@" "$<"
 	@echo 'Finished building: $<'
 	@echo ' '
 
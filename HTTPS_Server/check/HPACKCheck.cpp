@@ -0,0 +1,140 @@
+//
+// HPACKCheck.cpp
+//
+// Checks HPACKDecoder against the examples of RFC 7541, Appendix C,
+// and HPACKEncoder by decoding what it encodes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "HPACK.h"
+#include "Poco/Exception.h"
+#include <cstdlib>
+#include <iostream>
+
+
+namespace
+{
+	int failures = 0;
+
+
+	void check(bool condition, const std::string& what)
+	{
+		std::cout << (condition ? "ok      " : "FAILED  ") << what << std::endl;
+		if (!condition) ++failures;
+	}
+
+
+	std::string unhex(const std::string& hex)
+	{
+		std::string data;
+		for (std::size_t i = 0; i + 1 < hex.size(); i += 2)
+		{
+			data += static_cast<char>(std::strtol(hex.substr(i, 2).c_str(), 0, 16));
+		}
+		return data;
+	}
+
+
+	HPACKHeaderList headers(const char* const* pairs)
+	{
+		HPACKHeaderList list;
+		for (; *pairs; pairs += 2)
+		{
+			list.push_back(HPACKHeader(pairs[0], pairs[1]));
+		}
+		return list;
+	}
+
+
+	void checkDecode(HPACKDecoder& decoder, const std::string& name, const char* hex, const char* const* expected)
+	{
+		HPACKHeaderList list;
+		try
+		{
+			decoder.decode(unhex(hex), list);
+		}
+		catch (Poco::Exception& exc)
+		{
+			check(false, name + ": " + exc.displayText());
+			return;
+		}
+		check(list == headers(expected), name);
+	}
+
+
+	void checkRejected(const std::string& name, const char* hex)
+	{
+		HPACKDecoder decoder;
+		HPACKHeaderList list;
+		try
+		{
+			decoder.decode(unhex(hex), list);
+			check(false, name);
+		}
+		catch (Poco::DataFormatException&)
+		{
+			check(true, name);
+		}
+	}
+
+
+	const char* const REQUEST_1[] = {":method", "GET", ":scheme", "http", ":path", "/", ":authority", "www.example.com", 0};
+	const char* const REQUEST_2[] = {":method", "GET", ":scheme", "http", ":path", "/", ":authority", "www.example.com", "cache-control", "no-cache", 0};
+	const char* const REQUEST_3[] = {":method", "GET", ":scheme", "https", ":path", "/index.html", ":authority", "www.example.com", "custom-key", "custom-value", 0};
+
+	const char* const RESPONSE_1[] = {":status", "302", "cache-control", "private", "date", "Mon, 21 Oct 2013 20:13:21 GMT", "location", "https://www.example.com", 0};
+	const char* const RESPONSE_2[] = {":status", "307", "cache-control", "private", "date", "Mon, 21 Oct 2013 20:13:21 GMT", "location", "https://www.example.com", 0};
+	const char* const RESPONSE_3[] = {":status", "200", "cache-control", "private", "date", "Mon, 21 Oct 2013 20:13:22 GMT", "location", "https://www.example.com",
+		"content-encoding", "gzip", "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1", 0};
+}
+
+
+int main()
+{
+	// C.3: requests without Huffman coding, sharing one dynamic table
+	HPACKDecoder c3;
+	checkDecode(c3, "C.3.1 first request", "828684410f7777772e6578616d706c652e636f6d", REQUEST_1);
+	checkDecode(c3, "C.3.2 second request", "828684be58086e6f2d6361636865", REQUEST_2);
+	checkDecode(c3, "C.3.3 third request", "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565", REQUEST_3);
+
+	// C.4: the same requests with Huffman coding
+	HPACKDecoder c4;
+	checkDecode(c4, "C.4.1 first request, Huffman", "828684418cf1e3c2e5f23a6ba0ab90f4ff", REQUEST_1);
+	checkDecode(c4, "C.4.2 second request, Huffman", "828684be5886a8eb10649cbf", REQUEST_2);
+	checkDecode(c4, "C.4.3 third request, Huffman", "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf", REQUEST_3);
+
+	// C.5: responses with a 256 byte table, so that entries are evicted
+	HPACKDecoder c5(256);
+	checkDecode(c5, "C.5.1 first response", "4803333032580770726976617465611d4d6f6e2c203231204f637420323031332032303a31333a323120474d546e1768747470733a2f2f7777772e6578616d706c652e636f6d", RESPONSE_1);
+	checkDecode(c5, "C.5.2 second response", "4803333037c1c0bf", RESPONSE_2);
+	checkDecode(c5, "C.5.3 third response", "88c1611d4d6f6e2c203231204f637420323031332032303a31333a323220474d54c05a04677a69707738666f6f3d4153444a4b48514b425a584f5157454f50495541585157454f49553b206d61782d6167653d333630303b2076657273696f6e3d31", RESPONSE_3);
+
+	// C.6: the same responses with Huffman coding
+	HPACKDecoder c6(256);
+	checkDecode(c6, "C.6.1 first response, Huffman", "488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a62d1bff6e919d29ad171863c78f0b97c8e9ae82ae43d3", RESPONSE_1);
+	checkDecode(c6, "C.6.2 second response, Huffman", "4883640effc1c0bf", RESPONSE_2);
+	checkDecode(c6, "C.6.3 third response, Huffman", "88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94e7821dd7f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c003ed4ee5b1063d5007", RESPONSE_3);
+
+	// the encoder's blocks decode to what was encoded, also once its
+	// dynamic table has entries and when the table evicts them
+	HPACKEncoder encoder(256);
+	HPACKDecoder decoder(256);
+	const char* const* lists[] = {REQUEST_1, REQUEST_2, REQUEST_3, RESPONSE_1, RESPONSE_2, RESPONSE_3, RESPONSE_3};
+	for (std::size_t i = 0; i < sizeof(lists)/sizeof(lists[0]); ++i)
+	{
+		HPACKHeaderList list(headers(lists[i]));
+		HPACKHeaderList decoded;
+		decoder.decode(encoder.encode(list), decoded);
+		check(decoded == list, "encoder round trip " + std::string(1, static_cast<char>('1' + i)));
+	}
+
+	checkRejected("truncated integer is rejected", "ff");
+	checkRejected("index 0 is rejected", "80");
+	checkRejected("index beyond the tables is rejected", "bf");
+	checkRejected("truncated string is rejected", "0085ff");
+
+	std::cout << (failures ? "HPACK checks FAILED" : "HPACK checks passed") << std::endl;
+	return failures ? 1 : 0;
+}
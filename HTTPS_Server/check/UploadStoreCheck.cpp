@@ -0,0 +1,93 @@
+//
+// UploadStoreCheck.cpp
+//
+// Checks that UploadStore refuses a complete file that does not match
+// its hash and leaves nothing of it behind, that it refuses sizes out
+// of range, and that ChunkedUpload::chunks() does not overflow.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "UploadStore.h"
+#include "ChunkedUpload.h"
+#include "Poco/Exception.h"
+#include "Poco/File.h"
+#include "Poco/Path.h"
+#include "Poco/TemporaryFile.h"
+#include <iostream>
+
+
+namespace
+{
+	int failures = 0;
+
+
+	void check(bool condition, const std::string& what)
+	{
+		std::cout << (condition ? "ok      " : "FAILED  ") << what << std::endl;
+		if (!condition) ++failures;
+	}
+
+
+	void checkInvalid(UploadStore& store, const std::string& what, Poco::UInt64 size, std::size_t chunkSize)
+	{
+		bool refused = false;
+		try
+		{
+			store.store("dev-limits", size, chunkSize, std::string(64, 'a'), 0, std::string());
+		}
+		catch (Poco::InvalidArgumentException&)
+		{
+			refused = true;
+		}
+		check(refused, what);
+	}
+}
+
+
+int main()
+{
+	Poco::TemporaryFile directory;
+	std::string data;
+	for (int i = 0; i < 3000; ++i) data += static_cast<char>(i*13);
+	{
+		UploadStore store(directory.path());
+
+		// a file of one chunk is complete with its first chunk, so its
+		// hash is checked at once
+		bool refused = false;
+		try
+		{
+			store.store("dev-1", data.size(), 4096, std::string(64, 'a'), 0, data);
+		}
+		catch (Poco::DataException&)
+		{
+			refused = true;
+		}
+		check(refused, "single chunk with a wrong hash is refused");
+		UploadStore::Status status;
+		check(!store.status("dev-1", status), "refused upload leaves no status");
+		check(!Poco::File(Poco::Path(directory.path(), "dev-1.part")).exists(), "refused upload leaves no .part file");
+		check(!Poco::File(Poco::Path(directory.path(), "dev-1")).exists(), "refused upload leaves no file");
+
+		status = store.store("dev-1", data.size(), 4096, ChunkedUpload::sha256(data), 0, data);
+		check(status.complete, "retry with the right hash completes");
+		check(ChunkedUpload::sha256File(Poco::Path(directory.path(), "dev-1").toString()) == ChunkedUpload::sha256(data), "stored file matches its hash");
+
+		UploadStore small(Poco::Path(directory.path(), "small").toString(), 1024*1024);
+		checkInvalid(small, "size beyond the maximum is refused", 1024*1024 + 1, 4096);
+		checkInvalid(small, "size near 2^64 is refused", ~0ULL, 4096);
+		checkInvalid(small, "chunk size below the minimum is refused", 3000, 1);
+		checkInvalid(small, "chunk size above the maximum is refused", 3000, ChunkedUpload::MAX_CHUNK_SIZE + 1);
+	}
+
+	check(ChunkedUpload::chunks(0, 1024) == 1, "empty file has one chunk");
+	check(ChunkedUpload::chunks(1024, 1024) == 1, "exact multiple has no extra chunk");
+	check(ChunkedUpload::chunks(1025, 1024) == 2, "remainder takes a chunk");
+	check(ChunkedUpload::chunks(~0ULL, 262144) == static_cast<std::size_t>((~0ULL)/262144 + 1), "chunk count near 2^64 does not overflow");
+	check(ChunkedUpload::chunkLength(~0ULL, 262144, ChunkedUpload::chunks(~0ULL, 262144) - 1) == (~0ULL) % 262144, "last chunk near 2^64 has the remainder");
+
+	std::cout << (failures ? "UploadStore checks FAILED" : "UploadStore checks passed") << std::endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+//
+// ALPN.cpp
+//
+// Implementation of the ALPN class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ALPN.h"
+#include "Poco/Exception.h"
+#include <openssl/ssl.h>
+
+
+std::string ALPN::_serverProtocols;
+ALPN::ProtocolMap ALPN::_protocols;
+Poco::FastMutex ALPN::_mutex;
+
+
+#if OPENSSL_VERSION_NUMBER >= 0x10002000L
+
+
+struct ALPNCallbacks
+{
+	static int select(SSL* /*pSSL*/, const unsigned char** pOut, unsigned char* pOutLength, const unsigned char* pIn, unsigned inLength, void* /*pArg*/)
+	{
+		unsigned char* pSelected = 0;
+		const std::string& server = ALPN::_serverProtocols;
+		if (SSL_select_next_proto(&pSelected, pOutLength, reinterpret_cast<const unsigned char*>(server.data()), static_cast<unsigned>(server.size()), pIn, inLength) != OPENSSL_NPN_NEGOTIATED)
+			return SSL_TLSEXT_ERR_NOACK;
+		*pOut = pSelected;
+		return SSL_TLSEXT_ERR_OK;
+	}
+
+	static void info(const SSL* pSSL, int where, int /*ret*/)
+	{
+		if (!(where & SSL_CB_HANDSHAKE_DONE)) return;
+		const unsigned char* pData = 0;
+		unsigned length = 0;
+		SSL_get0_alpn_selected(pSSL, &pData, &length);
+		ALPN::record(SSL_get_fd(pSSL), std::string(reinterpret_cast<const char*>(pData), length));
+	}
+};
+
+
+void ALPN::enableServer(Poco::Net::Context::Ptr pContext, const std::string& protocols)
+{
+	_serverProtocols = protocols;
+	SSL_CTX_set_alpn_select_cb(pContext->sslContext(), &ALPNCallbacks::select, 0);
+	SSL_CTX_set_info_callback(pContext->sslContext(), &ALPNCallbacks::info);
+}
+
+
+void ALPN::enableClient(Poco::Net::Context::Ptr pContext, const std::string& protocols)
+{
+	if (SSL_CTX_set_alpn_protos(pContext->sslContext(), reinterpret_cast<const unsigned char*>(protocols.data()), static_cast<unsigned>(protocols.size())) != 0)
+		throw Poco::InvalidArgumentException("Invalid ALPN protocol list");
+	SSL_CTX_set_info_callback(pContext->sslContext(), &ALPNCallbacks::info);
+}
+
+
+#else
+
+
+void ALPN::enableServer(Poco::Net::Context::Ptr, const std::string&)
+{
+}
+
+
+void ALPN::enableClient(Poco::Net::Context::Ptr, const std::string&)
+{
+}
+
+
+#endif
+
+
+std::string ALPN::negotiated(Poco::Net::SecureStreamSocket& socket)
+{
+	int fd = static_cast<int>(socket.impl()->sockfd());
+	std::string protocol;
+	try
+	{
+		socket.completeHandshake();
+	}
+	catch (...)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_protocols.erase(fd);
+		throw;
+	}
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	ProtocolMap::iterator it = _protocols.find(fd);
+	if (it != _protocols.end())
+	{
+		protocol = it->second;
+		_protocols.erase(it);
+	}
+	return protocol;
+}
+
+
+void ALPN::record(int fd, const std::string& protocol)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_protocols[fd] = protocol;
+}
@@ -0,0 +1,61 @@
+//
+// ALPN.h
+//
+// Definition of the ALPN class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ALPN_INCLUDED
+#define ALPN_INCLUDED
+
+
+#include "Poco/Net/Context.h"
+#include "Poco/Net/SecureStreamSocket.h"
+#include "Poco/Mutex.h"
+#include <map>
+#include <string>
+
+
+class ALPN
+	/// Application-Layer Protocol Negotiation (RFC 7301) for Poco's
+	/// SSL contexts.
+	///
+	/// Poco 1.7 does not expose the SSL object of a socket, so the
+	/// protocol negotiated during a handshake is recorded per socket
+	/// descriptor and picked up with negotiated() right after the
+	/// handshake.
+	///
+	/// ALPN needs OpenSSL 1.0.2 or later; with older versions nothing
+	/// is negotiated and negotiated() always returns an empty string.
+{
+public:
+	static void enableServer(Poco::Net::Context::Ptr pContext, const std::string& protocols);
+		/// Lets the server select a protocol from the given list,
+		/// in order of preference. The list is in wire format: each
+		/// name is preceded by its length byte, e.g. "\x02h2\x08http/1.1".
+
+	static void enableClient(Poco::Net::Context::Ptr pContext, const std::string& protocols);
+		/// Makes the client offer the given protocols (wire format).
+
+	static std::string negotiated(Poco::Net::SecureStreamSocket& socket);
+		/// Completes the handshake and returns the negotiated protocol,
+		/// or an empty string if none was negotiated.
+
+private:
+	ALPN();
+
+	static void record(int fd, const std::string& protocol);
+
+	typedef std::map<int, std::string> ProtocolMap;
+
+	static std::string _serverProtocols;
+	static ProtocolMap _protocols;
+	static Poco::FastMutex _mutex;
+
+	friend struct ALPNCallbacks;
+};
+
+
+#endif // ALPN_INCLUDED
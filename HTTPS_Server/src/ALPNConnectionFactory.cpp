@@ -0,0 +1,109 @@
+//
+// ALPNConnectionFactory.cpp
+//
+// Implementation of the ALPNConnectionFactory class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ALPNConnectionFactory.h"
+#include "ALPN.h"
+#include "SNI.h"
+#include "Http2ServerSession.h"
+#include "Http1ServerSession.h"
+#include "Poco/Net/TCPServerConnection.h"
+#include "Poco/Net/SecureStreamSocket.h"
+#include "Poco/String.h"
+
+
+namespace
+{
+	const std::string PROTOCOLS("\x02h2\x08http/1.1", 12);
+
+	class ALPNServerConnection: public Poco::Net::TCPServerConnection
+	{
+	public:
+		ALPNServerConnection(const Poco::Net::StreamSocket& socket, Poco::Net::HTTPServerParams::Ptr pParams, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, IngestPipeline::Ptr pPipeline, Poco::SharedPtr<ALPNConnectionFactory::TenantMap> pTenants, Poco::SharedPtr<Poco::ThreadPool> pStreamThreads):
+			Poco::Net::TCPServerConnection(socket),
+			_pParams(pParams),
+			_pFactory(pFactory),
+			_pPipeline(pPipeline),
+			_pTenants(pTenants),
+			_pStreamThreads(pStreamThreads)
+		{
+		}
+
+		void run()
+		{
+			Poco::Net::SecureStreamSocket secureSocket(socket());
+			secureSocket.setReceiveTimeout(_pParams->getTimeout());
+			if (!_pTenants->empty())
+			{
+				ALPNConnectionFactory::TenantMap::const_iterator it = _pTenants->find(SNI::selected(secureSocket));
+				if (it != _pTenants->end())
+				{
+					_pFactory = it->second.pFactory;
+					_pPipeline = it->second.pPipeline;
+				}
+			}
+			if (ALPN::negotiated(secureSocket) == "h2")
+			{
+				Http2ServerSession session(socket(), _pParams, _pFactory, _pStreamThreads.get());
+				session.run();
+			}
+			else
+			{
+				Http1ServerSession session(socket(), _pParams, _pFactory, _pPipeline);
+				session.run();
+			}
+		}
+
+	private:
+		Poco::Net::HTTPServerParams::Ptr _pParams;
+		Poco::Net::HTTPRequestHandlerFactory::Ptr _pFactory;
+		IngestPipeline::Ptr _pPipeline;
+		Poco::SharedPtr<ALPNConnectionFactory::TenantMap> _pTenants;
+		Poco::SharedPtr<Poco::ThreadPool> _pStreamThreads;
+	};
+}
+
+
+ALPNConnectionFactory::ALPNConnectionFactory(Poco::Net::HTTPServerParams::Ptr pParams, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, IngestPipeline::Ptr pPipeline):
+	_pParams(pParams),
+	_pFactory(pFactory),
+	_pPipeline(pPipeline),
+	_pTenants(new TenantMap)
+{
+}
+
+
+ALPNConnectionFactory::~ALPNConnectionFactory()
+{
+}
+
+
+Poco::Net::TCPServerConnection* ALPNConnectionFactory::createConnection(const Poco::Net::StreamSocket& socket)
+{
+	return new ALPNServerConnection(socket, _pParams, _pFactory, _pPipeline, _pTenants, _pStreamThreads);
+}
+
+
+void ALPNConnectionFactory::addTenant(const std::string& serverName, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, IngestPipeline::Ptr pPipeline)
+{
+	Tenant& tenant = (*_pTenants)[Poco::toLower(serverName)];
+	tenant.pFactory = pFactory;
+	tenant.pPipeline = pPipeline;
+}
+
+
+void ALPNConnectionFactory::setStreamThreads(int threads)
+{
+	_pStreamThreads = new Poco::ThreadPool("http2", 1, threads);
+}
+
+
+void ALPNConnectionFactory::enable(Poco::Net::Context::Ptr pContext)
+{
+	ALPN::enableServer(pContext, PROTOCOLS);
+}
@@ -0,0 +1,86 @@
+//
+// ALPNConnectionFactory.h
+//
+// Definition of the ALPNConnectionFactory class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ALPNConnectionFactory_INCLUDED
+#define ALPNConnectionFactory_INCLUDED
+
+
+#include "Poco/Net/TCPServerConnectionFactory.h"
+#include "Poco/Net/HTTPServerParams.h"
+#include "Poco/Net/HTTPRequestHandlerFactory.h"
+#include "Poco/Net/Context.h"
+#include "IngestPipeline.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/ThreadPool.h"
+#include <map>
+#include <string>
+
+
+class ALPNConnectionFactory: public Poco::Net::TCPServerConnectionFactory
+	/// Replaces Poco::Net::HTTPServerConnectionFactory for a TLS server
+	/// socket. Each connection completes the TLS handshake and is then
+	/// served by an Http2ServerSession if the client negotiated "h2"
+	/// with ALPN (see enable()), or over HTTP/1.1 otherwise. Both use
+	/// the same request handler factory.
+	///
+	/// The streams of an HTTP/2 connection are handled one at a time
+	/// on the connection's thread, or, after setStreamThreads(), on a
+	/// thread pool shared by all connections.
+	///
+	/// HTTP/1.1 connections are served by an Http1ServerSession, which
+	/// writes each response with a single write, with the ingest fast
+	/// path if an IngestPipeline is given.
+	///
+	/// With tenants (see addTenant()), the server name selected with
+	/// SNI during the handshake picks the request handler factory and
+	/// pipeline, so that the requests of each tenant reach only its
+	/// own keys and storage.
+{
+public:
+	ALPNConnectionFactory(Poco::Net::HTTPServerParams::Ptr pParams, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, IngestPipeline::Ptr pPipeline = IngestPipeline::Ptr());
+		/// Creates the ALPNConnectionFactory.
+
+	~ALPNConnectionFactory();
+		/// Destroys the ALPNConnectionFactory.
+
+	Poco::Net::TCPServerConnection* createConnection(const Poco::Net::StreamSocket& socket);
+
+	void addTenant(const std::string& serverName, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, IngestPipeline::Ptr pPipeline = IngestPipeline::Ptr());
+		/// Serves the connections for which SNI selected the given
+		/// server name (see SNI::addContext()) with the given factory
+		/// and pipeline instead of the default ones. Must be called
+		/// before the server is started.
+
+	void setStreamThreads(int threads);
+		/// Handles the streams of HTTP/2 connections on a pool of the
+		/// given number of threads, several streams of a connection at
+		/// once (see Http2ServerSession). Must be called before the
+		/// server is started.
+
+	static void enable(Poco::Net::Context::Ptr pContext);
+		/// Makes the server context offer "h2" and "http/1.1" with ALPN.
+
+	struct Tenant
+	{
+		Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory;
+		IngestPipeline::Ptr pPipeline;
+	};
+
+	typedef std::map<std::string, Tenant> TenantMap;
+
+private:
+	Poco::Net::HTTPServerParams::Ptr _pParams;
+	Poco::Net::HTTPRequestHandlerFactory::Ptr _pFactory;
+	IngestPipeline::Ptr _pPipeline;
+	Poco::SharedPtr<TenantMap> _pTenants;
+	Poco::SharedPtr<Poco::ThreadPool> _pStreamThreads;
+};
+
+
+#endif // ALPNConnectionFactory_INCLUDED
@@ -24,12 +24,42 @@
 #include "Poco/Crypto/Cipher.h"
 #include "Poco/Crypto/CipherFactory.h"
 #include "Poco/Crypto/CryptoStream.h"
+#include "ECIESCipher.h"
+#include "CipherBenchmark.h"
+#include "DeviceKeyStore.h"
+#include "AEAD.h"
+#include "RSAKeyGenerator.h"
+#include "PerThreadRSACipher.h"
+#include "OpenSSLLocking.h"
+#include "SignedBatch.h"
+#include "DeviceSignatureKeys.h"
+#include "ALPNConnectionFactory.h"
+#include "SNI.h"
+#include "BufferedServerRequest.h"
+#include "IngestPipeline.h"
+#include "LongPollLimiter.h"
+#include "FastIngestRequest.h"
+#include "ResponseBenchmark.h"
+#include "PipelineBenchmark.h"
+#include "LoadGenerator.h"
+#include "FaultProxy.h"
+#include "ChunkedUpload.h"
+#include "UploadStore.h"
+#include "ConfigStore.h"
+#include "CommandQueue.h"
+#include "StaticAssets.h"
+#include "FleetStatus.h"
+#include "Http2ServerSession.h"
+#include "ServiceAdvertiser.h"
+#include "Poco/DNSSD/Avahi/Avahi.h"
 
 #include <iostream>
 #include <string>       // std::string
 #include <iostream>     // std::cout
 #include "sstream"     // std::istringstream
 #include "fstream"
+#include <iomanip>
+#include <ctime>
 
 #include "Poco/Net/HTTPServer.h"
 #include "Poco/Net/HTTPRequestHandler.h"
@@ -43,9 +73,14 @@
 #include "Poco/Net/HTTPServerResponse.h"
 #include "Poco/Net/HTTPServerParams.h"
 #include "Poco/Net/ServerSocket.h"
+#include "Poco/Net/TCPServer.h"
 #include "Poco/Timestamp.h"
 #include "Poco/DateTimeFormatter.h"
 #include "Poco/DateTimeFormat.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
+#include "Poco/StringTokenizer.h"
+#include "Poco/URI.h"
 #include "Poco/Exception.h"
 #include "Poco/ThreadPool.h"
 #include "Poco/Util/ServerApplication.h"
@@ -68,6 +103,8 @@
 #include "Poco/StreamCopier.h"
 #include "Poco/Timespan.h"
 #include "Poco/FileStream.h"
+#include "Poco/File.h"
+#include "Poco/Path.h"
 
 using namespace Poco;
 using namespace Poco::Net;
@@ -103,95 +140,588 @@ using Poco::Net::PrivateKeyPassphraseHandler;
 using Poco::Net::InvalidCertificateHandler;
 using Poco::Net::AcceptCertificateHandler;
 
-char a[30]="!!!! Hello from Server !!!!";
+class TimeRequestHandler: public HTTPRequestHandler
+	/// Return a HTML document with the current date and time.
+{
+public:
+	TimeRequestHandler(const std::string& format, IngestPipeline::Ptr pPipeline):
+		_format(format),
+		_pPipeline(pPipeline)
+	{
+	}
 
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
+	{
+		std::string body;
+		StreamCopier::copyToString(request.stream(), body);
 
+		// the socket is needed only to log the client certificate, a
+		// request of another kind is processed without
+		StreamSocket* pSocket = 0;
+		if (HTTPServerRequestImpl* pRequestImpl = dynamic_cast<HTTPServerRequestImpl*>(&request))
+			pSocket = &pRequestImpl->socket();
+		else if (BufferedServerRequest* pBufferedRequest = dynamic_cast<BufferedServerRequest*>(&request))
+			pSocket = &pBufferedRequest->socket();
 
+		try
+		{
+			_pPipeline->process(IngestPipeline::mode(request.get("X-Encryption", "rsa")), request.get("X-Device-Id", ""), request.get("X-Sequence", ""), body, request.clientAddress(), pSocket);
+		}
+		catch (Poco::InvalidAccessException& exc)
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST, exc.message());
+			response.send();
+			return;
+		}
+		std::ostream& ostr = response.send();
+		ostr << IngestPipeline::ACKNOWLEDGEMENT;
+	}
 
-class TimeRequestHandler: public HTTPRequestHandler
-	/// Return a HTML document with the current date and time.
+private:
+	std::string _format;
+	IngestPipeline::Ptr _pPipeline;
+};
+
+
+class UploadRequestHandler: public HTTPRequestHandler
+	/// Receives the chunks of resumable file uploads (see ChunkedUpload):
+	/// PUT /uploads/<id>/<index> decrypts, checks and stores a chunk,
+	/// GET /uploads/<id> returns the chunks received so far.
 {
 public:
-	TimeRequestHandler(const std::string& format):
-		_format(format)
+	UploadRequestHandler(UploadStore::Ptr pStore, IngestPipeline::Ptr pPipeline):
+		_pStore(pStore),
+		_pPipeline(pPipeline)
 	{
 	}
 
 	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
 	{
-		std::istream& i = request.stream();
-		unsigned int len = request.getContentLength();
-		char* buffer = new char[len];
-		i.read(buffer, len);
+		std::string body;
+		StreamCopier::copyToString(request.stream(), body);
 
+		std::string path(request.getURI().substr(ChunkedUpload::PATH.size()));
+		std::string::size_type slash = path.find('/');
+		std::string id(path.substr(0, slash));
+		UploadStore::Status status;
+		try
+		{
+			if (request.getMethod() == HTTPRequest::HTTP_GET && slash == std::string::npos)
+			{
+				if (!_pStore->status(id, status))
+				{
+					response.setStatusAndReason(HTTPResponse::HTTP_NOT_FOUND);
+					response.setContentLength(0);
+					response.send();
+					return;
+				}
+			}
+			else if (request.getMethod() == HTTPRequest::HTTP_PUT && slash != std::string::npos)
+			{
+				IngestPipeline::Mode mode = IngestPipeline::mode(request.get("X-Encryption", "rsa"));
+				std::string deviceId(request.get("X-Device-Id", ""));
+				// rsa would decrypt a chunk block by block with the
+				// private key, hundreds of RSA operations per request
+				if (mode == IngestPipeline::MODE_SIGN || mode == IngestPipeline::MODE_RSA)
+					throw Poco::InvalidAccessException("Uploads must be encrypted with ecies or psk");
+				if (mode == IngestPipeline::MODE_PSK && id.compare(0, deviceId.size() + 1, deviceId + "-") != 0)
+					throw Poco::InvalidAccessException("Upload of another device");
+				Poco::UInt64 size = NumberParser::parseUnsigned64(request.get("X-Upload-Size"));
+				std::size_t chunkSize = NumberParser::parseUnsigned(request.get("X-Chunk-Size"));
+				_pStore->check(size, chunkSize);
+				std::string chunk(_pPipeline->decrypt(mode, deviceId, body));
+				if (ChunkedUpload::sha256(chunk) != request.get("X-Chunk-Hash"))
+					throw Poco::DataException("Chunk hash mismatch");
+				status = _pStore->store(id,
+					size,
+					chunkSize,
+					request.get("X-File-Hash"),
+					NumberParser::parseUnsigned(path.substr(slash + 1)),
+					chunk);
+				if (status.complete)
+					Application::instance().logger().information("Upload " + id + " from " + request.clientAddress().toString() + " complete");
+			}
+			else
+			{
+				response.setStatusAndReason(HTTPResponse::HTTP_METHOD_NOT_ALLOWED);
+				response.setContentLength(0);
+				response.send();
+				return;
+			}
+		}
+		catch (Poco::Exception& exc)
+		{
+			// the client cannot fix any of these by sending the chunk again
+			response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST, exc.message().empty() ? exc.name() : exc.message());
+			response.setContentLength(0);
+			response.send();
+			return;
+		}
+		response.set("X-Upload-Size", NumberFormatter::format(status.size));
+		response.set("X-Chunk-Size", NumberFormatter::format(status.chunkSize));
+		response.set("X-Received", ChunkedUpload::formatRanges(status.received));
+		if (status.complete) response.set("X-Upload-Complete", "true");
+		response.setContentLength(0);
+		response.send();
+	}
 
+private:
+	UploadStore::Ptr _pStore;
+	IngestPipeline::Ptr _pPipeline;
+};
 
-		std::cout << "\nEncrypted data: \n"<<buffer<<std::endl;
 
+class ConfigRequestHandler: public HTTPRequestHandler
+	/// Pushes the client configuration (see ConfigStore): GET
+	/// /config?epoch=<epoch>&version=<version>&wait=<seconds> is held
+	/// until there is a newer version, at most wait seconds (and the
+	/// configured maximum), and then answered with the changes, or with
+	/// 304 Not Modified.
+	///
+	/// Requests over HTTP/2 are answered right away, as a held stream
+	/// would take one of the few handlers of the connection (see
+	/// Http2ServerSession) from its other streams. So are the
+	/// polls beyond the limit of the LongPollLimiter, with Retry-After
+	/// set to the wait, so that the client does not ask again at once.
+{
+public:
+	ConfigRequestHandler(ConfigStore::Ptr pStore, int maxWait, LongPollLimiter::Ptr pLimiter):
+		_pStore(pStore),
+		_maxWait(maxWait),
+		_pLimiter(pLimiter)
+	{
+	}
 
-		std::cout << " "<< std::endl;
-		std::cout << " "<< std::endl;
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
+	{
+		std::string epoch;
+		Poco::UInt32 version = 0;
+		int wait = 0;
+		try
+		{
+			Poco::URI::QueryParameters params(Poco::URI(request.getURI()).getQueryParameters());
+			for (Poco::URI::QueryParameters::const_iterator it = params.begin(); it != params.end(); ++it)
+			{
+				if (it->first == "epoch") epoch = it->second;
+				else if (it->first == "version") version = NumberParser::parseUnsigned(it->second);
+				else if (it->first == "wait") wait = NumberParser::parse(it->second);
+			}
+		}
+		catch (Poco::SyntaxException& exc)
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST, exc.displayText());
+			response.setContentLength(0);
+			response.send();
+			return;
+		}
+		if (wait > _maxWait) wait = _maxWait;
+		if (wait < 0 || dynamic_cast<Http2ServerRequest*>(&request)) wait = 0;
+		LongPollLimiter::Hold hold(wait > 0 ? _pLimiter.get() : 0);
+		if (!hold.held())
+		{
+			response.set("Retry-After", NumberFormatter::format(wait));
+			wait = 0;
+		}
 
-		Poco::Crypto::CipherFactory &factory = Poco::Crypto::CipherFactory::defaultFactory();
-		//Poco::Crypto::Cipher* pCipher = factory.createCipher(Poco::Crypto::RSAKey("", "server.key", "aravind"),RSA_PADDING_PKCS1);
-		Poco::Crypto::Cipher* pCipher = factory.createCipher(Poco::Crypto::RSAKey("", "any.pem", "secret"),RSA_PADDING_PKCS1);
-		 const std::string decrypted_string(pCipher->decryptString(buffer));
-		 std::cout << "\nDecrypted string: \n" << decrypted_string<<std::endl;
-		 //delete buffer;
-		buffer=NULL;
-		std::remove(buffer);
+		ConfigStore::Update update;
+		if (!_pStore->poll(epoch, version, wait*1000L, update))
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_NOT_MODIFIED);
+			response.setContentLength(0);
+			response.send();
+			return;
+		}
+		response.set("X-Config-Epoch", update.epoch);
+		response.set("X-Config-Version", NumberFormatter::format(update.version));
+		response.set("X-Config-Delta", update.full ? std::string("full") : NumberFormatter::format(version));
+		response.setContentType("text/plain");
+		response.setContentLength(static_cast<std::streamsize>(update.body.size()));
+		response.send() << update.body;
+	}
 
-		std::cout << " "<< std::endl;
-		std::cout << " "<< std::endl;
+private:
+	ConfigStore::Ptr _pStore;
+	int _maxWait;
+	LongPollLimiter::Ptr _pLimiter;
+};
 
-		Application& app = Application::instance();
 
-		app.logger().information("Request from " + request.clientAddress().toString());   //Uncomment this whwnever v need to display Client IP address
+class CommandRequestHandler: public HTTPRequestHandler
+	/// Carries the commands for the serial devices (see CommandQueue):
+	/// GET /commands?device=<id>&seq=<sequence>&done=<ids>&failed=<ids>&wait=<seconds>
+	/// from a client reports the commands it has written and is held
+	/// until there are commands for it, at most wait seconds (and the
+	/// configured maximum), or answered with 304 Not Modified. It needs
+	/// the HMAC of the device's psk key (CommandQueue::authorization())
+	/// and a fresh sequence, and is refused without the master key.
+	///
+	/// POST /commands?device=<id>[&wait=<seconds>] from an operator
+	/// queues the body as a command and, with wait, is held until the
+	/// client has reported it. It needs the configured token as
+	/// "Authorization: Bearer <token>", and is refused without one.
+	///
+	/// Requests over HTTP/2 are answered right away, as with /config,
+	/// and so are the requests beyond the limit of the LongPollLimiter,
+	/// with Retry-After.
+{
+public:
+	CommandRequestHandler(CommandQueue::Ptr pQueue, int maxWait, const std::string& token, DeviceKeyStore::Ptr pDeviceKeys, LongPollLimiter::Ptr pLimiter):
+		_pQueue(pQueue),
+		_maxWait(maxWait),
+		_token(token),
+		_pDeviceKeys(pDeviceKeys),
+		_pLimiter(pLimiter)
+	{
+	}
 
-		SecureStreamSocket socket = static_cast<HTTPServerRequestImpl&>(request).socket();
-		if (socket.havePeerCertificate())
-		{
-			X509Certificate cert = socket.peerCertificate();
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
+	{
+		std::string body;
+		StreamCopier::copyToString(request.stream(), body);
 
-			app.logger().information("Client certificate: " + cert.subjectName());
+		std::string device;
+		std::string sequence;
+		std::string doneIds;
+		std::string failedIds;
+		std::vector<Poco::UInt32> done;
+		std::vector<Poco::UInt32> failed;
+		int wait = 0;
+		try
+		{
+			Poco::URI::QueryParameters params(Poco::URI(request.getURI()).getQueryParameters());
+			for (Poco::URI::QueryParameters::const_iterator it = params.begin(); it != params.end(); ++it)
+			{
+				if (it->first == "device") device = it->second;
+				else if (it->first == "seq") sequence = it->second;
+				else if (it->first == "done") done = CommandQueue::parseIds(doneIds = it->second);
+				else if (it->first == "failed") failed = CommandQueue::parseIds(failedIds = it->second);
+				else if (it->first == "wait") wait = NumberParser::parse(it->second);
+			}
+			if (device.empty()) throw Poco::SyntaxException("Missing device");
+		}
+		catch (Poco::SyntaxException& exc)
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST, exc.displayText());
+			response.setContentLength(0);
+			response.send();
+			return;
+		}
+		if (wait > _maxWait) wait = _maxWait;
+		if (wait < 0 || dynamic_cast<Http2ServerRequest*>(&request)) wait = 0;
+		LongPollLimiter::Hold hold(wait > 0 ? _pLimiter.get() : 0);
+		if (!hold.held())
+		{
+			response.set("Retry-After", NumberFormatter::format(wait));
+			wait = 0;
+		}
 
+		if (request.getMethod() == HTTPRequest::HTTP_GET)
+		{
+			if (!authenticated(request, device, sequence, doneIds, failedIds))
+			{
+				response.setStatusAndReason(HTTPResponse::HTTP_FORBIDDEN);
+				response.setContentLength(0);
+				response.send();
+				return;
+			}
+			_pQueue->report(device, done, failed);
+			CommandQueue::Commands commands;
+			if (!_pQueue->poll(device, wait*1000L, commands))
+			{
+				response.setStatusAndReason(HTTPResponse::HTTP_NOT_MODIFIED);
+				response.setContentLength(0);
+				response.send();
+				return;
+			}
+			std::string text(CommandQueue::format(commands));
+			response.set("X-Command-Epoch", _pQueue->epoch());
+			response.setContentType("text/plain");
+			response.setContentLength(static_cast<std::streamsize>(text.size()));
+			response.send() << text;
+		}
+		else if (request.getMethod() == HTTPRequest::HTTP_POST)
+		{
+			if (!authorized(request))
+			{
+				response.setStatusAndReason(HTTPResponse::HTTP_FORBIDDEN);
+				response.setContentLength(0);
+				response.send();
+				return;
+			}
+			Poco::UInt32 id;
+			try
+			{
+				id = _pQueue->enqueue(device, body);
+			}
+			catch (Poco::IllegalStateException& exc)
+			{
+				response.setStatusAndReason(HTTPResponse::HTTP_SERVICE_UNAVAILABLE, exc.displayText());
+				response.setContentLength(0);
+				response.send();
+				return;
+			}
+			CommandQueue::Status status = _pQueue->wait(device, id, wait*1000L);
+			response.setStatusAndReason(status == CommandQueue::STATUS_PENDING ? HTTPResponse::HTTP_ACCEPTED : HTTPResponse::HTTP_OK);
+			response.set("X-Command-Id", NumberFormatter::format(id));
+			response.set("X-Command-Status", CommandQueue::status(status));
+			response.setContentLength(0);
+			response.send();
 		}
 		else
 		{
+			response.setStatusAndReason(HTTPResponse::HTTP_METHOD_NOT_ALLOWED);
+			response.setContentLength(0);
+			response.send();
+		}
+	}
 
-		app.logger().information("No client certificate available.");      //Uncomment this whwnever v need to display Client Certificate
+private:
+	bool authorized(const HTTPServerRequest& request) const
+	{
+		if (_token.empty()) return false;
+		// compared in constant time
+		return AEAD::equal(request.get("Authorization", ""), "Bearer " + _token);
+	}
 
+	bool authenticated(const HTTPServerRequest& request, const std::string& device, const std::string& sequence, const std::string& done, const std::string& failed)
+	{
+		if (!_pDeviceKeys) return false;
+		Poco::UInt64 value;
+		if (!NumberParser::tryParseUnsigned64(sequence, value)) return false;
+		std::string expected(CommandQueue::authorization(_pDeviceKeys->key(device), device, sequence, done, failed));
+		// the sequence is recorded only for an authentic poll, so that
+		// others cannot hold back the device's polls
+		return AEAD::equal(request.get("Authorization", ""), expected) && _pQueue->fresh(device, value);
+	}
+
+	CommandQueue::Ptr _pQueue;
+	int _maxWait;
+	std::string _token;
+	DeviceKeyStore::Ptr _pDeviceKeys;
+	LongPollLimiter::Ptr _pLimiter;
+};
+
+
+class StatusRequestHandler: public HTTPRequestHandler
+	/// Serves the device table (see FleetStatus): GET
+	/// /status[?epoch=<epoch>&since=<version>] is answered with the
+	/// current snapshot, or the devices changed since the version, or
+	/// with 304 Not Modified if the client has the current version.
+{
+public:
+	StatusRequestHandler(FleetStatus::Ptr pStatus):
+		_pStatus(pStatus)
+	{
+	}
+
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
+	{
+		std::string epoch;
+		Poco::UInt32 since = 0;
+		bool delta = false;
+		try
+		{
+			Poco::URI::QueryParameters params(Poco::URI(request.getURI()).getQueryParameters());
+			for (Poco::URI::QueryParameters::const_iterator it = params.begin(); it != params.end(); ++it)
+			{
+				if (it->first == "epoch") epoch = it->second;
+				else if (it->first == "since")
+				{
+					since = NumberParser::parseUnsigned(it->second);
+					delta = true;
+				}
+			}
+		}
+		catch (Poco::SyntaxException& exc)
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_BAD_REQUEST, exc.displayText());
+			response.setContentLength(0);
+			response.send();
+			return;
 		}
-		std::cout << " "<< std::endl;
-		std::cout << " "<< std::endl;
-		std::ostream& ostr = response.send();
-		ostr << a;
 
-}
+		FleetStatus::Snapshot changes;
+		FleetStatus::SnapshotPtr pSnapshot = _pStatus->snapshot();
+		bool full = !delta || !_pStatus->delta(epoch, since, changes);
+		const FleetStatus::Snapshot& snapshot = full ? *pSnapshot : changes;
+		response.set("ETag", snapshot.etag);
+		response.set("Cache-Control", "no-cache");
+		if (StaticAssets::matches(request.get("If-None-Match", ""), snapshot.etag) || (!full && since == snapshot.version))
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_NOT_MODIFIED);
+			response.setContentLength(0);
+			response.send();
+			return;
+		}
+		response.set("X-Status-Epoch", _pStatus->epoch());
+		response.set("X-Status-Version", NumberFormatter::format(snapshot.version));
+		response.set("X-Status-Delta", full ? std::string("full") : NumberFormatter::format(since));
+		response.setContentType("application/json");
+		response.sendBuffer(snapshot.body.data(), snapshot.body.size());
+	}
 
 private:
-	std::string _format;
+	FleetStatus::Ptr _pStatus;
+};
+
+
+class AssetRequestHandler: public HTTPRequestHandler
+	/// Serves the operator dashboard from memory (see StaticAssets):
+	/// gzip-encoded to clients that accept it, and as 304 Not Modified
+	/// to clients whose If-None-Match has the current ETag.
+{
+public:
+	AssetRequestHandler(StaticAssets::Ptr pAssets):
+		_pAssets(pAssets)
+	{
+	}
+
+	void handleRequest(HTTPServerRequest& request, HTTPServerResponse& response)
+	{
+		if (request.getMethod() != HTTPRequest::HTTP_GET && request.getMethod() != HTTPRequest::HTTP_HEAD)
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_METHOD_NOT_ALLOWED);
+			response.set("Allow", "GET, HEAD");
+			response.send();
+			return;
+		}
+		StaticAssets::AssetPtr pAsset;
+		try
+		{
+			pAsset = _pAssets->find(Poco::URI(request.getURI()).getPath());
+		}
+		catch (Poco::SyntaxException&)
+		{
+		}
+		if (!pAsset)
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_NOT_FOUND);
+			response.send();
+			return;
+		}
+
+		bool gzip = !pAsset->gzipBody.empty() && StaticAssets::acceptsGzip(request.get("Accept-Encoding", ""));
+		const std::string& etag = gzip ? pAsset->gzipETag : pAsset->etag;
+		response.set("ETag", etag);
+		response.set("Cache-Control", pAsset->cacheControl);
+		response.set("Last-Modified", DateTimeFormatter::format(pAsset->lastModified, DateTimeFormat::HTTP_FORMAT));
+		if (!pAsset->gzipBody.empty())
+			response.set("Vary", "Accept-Encoding");
+		if (StaticAssets::matches(request.get("If-None-Match", ""), etag))
+		{
+			response.setStatusAndReason(HTTPResponse::HTTP_NOT_MODIFIED);
+			response.send();
+			return;
+		}
+		response.setContentType(pAsset->contentType);
+		if (gzip)
+			response.set("Content-Encoding", "gzip");
+		const std::string& body = gzip ? pAsset->gzipBody : pAsset->body;
+		response.sendBuffer(body.data(), body.size());
+	}
+
+private:
+	StaticAssets::Ptr _pAssets;
+};
+
+
+class DashboardRequestHandlerFactory: public HTTPRequestHandlerFactory
+{
+public:
+	DashboardRequestHandlerFactory(StaticAssets::Ptr pAssets, FleetStatus::Ptr pStatus):
+		_pAssets(pAssets),
+		_pStatus(pStatus)
+	{
+	}
+
+	HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request)
+	{
+		if (isStatus(request.getURI()))
+			return new StatusRequestHandler(_pStatus);
+		else
+			return new AssetRequestHandler(_pAssets);
+	}
+
+	static bool isStatus(const std::string& uri)
+	{
+		return uri.compare(0, FleetStatus::PATH.size(), FleetStatus::PATH) == 0 && (uri.size() == FleetStatus::PATH.size() || uri[FleetStatus::PATH.size()] == '?');
+	}
+
+private:
+	StaticAssets::Ptr _pAssets;
+	FleetStatus::Ptr _pStatus;
 };
 
 
 class TimeRequestHandlerFactory: public HTTPRequestHandlerFactory
 {
 public:
-	TimeRequestHandlerFactory(const std::string& format):
-		_format(format)
+	TimeRequestHandlerFactory(const std::string& format, IngestPipeline::Ptr pPipeline, UploadStore::Ptr pUploads, ConfigStore::Ptr pConfig, int maxConfigWait, FleetStatus::Ptr pStatus, CommandQueue::Ptr pCommands, int maxCommandWait, const std::string& commandToken, DeviceKeyStore::Ptr pDeviceKeys, LongPollLimiter::Ptr pLongPolls):
+		_format(format),
+		_pPipeline(pPipeline),
+		_pUploads(pUploads),
+		_pConfig(pConfig),
+		_maxConfigWait(maxConfigWait),
+		_pStatus(pStatus),
+		_pCommands(pCommands),
+		_maxCommandWait(maxCommandWait),
+		_commandToken(commandToken),
+		_pDeviceKeys(pDeviceKeys),
+		_pLongPolls(pLongPolls)
 	{
 	}
 
 	HTTPRequestHandler* createRequestHandler(const HTTPServerRequest& request)
 	{
 		if (request.getURI() == "/")
-			return new TimeRequestHandler(_format);
+			return new TimeRequestHandler(_format, _pPipeline);
+		else if (request.getURI().compare(0, ChunkedUpload::PATH.size(), ChunkedUpload::PATH) == 0)
+			return new UploadRequestHandler(_pUploads, _pPipeline);
+		else if (request.getURI().compare(0, ConfigStore::PATH.size(), ConfigStore::PATH) == 0 && (request.getURI().size() == ConfigStore::PATH.size() || request.getURI()[ConfigStore::PATH.size()] == '?'))
+			return new ConfigRequestHandler(_pConfig, _maxConfigWait, _pLongPolls);
+		else if (request.getURI().compare(0, CommandQueue::PATH.size(), CommandQueue::PATH) == 0 && (request.getURI().size() == CommandQueue::PATH.size() || request.getURI()[CommandQueue::PATH.size()] == '?'))
+			return new CommandRequestHandler(_pCommands, _maxCommandWait, _commandToken, _pDeviceKeys, _pLongPolls);
+		else if (DashboardRequestHandlerFactory::isStatus(request.getURI()))
+			return new StatusRequestHandler(_pStatus);
 		else
 			return 0;
 	}
 
 private:
 	std::string _format;
+	IngestPipeline::Ptr _pPipeline;
+	UploadStore::Ptr _pUploads;
+	ConfigStore::Ptr _pConfig;
+	int _maxConfigWait;
+	FleetStatus::Ptr _pStatus;
+	CommandQueue::Ptr _pCommands;
+	int _maxCommandWait;
+	std::string _commandToken;
+	DeviceKeyStore::Ptr _pDeviceKeys;
+	LongPollLimiter::Ptr _pLongPolls;
+};
+
+
+class StoredPSKBenchmarkCase: public PSKBenchmarkCase
+	/// The psk path as the server takes it: unprotecting goes through
+	/// the DeviceKeyStore, so it includes the cache lookup.
+{
+public:
+	StoredPSKBenchmarkCase(const std::string& deviceId, DeviceKeyStore::Ptr pStore):
+		PSKBenchmarkCase(deviceId, pStore->key(deviceId)),
+		_deviceId(deviceId),
+		_pStore(pStore)
+	{
+	}
+
+	std::string unprotect(const std::string& data)
+	{
+		return _pStore->decrypt(_deviceId, data);
+	}
+
+private:
+	std::string _deviceId;
+	DeviceKeyStore::Ptr _pStore;
 };
 
 
@@ -218,7 +748,7 @@ class HTTPSTimeServer: public Poco::Util::ServerApplication
 	/// To test the TimeServer you can use any web browser (https://localhost:9980/).
 {
 public:
-	HTTPSTimeServer(): _helpRequested(false)
+	HTTPSTimeServer(): _helpRequested(false), _benchmarkRequested(false), _scalingRequested(false), _parserBenchmarkRequested(false), _responseBenchmarkRequested(false), _pipelineBenchmarkRequested(false)
 	{
 	}
 
@@ -231,10 +761,14 @@ protected:
 	{
 		loadConfiguration(); // load default configuration files, if present
 		ServerApplication::initialize(self);
+		OpenSSLLocking::install(
+			config().getBool("HTTPTimeServer.openssl.sharedReadLocks", true),
+			config().getBool("HTTPTimeServer.openssl.lockProfiling", false));
 	}
 
 	void uninitialize()
 	{
+		OpenSSLLocking::uninstall();
 		ServerApplication::uninitialize();
 	}
 
@@ -246,6 +780,55 @@ protected:
 			Option("help", "h", "display help information on command line arguments")
 				.required(false)
 				.repeatable(false));
+
+		options.addOption(
+			Option("benchmark", "b", "measure per-message CPU time of the payload encryption modes and exit")
+				.required(false)
+				.repeatable(false));
+
+		options.addOption(
+			Option("scaling", "s", "measure decryption throughput over HTTPTimeServer.benchmark.threads threads, before and after the OpenSSL locking changes, and exit")
+				.required(false)
+				.repeatable(false));
+
+		options.addOption(
+			Option("parser-benchmark", "p", "measure per-request CPU time of parsing an ingest request with and without the HTTP/1.1 fast path and exit")
+				.required(false)
+				.repeatable(false));
+
+		options.addOption(
+			Option("response-benchmark", "r", "count the socket writes (TLS records and system calls) per HTTP/1.1 response with Poco's and the server's own connection class and exit")
+				.required(false)
+				.repeatable(false));
+
+		options.addOption(
+			Option("pipeline-benchmark", "e", "measure the per-event overhead of pipeline stages composed at compile time, chained with virtual calls and written by hand, and exit")
+				.required(false)
+				.repeatable(false));
+
+		options.addOption(
+			Option("device-key", "k", "print the key to provision on the device with the given id and exit")
+				.required(false)
+				.repeatable(false)
+				.argument("id"));
+
+		options.addOption(
+			Option("generate-key", "g", "generate an RSA private key (HTTPTimeServer.rsa.bits, HTTPTimeServer.rsa.primes) into the given file and exit")
+				.required(false)
+				.repeatable(false)
+				.argument("file"));
+
+		options.addOption(
+			Option("loadgen", "l", "compare HTTP/1.1 keep-alive and HTTP/2 request throughput against the server at the given host:port and exit")
+				.required(false)
+				.repeatable(false)
+				.argument("address"));
+
+		options.addOption(
+			Option("fault-proxy", "f", "forward the given port on 127.0.0.1 to HTTPTimeServer.proxy.target with the network faults of HTTPTimeServer.proxy.script")
+				.required(false)
+				.repeatable(false)
+				.argument("port"));
 	}
 
 	void handleOption(const std::string& name, const std::string& value)
@@ -254,6 +837,24 @@ protected:
 
 		if (name == "help")
 			_helpRequested = true;
+		else if (name == "benchmark")
+			_benchmarkRequested = true;
+		else if (name == "scaling")
+			_scalingRequested = true;
+		else if (name == "parser-benchmark")
+			_parserBenchmarkRequested = true;
+		else if (name == "response-benchmark")
+			_responseBenchmarkRequested = true;
+		else if (name == "pipeline-benchmark")
+			_pipelineBenchmarkRequested = true;
+		else if (name == "device-key")
+			_deviceKeyId = value;
+		else if (name == "generate-key")
+			_generateKeyFile = value;
+		else if (name == "loadgen")
+			_loadgenAddress = value;
+		else if (name == "fault-proxy")
+			_faultProxyPort = value;
 	}
 
 	void displayHelp()
@@ -271,18 +872,67 @@ protected:
 		{
 			displayHelp();
 		}
+		else if (_benchmarkRequested)
+		{
+			runBenchmark();
+		}
+		else if (_scalingRequested)
+		{
+			runScalingBenchmark();
+		}
+		else if (_parserBenchmarkRequested)
+		{
+			runParserBenchmark();
+		}
+		else if (_pipelineBenchmarkRequested)
+		{
+			PipelineBenchmark benchmark(config().getInt("HTTPTimeServer.benchmark.pipelineEvents", 10000000));
+			benchmark.run(std::cout);
+		}
+		else if (_responseBenchmarkRequested)
+		{
+			ResponseBenchmark benchmark(
+				config().getInt("HTTPTimeServer.benchmark.responseRequests", 200),
+				config().getString("HTTPTimeServer.benchmark.message", "!!!!...REMOTE SYNC TROUBLE...!!!!\n"));
+			benchmark.run(std::cout);
+		}
+		else if (!_deviceKeyId.empty())
+		{
+			std::string masterKey(AEAD::readKeyFile(config().getString("HTTPTimeServer.psk.masterKeyFile", "master.key")));
+			std::cout << AEAD::toHex(DeviceKeyStore::deriveKey(masterKey, _deviceKeyId)) << std::endl;
+		}
+		else if (!_generateKeyFile.empty())
+		{
+			int bits = config().getInt("HTTPTimeServer.rsa.bits", 2048);
+			int primes = config().getInt("HTTPTimeServer.rsa.primes", RSAKeyGenerator::supportsMultiPrime() ? 3 : 2);
+			RSAKeyGenerator::generate(bits, primes, _generateKeyFile, _generateKeyFile + ".pub", config().getString("HTTPTimeServer.rsa.passphrase", "secret"));
+			std::cout << "Generated " << bits << " bit RSA key with " << primes << " primes in " << _generateKeyFile << std::endl;
+		}
+		else if (!_loadgenAddress.empty())
+		{
+			runLoadGenerator(_loadgenAddress);
+		}
+		else if (!_faultProxyPort.empty())
+		{
+			runFaultProxy(_faultProxyPort);
+		}
 		else
 		{
 			// get parameters from configuration file
 			unsigned short port = (unsigned short) config().getInt("HTTPTimeServer.port",80);
 			std::string format(config().getString("HTTPTimeServer.format", DateTimeFormat::SORTABLE_FORMAT));
 			int maxQueued  = config().getInt("HTTPTimeServer.maxQueued", 100);
-		    int maxThreads = config().getInt("HTTPTimeServer.maxThreads", 16);
-			ThreadPool::defaultPool().addCapacity(maxThreads);
+			int maxThreads = config().getInt("HTTPTimeServer.maxThreads", 16);
+			// every long poll held keeps a thread waiting, so the server
+			// gets one more thread per poll held, and maxThreads stay
+			// for the uploads
+			int maxHeldPolls = config().getInt("HTTPTimeServer.longPoll.maxHeld", 256);
+			ThreadPool::defaultPool().addCapacity(maxThreads + maxHeldPolls);
 
-			HTTPServerParams* pParams = new HTTPServerParams;
+			HTTPServerParams::Ptr pParams = new HTTPServerParams;
 			pParams->setMaxQueued(maxQueued);
 			pParams->setMaxThreads(maxThreads);
+			LongPollLimiter::Ptr pLongPolls = new LongPollLimiter(pParams, maxHeldPolls);
 			SharedPtr<PrivateKeyPassphraseHandler> pConsoleHandler = new KeyConsoleHandler(false);
 			SharedPtr<InvalidCertificateHandler> pInvalidCertHandler = new ConsoleCertificateHandler(false);
 			//Context::Ptr pContext = new Context(Context::SERVER_USE, "server.key", "server.crt", "", Context::VERIFY_NONE, 9, false, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
@@ -294,21 +944,421 @@ protected:
 
 			SecureServerSocket svs(sa,64,pContext);
 
-			// set-up a HTTPServer instance
-			HTTPServer srv(new TimeRequestHandlerFactory(format), svs, pParams);
+			// set-up a TCPServer that speaks HTTP/1.1, with single-write
+			// responses and a fast path for ingest requests, and HTTP/2
+			// to clients negotiating it with ALPN
+			FleetStatus::Ptr pStatus = new FleetStatus(config().getInt("HTTPTimeServer.status.interval", 1000), config().getInt("HTTPTimeServer.status.maxDevices", FleetStatus::DEFAULT_MAX_DEVICES));
+			Keyring keyring(loadKeyring());
+			IngestPipeline::Ptr pPipeline = new IngestPipeline(keyring, "", pStatus);
+			reorder(pPipeline);
+			pPipeline->setMaxSkew(config().getInt("HTTPTimeServer.sign.maxSkew", 300)*1000L);
+			UploadStore::Ptr pUploads = new UploadStore(config().getString("HTTPTimeServer.upload.directory", "uploads"), maxUploadSize(""));
+			ConfigStore::Ptr pConfig = new ConfigStore(config().getString("HTTPTimeServer.config.file", "clientconfig.properties"));
+			pConfig->watch(config().getInt("HTTPTimeServer.config.checkInterval", 2000));
+			CommandQueue::Ptr pCommands = new CommandQueue(config().getInt("HTTPTimeServer.commands.maxQueued", 16), config().getInt("HTTPTimeServer.commands.expiry", 300)*1000L, config().getInt("HTTPTimeServer.commands.maxSkew", 300)*1000L);
+			HTTPRequestHandlerFactory::Ptr pFactory = new TimeRequestHandlerFactory(format, pPipeline, pUploads, pConfig, config().getInt("HTTPTimeServer.config.maxWait", 60), pStatus, pCommands, maxCommandWait(""), config().getString("HTTPTimeServer.commands.token", ""), keyring.pDeviceKeys, pLongPolls);
+			bool http2 = config().getBool("HTTPTimeServer.http2.enable", true);
+			if (http2)
+				ALPNConnectionFactory::enable(pContext);
+			bool fastPath = config().getBool("HTTPTimeServer.http1.fastPath", true);
+			ALPNConnectionFactory* pConnectionFactory = new ALPNConnectionFactory(pParams, pFactory, fastPath ? pPipeline : IngestPipeline::Ptr());
+			int streamThreads = config().getInt("HTTPTimeServer.http2.threads", 16);
+			if (http2 && streamThreads > 0)
+				pConnectionFactory->setStreamThreads(streamThreads);
+			SharedPtr<TCPServer> pServer = new TCPServer(pConnectionFactory, svs, pParams);
+
+			// the dashboard has its own port and threads, so that
+			// loading it never holds up ingest
+			SharedPtr<ThreadPool> pDashboardPool;
+			SharedPtr<TCPServer> pDashboard;
+			HTTPServerParams::Ptr pDashboardParams;
+			SharedPtr<ALPNConnectionFactory> pDashboardFactory;
+			StaticAssets::Ptr pAssets;
+			std::string dashboardDirectory(config().getString("HTTPTimeServer.dashboard.directory", "dashboard"));
+			if (config().getBool("HTTPTimeServer.dashboard.enable", true) && Poco::File(dashboardDirectory).exists())
+			{
+				int dashboardThreads = config().getInt("HTTPTimeServer.dashboard.threads", 2);
+				pDashboardPool = new ThreadPool("dashboard", 1, dashboardThreads);
+				pDashboardParams = new HTTPServerParams;
+				pDashboardParams->setMaxQueued(config().getInt("HTTPTimeServer.dashboard.maxQueued", 16));
+				pDashboardParams->setMaxThreads(dashboardThreads);
+				pAssets = new StaticAssets(dashboardDirectory, config().getInt("HTTPTimeServer.dashboard.maxAge", 31536000), config().getInt("HTTPTimeServer.dashboard.checkInterval", 2000));
+				pDashboardFactory = new ALPNConnectionFactory(pDashboardParams, new DashboardRequestHandlerFactory(pAssets, pStatus));
+			}
+
+			// the tenants get their own certificate, keys and storage,
+			// selected by the server name the client asks for; the
+			// dashboard shares the context, so its SNI picks the
+			// device table of the tenant there too
+			Poco::StringTokenizer tenants(config().getString("HTTPTimeServer.tenants", ""), ",;", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+			for (Poco::StringTokenizer::Iterator it = tenants.begin(); it != tenants.end(); ++it)
+			{
+				addTenant(*it, pContext, *pConnectionFactory, pDashboardFactory.get(), pAssets, pLongPolls, format, http2, fastPath);
+			}
+
+			if (pDashboardFactory)
+			{
+				SecureServerSocket dashboardSocket(Poco::Net::SocketAddress(ipaddr, (unsigned short) config().getInt("HTTPTimeServer.dashboard.port", 8443)), 64, pContext);
+				pDashboard = new TCPServer(pDashboardFactory, *pDashboardPool, dashboardSocket, pDashboardParams);
+			}
 
 			// start the HTTPServer
-			srv.start();
+			pServer->start();
+			if (pDashboard)
+				pDashboard->start();
+			ServiceAdvertiser::Ptr pAdvertiser;
+			if (config().getBool("HTTPTimeServer.dnssd.enable", true))
+				pAdvertiser = advertise(sa.port());
 			// wait for CTRL-C or kill
 			waitForTerminationRequest();
 			// Stop the HTTPServer
-			srv.stop();
+			if (pAdvertiser)
+			{
+				pAdvertiser = 0;
+				Poco::DNSSD::uninitializeDNSSD();
+			}
+			if (pDashboard)
+				pDashboard->stop();
+			pServer->stop();
+			if (OpenSSLLocking::isProfiling())
+				OpenSSLLocking::report(std::cout);
 		}
 		return Application::EXIT_OK;
 	}
 
+	void addTenant(const std::string& tenant, Context::Ptr pContext, ALPNConnectionFactory& connectionFactory, ALPNConnectionFactory* pDashboardFactory, StaticAssets::Ptr pAssets, LongPollLimiter::Ptr pLongPolls, const std::string& format, bool http2, bool fastPath)
+		/// Loads the certificate, private key and payload keys of a
+		/// tenant and serves the clients asking for its server name
+		/// with them, its own upload directory and client configuration,
+		/// and the dashboards asking for it, if pDashboardFactory is
+		/// given, with its device table.
+	{
+		std::string serverName(setting(tenant, "serverName", tenant));
+		Context::Ptr pTenantContext = new Context(Context::SERVER_USE, file(tenant, "privateKeyFile", "any.pem"), file(tenant, "certificateFile", "anyCert.pem"), "rootcert.pem", Context::VERIFY_NONE, 9, false, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+		if (http2)
+			ALPNConnectionFactory::enable(pTenantContext);
+		SNI::addContext(pContext, serverName, pTenantContext);
+
+		FleetStatus::Ptr pStatus = new FleetStatus(config().getInt("HTTPTimeServer.status.interval", 1000), config().getInt("HTTPTimeServer.status.maxDevices", FleetStatus::DEFAULT_MAX_DEVICES));
+		Keyring keyring(loadKeyring(tenant));
+		IngestPipeline::Ptr pPipeline = new IngestPipeline(keyring, tenant, pStatus);
+		reorder(pPipeline);
+		pPipeline->setMaxSkew(config().getInt("HTTPTimeServer.sign.maxSkew", 300)*1000L);
+		UploadStore::Ptr pUploads = new UploadStore(file(tenant, "upload.directory", "uploads"), maxUploadSize(tenant));
+		ConfigStore::Ptr pConfig = new ConfigStore(file(tenant, "config.file", "clientconfig.properties"));
+		pConfig->watch(config().getInt("HTTPTimeServer.config.checkInterval", 2000));
+		CommandQueue::Ptr pCommands = new CommandQueue(config().getInt("HTTPTimeServer.commands.maxQueued", 16), config().getInt("HTTPTimeServer.commands.expiry", 300)*1000L, config().getInt("HTTPTimeServer.commands.maxSkew", 300)*1000L);
+		HTTPRequestHandlerFactory::Ptr pFactory = new TimeRequestHandlerFactory(format, pPipeline, pUploads, pConfig, config().getInt("HTTPTimeServer.config.maxWait", 60), pStatus, pCommands, maxCommandWait(tenant), setting(tenant, "commands.token", ""), keyring.pDeviceKeys, pLongPolls);
+		connectionFactory.addTenant(serverName, pFactory, fastPath ? pPipeline : IngestPipeline::Ptr());
+		if (pDashboardFactory)
+			pDashboardFactory->addTenant(serverName, new DashboardRequestHandlerFactory(pAssets, pStatus));
+		logger().information("Tenant " + tenant + " serves " + serverName + ".");
+	}
+
+	ServiceAdvertiser::Ptr advertise(Poco::UInt16 port)
+	{
+		Poco::DNSSD::Service::Properties properties;
+		if (config().has("HTTPTimeServer.dnssd.host"))
+			properties.set("host", config().getString("HTTPTimeServer.dnssd.host"));
+		try
+		{
+			Poco::DNSSD::initializeDNSSD();
+			return new ServiceAdvertiser(config().getString("HTTPTimeServer.dnssd.name", ""), config().getString("HTTPTimeServer.dnssd.type", ServiceAdvertiser::DEFAULT_TYPE), port, properties);
+		}
+		catch (Poco::Exception& exc)
+		{
+			// without Avahi the clients fall back to their configured address
+			logger().warning("DNS-SD disabled: " + exc.displayText());
+			Poco::DNSSD::uninitializeDNSSD();
+			return 0;
+		}
+	}
+
+	std::string setting(const std::string& tenant, const std::string& key, const std::string& deflt)
+		/// Returns HTTPTimeServer.<key>, or for a tenant
+		/// HTTPTimeServer.tenant.<tenant>.<key>.
+	{
+		if (tenant.empty())
+			return config().getString("HTTPTimeServer." + key, deflt);
+		return config().getString("HTTPTimeServer.tenant." + tenant + "." + key, deflt);
+	}
+
+	std::string file(const std::string& tenant, const std::string& key, const std::string& deflt)
+		/// Like setting(), for a file or directory. Those of a tenant
+		/// default to its directory, HTTPTimeServer.tenant.<tenant>.directory
+		/// (default: the name of the tenant).
+	{
+		if (tenant.empty())
+			return setting(tenant, key, deflt);
+		Poco::Path dir(setting(tenant, "directory", tenant));
+		dir.makeDirectory();
+		return setting(tenant, key, Poco::Path(dir, deflt).toString());
+	}
+
+	Poco::UInt64 maxUploadSize(const std::string& tenant)
+		/// Returns upload.maxMB of the tenant in bytes, which defaults
+		/// to HTTPTimeServer.upload.maxMB (1024).
+	{
+		std::string maxMB(config().getString("HTTPTimeServer.upload.maxMB", "1024"));
+		return NumberParser::parseUnsigned64(setting(tenant, "upload.maxMB", maxMB))*1024*1024;
+	}
+
+	int maxCommandWait(const std::string& tenant)
+		/// Returns commands.maxWait of the tenant, the longest a command
+		/// poll or an operator's POST is held, in seconds, which
+		/// defaults to HTTPTimeServer.commands.maxWait (60).
+	{
+		std::string maxWait(config().getString("HTTPTimeServer.commands.maxWait", "60"));
+		return NumberParser::parse(setting(tenant, "commands.maxWait", maxWait));
+	}
+
+	void reorder(IngestPipeline::Ptr pPipeline)
+		/// Puts the messages of each device back into the order of
+		/// their X-Sequence, unless HTTPTimeServer.reorder.window is 0.
+	{
+		int window = config().getInt("HTTPTimeServer.reorder.window", SequenceReorderer::DEFAULT_WINDOW);
+		if (window > 0)
+			pPipeline->reorder(window, config().getInt("HTTPTimeServer.reorder.timeout", SequenceReorderer::DEFAULT_TIMEOUT));
+	}
+
+	PerThreadRSACipher::Ptr loadRSA(const std::string& keyFile, const std::string& tenant = std::string())
+	{
+		Poco::Crypto::RSAKey key("", keyFile, setting(tenant, "rsa.passphrase", "secret"));
+		logger().information("RSA key " + keyFile + " has " + Poco::NumberFormatter::format(RSAKeyGenerator::primes(key)) + " primes.");
+		return new PerThreadRSACipher(key, config().getBool("HTTPTimeServer.rsa.perThreadKeys", true));
+	}
+
+	Keyring loadKeyring(const std::string& tenant = std::string())
+		/// Loads the payload keys of the server, or of a tenant.
+	{
+		Keyring keyring;
+		keyring.pRSA = loadRSA(file(tenant, "rsa.privateKeyFile", "any.pem"), tenant);
+		keyring.pECIES = loadECIES(tenant);
+		keyring.pDeviceKeys = loadDeviceKeys(tenant);
+		keyring.pSignatureKeys = loadSignatureKeys(tenant);
+		return keyring;
+	}
+
+	SharedPtr<ECIESCipher> loadECIES(const std::string& tenant = std::string())
+		/// Loads the static ECIES private key, if one is configured.
+		/// Without it, requests using "X-Encryption: ecies" are rejected.
+	{
+		std::string keyFile(file(tenant, "ecies.privateKeyFile", "ecc.pem"));
+		if (!Poco::File(keyFile).exists())
+		{
+			logger().information("No ECIES key " + keyFile + ", ECIES mode disabled.");
+			return SharedPtr<ECIESCipher>();
+		}
+		return new ECIESCipher("", keyFile, setting(tenant, "ecies.passphrase", "secret"));
+	}
+
+	DeviceKeyStore::Ptr loadDeviceKeys(const std::string& tenant = std::string())
+		/// Loads the master key for per-device keys, if one is configured.
+		/// Without it, requests using "X-Encryption: psk" are rejected.
+	{
+		std::string keyFile(file(tenant, "psk.masterKeyFile", "master.key"));
+		if (!Poco::File(keyFile).exists())
+		{
+			logger().information("No master key " + keyFile + ", PSK mode disabled.");
+			return DeviceKeyStore::Ptr();
+		}
+		return new DeviceKeyStore(AEAD::readKeyFile(keyFile), config().getInt("HTTPTimeServer.psk.cacheSize", 10000));
+	}
+
+	DeviceSignatureKeys::Ptr loadSignatureKeys(const std::string& tenant = std::string())
+		/// Enables "X-Encryption: sign" if the device public key
+		/// directory exists.
+	{
+		std::string keyDir(file(tenant, "sign.keyDir", "devicekeys"));
+		if (!Poco::File(keyDir).exists())
+		{
+			logger().information("No device key directory " + keyDir + ", sign mode disabled.");
+			return DeviceSignatureKeys::Ptr();
+		}
+		return new DeviceSignatureKeys(keyDir);
+	}
+
+	void runBenchmark()
+	{
+		int iterations = config().getInt("HTTPTimeServer.benchmark.iterations", 1000);
+		std::string message(config().getString("HTTPTimeServer.benchmark.message", "!!!!...REMOTE SYNC TROUBLE...!!!!\n"));
+
+		std::string rsaKeyFile(config().getString("HTTPTimeServer.rsa.privateKeyFile", "any.pem"));
+		std::string rsaPassphrase(config().getString("HTTPTimeServer.rsa.passphrase", "secret"));
+
+		CipherBenchmark benchmark(iterations, message);
+		benchmark.add(new RSAReloadBenchmarkCase(rsaKeyFile, rsaPassphrase));
+		benchmark.add(new RSABenchmarkCase(Poco::Crypto::RSAKey("", rsaKeyFile, rsaPassphrase), true));
+		std::string multiPrimeKeyFile(config().getString("HTTPTimeServer.benchmark.multiPrimeKeyFile", "any-mp.pem"));
+		if (Poco::File(multiPrimeKeyFile).exists())
+		{
+			Poco::Crypto::RSAKey key("", multiPrimeKeyFile, rsaPassphrase);
+			benchmark.add(new RSABenchmarkCase(key, true, "rsa-" + Poco::NumberFormatter::format(RSAKeyGenerator::primes(key)) + "p"));
+		}
+		SharedPtr<ECIESCipher> pECIES = loadECIES();
+		if (pECIES) benchmark.add(new ECIESBenchmarkCase(pECIES));
+		DeviceKeyStore::Ptr pDeviceKeys = loadDeviceKeys();
+		if (!pDeviceKeys) pDeviceKeys = new DeviceKeyStore(AEAD::random(AEAD::KEY_SIZE));
+		benchmark.add(new StoredPSKBenchmarkCase("benchmark", pDeviceKeys));
+		std::string signKeyFile(config().getString("HTTPTimeServer.benchmark.signPrivateKeyFile", "ClientSign.pem"));
+		if (Poco::File(signKeyFile).exists())
+		{
+			ECDSAKey::Ptr pKey = new ECDSAKey("", signKeyFile, config().getString("HTTPTimeServer.benchmark.signPassphrase", "secret"));
+			benchmark.add(new SignBenchmarkCase("benchmark", pKey, pKey, 1));
+			benchmark.add(new SignBenchmarkCase("benchmark", pKey, pKey, 16));
+			benchmark.add(new SignBenchmarkCase("benchmark", pKey, pKey, 64));
+		}
+		benchmark.run(std::cout);
+	}
+
+	static void reportLocks(std::ostream& ostr)
+	{
+		OpenSSLLocking::report(ostr, 3);
+		OpenSSLLocking::reset();
+	}
+
+	void runScalingBenchmark()
+		/// Runs the decryption throughput curves twice: with Poco's
+		/// exclusive OpenSSL locks and one shared RSA key (before), and
+		/// with shared read locks and per-thread RSA keys (after).
+	{
+		int iterations = config().getInt("HTTPTimeServer.benchmark.scalingIterations", 200);
+		std::string message(config().getString("HTTPTimeServer.benchmark.message", "!!!!...REMOTE SYNC TROUBLE...!!!!\n"));
+		std::vector<int> threads;
+		Poco::StringTokenizer tok(config().getString("HTTPTimeServer.benchmark.threads", "1,2,4,8,16,32"), ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+		for (Poco::StringTokenizer::Iterator it = tok.begin(); it != tok.end(); ++it)
+		{
+			threads.push_back(Poco::NumberParser::parse(*it));
+		}
+
+		Poco::Crypto::RSAKey rsaKey("", config().getString("HTTPTimeServer.rsa.privateKeyFile", "any.pem"), config().getString("HTTPTimeServer.rsa.passphrase", "secret"));
+		SharedPtr<ECIESCipher> pECIES = loadECIES();
+		DeviceKeyStore::Ptr pDeviceKeys = new DeviceKeyStore(AEAD::random(AEAD::KEY_SIZE));
+
+		for (int after = 0; after < 2; ++after)
+		{
+			OpenSSLLocking::uninstall();
+			OpenSSLLocking::install(after == 1, true);
+			std::cout << std::endl << (after ? "after: shared read locks, per-thread RSA keys" : "before: exclusive locks, shared RSA key") << std::endl;
+
+			CipherBenchmark benchmark(iterations, message);
+			benchmark.add(new RSABenchmarkCase(rsaKey, true, "rsa", after == 1));
+			if (pECIES) benchmark.add(new ECIESBenchmarkCase(pECIES));
+			benchmark.add(new StoredPSKBenchmarkCase("benchmark", pDeviceKeys));
+			benchmark.runScaling(std::cout, threads, &HTTPSTimeServer::reportLocks);
+		}
+	}
+
+	void runParserBenchmark()
+		/// Parses a typical ingest request head with FastIngestRequest
+		/// and with Poco's HTTPRequest, which builds the header map that
+		/// every request went through before the fast path, and prints
+		/// the CPU time per request of both.
+	{
+		int iterations = config().getInt("HTTPTimeServer.benchmark.parserIterations", 200000);
+		std::string head(
+			"POST / HTTP/1.1\r\n"
+			"Host: 159.99.184.156\r\n"
+			"Content-Type: application/octet-stream\r\n"
+			"X-Encryption: psk\r\n"
+			"X-Device-Id: pi-0001\r\n"
+			"X-Sequence: 4711\r\n"
+			"Content-Length: 62\r\n"
+			"\r\n");
+		std::string deviceId;
+		std::string sequence;
+
+		std::clock_t start = std::clock();
+		FastIngestRequest fastRequest;
+		for (int i = 0; i < iterations; ++i)
+		{
+			if (fastRequest.parse(head.data(), head.size()) != FastIngestRequest::RESULT_OK)
+				throw Poco::DataException("Fast path rejected the benchmark request");
+			deviceId.assign(fastRequest.deviceId(), fastRequest.deviceIdLength());
+			sequence.assign(fastRequest.sequence(), fastRequest.sequenceLength());
+		}
+		double fastMicros = 1e6*static_cast<double>(std::clock() - start)/CLOCKS_PER_SEC/iterations;
+
+		start = std::clock();
+		for (int i = 0; i < iterations; ++i)
+		{
+			std::istringstream istr(head);
+			HTTPRequest request;
+			request.read(istr);
+			deviceId = request.get("X-Device-Id", "");
+			sequence = request.get("X-Sequence", "");
+			IngestPipeline::mode(request.get("X-Encryption", "rsa"));
+			request.getContentLength();
+		}
+		double fullMicros = 1e6*static_cast<double>(std::clock() - start)/CLOCKS_PER_SEC/iterations;
+
+		std::cout << "parser       cpu[us]" << std::endl;
+		std::cout << "fast path    " << std::setw(7) << Poco::NumberFormatter::format(fastMicros, 3) << std::endl;
+		std::cout << "HTTPRequest  " << std::setw(7) << Poco::NumberFormatter::format(fullMicros, 3) << std::endl;
+	}
+
+	void runLoadGenerator(const std::string& address)
+		/// Posts encrypted messages to a running server, first over
+		/// HTTP/1.1 keep-alive connections, then over HTTP/2 with one
+		/// and with HTTPTimeServer.loadgen.streams concurrent streams
+		/// per connection. Uses PSK mode if master.key is present,
+		/// RSA otherwise.
+	{
+		int connections = config().getInt("HTTPTimeServer.loadgen.connections", 4);
+		int requests = config().getInt("HTTPTimeServer.loadgen.requests", 500);
+		int streams = config().getInt("HTTPTimeServer.loadgen.streams", 16);
+		std::string message(config().getString("HTTPTimeServer.benchmark.message", "!!!!...REMOTE SYNC TROUBLE...!!!!\n"));
+
+		Poco::Net::NameValueCollection headers;
+		std::string body;
+		DeviceKeyStore::Ptr pDeviceKeys = loadDeviceKeys();
+		if (pDeviceKeys)
+		{
+			headers.set("X-Encryption", "psk");
+			headers.set("X-Device-Id", "loadgen");
+			body = pDeviceKeys->encrypt("loadgen", message);
+		}
+		else
+		{
+			body = loadRSA(config().getString("HTTPTimeServer.rsa.privateKeyFile", "any.pem"))->encryptString(message);
+		}
+
+		Poco::Net::SocketAddress sa(address);
+		LoadGenerator generator(sa.host().toString(), sa.port(), headers, body);
+		LoadGenerator::printHeader(std::cout);
+		LoadGenerator::print(std::cout, "http/1.1", connections, 1, generator.runHttp1(connections, requests));
+		LoadGenerator::print(std::cout, "h2", connections, 1, generator.runHttp2(connections, requests, 1));
+		LoadGenerator::print(std::cout, "h2", connections, streams, generator.runHttp2(connections, requests, streams));
+	}
+
+	void runFaultProxy(const std::string& port)
+		/// Forwards 127.0.0.1:port to the server with the faults of
+		/// HTTPTimeServer.proxy.script, for running a client against
+		/// a bad network. After the script the network is clean until
+		/// the proxy is terminated.
+	{
+		std::string target(config().getString("HTTPTimeServer.proxy.target", "127.0.0.1:" + config().getString("HTTPTimeServer.port", "80")));
+		FaultProxy::Script script(FaultProxy::parse(config().getString("HTTPTimeServer.proxy.script", "")));
+		FaultProxy proxy(Poco::Net::SocketAddress("127.0.0.1", port), Poco::Net::SocketAddress(target));
+		proxy.start();
+		std::cout << "Forwarding " << proxy.address().toString() << " to " << target << ", " << script.size() << " phases" << std::endl;
+		proxy.play(script);
+		std::cout << "Script done after " << proxy.connections() << " connections, " << proxy.resets() << " reset" << std::endl;
+		waitForTerminationRequest();
+		proxy.stop();
+	}
+
 private:
 	bool _helpRequested;
+	bool _benchmarkRequested;
+	bool _scalingRequested;
+	bool _parserBenchmarkRequested;
+	bool _responseBenchmarkRequested;
+	bool _pipelineBenchmarkRequested;
+	std::string _deviceKeyId;
+	std::string _generateKeyFile;
+	std::string _loadgenAddress;
+	std::string _faultProxyPort;
 };
 
 
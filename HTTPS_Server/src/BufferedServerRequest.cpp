@@ -0,0 +1,163 @@
+//
+// BufferedServerRequest.cpp
+//
+// Implementation of the BufferedServerRequest and BufferedServerResponse
+// classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "BufferedServerRequest.h"
+#include "Poco/FileStream.h"
+#include "Poco/StreamCopier.h"
+
+
+//
+// BufferedServerResponse
+//
+
+
+BufferedServerResponse::BufferedServerResponse():
+	_streamed(false),
+	_sent(false)
+{
+}
+
+
+BufferedServerResponse::~BufferedServerResponse()
+{
+}
+
+
+void BufferedServerResponse::sendContinue()
+{
+}
+
+
+std::ostream& BufferedServerResponse::send()
+{
+	_streamed = true;
+	_sent = true;
+	return _stream;
+}
+
+
+void BufferedServerResponse::sendFile(const std::string& path, const std::string& mediaType)
+{
+	Poco::FileInputStream istr(path);
+	setContentType(mediaType);
+	Poco::StreamCopier::copyToString(istr, _body);
+	_sent = true;
+}
+
+
+void BufferedServerResponse::sendBuffer(const void* pBuffer, std::size_t length)
+{
+	_body.append(static_cast<const char*>(pBuffer), length);
+	_sent = true;
+}
+
+
+void BufferedServerResponse::redirect(const std::string& uri, HTTPStatus status)
+{
+	setStatusAndReason(status);
+	set("Location", uri);
+	_sent = true;
+}
+
+
+void BufferedServerResponse::requireAuthentication(const std::string& realm)
+{
+	setStatusAndReason(HTTP_UNAUTHORIZED);
+	set("WWW-Authenticate", "Basic realm=\"" + realm + "\"");
+	_sent = true;
+}
+
+
+bool BufferedServerResponse::sent() const
+{
+	return _sent;
+}
+
+
+const std::string& BufferedServerResponse::body()
+{
+	if (_streamed)
+	{
+		_body += _stream.str();
+		_stream.str(std::string());
+		_streamed = false;
+	}
+	return _body;
+}
+
+
+//
+// BufferedServerRequest
+//
+
+
+BufferedServerRequest::BufferedServerRequest(Poco::Net::StreamSocket& socket, const Poco::Net::HTTPServerParams& params, BufferedServerResponse& response):
+	_socket(socket),
+	_clientAddress(socket.peerAddress()),
+	_serverAddress(socket.address()),
+	_params(params),
+	_response(response)
+{
+}
+
+
+BufferedServerRequest::~BufferedServerRequest()
+{
+}
+
+
+void BufferedServerRequest::setBody(const std::string& body)
+{
+	_stream.str(body);
+	_stream.clear();
+	setContentLength(static_cast<std::streamsize>(body.size()));
+}
+
+
+std::istream& BufferedServerRequest::stream()
+{
+	return _stream;
+}
+
+
+bool BufferedServerRequest::expectContinue() const
+{
+	return false;
+}
+
+
+const Poco::Net::SocketAddress& BufferedServerRequest::clientAddress() const
+{
+	return _clientAddress;
+}
+
+
+const Poco::Net::SocketAddress& BufferedServerRequest::serverAddress() const
+{
+	return _serverAddress;
+}
+
+
+const Poco::Net::HTTPServerParams& BufferedServerRequest::serverParams() const
+{
+	return _params;
+}
+
+
+Poco::Net::HTTPServerResponse& BufferedServerRequest::response() const
+{
+	return _response;
+}
+
+
+Poco::Net::StreamSocket& BufferedServerRequest::socket()
+{
+	return _socket;
+}
@@ -0,0 +1,90 @@
+//
+// BufferedServerRequest.h
+//
+// Definition of the BufferedServerRequest and BufferedServerResponse
+// classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef BufferedServerRequest_INCLUDED
+#define BufferedServerRequest_INCLUDED
+
+
+#include "Poco/Net/HTTPServerRequest.h"
+#include "Poco/Net/HTTPServerResponse.h"
+#include "Poco/Net/HTTPServerParams.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Net/StreamSocket.h"
+#include <sstream>
+
+
+class BufferedServerResponse: public Poco::Net::HTTPServerResponse
+	/// A response whose body is buffered while the request handler
+	/// runs and sent by the connection after the handler returns.
+	///
+	/// sendBuffer() and sendFile() fill the buffer directly, so that
+	/// the body is copied once, and the connection writes it from
+	/// there. Only a body written to the stream returned by send() is
+	/// copied into the buffer once more when the handler is done.
+{
+public:
+	BufferedServerResponse();
+	~BufferedServerResponse();
+
+	void sendContinue();
+	std::ostream& send();
+	void sendFile(const std::string& path, const std::string& mediaType);
+	void sendBuffer(const void* pBuffer, std::size_t length);
+	void redirect(const std::string& uri, HTTPStatus status = HTTP_FOUND);
+	void requireAuthentication(const std::string& realm);
+	bool sent() const;
+
+	const std::string& body();
+		/// Returns the response body.
+
+private:
+	std::string _body;
+	std::ostringstream _stream;
+	bool _streamed;
+	bool _sent;
+};
+
+
+class BufferedServerRequest: public Poco::Net::HTTPServerRequest
+	/// A request whose body has already been read, presented to the
+	/// request handlers like an HTTP/1.1 request with a Content-Length
+	/// body. The request line and headers are set by the connection
+	/// that created it.
+{
+public:
+	BufferedServerRequest(Poco::Net::StreamSocket& socket, const Poco::Net::HTTPServerParams& params, BufferedServerResponse& response);
+		/// Creates the BufferedServerRequest with an empty body.
+
+	~BufferedServerRequest();
+
+	void setBody(const std::string& body);
+		/// Sets the body and the Content-Length.
+
+	std::istream& stream();
+	bool expectContinue() const;
+	const Poco::Net::SocketAddress& clientAddress() const;
+	const Poco::Net::SocketAddress& serverAddress() const;
+	const Poco::Net::HTTPServerParams& serverParams() const;
+	Poco::Net::HTTPServerResponse& response() const;
+
+	Poco::Net::StreamSocket& socket();
+		/// Returns the connection's socket.
+
+private:
+	std::istringstream _stream;
+	Poco::Net::StreamSocket& _socket;
+	Poco::Net::SocketAddress _clientAddress;
+	Poco::Net::SocketAddress _serverAddress;
+	const Poco::Net::HTTPServerParams& _params;
+	BufferedServerResponse& _response;
+};
+
+
+#endif // BufferedServerRequest_INCLUDED
@@ -0,0 +1,226 @@
+//
+// CommandQueue.cpp
+//
+// Implementation of the CommandQueue class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "CommandQueue.h"
+#include "AEAD.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
+#include "Poco/StringTokenizer.h"
+#include "Poco/Util/Application.h"
+
+
+const std::string CommandQueue::PATH("/commands");
+
+
+CommandQueue::Device::Device():
+	nextId(1),
+	lastSequence(0)
+{
+}
+
+
+CommandQueue::CommandQueue(std::size_t maxQueued, long expiry, long maxSkew):
+	_epoch(Poco::NumberFormatter::formatHex(static_cast<Poco::UInt64>(Poco::Timestamp().epochMicroseconds()))),
+	_maxQueued(maxQueued),
+	_expiry(static_cast<Poco::Timestamp::TimeDiff>(expiry)*1000),
+	_maxSkew(maxSkew)
+{
+}
+
+
+CommandQueue::~CommandQueue()
+{
+}
+
+
+Poco::UInt32 CommandQueue::enqueue(const std::string& deviceId, const std::string& data)
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	Device& device = _devices[deviceId];
+	expire(deviceId, device);
+	if (device.pending.size() >= _maxQueued)
+		throw Poco::IllegalStateException("Command queue full", deviceId);
+
+	Command command;
+	command.id = device.nextId++;
+	command.data = data;
+	device.pending.push_back(command);
+	_changed.broadcast();
+	return command.id;
+}
+
+
+bool CommandQueue::fresh(const std::string& deviceId, Poco::UInt64 sequence)
+{
+	Poco::Int64 now = Poco::Timestamp().epochMicroseconds()/1000;
+	Poco::Int64 skew = static_cast<Poco::Int64>(sequence) - now;
+	if (skew > _maxSkew || skew < -_maxSkew) return false;
+
+	Poco::Mutex::ScopedLock lock(_mutex);
+	Device& device = _devices[deviceId];
+	if (sequence <= device.lastSequence) return false;
+	device.lastSequence = sequence;
+	return true;
+}
+
+
+void CommandQueue::report(const std::string& deviceId, const std::vector<Poco::UInt32>& done, const std::vector<Poco::UInt32>& failed)
+{
+	if (done.empty() && failed.empty()) return;
+
+	Poco::Mutex::ScopedLock lock(_mutex);
+	DeviceMap::iterator it = _devices.find(deviceId);
+	if (it == _devices.end()) return;
+	for (std::vector<Poco::UInt32>::const_iterator dit = done.begin(); dit != done.end(); ++dit)
+	{
+		complete(deviceId, it->second, *dit, STATUS_DONE);
+	}
+	for (std::vector<Poco::UInt32>::const_iterator fit = failed.begin(); fit != failed.end(); ++fit)
+	{
+		complete(deviceId, it->second, *fit, STATUS_FAILED);
+	}
+	_changed.broadcast();
+}
+
+
+bool CommandQueue::poll(const std::string& deviceId, long timeout, Commands& commands)
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	Poco::Timestamp start;
+	for (;;)
+	{
+		// the entry is looked up again after every wait, as it may
+		// have been made in the meantime
+		DeviceMap::iterator it = _devices.find(deviceId);
+		if (it != _devices.end())
+		{
+			expire(deviceId, it->second);
+			if (!it->second.pending.empty())
+			{
+				commands.assign(it->second.pending.begin(), it->second.pending.end());
+				return true;
+			}
+		}
+		long left = timeout - static_cast<long>(start.elapsed()/1000);
+		if (left <= 0 || !_changed.tryWait(_mutex, left)) return false;
+	}
+}
+
+
+CommandQueue::Status CommandQueue::wait(const std::string& deviceId, Poco::UInt32 id, long timeout)
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	Poco::Timestamp start;
+	for (;;)
+	{
+		DeviceMap::iterator it = _devices.find(deviceId);
+		if (it == _devices.end()) return STATUS_UNKNOWN;
+		expire(deviceId, it->second);
+		Status status = find(it->second, id);
+		if (status != STATUS_PENDING) return status;
+		long left = timeout - static_cast<long>(start.elapsed()/1000);
+		if (left <= 0 || !_changed.tryWait(_mutex, left)) return STATUS_PENDING;
+	}
+}
+
+
+std::string CommandQueue::status(Status status)
+{
+	switch (status)
+	{
+	case STATUS_PENDING: return "pending";
+	case STATUS_DONE:    return "done";
+	case STATUS_FAILED:  return "failed";
+	case STATUS_EXPIRED: return "expired";
+	default:             return "unknown";
+	}
+}
+
+
+std::string CommandQueue::format(const Commands& commands)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string body;
+	for (Commands::const_iterator it = commands.begin(); it != commands.end(); ++it)
+	{
+		body += Poco::NumberFormatter::format(it->id);
+		body += ' ';
+		for (std::string::const_iterator cit = it->data.begin(); cit != it->data.end(); ++cit)
+		{
+			unsigned char c = static_cast<unsigned char>(*cit);
+			body += digits[c >> 4];
+			body += digits[c & 0xF];
+		}
+		body += '\n';
+	}
+	return body;
+}
+
+
+std::string CommandQueue::authorization(const std::string& key, const std::string& deviceId, const std::string& sequence, const std::string& done, const std::string& failed)
+{
+	return "HMAC " + AEAD::toHex(AEAD::hmac(key, deviceId + "\n" + sequence + "\n" + done + "\n" + failed));
+}
+
+
+std::vector<Poco::UInt32> CommandQueue::parseIds(const std::string& ids)
+{
+	std::vector<Poco::UInt32> result;
+	Poco::StringTokenizer tokens(ids, ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = tokens.begin(); it != tokens.end(); ++it)
+	{
+		result.push_back(Poco::NumberParser::parseUnsigned(*it));
+	}
+	return result;
+}
+
+
+void CommandQueue::expire(const std::string& deviceId, Device& device)
+{
+	while (!device.pending.empty() && device.pending.front().queued.isElapsed(_expiry))
+	{
+		complete(deviceId, device, device.pending.front().id, STATUS_EXPIRED);
+	}
+}
+
+
+void CommandQueue::complete(const std::string& deviceId, Device& device, Poco::UInt32 id, Status status)
+{
+	for (std::deque<Command>::iterator it = device.pending.begin(); it != device.pending.end(); ++it)
+	{
+		if (it->id != id) continue;
+
+		Poco::Util::Application& app = Poco::Util::Application::instance();
+		std::string message("Command " + Poco::NumberFormatter::format(id) + " for " + deviceId + " " + this->status(status) +
+			" after " + Poco::NumberFormatter::format(static_cast<double>(it->queued.elapsed())/1000, 1) + " ms");
+		if (status == STATUS_DONE)
+			app.logger().information(message);
+		else
+			app.logger().warning(message);
+		device.pending.erase(it);
+		device.results.push_back(std::make_pair(id, status));
+		if (device.results.size() > MAX_RESULTS) device.results.pop_front();
+		return;
+	}
+}
+
+
+CommandQueue::Status CommandQueue::find(const Device& device, Poco::UInt32 id)
+{
+	for (std::deque<Command>::const_iterator it = device.pending.begin(); it != device.pending.end(); ++it)
+	{
+		if (it->id == id) return STATUS_PENDING;
+	}
+	for (std::deque<std::pair<Poco::UInt32, Status> >::const_reverse_iterator it = device.results.rbegin(); it != device.results.rend(); ++it)
+	{
+		if (it->first == id) return it->second;
+	}
+	return STATUS_UNKNOWN;
+}
@@ -0,0 +1,177 @@
+//
+// CommandQueue.h
+//
+// Definition of the CommandQueue class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef CommandQueue_INCLUDED
+#define CommandQueue_INCLUDED
+
+
+#include "Poco/Condition.h"
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+
+class CommandQueue
+	/// Queues the commands for the serial devices behind the clients,
+	/// such as a remote reset, per device, until the client has written
+	/// them to its serial port.
+	///
+	/// An operator queues a command, the bytes to write, with
+	///
+	///     POST /commands?device=<id>[&wait=<seconds>]
+	///     Authorization: Bearer <token>
+	///
+	/// which is answered with its X-Command-Id, and, with wait, when the
+	/// client has reported it or the wait is over, with its
+	/// X-Command-Status. A client long-polls
+	///
+	///     GET /commands?device=<id>&seq=<sequence>&done=<ids>&failed=<ids>&wait=<seconds>
+	///     Authorization: HMAC <hex>
+	///
+	/// reporting the commands it has written since the last poll, and
+	/// gets the pending commands as soon as there are any. The device
+	/// authenticates the poll with its psk key (see DeviceKeyStore):
+	/// the HMAC-SHA256 of "<id>\n<sequence>\n<done>\n<failed>", see
+	/// authorization(). The sequence is the time of the client in
+	/// milliseconds since the epoch, made to grow with every poll; a
+	/// poll is refused unless its sequence is higher than that of the
+	/// last poll of the device and within the maximum skew of the
+	/// server's time, so that it cannot be replayed. The response is:
+	///
+	///     X-Command-Epoch: <epoch>
+	///
+	///     <id> <bytes in hex>
+	///
+	/// A command is sent again until the client has reported it, so a
+	/// client must skip the ids of the epoch it has already written.
+	/// Commands not reported within the expiry time are dropped, so a
+	/// device that comes back online is not reset by a stale command.
+{
+public:
+	typedef Poco::SharedPtr<CommandQueue> Ptr;
+
+	enum Status
+	{
+		STATUS_PENDING,
+		STATUS_DONE,
+		STATUS_FAILED,
+		STATUS_EXPIRED,
+		STATUS_UNKNOWN
+	};
+
+	struct Command
+	{
+		Poco::UInt32 id;
+		std::string data;
+		Poco::Timestamp queued;
+	};
+
+	typedef std::vector<Command> Commands;
+
+	static const std::string PATH;
+		/// The path of the command channel, "/commands".
+
+	CommandQueue(std::size_t maxQueued, long expiry, long maxSkew = 300000);
+		/// Creates the CommandQueue, keeping at most maxQueued commands
+		/// per device for at most expiry milliseconds, and accepting
+		/// poll sequences up to maxSkew milliseconds from the time of
+		/// the server.
+
+	~CommandQueue();
+		/// Destroys the CommandQueue.
+
+	Poco::UInt32 enqueue(const std::string& deviceId, const std::string& data);
+		/// Queues a command for the device and wakes up its client.
+		/// Returns the id of the command. Throws a
+		/// Poco::IllegalStateException if the queue of the device is full.
+
+	bool fresh(const std::string& deviceId, Poco::UInt64 sequence);
+		/// Returns true, and records the sequence, if it is higher
+		/// than that of the last poll of the device and within the
+		/// maximum skew. Call it after the poll has been authenticated.
+
+	void report(const std::string& deviceId, const std::vector<Poco::UInt32>& done, const std::vector<Poco::UInt32>& failed);
+		/// Records the commands the client has written, or failed to
+		/// write, and wakes up the operators waiting for them.
+
+	bool poll(const std::string& deviceId, long timeout, Commands& commands);
+		/// Waits up to timeout milliseconds for commands for the device.
+		/// Returns false if there are none, otherwise fills them in.
+
+	Status wait(const std::string& deviceId, Poco::UInt32 id, long timeout);
+		/// Waits up to timeout milliseconds for the client to report the
+		/// command. Returns STATUS_PENDING if it has not.
+
+	const std::string& epoch() const;
+		/// Returns the epoch, which changes when the server restarts.
+
+	static std::string status(Status status);
+		/// Returns "pending", "done", "failed", "expired" or "unknown".
+
+	static std::string format(const Commands& commands);
+		/// Returns the body of a poll response.
+
+	static std::string authorization(const std::string& key, const std::string& deviceId, const std::string& sequence, const std::string& done, const std::string& failed);
+		/// Returns the Authorization header value of a poll, "HMAC "
+		/// and the hex HMAC-SHA256 with the key of the device.
+
+	static std::vector<Poco::UInt32> parseIds(const std::string& ids);
+		/// Parses a comma-separated list of ids. Throws a
+		/// Poco::SyntaxException if an id is not a number.
+
+private:
+	struct Device
+	{
+		Device();
+
+		Poco::UInt32 nextId;
+		Poco::UInt64 lastSequence;
+		std::deque<Command> pending;
+		std::deque<std::pair<Poco::UInt32, Status> > results;
+	};
+
+	enum
+	{
+		MAX_RESULTS = 64 /// results kept per device for waiting operators
+	};
+
+	typedef std::map<std::string, Device> DeviceMap;
+
+	void expire(const std::string& deviceId, Device& device);
+	void complete(const std::string& deviceId, Device& device, Poco::UInt32 id, Status status);
+	static Status find(const Device& device, Poco::UInt32 id);
+
+	CommandQueue(const CommandQueue&);
+	CommandQueue& operator = (const CommandQueue&);
+
+	std::string _epoch;
+	std::size_t _maxQueued;
+	Poco::Timestamp::TimeDiff _expiry;
+	Poco::Int64 _maxSkew;
+	DeviceMap _devices;
+	Poco::Mutex _mutex;
+	Poco::Condition _changed;
+};
+
+
+//
+// inlines
+//
+inline const std::string& CommandQueue::epoch() const
+{
+	return _epoch;
+}
+
+
+#endif // CommandQueue_INCLUDED
@@ -0,0 +1,189 @@
+//
+// ConfigStore.cpp
+//
+// Implementation of the ConfigStore class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ConfigStore.h"
+#include "Poco/Exception.h"
+#include "Poco/File.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/String.h"
+#include "Poco/Util/Application.h"
+#include <fstream>
+
+
+const std::string ConfigStore::PATH("/config");
+
+
+ConfigStore::ConfigStore(const std::string& path):
+	_path(path),
+	_epoch(Poco::NumberFormatter::formatHex(static_cast<Poco::UInt64>(Poco::Timestamp().epochMicroseconds()))),
+	_modified(0),
+	_version(1)
+{
+	reload();
+}
+
+
+ConfigStore::~ConfigStore()
+{
+	_timer.stop();
+}
+
+
+void ConfigStore::watch(long interval)
+{
+	_timer.setStartInterval(interval);
+	_timer.setPeriodicInterval(interval);
+	_timer.start(Poco::TimerCallback<ConfigStore>(*this, &ConfigStore::onTimer));
+}
+
+
+bool ConfigStore::reload()
+{
+	Poco::File file(_path);
+	if (!file.exists()) return false;
+	Poco::Timestamp modified(file.getLastModified());
+	if (modified == _modified) return false;
+
+	std::ifstream istr(_path.c_str());
+	if (!istr) throw Poco::OpenFileException(_path);
+	Map values(parse(istr));
+	_modified = modified;
+	Poco::UInt32 version = this->version();
+	set(values);
+	return this->version() != version;
+}
+
+
+void ConfigStore::set(const Map& values)
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	Change change;
+	for (Map::const_iterator it = values.begin(); it != values.end(); ++it)
+	{
+		Map::const_iterator old = _values.find(it->first);
+		if (old == _values.end() || old->second != it->second)
+			change.set.insert(*it);
+	}
+	for (Map::const_iterator it = _values.begin(); it != _values.end(); ++it)
+	{
+		if (values.find(it->first) == values.end())
+			change.removed.insert(it->first);
+	}
+	if (change.set.empty() && change.removed.empty()) return;
+
+	change.version = ++_version;
+	_changes.push_back(change);
+	if (_changes.size() > MAX_CHANGES) _changes.pop_front();
+	_values = values;
+	_changed.broadcast();
+}
+
+
+Poco::UInt32 ConfigStore::version() const
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	return _version;
+}
+
+
+bool ConfigStore::poll(const std::string& epoch, Poco::UInt32 version, long timeout, Update& update)
+{
+	Poco::Mutex::ScopedLock lock(_mutex);
+	Poco::Timestamp start;
+	while (epoch == _epoch && version == _version)
+	{
+		long left = timeout - static_cast<long>(start.elapsed()/1000);
+		if (left <= 0 || !_changed.tryWait(_mutex, left)) return false;
+	}
+	update.epoch = _epoch;
+	update.version = _version;
+	update.body = format(epoch == _epoch ? version : 0, update.full);
+	return true;
+}
+
+
+ConfigStore::Map ConfigStore::parse(std::istream& istr)
+{
+	Map values;
+	std::string line;
+	int number = 0;
+	while (std::getline(istr, line))
+	{
+		++number;
+		Poco::trimInPlace(line);
+		if (line.empty() || line[0] == '#' || line[0] == '!') continue;
+		std::string::size_type eq = line.find('=');
+		if (eq == std::string::npos)
+			throw Poco::SyntaxException("Missing '=' in configuration line", Poco::NumberFormatter::format(number));
+		std::string key(Poco::trim(line.substr(0, eq)));
+		std::string value(Poco::trim(line.substr(eq + 1)));
+		// the push format has one "key=value" or "-key" per line
+		if (key.empty() || key[0] == '-' || key.find_first_of("=\r") != std::string::npos || value.find('\r') != std::string::npos)
+			throw Poco::SyntaxException("Invalid configuration line", Poco::NumberFormatter::format(number));
+		values[key] = value;
+	}
+	return values;
+}
+
+
+void ConfigStore::onTimer(Poco::Timer& timer)
+{
+	Poco::Util::Application& app = Poco::Util::Application::instance();
+	try
+	{
+		if (reload())
+			app.logger().information("Client configuration version " + Poco::NumberFormatter::format(version()) + " from " + _path);
+	}
+	catch (Poco::Exception& exc)
+	{
+		app.logger().error("Client configuration not changed: " + exc.displayText());
+	}
+}
+
+
+std::string ConfigStore::format(Poco::UInt32 version, bool& full) const
+{
+	// the changes since the client's version, if they are all kept
+	full = version == 0 || version > _version || _changes.empty() || version + 1 < _changes.front().version;
+	std::string body;
+	if (full)
+	{
+		for (Map::const_iterator it = _values.begin(); it != _values.end(); ++it)
+		{
+			body += it->first + "=" + it->second + "\n";
+		}
+		return body;
+	}
+
+	Map set;
+	std::set<std::string> removed;
+	for (std::deque<Change>::const_iterator it = _changes.begin(); it != _changes.end(); ++it)
+	{
+		if (it->version <= version) continue;
+		for (Map::const_iterator sit = it->set.begin(); sit != it->set.end(); ++sit)
+		{
+			set[sit->first] = sit->second;
+			removed.erase(sit->first);
+		}
+		for (std::set<std::string>::const_iterator rit = it->removed.begin(); rit != it->removed.end(); ++rit)
+		{
+			set.erase(*rit);
+			removed.insert(*rit);
+		}
+	}
+	for (Map::const_iterator it = set.begin(); it != set.end(); ++it)
+	{
+		body += it->first + "=" + it->second + "\n";
+	}
+	for (std::set<std::string>::const_iterator it = removed.begin(); it != removed.end(); ++it)
+	{
+		body += "-" + *it + "\n";
+	}
+	return body;
+}
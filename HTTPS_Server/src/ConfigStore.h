@@ -0,0 +1,136 @@
+//
+// ConfigStore.h
+//
+// Definition of the ConfigStore class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ConfigStore_INCLUDED
+#define ConfigStore_INCLUDED
+
+
+#include "Poco/Condition.h"
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Timer.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+
+
+class ConfigStore
+	/// Holds the configuration pushed to the clients, read from a file of
+	/// "key = value" lines, and the changes between its versions.
+	///
+	/// Every change of the file makes a new version. A client long-polls
+	///
+	///     GET /config?epoch=<epoch>&version=<version>&wait=<seconds>
+	///
+	/// with the epoch and version it has, and gets the changes since that
+	/// version as soon as there are any:
+	///
+	///     X-Config-Epoch: <epoch>
+	///     X-Config-Version: <version>
+	///     X-Config-Delta: <the client's version, or "full">
+	///
+	///     key=value
+	///     -removed.key
+	///
+	/// A full update, with all keys, is sent if the client has no version
+	/// yet, the server was restarted since (the epoch differs), or the
+	/// version is older than the changes kept.
+{
+public:
+	typedef Poco::SharedPtr<ConfigStore> Ptr;
+	typedef std::map<std::string, std::string> Map;
+
+	struct Update
+	{
+		std::string epoch;
+		Poco::UInt32 version;
+		bool full;
+		std::string body;
+	};
+
+	static const std::string PATH;
+		/// The path of the push channel, "/config".
+
+	explicit ConfigStore(const std::string& path);
+		/// Creates the ConfigStore and reads the file, if it exists.
+
+	~ConfigStore();
+		/// Stops watching the file and destroys the ConfigStore.
+
+	void watch(long interval);
+		/// Checks the file for changes every interval milliseconds.
+
+	bool reload();
+		/// Reads the file if it was modified. Returns true if this made
+		/// a new version. A file that cannot be parsed is logged and
+		/// ignored.
+
+	void set(const Map& values);
+		/// Replaces the configuration, making a new version if it
+		/// differs from the current one, and wakes up the waiting
+		/// clients.
+
+	const std::string& epoch() const;
+		/// Returns the epoch, which changes when the server restarts.
+
+	Poco::UInt32 version() const;
+		/// Returns the current version.
+
+	bool poll(const std::string& epoch, Poco::UInt32 version, long timeout, Update& update);
+		/// Waits up to timeout milliseconds for a newer version than the
+		/// client's. Returns false if there is none, otherwise fills in
+		/// the update.
+
+	static Map parse(std::istream& istr);
+		/// Parses "key = value" lines. Blank lines and lines starting
+		/// with '#' or '!' are skipped. Throws a Poco::SyntaxException
+		/// if a line has no '=', or a key or value contains characters
+		/// the push format cannot carry.
+
+private:
+	struct Change
+	{
+		Poco::UInt32 version;
+		Map set;
+		std::set<std::string> removed;
+	};
+
+	enum
+	{
+		MAX_CHANGES = 64
+	};
+
+	void onTimer(Poco::Timer& timer);
+	std::string format(Poco::UInt32 version, bool& full) const;
+
+	std::string _path;
+	std::string _epoch;
+	Poco::Timestamp _modified;
+	Poco::UInt32 _version;
+	Map _values;
+	std::deque<Change> _changes;
+	mutable Poco::Mutex _mutex;
+	Poco::Condition _changed;
+	Poco::Timer _timer;
+};
+
+
+//
+// inlines
+//
+inline const std::string& ConfigStore::epoch() const
+{
+	return _epoch;
+}
+
+
+#endif // ConfigStore_INCLUDED
@@ -0,0 +1,55 @@
+//
+// DeviceKeyStore.cpp
+//
+// Implementation of the DeviceKeyStore class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "DeviceKeyStore.h"
+#include "AEAD.h"
+#include "Poco/Exception.h"
+
+
+DeviceKeyStore::DeviceKeyStore(const std::string& masterKey, long cacheSize):
+	_masterKey(masterKey),
+	_cache(cacheSize)
+{
+	if (_masterKey.size() != AEAD::KEY_SIZE) throw Poco::InvalidArgumentException("Master key must be 32 bytes");
+}
+
+
+DeviceKeyStore::~DeviceKeyStore()
+{
+}
+
+
+std::string DeviceKeyStore::key(const std::string& deviceId)
+{
+	Poco::SharedPtr<std::string> pKey = _cache.get(deviceId);
+	if (pKey) return *pKey;
+
+	std::string derived(deriveKey(_masterKey, deviceId));
+	_cache.add(deviceId, derived);
+	return derived;
+}
+
+
+std::string DeviceKeyStore::encrypt(const std::string& deviceId, const std::string& message)
+{
+	return AEAD::seal(key(deviceId), message, deviceId);
+}
+
+
+std::string DeviceKeyStore::decrypt(const std::string& deviceId, const std::string& data)
+{
+	return AEAD::open(key(deviceId), data, deviceId);
+}
+
+
+std::string DeviceKeyStore::deriveKey(const std::string& masterKey, const std::string& deviceId)
+{
+	if (deviceId.empty()) throw Poco::InvalidArgumentException("Empty device id");
+	return AEAD::hkdf(masterKey, "device-key", deviceId);
+}
@@ -0,0 +1,68 @@
+//
+// DeviceKeyStore.h
+//
+// Definition of the DeviceKeyStore class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef DeviceKeyStore_INCLUDED
+#define DeviceKeyStore_INCLUDED
+
+
+#include "Poco/LRUCache.h"
+#include "Poco/SharedPtr.h"
+#include <string>
+
+
+class DeviceKeyStore
+	/// Per-device symmetric keys for devices that can be provisioned
+	/// with a secret ("psk" mode).
+	///
+	/// Every device key is derived from a single master key as
+	///
+	///     key = HKDF-SHA256(master, salt = "device-key", info = device id)
+	///
+	/// so the server stores no per-device state. Derived keys are kept
+	/// in a bounded LRU cache, a miss costs one HKDF (two HMACs). The
+	/// device id is also bound to each message as AEAD associated data,
+	/// so a message cannot be replayed under another device's id.
+	///
+	/// A DeviceKeyStore can be shared between threads.
+{
+public:
+	typedef Poco::SharedPtr<DeviceKeyStore> Ptr;
+
+	DeviceKeyStore(const std::string& masterKey, long cacheSize = 10000);
+		/// Creates the DeviceKeyStore for the given 32-byte master key.
+
+	~DeviceKeyStore();
+		/// Destroys the DeviceKeyStore.
+
+	std::string key(const std::string& deviceId);
+		/// Returns the key of the given device, deriving it if it
+		/// is not cached.
+
+	std::string encrypt(const std::string& deviceId, const std::string& message);
+		/// Encrypts message as the given device would.
+
+	std::string decrypt(const std::string& deviceId, const std::string& data);
+		/// Decrypts a message sent by the given device.
+		///
+		/// Throws a Poco::DataFormatException if the message was not
+		/// sealed with that device's key.
+
+	static std::string deriveKey(const std::string& masterKey, const std::string& deviceId);
+		/// Derives the key to provision on the given device.
+
+private:
+	DeviceKeyStore(const DeviceKeyStore&);
+	DeviceKeyStore& operator = (const DeviceKeyStore&);
+
+	std::string _masterKey;
+	Poco::LRUCache<std::string, std::string> _cache;
+};
+
+
+#endif // DeviceKeyStore_INCLUDED
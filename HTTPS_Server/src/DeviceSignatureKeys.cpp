@@ -0,0 +1,50 @@
+//
+// DeviceSignatureKeys.cpp
+//
+// Implementation of the DeviceSignatureKeys class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "DeviceSignatureKeys.h"
+#include "Poco/Path.h"
+#include "Poco/File.h"
+#include "Poco/Ascii.h"
+#include "Poco/Exception.h"
+
+
+DeviceSignatureKeys::DeviceSignatureKeys(const std::string& directory):
+	_directory(directory)
+{
+}
+
+
+DeviceSignatureKeys::~DeviceSignatureKeys()
+{
+}
+
+
+ECDSAKey::Ptr DeviceSignatureKeys::key(const std::string& deviceId)
+{
+	if (deviceId.empty()) throw Poco::InvalidArgumentException("Empty device id");
+	for (std::string::const_iterator it = deviceId.begin(); it != deviceId.end(); ++it)
+	{
+		if (!Poco::Ascii::isAlphaNumeric(*it) && *it != '-' && *it != '_')
+			throw Poco::InvalidArgumentException("Invalid device id", deviceId);
+	}
+
+	Poco::FastMutex::ScopedLock lock(_mutex);
+
+	KeyMap::iterator it = _keys.find(deviceId);
+	if (it != _keys.end()) return it->second;
+
+	Poco::Path path(_directory);
+	path.makeDirectory();
+	path.setFileName(deviceId + ".pem");
+	if (!Poco::File(path).exists()) throw Poco::NotFoundException("No signing key for device", deviceId);
+
+	ECDSAKey::Ptr pKey = new ECDSAKey(path.toString());
+	_keys[deviceId] = pKey;
+	return pKey;
+}
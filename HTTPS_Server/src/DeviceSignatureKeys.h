@@ -0,0 +1,53 @@
+//
+// DeviceSignatureKeys.h
+//
+// Definition of the DeviceSignatureKeys class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef DeviceSignatureKeys_INCLUDED
+#define DeviceSignatureKeys_INCLUDED
+
+
+#include "SignedBatch.h"
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include <map>
+#include <string>
+
+
+class DeviceSignatureKeys
+	/// The public signing keys of the devices using "sign" mode,
+	/// stored as <directory>/<device id>.pem. Keys are loaded on first
+	/// use and kept in memory.
+	///
+	/// A DeviceSignatureKeys can be shared between threads.
+{
+public:
+	typedef Poco::SharedPtr<DeviceSignatureKeys> Ptr;
+
+	explicit DeviceSignatureKeys(const std::string& directory);
+		/// Creates the DeviceSignatureKeys for the given key directory.
+
+	~DeviceSignatureKeys();
+		/// Destroys the DeviceSignatureKeys.
+
+	ECDSAKey::Ptr key(const std::string& deviceId);
+		/// Returns the public key of the given device.
+		///
+		/// Throws a Poco::NotFoundException if the device has no key
+		/// and a Poco::InvalidArgumentException if the device id
+		/// contains characters other than letters, digits, '-' and '_'.
+
+private:
+	typedef std::map<std::string, ECDSAKey::Ptr> KeyMap;
+
+	std::string _directory;
+	KeyMap _keys;
+	Poco::FastMutex _mutex;
+};
+
+
+#endif // DeviceSignatureKeys_INCLUDED
@@ -0,0 +1,178 @@
+//
+// FastIngestRequest.cpp
+//
+// Implementation of the FastIngestRequest class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "FastIngestRequest.h"
+#include <cstring>
+
+
+namespace
+{
+	const char REQUEST_LINE[] = "POST / HTTP/1.";
+	const std::size_t REQUEST_LINE_LENGTH = sizeof(REQUEST_LINE) - 1;
+
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+}
+
+
+FastIngestRequest::FastIngestRequest():
+	_headerLength(0),
+	_contentLength(0),
+	_seen(0),
+	_mode(IngestPipeline::MODE_RSA),
+	_deviceId(0),
+	_deviceIdLength(0),
+	_sequence(0),
+	_sequenceLength(0),
+	_keepAlive(false)
+{
+}
+
+
+FastIngestRequest::~FastIngestRequest()
+{
+}
+
+
+FastIngestRequest::Result FastIngestRequest::parse(const char* buffer, std::size_t length)
+{
+	_headerLength = findHeaderEnd(buffer, length);
+	if (_headerLength == 0) return RESULT_INCOMPLETE;
+
+	_contentLength = 0;
+	_seen = 0;
+	_mode = IngestPipeline::MODE_RSA;
+	_deviceId = 0;
+	_deviceIdLength = 0;
+	_sequence = 0;
+	_sequenceLength = 0;
+
+	const char* p = buffer;
+	const char* end = buffer + _headerLength;
+	while (*p == '\r' || *p == '\n') ++p;
+
+	if (static_cast<std::size_t>(end - p) < REQUEST_LINE_LENGTH + 2 || std::memcmp(p, REQUEST_LINE, REQUEST_LINE_LENGTH) != 0)
+		return RESULT_FALLBACK;
+	p += REQUEST_LINE_LENGTH;
+	if (*p != '0' && *p != '1') return RESULT_FALLBACK;
+	_keepAlive = *p++ == '1';
+	if (*p == '\r') ++p;
+	if (*p++ != '\n') return RESULT_FALLBACK;
+
+	for (;;)
+	{
+		// the head ends with a line feed, so every line has one
+		const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		const char* lineEnd = eol;
+		if (lineEnd > p && lineEnd[-1] == '\r') --lineEnd;
+		if (lineEnd == p) break;
+		if (isBlank(*p)) return RESULT_FALLBACK; // obsolete line folding
+
+		const char* colon = static_cast<const char*>(std::memchr(p, ':', lineEnd - p));
+		if (!colon || colon == p || isBlank(colon[-1])) return RESULT_FALLBACK;
+		const char* value = colon + 1;
+		while (value < lineEnd && isBlank(*value)) ++value;
+		const char* valueEnd = lineEnd;
+		while (valueEnd > value && isBlank(valueEnd[-1])) --valueEnd;
+
+		if (!parseHeader(p, colon - p, value, valueEnd - value)) return RESULT_FALLBACK;
+		p = eol + 1;
+	}
+	return (_seen & SEEN_CONTENT_LENGTH) ? RESULT_OK : RESULT_FALLBACK;
+}
+
+
+std::size_t FastIngestRequest::findHeaderEnd(const char* buffer, std::size_t length)
+{
+	const char* p = buffer;
+	const char* end = buffer + length;
+	while (p < end && (*p == '\r' || *p == '\n')) ++p;
+	while (p < end)
+	{
+		const char* eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		if (!eol) return 0;
+		p = eol + 1;
+		if (p < end && *p == '\n')
+			return p + 1 - buffer;
+		if (p + 1 < end && p[0] == '\r' && p[1] == '\n')
+			return p + 2 - buffer;
+	}
+	return 0;
+}
+
+
+bool FastIngestRequest::parseHeader(const char* name, std::size_t nameLength, const char* value, std::size_t valueLength)
+{
+	if (equalsIgnoreCase(name, nameLength, "Content-Length"))
+	{
+		// at most 7 digits, which is enough for MAX_CONTENT_LENGTH
+		if ((_seen & SEEN_CONTENT_LENGTH) || valueLength == 0 || valueLength > 7) return false;
+		std::size_t n = 0;
+		for (std::size_t i = 0; i < valueLength; ++i)
+		{
+			if (value[i] < '0' || value[i] > '9') return false;
+			n = 10*n + (value[i] - '0');
+		}
+		if (n > MAX_CONTENT_LENGTH) return false;
+		_contentLength = n;
+		_seen |= SEEN_CONTENT_LENGTH;
+	}
+	else if (equalsIgnoreCase(name, nameLength, "X-Encryption"))
+	{
+		if (_seen & SEEN_ENCRYPTION) return false;
+		_mode = IngestPipeline::mode(value, valueLength);
+		_seen |= SEEN_ENCRYPTION;
+	}
+	else if (equalsIgnoreCase(name, nameLength, "X-Device-Id"))
+	{
+		if ((_seen & SEEN_DEVICE_ID) || valueLength > MAX_DEVICE_ID_LENGTH) return false;
+		_deviceId = value;
+		_deviceIdLength = valueLength;
+		_seen |= SEEN_DEVICE_ID;
+	}
+	else if (equalsIgnoreCase(name, nameLength, "X-Sequence"))
+	{
+		if ((_seen & SEEN_SEQUENCE) || valueLength > MAX_SEQUENCE_LENGTH) return false;
+		_sequence = value;
+		_sequenceLength = valueLength;
+		_seen |= SEEN_SEQUENCE;
+	}
+	else if (equalsIgnoreCase(name, nameLength, "Connection"))
+	{
+		if (_seen & SEEN_CONNECTION) return false;
+		if (equalsIgnoreCase(value, valueLength, "close"))
+			_keepAlive = false;
+		else if (equalsIgnoreCase(value, valueLength, "keep-alive"))
+			_keepAlive = true;
+		else
+			return false;
+		_seen |= SEEN_CONNECTION;
+	}
+	else if (equalsIgnoreCase(name, nameLength, "Transfer-Encoding") || equalsIgnoreCase(name, nameLength, "Expect"))
+	{
+		return false;
+	}
+	return true;
+}
+
+
+bool FastIngestRequest::equalsIgnoreCase(const char* s, std::size_t length, const char* literal)
+{
+	for (std::size_t i = 0; i < length; ++i, ++literal)
+	{
+		char c = s[i];
+		if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+		char l = *literal;
+		if (l >= 'A' && l <= 'Z') l += 'a' - 'A';
+		if (c != l || l == 0) return false;
+	}
+	return *literal == 0;
+}
@@ -0,0 +1,174 @@
+//
+// FastIngestRequest.h
+//
+// Definition of the FastIngestRequest class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef FastIngestRequest_INCLUDED
+#define FastIngestRequest_INCLUDED
+
+
+#include "IngestPipeline.h"
+#include <cstddef>
+
+
+class FastIngestRequest
+	/// The head of an HTTP/1.x ingest request, parsed in place from a
+	/// connection's receive buffer without allocating memory.
+	///
+	/// Only what the ingest endpoint needs is looked at: the request
+	/// line, which must be "POST / HTTP/1.0" or "POST / HTTP/1.1", and
+	/// the Content-Length, X-Encryption, X-Device-Id, X-Sequence and
+	/// Connection headers. Other headers are skipped. The device id
+	/// and sequence point into the buffer and are valid as long as
+	/// it is.
+	///
+	/// Anything the fast path does not handle (other methods or paths,
+	/// a missing Content-Length, Transfer-Encoding, Expect, folded or
+	/// malformed header lines, repeated or oversized values) makes
+	/// parse() return RESULT_FALLBACK, and the request must then be
+	/// parsed by Poco::Net::HTTPRequest. Malformed requests are left to
+	/// the full parser to reject.
+{
+public:
+	enum Result
+	{
+		RESULT_INCOMPLETE,
+			/// The blank line ending the head has not been received yet.
+		RESULT_OK,
+			/// The request can be served by the fast path.
+		RESULT_FALLBACK
+			/// The head is complete, but needs the full parser.
+	};
+
+	enum
+	{
+		MAX_DEVICE_ID_LENGTH = 64,
+		MAX_SEQUENCE_LENGTH  = 20,
+		MAX_CONTENT_LENGTH   = 1048576
+	};
+
+	FastIngestRequest();
+		/// Creates an empty FastIngestRequest.
+
+	~FastIngestRequest();
+		/// Destroys the FastIngestRequest.
+
+	Result parse(const char* buffer, std::size_t length);
+		/// Parses the request head at the start of the buffer. Empty
+		/// lines before the request line are skipped. Unless the result
+		/// is RESULT_INCOMPLETE, headerLength() is the number of bytes
+		/// up to and including the blank line.
+
+	std::size_t headerLength() const;
+		/// Returns the length of the head, including skipped empty
+		/// lines and the blank line.
+
+	std::size_t contentLength() const;
+		/// Returns the Content-Length.
+
+	IngestPipeline::Mode mode() const;
+		/// Returns the mode selected by X-Encryption (RSA without it).
+
+	const char* deviceId() const;
+		/// Returns the X-Device-Id value.
+
+	std::size_t deviceIdLength() const;
+		/// Returns the length of the X-Device-Id value, 0 if there is none.
+
+	const char* sequence() const;
+		/// Returns the X-Sequence value.
+
+	std::size_t sequenceLength() const;
+		/// Returns the length of the X-Sequence value, 0 if there is none.
+
+	bool keepAlive() const;
+		/// Returns true if the connection stays open after the response:
+		/// for HTTP/1.1 unless "Connection: close" was sent, for HTTP/1.0
+		/// only with "Connection: keep-alive".
+
+	static std::size_t findHeaderEnd(const char* buffer, std::size_t length);
+		/// Returns the length of the head at the start of the buffer
+		/// (up to and including the blank line), or 0 if the blank line
+		/// is not in the buffer.
+
+private:
+	enum Seen
+	{
+		SEEN_CONTENT_LENGTH = 0x01,
+		SEEN_ENCRYPTION     = 0x02,
+		SEEN_DEVICE_ID      = 0x04,
+		SEEN_SEQUENCE       = 0x08,
+		SEEN_CONNECTION     = 0x10
+	};
+
+	bool parseHeader(const char* name, std::size_t nameLength, const char* value, std::size_t valueLength);
+	static bool equalsIgnoreCase(const char* s, std::size_t length, const char* literal);
+
+	std::size_t _headerLength;
+	std::size_t _contentLength;
+	int _seen;
+	IngestPipeline::Mode _mode;
+	const char* _deviceId;
+	std::size_t _deviceIdLength;
+	const char* _sequence;
+	std::size_t _sequenceLength;
+	bool _keepAlive;
+};
+
+
+//
+// inlines
+//
+inline std::size_t FastIngestRequest::headerLength() const
+{
+	return _headerLength;
+}
+
+
+inline std::size_t FastIngestRequest::contentLength() const
+{
+	return _contentLength;
+}
+
+
+inline IngestPipeline::Mode FastIngestRequest::mode() const
+{
+	return _mode;
+}
+
+
+inline const char* FastIngestRequest::deviceId() const
+{
+	return _deviceId;
+}
+
+
+inline std::size_t FastIngestRequest::deviceIdLength() const
+{
+	return _deviceIdLength;
+}
+
+
+inline const char* FastIngestRequest::sequence() const
+{
+	return _sequence;
+}
+
+
+inline std::size_t FastIngestRequest::sequenceLength() const
+{
+	return _sequenceLength;
+}
+
+
+inline bool FastIngestRequest::keepAlive() const
+{
+	return _keepAlive;
+}
+
+
+#endif // FastIngestRequest_INCLUDED
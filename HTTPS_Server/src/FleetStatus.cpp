@@ -0,0 +1,200 @@
+//
+// FleetStatus.cpp
+//
+// Implementation of the FleetStatus class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "FleetStatus.h"
+#include "Poco/DateTimeFormat.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/NumberParser.h"
+#include <algorithm>
+
+
+const std::string FleetStatus::PATH("/status");
+
+
+FleetStatus::FleetStatus(long interval, std::size_t maxDevices):
+	_epoch(Poco::NumberFormatter::formatHex(static_cast<Poco::UInt64>(Poco::Timestamp().epochMicroseconds()))),
+	_interval(static_cast<Poco::Timestamp::TimeDiff>(interval)*1000),
+	_made(0),
+	_maxDevices(maxDevices > 0 ? maxDevices : 1),
+	_evicted(false),
+	_evictedVersion(0)
+{
+	_pSnapshot = new Snapshot;
+	_pSnapshot->version = 1;
+	_pSnapshot->etag = "\"" + _epoch + "-1\"";
+	_pSnapshot->body = format(1, 0, "");
+}
+
+
+FleetStatus::~FleetStatus()
+{
+}
+
+
+void FleetStatus::update(const std::string& deviceId, const std::string& sequence, const Poco::Net::SocketAddress& clientAddress)
+{
+	std::string id(deviceId.empty() ? clientAddress.host().toString() : deviceId);
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	DeviceMap::iterator it = _devices.find(id);
+	if (it == _devices.end())
+	{
+		if (_devices.size() >= _maxDevices) evict();
+		Device device;
+		device.messages = 0;
+		device.version = 0;
+		device.changed = false;
+		it = _devices.insert(DeviceMap::value_type(id, device)).first;
+	}
+	Device& device = it->second;
+	device.address = clientAddress.toString();
+	if (!sequence.empty() && newer(sequence, device.sequence)) device.sequence = sequence;
+	device.lastSeen.update();
+	++device.messages;
+	if (!device.changed)
+	{
+		device.changed = true;
+		_changed.push_back(it);
+	}
+}
+
+
+FleetStatus::SnapshotPtr FleetStatus::snapshot()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	refresh();
+	return _pSnapshot;
+}
+
+
+bool FleetStatus::delta(const std::string& epoch, Poco::UInt32 since, Snapshot& delta)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	refresh();
+	if (epoch != _epoch || since > _pSnapshot->version || since < _evictedVersion) return false;
+
+	std::string devices;
+	for (DeviceMap::const_iterator it = _devices.begin(); it != _devices.end(); ++it)
+	{
+		if (it->second.version <= since) continue;
+		if (!devices.empty()) devices += ',';
+		devices += it->second.json;
+	}
+	delta.version = _pSnapshot->version;
+	delta.etag = _pSnapshot->etag;
+	delta.body = format(_pSnapshot->version, since, devices);
+	return true;
+}
+
+
+void FleetStatus::refresh()
+{
+	if (_changed.empty() || _made.elapsed() < _interval) return;
+
+	// only the changed entries are serialized again, the others are
+	// copied from the previous snapshot
+	Poco::UInt32 version = _pSnapshot->version + 1;
+	for (std::vector<DeviceMap::iterator>::iterator it = _changed.begin(); it != _changed.end(); ++it)
+	{
+		Device& device = (*it)->second;
+		device.version = version;
+		device.changed = false;
+		device.json = "{\"id\":" + quote((*it)->first) +
+		              ",\"address\":" + quote(device.address) +
+		              ",\"lastSeen\":\"" + Poco::DateTimeFormatter::format(device.lastSeen, Poco::DateTimeFormat::ISO8601_FORMAT) +
+		              "\",\"messages\":" + Poco::NumberFormatter::format(device.messages) +
+		              ",\"sequence\":" + quote(device.sequence) + "}";
+	}
+	_changed.clear();
+	if (_evicted)
+	{
+		// the dashboards that ask for a delta must reload the table to
+		// lose the devices dropped
+		_evictedVersion = version;
+		_evicted = false;
+	}
+
+	std::string devices;
+	devices.reserve(_pSnapshot->body.size() + 256);
+	for (DeviceMap::const_iterator it = _devices.begin(); it != _devices.end(); ++it)
+	{
+		if (!devices.empty()) devices += ',';
+		devices += it->second.json;
+	}
+	// the dashboards may still be sending the previous snapshot
+	SnapshotPtr pSnapshot = new Snapshot;
+	pSnapshot->version = version;
+	pSnapshot->etag = "\"" + _epoch + "-" + Poco::NumberFormatter::format(version) + "\"";
+	pSnapshot->body = format(version, 0, devices);
+	_pSnapshot = pSnapshot;
+	_made.update();
+}
+
+
+void FleetStatus::evict()
+{
+	DeviceMap::iterator oldest = _devices.begin();
+	for (DeviceMap::iterator it = _devices.begin(); it != _devices.end(); ++it)
+	{
+		if (it->second.lastSeen < oldest->second.lastSeen) oldest = it;
+	}
+	if (oldest == _devices.end()) return;
+	if (oldest->second.changed)
+		_changed.erase(std::find(_changed.begin(), _changed.end(), oldest));
+	_devices.erase(oldest);
+	_evicted = true;
+}
+
+
+bool FleetStatus::newer(const std::string& sequence, const std::string& last)
+{
+	// uploads sent in parallel arrive out of order, so a lower
+	// sequence is an older message, unless it is so much lower that
+	// the device has restarted its numbering
+	Poco::UInt64 value;
+	Poco::UInt64 lastValue;
+	if (!Poco::NumberParser::tryParseUnsigned64(sequence, value) || !Poco::NumberParser::tryParseUnsigned64(last, lastValue))
+		return true;
+	return value > lastValue || lastValue - value > REORDER_WINDOW;
+}
+
+
+std::string FleetStatus::format(Poco::UInt32 version, Poco::UInt32 since, const std::string& devices) const
+{
+	std::string body("{\"epoch\":\"" + _epoch + "\",\"version\":" + Poco::NumberFormatter::format(version));
+	if (since != 0) body += ",\"since\":" + Poco::NumberFormatter::format(since);
+	body += ",\"devices\":[";
+	body += devices;
+	body += "]}";
+	return body;
+}
+
+
+std::string FleetStatus::quote(const std::string& value)
+{
+	std::string s("\"");
+	for (std::string::const_iterator it = value.begin(); it != value.end(); ++it)
+	{
+		unsigned char c = static_cast<unsigned char>(*it);
+		if (c == '"' || c == '\\')
+		{
+			s += '\\';
+			s += *it;
+		}
+		else if (c < 0x20)
+		{
+			s += "\\u00";
+			s += "0123456789abcdef"[c >> 4];
+			s += "0123456789abcdef"[c & 0xF];
+		}
+		else s += *it;
+	}
+	s += '"';
+	return s;
+}
@@ -0,0 +1,155 @@
+//
+// FleetStatus.h
+//
+// Definition of the FleetStatus class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef FleetStatus_INCLUDED
+#define FleetStatus_INCLUDED
+
+
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <map>
+#include <string>
+#include <vector>
+
+
+class FleetStatus
+	/// The device table for the dashboards: for every device, the
+	/// client address and time of its last message, the highest
+	/// sequence received and the number of messages.
+	///
+	/// Uploads sent over several connections arrive out of order, so
+	/// a sequence lower than the highest by at most REORDER_WINDOW
+	/// does not replace it; a larger step back means that the device
+	/// has restarted and is taken. Sequences that are not numbers are
+	/// kept as they arrive.
+	///
+	/// The table holds at most maxDevices entries; a new device beyond
+	/// that takes the place of the one that has been silent longest.
+	/// The devices are keyed by an id that the caller has verified,
+	/// or by the client host, so this only matters when many hosts
+	/// send, but it bounds the memory they can take.
+	///
+	/// The table is served as a pre-serialized JSON snapshot,
+	///
+	///     GET /status[?epoch=<epoch>&since=<version>]
+	///
+	///     ETag: "<epoch>-<version>"
+	///     X-Status-Epoch: <epoch>
+	///     X-Status-Version: <version>
+	///     X-Status-Delta: <since, or "full">
+	///
+	///     {"epoch":"...","version":7,"devices":[{"id":"...",...},...]}
+	///
+	/// so that polling dashboards cost a copy of the snapshot, or a 304
+	/// Not Modified if their If-None-Match has its ETag. A new snapshot
+	/// is made only when a device has changed, and at most once per
+	/// interval; only the entries of the devices that changed are
+	/// serialized again. With since, only the devices that changed
+	/// after that version are sent, with "since" in the body; the
+	/// whole table is sent if the server was restarted since (the
+	/// epoch differs), since is newer than the current version, or a
+	/// device has been dropped from the table after since.
+{
+public:
+	typedef Poco::SharedPtr<FleetStatus> Ptr;
+
+	struct Snapshot
+	{
+		Poco::UInt32 version;
+		std::string etag;
+		std::string body;
+	};
+
+	typedef Poco::SharedPtr<Snapshot> SnapshotPtr;
+
+	enum
+	{
+		REORDER_WINDOW      = 1024,
+		DEFAULT_MAX_DEVICES = 100000
+	};
+
+	static const std::string PATH;
+		/// The path of the status endpoint, "/status".
+
+	explicit FleetStatus(long interval, std::size_t maxDevices = DEFAULT_MAX_DEVICES);
+		/// Creates the FleetStatus, making a new snapshot at most every
+		/// interval milliseconds, with at most maxDevices devices.
+
+	~FleetStatus();
+		/// Destroys the FleetStatus.
+
+	void update(const std::string& deviceId, const std::string& sequence, const Poco::Net::SocketAddress& clientAddress);
+		/// Records a message of a device. deviceId must have been
+		/// verified; devices without one are recorded under the host of
+		/// their address. Only marks the device as changed, so it is
+		/// cheap on the ingest path, unless the table is full.
+
+	SnapshotPtr snapshot();
+		/// Returns the current snapshot, made anew if a device has
+		/// changed and the interval has passed.
+
+	bool delta(const std::string& epoch, Poco::UInt32 since, Snapshot& delta);
+		/// Fills in the devices that changed after the given version,
+		/// as of the current snapshot. Returns false if the whole table
+		/// must be sent instead.
+
+	const std::string& epoch() const;
+		/// Returns the epoch, which changes when the server restarts.
+
+	static std::string quote(const std::string& value);
+		/// Returns the value as a JSON string.
+
+private:
+	struct Device
+	{
+		std::string address;
+		std::string sequence;
+		Poco::Timestamp lastSeen;
+		Poco::UInt64 messages;
+		Poco::UInt32 version;  /// of the snapshot with the last change
+		std::string json;      /// the entry in that snapshot
+		bool changed;
+	};
+
+	typedef std::map<std::string, Device> DeviceMap;
+
+	void refresh();
+	void evict();
+	static bool newer(const std::string& sequence, const std::string& last);
+	std::string format(Poco::UInt32 version, Poco::UInt32 since, const std::string& devices) const;
+
+	FleetStatus(const FleetStatus&);
+	FleetStatus& operator = (const FleetStatus&);
+
+	std::string _epoch;
+	Poco::Timestamp::TimeDiff _interval;
+	Poco::Timestamp _made;
+	std::size_t _maxDevices;
+	DeviceMap _devices;
+	std::vector<DeviceMap::iterator> _changed;
+	SnapshotPtr _pSnapshot;
+	bool _evicted;
+	Poco::UInt32 _evictedVersion;
+	Poco::FastMutex _mutex;
+};
+
+
+//
+// inlines
+//
+inline const std::string& FleetStatus::epoch() const
+{
+	return _epoch;
+}
+
+
+#endif // FleetStatus_INCLUDED
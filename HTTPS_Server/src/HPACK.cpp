@@ -0,0 +1,536 @@
+//
+// HPACK.cpp
+//
+// Implementation of the HPACKEncoder and HPACKDecoder classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "HPACK.h"
+#include "Poco/Exception.h"
+#include "Poco/Types.h"
+
+
+namespace
+{
+	const char* staticTable[HPACKTable::STATIC_ENTRIES][2] =
+		/// RFC 7541, Appendix A.
+	{
+		{":authority", ""},
+		{":method", "GET"},
+		{":method", "POST"},
+		{":path", "/"},
+		{":path", "/index.html"},
+		{":scheme", "http"},
+		{":scheme", "https"},
+		{":status", "200"},
+		{":status", "204"},
+		{":status", "206"},
+		{":status", "304"},
+		{":status", "400"},
+		{":status", "404"},
+		{":status", "500"},
+		{"accept-charset", ""},
+		{"accept-encoding", "gzip, deflate"},
+		{"accept-language", ""},
+		{"accept-ranges", ""},
+		{"accept", ""},
+		{"access-control-allow-origin", ""},
+		{"age", ""},
+		{"allow", ""},
+		{"authorization", ""},
+		{"cache-control", ""},
+		{"content-disposition", ""},
+		{"content-encoding", ""},
+		{"content-language", ""},
+		{"content-length", ""},
+		{"content-location", ""},
+		{"content-range", ""},
+		{"content-type", ""},
+		{"cookie", ""},
+		{"date", ""},
+		{"etag", ""},
+		{"expect", ""},
+		{"expires", ""},
+		{"from", ""},
+		{"host", ""},
+		{"if-match", ""},
+		{"if-modified-since", ""},
+		{"if-none-match", ""},
+		{"if-range", ""},
+		{"if-unmodified-since", ""},
+		{"last-modified", ""},
+		{"link", ""},
+		{"location", ""},
+		{"max-forwards", ""},
+		{"proxy-authenticate", ""},
+		{"proxy-authorization", ""},
+		{"range", ""},
+		{"referer", ""},
+		{"refresh", ""},
+		{"retry-after", ""},
+		{"server", ""},
+		{"set-cookie", ""},
+		{"strict-transport-security", ""},
+		{"transfer-encoding", ""},
+		{"user-agent", ""},
+		{"vary", ""},
+		{"via", ""},
+		{"www-authenticate", ""}
+	};
+
+	const unsigned huffmanCodes[256] =
+		/// RFC 7541, Appendix B; EOS (256) is 0x3fffffff/30.
+	{
+		0x00001ff8, 0x007fffd8, 0x0fffffe2, 0x0fffffe3, 0x0fffffe4, 0x0fffffe5, 0x0fffffe6, 0x0fffffe7,
+		0x0fffffe8, 0x00ffffea, 0x3ffffffc, 0x0fffffe9, 0x0fffffea, 0x3ffffffd, 0x0fffffeb, 0x0fffffec,
+		0x0fffffed, 0x0fffffee, 0x0fffffef, 0x0ffffff0, 0x0ffffff1, 0x0ffffff2, 0x3ffffffe, 0x0ffffff3,
+		0x0ffffff4, 0x0ffffff5, 0x0ffffff6, 0x0ffffff7, 0x0ffffff8, 0x0ffffff9, 0x0ffffffa, 0x0ffffffb,
+		0x00000014, 0x000003f8, 0x000003f9, 0x00000ffa, 0x00001ff9, 0x00000015, 0x000000f8, 0x000007fa,
+		0x000003fa, 0x000003fb, 0x000000f9, 0x000007fb, 0x000000fa, 0x00000016, 0x00000017, 0x00000018,
+		0x00000000, 0x00000001, 0x00000002, 0x00000019, 0x0000001a, 0x0000001b, 0x0000001c, 0x0000001d,
+		0x0000001e, 0x0000001f, 0x0000005c, 0x000000fb, 0x00007ffc, 0x00000020, 0x00000ffb, 0x000003fc,
+		0x00001ffa, 0x00000021, 0x0000005d, 0x0000005e, 0x0000005f, 0x00000060, 0x00000061, 0x00000062,
+		0x00000063, 0x00000064, 0x00000065, 0x00000066, 0x00000067, 0x00000068, 0x00000069, 0x0000006a,
+		0x0000006b, 0x0000006c, 0x0000006d, 0x0000006e, 0x0000006f, 0x00000070, 0x00000071, 0x00000072,
+		0x000000fc, 0x00000073, 0x000000fd, 0x00001ffb, 0x0007fff0, 0x00001ffc, 0x00003ffc, 0x00000022,
+		0x00007ffd, 0x00000003, 0x00000023, 0x00000004, 0x00000024, 0x00000005, 0x00000025, 0x00000026,
+		0x00000027, 0x00000006, 0x00000074, 0x00000075, 0x00000028, 0x00000029, 0x0000002a, 0x00000007,
+		0x0000002b, 0x00000076, 0x0000002c, 0x00000008, 0x00000009, 0x0000002d, 0x00000077, 0x00000078,
+		0x00000079, 0x0000007a, 0x0000007b, 0x00007ffe, 0x000007fc, 0x00003ffd, 0x00001ffd, 0x0ffffffc,
+		0x000fffe6, 0x003fffd2, 0x000fffe7, 0x000fffe8, 0x003fffd3, 0x003fffd4, 0x003fffd5, 0x007fffd9,
+		0x003fffd6, 0x007fffda, 0x007fffdb, 0x007fffdc, 0x007fffdd, 0x007fffde, 0x00ffffeb, 0x007fffdf,
+		0x00ffffec, 0x00ffffed, 0x003fffd7, 0x007fffe0, 0x00ffffee, 0x007fffe1, 0x007fffe2, 0x007fffe3,
+		0x007fffe4, 0x001fffdc, 0x003fffd8, 0x007fffe5, 0x003fffd9, 0x007fffe6, 0x007fffe7, 0x00ffffef,
+		0x003fffda, 0x001fffdd, 0x000fffe9, 0x003fffdb, 0x003fffdc, 0x007fffe8, 0x007fffe9, 0x001fffde,
+		0x007fffea, 0x003fffdd, 0x003fffde, 0x00fffff0, 0x001fffdf, 0x003fffdf, 0x007fffeb, 0x007fffec,
+		0x001fffe0, 0x001fffe1, 0x003fffe0, 0x001fffe2, 0x007fffed, 0x003fffe1, 0x007fffee, 0x007fffef,
+		0x000fffea, 0x003fffe2, 0x003fffe3, 0x003fffe4, 0x007ffff0, 0x003fffe5, 0x003fffe6, 0x007ffff1,
+		0x03ffffe0, 0x03ffffe1, 0x000fffeb, 0x0007fff1, 0x003fffe7, 0x007ffff2, 0x003fffe8, 0x01ffffec,
+		0x03ffffe2, 0x03ffffe3, 0x03ffffe4, 0x07ffffde, 0x07ffffdf, 0x03ffffe5, 0x00fffff1, 0x01ffffed,
+		0x0007fff2, 0x001fffe3, 0x03ffffe6, 0x07ffffe0, 0x07ffffe1, 0x03ffffe7, 0x07ffffe2, 0x00fffff2,
+		0x001fffe4, 0x001fffe5, 0x03ffffe8, 0x03ffffe9, 0x0ffffffd, 0x07ffffe3, 0x07ffffe4, 0x07ffffe5,
+		0x000fffec, 0x00fffff3, 0x000fffed, 0x001fffe6, 0x003fffe9, 0x001fffe7, 0x001fffe8, 0x007ffff3,
+		0x003fffea, 0x003fffeb, 0x01ffffee, 0x01ffffef, 0x00fffff4, 0x00fffff5, 0x03ffffea, 0x007ffff4,
+		0x03ffffeb, 0x07ffffe6, 0x03ffffec, 0x03ffffed, 0x07ffffe7, 0x07ffffe8, 0x07ffffe9, 0x07ffffea,
+		0x07ffffeb, 0x0ffffffe, 0x07ffffec, 0x07ffffed, 0x07ffffee, 0x07ffffef, 0x07fffff0, 0x03ffffee
+	};
+
+	const unsigned char huffmanLengths[256] =
+	{
+		13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+		28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+		 6, 10, 10, 12, 13,  6,  8, 11, 10, 10,  8, 11,  8,  6,  6,  6,
+		 5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  7,  8, 15,  6, 12, 10,
+		13,  6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,
+		 7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  8, 13, 19, 13, 14,  6,
+		15,  5,  6,  5,  6,  5,  6,  6,  6,  5,  7,  7,  6,  6,  6,  5,
+		 6,  7,  6,  5,  5,  6,  7,  7,  7,  7,  7, 15, 11, 14, 13, 28,
+		20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+		24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+		22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+		21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+		26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+		19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+		20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+		26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26
+	};
+
+	class HuffmanTree
+		/// Binary decoding tree for the Huffman code, built once.
+	{
+	public:
+		enum
+		{
+			EOS = 256,
+			NONE = -1
+		};
+
+		HuffmanTree(): _count(1)
+		{
+			node(0);
+			for (int sym = 0; sym < 256; ++sym)
+			{
+				insert(huffmanCodes[sym], huffmanLengths[sym], sym);
+			}
+			insert(0x3fffffff, 30, EOS);
+		}
+
+		int child(int n, int bit) const
+		{
+			return _nodes[n].child[bit];
+		}
+
+		int symbol(int n) const
+		{
+			return _nodes[n].symbol;
+		}
+
+	private:
+		struct Node
+		{
+			int child[2];
+			int symbol;
+		};
+
+		void node(int n)
+		{
+			_nodes[n].child[0] = _nodes[n].child[1] = NONE;
+			_nodes[n].symbol = NONE;
+		}
+
+		void insert(unsigned code, int length, int sym)
+		{
+			int n = 0;
+			for (int i = length - 1; i >= 0; --i)
+			{
+				int bit = (code >> i) & 1;
+				if (_nodes[n].child[bit] == NONE)
+				{
+					node(_count);
+					_nodes[n].child[bit] = _count++;
+				}
+				n = _nodes[n].child[bit];
+			}
+			_nodes[n].symbol = sym;
+		}
+
+		Node _nodes[2*257];
+		int _count;
+	};
+
+	const HuffmanTree huffmanTree;
+
+	HPACKHeaderList makeStaticHeaders()
+	{
+		HPACKHeaderList headers;
+		for (int i = 0; i < HPACKTable::STATIC_ENTRIES; ++i)
+		{
+			headers.push_back(HPACKHeader(staticTable[i][0], staticTable[i][1]));
+		}
+		return headers;
+	}
+
+	const HPACKHeaderList staticHeaders(makeStaticHeaders());
+
+	std::string huffmanDecode(const std::string& in)
+	{
+		std::string out;
+		int n = 0;
+		int depth = 0;      // bits consumed since the last symbol
+		bool allOnes = true;
+		for (std::string::const_iterator it = in.begin(); it != in.end(); ++it)
+		{
+			unsigned char c = static_cast<unsigned char>(*it);
+			for (int i = 7; i >= 0; --i)
+			{
+				int bit = (c >> i) & 1;
+				n = huffmanTree.child(n, bit);
+				if (n == HuffmanTree::NONE) throw Poco::DataFormatException("Invalid Huffman code");
+				++depth;
+				allOnes = allOnes && bit;
+				int sym = huffmanTree.symbol(n);
+				if (sym == HuffmanTree::EOS) throw Poco::DataFormatException("EOS in Huffman string");
+				if (sym != HuffmanTree::NONE)
+				{
+					out += static_cast<char>(sym);
+					n = 0;
+					depth = 0;
+					allOnes = true;
+				}
+			}
+		}
+		if (depth > 7 || !allOnes) throw Poco::DataFormatException("Invalid Huffman padding");
+		return out;
+	}
+
+	std::size_t huffmanLength(const std::string& in)
+	{
+		std::size_t bits = 0;
+		for (std::string::const_iterator it = in.begin(); it != in.end(); ++it)
+		{
+			bits += huffmanLengths[static_cast<unsigned char>(*it)];
+		}
+		return (bits + 7)/8;
+	}
+
+	void huffmanEncode(const std::string& in, std::string& out)
+	{
+		Poco::UInt64 acc = 0;
+		int bits = 0;
+		for (std::string::const_iterator it = in.begin(); it != in.end(); ++it)
+		{
+			unsigned char c = static_cast<unsigned char>(*it);
+			acc = (acc << huffmanLengths[c]) | huffmanCodes[c];
+			bits += huffmanLengths[c];
+			while (bits >= 8)
+			{
+				bits -= 8;
+				out += static_cast<char>(acc >> bits);
+			}
+		}
+		if (bits > 0)
+			out += static_cast<char>((acc << (8 - bits)) | (0xff >> bits));
+	}
+
+	void encodeInteger(std::string& out, unsigned char flags, int prefixBits, std::size_t value)
+	{
+		std::size_t max = (1u << prefixBits) - 1;
+		if (value < max)
+		{
+			out += static_cast<char>(flags | value);
+			return;
+		}
+		out += static_cast<char>(flags | max);
+		value -= max;
+		while (value >= 128)
+		{
+			out += static_cast<char>((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += static_cast<char>(value);
+	}
+
+	void encodeString(std::string& out, const std::string& s)
+	{
+		std::size_t hlen = huffmanLength(s);
+		if (hlen < s.size())
+		{
+			encodeInteger(out, 0x80, 7, hlen);
+			huffmanEncode(s, out);
+		}
+		else
+		{
+			encodeInteger(out, 0, 7, s.size());
+			out += s;
+		}
+	}
+
+	std::size_t decodeInteger(const std::string& in, std::size_t& pos, int prefixBits)
+	{
+		if (pos >= in.size()) throw Poco::DataFormatException("Truncated HPACK integer");
+		std::size_t max = (1u << prefixBits) - 1;
+		std::size_t value = static_cast<unsigned char>(in[pos++]) & max;
+		if (value < max) return value;
+		for (int shift = 0; ; shift += 7)
+		{
+			if (pos >= in.size()) throw Poco::DataFormatException("Truncated HPACK integer");
+			if (shift > 21) throw Poco::DataFormatException("HPACK integer too large");
+			unsigned char c = static_cast<unsigned char>(in[pos++]);
+			value += static_cast<std::size_t>(c & 0x7f) << shift;
+			if (!(c & 0x80)) return value;
+		}
+	}
+
+	std::string decodeString(const std::string& in, std::size_t& pos)
+	{
+		if (pos >= in.size()) throw Poco::DataFormatException("Truncated HPACK string");
+		bool huffman = (in[pos] & 0x80) != 0;
+		std::size_t length = decodeInteger(in, pos, 7);
+		if (length > in.size() - pos) throw Poco::DataFormatException("Truncated HPACK string");
+		std::string s(in, pos, length);
+		pos += length;
+		return huffman ? huffmanDecode(s) : s;
+	}
+}
+
+
+//
+// HPACKTable
+//
+
+
+HPACKTable::HPACKTable(std::size_t maxSize):
+	_size(0),
+	_maxSize(maxSize)
+{
+}
+
+
+HPACKTable::~HPACKTable()
+{
+}
+
+
+const HPACKHeader& HPACKTable::get(std::size_t index) const
+{
+	if (index == 0) throw Poco::DataFormatException("HPACK index 0");
+	if (index <= STATIC_ENTRIES) return staticHeaders[index - 1];
+	index -= STATIC_ENTRIES + 1;
+	if (index >= _entries.size()) throw Poco::DataFormatException("HPACK index out of range");
+	return _entries[index];
+}
+
+
+std::size_t HPACKTable::find(const std::string& name, const std::string& value, bool& valueMatches) const
+{
+	std::size_t nameIndex = 0;
+	valueMatches = false;
+	for (std::size_t i = 0; i < STATIC_ENTRIES; ++i)
+	{
+		if (staticHeaders[i].first == name)
+		{
+			if (staticHeaders[i].second == value)
+			{
+				valueMatches = true;
+				return i + 1;
+			}
+			if (!nameIndex) nameIndex = i + 1;
+		}
+	}
+	for (std::size_t i = 0; i < _entries.size(); ++i)
+	{
+		if (_entries[i].first == name)
+		{
+			if (_entries[i].second == value)
+			{
+				valueMatches = true;
+				return i + STATIC_ENTRIES + 1;
+			}
+			if (!nameIndex) nameIndex = i + STATIC_ENTRIES + 1;
+		}
+	}
+	return nameIndex;
+}
+
+
+void HPACKTable::add(const std::string& name, const std::string& value)
+{
+	std::size_t entrySize = name.size() + value.size() + ENTRY_OVERHEAD;
+	if (entrySize > _maxSize)
+	{
+		// an entry larger than the table empties it (RFC 7541, 4.4)
+		_entries.clear();
+		_size = 0;
+		return;
+	}
+	_entries.push_front(HPACKHeader(name, value));
+	_size += entrySize;
+	evict();
+}
+
+
+void HPACKTable::setMaxSize(std::size_t maxSize)
+{
+	_maxSize = maxSize;
+	evict();
+}
+
+
+void HPACKTable::evict()
+{
+	while (_size > _maxSize && !_entries.empty())
+	{
+		_size -= _entries.back().first.size() + _entries.back().second.size() + ENTRY_OVERHEAD;
+		_entries.pop_back();
+	}
+}
+
+
+//
+// HPACKEncoder
+//
+
+
+HPACKEncoder::HPACKEncoder(std::size_t tableSize):
+	_table(tableSize),
+	_sizeUpdatePending(tableSize != HPACKTable::DEFAULT_SIZE)
+{
+}
+
+
+HPACKEncoder::~HPACKEncoder()
+{
+}
+
+
+std::string HPACKEncoder::encode(const HPACKHeaderList& headers)
+{
+	std::string out;
+	if (_sizeUpdatePending)
+	{
+		encodeInteger(out, 0x20, 5, _table.maxSize());
+		_sizeUpdatePending = false;
+	}
+	for (HPACKHeaderList::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		bool valueMatches;
+		std::size_t index = _table.find(it->first, it->second, valueMatches);
+		if (valueMatches)
+		{
+			encodeInteger(out, 0x80, 7, index);
+			continue;
+		}
+		encodeInteger(out, 0x40, 6, index);
+		if (!index) encodeString(out, it->first);
+		encodeString(out, it->second);
+		_table.add(it->first, it->second);
+	}
+	return out;
+}
+
+
+void HPACKEncoder::setTableSize(std::size_t tableSize)
+{
+	if (tableSize == _table.maxSize()) return;
+	_table.setMaxSize(tableSize);
+	_sizeUpdatePending = true;
+}
+
+
+//
+// HPACKDecoder
+//
+
+
+HPACKDecoder::HPACKDecoder(std::size_t tableSize, std::size_t maxHeaderListSize):
+	_table(tableSize),
+	_tableSizeLimit(tableSize),
+	_maxHeaderListSize(maxHeaderListSize)
+{
+}
+
+
+HPACKDecoder::~HPACKDecoder()
+{
+}
+
+
+void HPACKDecoder::decode(const std::string& block, HPACKHeaderList& headers)
+{
+	std::size_t listSize = 0;
+	std::size_t pos = 0;
+	bool headerSeen = false;
+	while (pos < block.size())
+	{
+		unsigned char c = static_cast<unsigned char>(block[pos]);
+		if ((c & 0xe0) == 0x20)
+		{
+			// dynamic table size update, only allowed before the first header
+			if (headerSeen) throw Poco::DataFormatException("HPACK table size update after header");
+			std::size_t size = decodeInteger(block, pos, 5);
+			if (size > _tableSizeLimit) throw Poco::DataFormatException("HPACK table size update exceeds limit");
+			_table.setMaxSize(size);
+			continue;
+		}
+
+		HPACKHeader header;
+		if (c & 0x80)
+		{
+			header = _table.get(decodeInteger(block, pos, 7));
+		}
+		else
+		{
+			bool index = (c & 0x40) != 0;
+			std::size_t nameIndex = decodeInteger(block, pos, index ? 6 : 4);
+			header.first = nameIndex ? _table.get(nameIndex).first : decodeString(block, pos);
+			header.second = decodeString(block, pos);
+			if (index) _table.add(header.first, header.second);
+		}
+		headerSeen = true;
+		listSize += header.first.size() + header.second.size() + HPACKTable::ENTRY_OVERHEAD;
+		if (listSize > _maxHeaderListSize) throw Poco::DataFormatException("HPACK header list too large");
+		headers.push_back(header);
+	}
+}
@@ -0,0 +1,138 @@
+//
+// HPACK.h
+//
+// Definition of the HPACKEncoder and HPACKDecoder classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef HPACK_INCLUDED
+#define HPACK_INCLUDED
+
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+typedef std::pair<std::string, std::string> HPACKHeader;
+typedef std::vector<HPACKHeader> HPACKHeaderList;
+
+
+class HPACKTable
+	/// The HPACK (RFC 7541) header table: the 61 entry static table
+	/// followed by the dynamic table of one direction of a connection.
+{
+public:
+	enum
+	{
+		STATIC_ENTRIES  = 61,
+		ENTRY_OVERHEAD  = 32,
+		DEFAULT_SIZE    = 4096
+	};
+
+	explicit HPACKTable(std::size_t maxSize = DEFAULT_SIZE);
+		/// Creates an empty dynamic table with the given maximum size.
+
+	~HPACKTable();
+		/// Destroys the HPACKTable.
+
+	const HPACKHeader& get(std::size_t index) const;
+		/// Returns the entry with the given 1-based index.
+		///
+		/// Throws a Poco::DataFormatException if there is no such entry.
+
+	std::size_t find(const std::string& name, const std::string& value, bool& valueMatches) const;
+		/// Returns the index of the entry with the given name and value,
+		/// or of an entry with the given name, or 0 if there is neither.
+
+	void add(const std::string& name, const std::string& value);
+		/// Inserts an entry at the front of the dynamic table, evicting
+		/// old entries to stay within the maximum size.
+
+	void setMaxSize(std::size_t maxSize);
+		/// Sets the maximum size, evicting entries as necessary.
+
+	std::size_t maxSize() const;
+		/// Returns the maximum size.
+
+private:
+	void evict();
+
+	std::deque<HPACKHeader> _entries;
+	std::size_t _size;
+	std::size_t _maxSize;
+};
+
+
+class HPACKEncoder
+	/// Encodes header lists into HPACK header blocks.
+	///
+	/// Headers found in the table are sent as an index, others as a
+	/// literal that is added to the dynamic table, so headers repeated
+	/// on every request of a connection cost one or two bytes after
+	/// the first request. String literals are Huffman coded if that
+	/// makes them shorter.
+{
+public:
+	explicit HPACKEncoder(std::size_t tableSize = HPACKTable::DEFAULT_SIZE);
+		/// Creates the HPACKEncoder. tableSize must not exceed the
+		/// peer's SETTINGS_HEADER_TABLE_SIZE.
+
+	~HPACKEncoder();
+		/// Destroys the HPACKEncoder.
+
+	std::string encode(const HPACKHeaderList& headers);
+		/// Returns the header block for the given headers. Names must
+		/// be lower case.
+
+	void setTableSize(std::size_t tableSize);
+		/// Changes the dynamic table size, for instance after the peer
+		/// lowered SETTINGS_HEADER_TABLE_SIZE. The next header block
+		/// starts with the size update.
+
+private:
+	HPACKTable _table;
+	bool _sizeUpdatePending;
+};
+
+
+class HPACKDecoder
+	/// Decodes HPACK header blocks.
+{
+public:
+	explicit HPACKDecoder(std::size_t tableSize = HPACKTable::DEFAULT_SIZE, std::size_t maxHeaderListSize = 65536);
+		/// Creates the HPACKDecoder. tableSize is the
+		/// SETTINGS_HEADER_TABLE_SIZE announced to the peer.
+		/// Header blocks decoding to more than maxHeaderListSize bytes
+		/// (counted as in SETTINGS_MAX_HEADER_LIST_SIZE) are rejected.
+
+	~HPACKDecoder();
+		/// Destroys the HPACKDecoder.
+
+	void decode(const std::string& block, HPACKHeaderList& headers);
+		/// Decodes a complete header block and appends the headers.
+		///
+		/// Throws a Poco::DataFormatException if the block is malformed.
+		/// The decoder state is then undefined and the connection must
+		/// be closed with a COMPRESSION_ERROR.
+
+private:
+	HPACKTable _table;
+	std::size_t _tableSizeLimit;
+	std::size_t _maxHeaderListSize;
+};
+
+
+//
+// inlines
+//
+inline std::size_t HPACKTable::maxSize() const
+{
+	return _maxSize;
+}
+
+
+#endif // HPACK_INCLUDED
@@ -0,0 +1,313 @@
+//
+// Http1ServerSession.cpp
+//
+// Implementation of the Http1ServerSession class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "Http1ServerSession.h"
+#include "BufferedServerRequest.h"
+#include "Poco/Net/HTTPRequestHandler.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/DateTimeFormat.h"
+#include "Poco/NumberParser.h"
+#include "Poco/Timestamp.h"
+#include "Poco/String.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Exception.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+
+Http1ServerSession::Http1ServerSession(const Poco::Net::StreamSocket& socket, Poco::Net::HTTPServerParams::Ptr pParams, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, IngestPipeline::Ptr pPipeline):
+	_socket(socket),
+	_pParams(pParams),
+	_pFactory(pFactory),
+	_pPipeline(pPipeline),
+	_clientAddress(_socket.peerAddress()),
+	_buffer(BUFFER_SIZE),
+	_begin(0),
+	_end(0),
+	_dateTime(0)
+{
+}
+
+
+Http1ServerSession::~Http1ServerSession()
+{
+}
+
+
+void Http1ServerSession::run()
+{
+	FastIngestRequest request;
+	int maxRequests = _pParams->getMaxKeepAliveRequests();
+	int requests = 0;
+	try
+	{
+		for (;;)
+		{
+			FastIngestRequest::Result result = receiveHead(request);
+			if (result == FastIngestRequest::RESULT_INCOMPLETE) break;
+			++requests;
+			bool keepAlive = _pParams->getKeepAlive() && (maxRequests <= 0 || requests < maxRequests);
+			if (result == FastIngestRequest::RESULT_OK && _pPipeline)
+				keepAlive = serveFast(request, keepAlive);
+			else
+				keepAlive = serveFallback(request.headerLength(), keepAlive);
+			if (!keepAlive) break;
+			_socket.setReceiveTimeout(_pParams->getKeepAliveTimeout());
+		}
+	}
+	catch (Poco::Net::MessageException&)
+	{
+		try
+		{
+			sendStatus(Poco::Net::HTTPResponse::HTTP_BAD_REQUEST);
+		}
+		catch (Poco::Exception&)
+		{
+		}
+	}
+	catch (Poco::Net::NetException&)
+	{
+	}
+	catch (Poco::TimeoutException&)
+	{
+	}
+}
+
+
+FastIngestRequest::Result Http1ServerSession::receiveHead(FastIngestRequest& request)
+{
+	FastIngestRequest::Result result;
+	while ((result = request.parse(&_buffer[0] + _begin, _end - _begin)) == FastIngestRequest::RESULT_INCOMPLETE)
+	{
+		compact();
+		if (_end == _buffer.size()) throw Poco::Net::MessageException("Request head too long");
+		if (!receive()) break;
+	}
+	return result;
+}
+
+
+bool Http1ServerSession::receive()
+{
+	int n = _socket.receiveBytes(&_buffer[0] + _end, static_cast<int>(_buffer.size() - _end));
+	if (n <= 0) return false;
+	_end += n;
+	return true;
+}
+
+
+void Http1ServerSession::compact()
+{
+	if (_begin > 0)
+	{
+		std::memmove(&_buffer[0], &_buffer[0] + _begin, _end - _begin);
+		_end -= _begin;
+		_begin = 0;
+	}
+}
+
+
+void Http1ServerSession::appendBody(std::size_t length, std::string& body)
+{
+	for (;;)
+	{
+		std::size_t n = std::min(length, _end - _begin);
+		body.append(&_buffer[0] + _begin, n);
+		_begin += n;
+		length -= n;
+		if (length == 0) break;
+		_begin = _end = 0;
+		if (!receive()) throw Poco::Net::MessageException("Unexpected end of request body");
+	}
+}
+
+
+bool Http1ServerSession::readChunkedBody(std::string& body)
+{
+	std::string line;
+	for (;;)
+	{
+		readLine(line);
+		unsigned size = 0;
+		if (!Poco::NumberParser::tryParseHex(Poco::trim(line.substr(0, line.find(';'))), size))
+			throw Poco::Net::MessageException("Invalid chunk size");
+		if (size == 0) break;
+		if (body.size() + size > MAX_BODY_SIZE) return false;
+		appendBody(size, body);
+		readLine(line);
+		if (!line.empty()) throw Poco::Net::MessageException("Missing chunk terminator");
+	}
+	do
+	{
+		readLine(line); // trailers are ignored
+	}
+	while (!line.empty());
+	return true;
+}
+
+
+void Http1ServerSession::readLine(std::string& line)
+{
+	for (;;)
+	{
+		const char* begin = &_buffer[0] + _begin;
+		const char* eol = static_cast<const char*>(std::memchr(begin, '\n', _end - _begin));
+		if (eol)
+		{
+			std::size_t n = eol - begin;
+			line.assign(begin, (n > 0 && eol[-1] == '\r') ? n - 1 : n);
+			_begin += n + 1;
+			return;
+		}
+		compact();
+		if (_end == _buffer.size()) throw Poco::Net::MessageException("Chunk header too long");
+		if (!receive()) throw Poco::Net::MessageException("Unexpected end of chunked body");
+	}
+}
+
+
+bool Http1ServerSession::serveFast(const FastIngestRequest& request, bool keepAlive)
+{
+	// the device id and sequence point into the buffer, which
+	// receiving the body may overwrite
+	_deviceId.assign(request.deviceId(), request.deviceIdLength());
+	_sequence.assign(request.sequence(), request.sequenceLength());
+	_begin += request.headerLength();
+	_body.clear();
+	appendBody(request.contentLength(), _body);
+
+	keepAlive = keepAlive && request.keepAlive();
+	try
+	{
+		_pPipeline->process(request.mode(), _deviceId, _sequence, _body, _clientAddress, &_socket);
+	}
+	catch (Poco::InvalidAccessException& exc)
+	{
+		sendAck(Poco::Net::HTTPResponse::HTTP_BAD_REQUEST, exc.message(), "", keepAlive);
+		return keepAlive;
+	}
+	catch (Poco::Net::NetException&)
+	{
+		throw;
+	}
+	catch (Poco::Exception&)
+	{
+		sendAck(Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR, Poco::Net::HTTPResponse::HTTP_REASON_INTERNAL_SERVER_ERROR, "", false);
+		return false;
+	}
+	sendAck(Poco::Net::HTTPResponse::HTTP_OK, Poco::Net::HTTPResponse::HTTP_REASON_OK, IngestPipeline::ACKNOWLEDGEMENT, keepAlive);
+	return keepAlive;
+}
+
+
+bool Http1ServerSession::serveFallback(std::size_t headerLength, bool keepAlive)
+{
+	std::istringstream head(std::string(&_buffer[0] + _begin, headerLength));
+	_begin += headerLength;
+
+	BufferedServerResponse response;
+	BufferedServerRequest request(_socket, *_pParams, response);
+	request.read(head);
+	response.setDate(Poco::Timestamp());
+	response.setVersion(request.getVersion());
+	response.setKeepAlive(keepAlive && request.getKeepAlive());
+	if (!_pParams->getServerName().empty())
+		response.set("Server", _pParams->getServerName());
+
+	bool expectContinue = request.getVersion() == Poco::Net::HTTPMessage::HTTP_1_1 && Poco::icompare(request.get("Expect", ""), "100-continue") == 0;
+	std::string body;
+	if (request.getChunkedTransferEncoding())
+	{
+		if (expectContinue) ResponseBuilder::sendAll(_socket, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+		if (!readChunkedBody(body))
+		{
+			sendStatus(Poco::Net::HTTPResponse::HTTP_REQUESTENTITYTOOLARGE);
+			return false;
+		}
+	}
+	else if (request.hasContentLength())
+	{
+		if (request.getContentLength64() > MAX_BODY_SIZE)
+		{
+			sendStatus(Poco::Net::HTTPResponse::HTTP_REQUESTENTITYTOOLARGE);
+			return false;
+		}
+		if (expectContinue) ResponseBuilder::sendAll(_socket, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+		appendBody(static_cast<std::size_t>(request.getContentLength64()), body);
+	}
+	request.setBody(body);
+
+	Poco::SharedPtr<Poco::Net::HTTPRequestHandler> pHandler(_pFactory->createRequestHandler(request));
+	if (pHandler.isNull())
+	{
+		sendStatus(Poco::Net::HTTPResponse::HTTP_NOT_IMPLEMENTED);
+		return false;
+	}
+	try
+	{
+		pHandler->handleRequest(request, response);
+	}
+	catch (Poco::Net::NetException&)
+	{
+		throw;
+	}
+	catch (Poco::Exception&)
+	{
+		sendStatus(Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+		return false;
+	}
+
+	// the body is written from the response's buffer, not copied
+	const std::string& responseBody = response.body();
+	response.setContentLength(static_cast<std::streamsize>(responseBody.size()));
+	_response.start(response);
+	if (request.getMethod() == Poco::Net::HTTPRequest::HTTP_HEAD)
+		_response.send(_socket);
+	else
+		_response.send(_socket, responseBody);
+	return response.getKeepAlive();
+}
+
+
+void Http1ServerSession::sendAck(Poco::Net::HTTPResponse::HTTPStatus status, const std::string& reason, const std::string& body, bool keepAlive)
+{
+	_response.start(status, reason);
+	_response.header("Date", date());
+	if (!_pParams->getServerName().empty())
+		_response.header("Server", _pParams->getServerName());
+	_response.header("Content-Length", body.size());
+	_response.header("Connection", keepAlive ? "Keep-Alive" : "close");
+	_response.body(body);
+	_response.send(_socket);
+}
+
+
+void Http1ServerSession::sendStatus(Poco::Net::HTTPResponse::HTTPStatus status)
+{
+	Poco::Net::HTTPResponse response(Poco::Net::HTTPMessage::HTTP_1_1, status);
+	response.setDate(Poco::Timestamp());
+	response.setContentLength(0);
+	response.setKeepAlive(false);
+	_response.start(response);
+	_response.send(_socket);
+}
+
+
+const std::string& Http1ServerSession::date()
+{
+	Poco::Timestamp now;
+	if (now.epochTime() != _dateTime)
+	{
+		_date = Poco::DateTimeFormatter::format(now, Poco::DateTimeFormat::HTTP_FORMAT);
+		_dateTime = now.epochTime();
+	}
+	return _date;
+}
@@ -0,0 +1,99 @@
+//
+// Http1ServerSession.h
+//
+// Definition of the Http1ServerSession class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef Http1ServerSession_INCLUDED
+#define Http1ServerSession_INCLUDED
+
+
+#include "IngestPipeline.h"
+#include "FastIngestRequest.h"
+#include "ResponseBuilder.h"
+#include "Poco/Net/StreamSocket.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/HTTPServerParams.h"
+#include "Poco/Net/HTTPRequestHandlerFactory.h"
+#include <ctime>
+#include <string>
+#include <vector>
+
+
+class Http1ServerSession
+	/// Serves one HTTP/1.x connection, in place of Poco's
+	/// HTTPServerConnection, with a fast path for the ingest endpoint.
+	///
+	/// The request head is read into a fixed buffer and parsed there by
+	/// FastIngestRequest. If an IngestPipeline is given, ingest requests
+	/// it accepts are handed straight to the pipeline and acknowledged,
+	/// without building a Poco::Net::HTTPServerRequest and its header
+	/// map; the buffers for the device id, the sequence, the body and
+	/// the response are kept for the whole connection. All other
+	/// requests are parsed by Poco::Net::HTTPRequest and passed to the
+	/// request handler factory as a BufferedServerRequest, with chunked
+	/// bodies and "Expect: 100-continue" supported as before.
+	///
+	/// Every response is assembled by a ResponseBuilder and written with
+	/// a single socket write, so a small response is one TLS record.
+	///
+	/// Bodies are limited to MAX_BODY_SIZE (413 otherwise) and request
+	/// heads to BUFFER_SIZE (400 otherwise). Keep-alive follows the
+	/// HTTPServerParams.
+{
+public:
+	enum
+	{
+		BUFFER_SIZE   = 16384,
+		MAX_BODY_SIZE = FastIngestRequest::MAX_CONTENT_LENGTH
+	};
+
+	Http1ServerSession(const Poco::Net::StreamSocket& socket, Poco::Net::HTTPServerParams::Ptr pParams, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, IngestPipeline::Ptr pPipeline);
+		/// Creates the Http1ServerSession for a connection whose TLS
+		/// handshake is complete. Without a pipeline, all requests go
+		/// to the request handler factory.
+
+	~Http1ServerSession();
+		/// Destroys the Http1ServerSession.
+
+	void run();
+		/// Serves the connection until it ends.
+
+private:
+	Http1ServerSession(const Http1ServerSession&);
+	Http1ServerSession& operator = (const Http1ServerSession&);
+
+	FastIngestRequest::Result receiveHead(FastIngestRequest& request);
+	bool receive();
+	void compact();
+	void appendBody(std::size_t length, std::string& body);
+	bool readChunkedBody(std::string& body);
+	void readLine(std::string& line);
+	bool serveFast(const FastIngestRequest& request, bool keepAlive);
+	bool serveFallback(std::size_t headerLength, bool keepAlive);
+	void sendAck(Poco::Net::HTTPResponse::HTTPStatus status, const std::string& reason, const std::string& body, bool keepAlive);
+	void sendStatus(Poco::Net::HTTPResponse::HTTPStatus status);
+	const std::string& date();
+
+	Poco::Net::StreamSocket _socket;
+	Poco::Net::HTTPServerParams::Ptr _pParams;
+	Poco::Net::HTTPRequestHandlerFactory::Ptr _pFactory;
+	IngestPipeline::Ptr _pPipeline;
+	Poco::Net::SocketAddress _clientAddress;
+	std::vector<char> _buffer;
+	std::size_t _begin;
+	std::size_t _end;
+	std::string _deviceId;
+	std::string _sequence;
+	std::string _body;
+	ResponseBuilder _response;
+	std::string _date;
+	std::time_t _dateTime;
+};
+
+
+#endif // Http1ServerSession_INCLUDED
@@ -0,0 +1,329 @@
+//
+// Http2ServerSession.cpp
+//
+// Implementation of the Http2ServerSession and Http2ServerRequest classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "Http2ServerSession.h"
+#include "Poco/Net/HTTPRequestHandler.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/String.h"
+#include "Poco/AutoPtr.h"
+#include "Poco/ScopedUnlock.h"
+#include "Poco/Exception.h"
+#include <exception>
+
+
+//
+// Http2ServerRequest
+//
+
+
+Http2ServerRequest::Http2ServerRequest(const HPACKHeaderList& headers, const std::string& body, Poco::Net::StreamSocket& socket, const Poco::Net::HTTPServerParams& params, BufferedServerResponse& response):
+	BufferedServerRequest(socket, params, response)
+{
+	setVersion("HTTP/2.0");
+	std::string path;
+	for (HPACKHeaderList::const_iterator it = headers.begin(); it != headers.end(); ++it)
+	{
+		if (it->first == ":method")
+			setMethod(it->second);
+		else if (it->first == ":path")
+			path = it->second;
+		else if (it->first == ":authority")
+			setHost(it->second);
+		else if (it->first.empty() || it->first[0] != ':')
+			add(it->first, it->second);
+	}
+	if (getMethod().empty() || path.empty()) throw Poco::ProtocolException("Missing :method or :path", Http2Session::PROTOCOL_ERROR);
+	setURI(path);
+	setBody(body);
+}
+
+
+Http2ServerRequest::~Http2ServerRequest()
+{
+}
+
+
+//
+// Http2ServerSession
+//
+
+
+Http2ServerSession::Http2ServerSession(const Poco::Net::StreamSocket& socket, Poco::Net::HTTPServerParams::Ptr pParams, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, Poco::ThreadPool* pThreads):
+	Http2Session(socket, MAX_CONCURRENT_STREAMS, CONNECTION_WINDOW),
+	_pParams(pParams),
+	_pFactory(pFactory),
+	_pThreads(pThreads),
+	_worker(*this, &Http2ServerSession::work),
+	_lastClientStreamId(0),
+	_running(0),
+	_stopping(false)
+{
+}
+
+
+Http2ServerSession::~Http2ServerSession()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_stopping = true;
+	while (_running > 0) _idle.wait(_mutex);
+}
+
+
+void Http2ServerSession::run()
+{
+	try
+	{
+		socket().setReceiveTimeout(_pParams->getKeepAliveTimeout());
+		if (!receivePreface()) return;
+		sendSettings();
+		for (;;)
+		{
+			dispatch();
+			sendResults();
+			// streams may have completed while a response waited for its window
+			if (!_ready.empty()) continue;
+			if (goAwayReceived() && _streams.empty() && _handling.empty()) break;
+			if (!_handling.empty() && !waitForInput(Poco::Timespan(POLL_INTERVAL*Poco::Timespan::MILLISECONDS))) continue;
+			if (!processFrame()) return;
+		}
+		goAway(NO_ERROR_CODE);
+	}
+	catch (Poco::ProtocolException& exc)
+	{
+		try
+		{
+			goAway(exc.code());
+		}
+		catch (Poco::Exception&)
+		{
+		}
+	}
+	catch (Poco::TimeoutException&)
+	{
+		try
+		{
+			goAway(NO_ERROR_CODE);
+		}
+		catch (Poco::Exception&)
+		{
+		}
+	}
+}
+
+
+void Http2ServerSession::dispatch()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	while (!_ready.empty())
+	{
+		Poco::UInt32 streamId = _ready.front();
+		_ready.pop_front();
+		StreamMap::iterator it = _streams.find(streamId);
+		if (it == _streams.end()) continue; // reset by the client
+		_queued.push_back(Job());
+		_queued.back().streamId = streamId;
+		_queued.back().stream.headers.swap(it->second.headers);
+		_queued.back().stream.body.swap(it->second.body);
+		_streams.erase(it);
+		_handling.insert(streamId);
+		// a running handler takes the next queued stream when it is done
+		if (_pThreads && _running < MAX_HANDLERS)
+		{
+			try
+			{
+				_pThreads->start(_worker);
+				++_running;
+			}
+			catch (Poco::NoThreadAvailableException&)
+			{
+			}
+		}
+	}
+	if (_running == 0 && !_queued.empty())
+	{
+		++_running;
+		Poco::ScopedUnlock<Poco::FastMutex> unlock(_mutex);
+		work();
+	}
+}
+
+
+void Http2ServerSession::work()
+{
+	for (;;)
+	{
+		Job job;
+		{
+			Poco::FastMutex::ScopedLock lock(_mutex);
+			if (_queued.empty() || _stopping)
+			{
+				--_running;
+				_idle.broadcast();
+				return;
+			}
+			job.streamId = _queued.front().streamId;
+			job.stream.headers.swap(_queued.front().stream.headers);
+			job.stream.body.swap(_queued.front().stream.body);
+			_queued.pop_front();
+		}
+		Result result;
+		handleStream(job.streamId, job.stream, result);
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_results.push_back(result);
+	}
+}
+
+
+void Http2ServerSession::sendResults()
+{
+	std::deque<Result> results;
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		results.swap(_results);
+	}
+	for (std::deque<Result>::iterator it = results.begin(); it != results.end(); ++it)
+	{
+		if (!_handling.erase(it->streamId)) continue; // reset by the client
+		if (it->reset != NO_RESET)
+			resetStream(it->streamId, it->reset);
+		else
+			sendResponse(it->streamId, *it->pResponse, it->pResponse->body(), it->head);
+	}
+}
+
+
+void Http2ServerSession::onStreamFrame(const Http2Frame& frame, const HPACKHeaderList* pHeaders)
+{
+	bool endStream = (frame.flags & Http2Frame::FLAG_END_STREAM) != 0;
+	StreamMap::iterator it = _streams.find(frame.streamId);
+
+	switch (frame.type)
+	{
+	case Http2Frame::HEADERS:
+		if (it != _streams.end())
+		{
+			// trailers
+			if (!endStream) throw Poco::ProtocolException("Trailers without END_STREAM", PROTOCOL_ERROR);
+			_ready.push_back(frame.streamId);
+			return;
+		}
+		if ((frame.streamId & 1) == 0 || frame.streamId <= _lastClientStreamId)
+			throw Poco::ProtocolException("Bad stream id", PROTOCOL_ERROR);
+		_lastClientStreamId = frame.streamId;
+		if (_streams.size() + _handling.size() >= MAX_CONCURRENT_STREAMS)
+		{
+			resetStream(frame.streamId, REFUSED_STREAM);
+			return;
+		}
+		_streams[frame.streamId].headers = *pHeaders;
+		if (endStream) _ready.push_back(frame.streamId);
+		break;
+	case Http2Frame::DATA:
+		if (it == _streams.end())
+		{
+			// DATA may still arrive on a stream we have refused or reset
+			if (frame.streamId > _lastClientStreamId) throw Poco::ProtocolException("DATA on idle stream", PROTOCOL_ERROR);
+			return;
+		}
+		if (it->second.body.size() + frame.payload.size() > MAX_BODY_SIZE)
+		{
+			_streams.erase(it);
+			sendStatus(frame.streamId, Poco::Net::HTTPResponse::HTTP_REQUESTENTITYTOOLARGE);
+			resetStream(frame.streamId, NO_ERROR_CODE);
+			return;
+		}
+		it->second.body += frame.payload;
+		if (endStream) _ready.push_back(frame.streamId);
+		break;
+	case Http2Frame::RST_STREAM:
+		if (it != _streams.end()) _streams.erase(it);
+		_handling.erase(frame.streamId);
+		break;
+	default:
+		break;
+	}
+}
+
+
+void Http2ServerSession::handleStream(Poco::UInt32 streamId, const Stream& stream, Result& result)
+{
+	result.streamId = streamId;
+	result.pResponse = new BufferedServerResponse;
+	result.head = false;
+	result.reset = NO_RESET;
+	try
+	{
+		Http2ServerRequest request(stream.headers, stream.body, socket(), *_pParams, *result.pResponse);
+		result.head = request.getMethod() == Poco::Net::HTTPRequest::HTTP_HEAD;
+		Poco::SharedPtr<Poco::Net::HTTPRequestHandler> pHandler(_pFactory->createRequestHandler(request));
+		if (pHandler.isNull())
+		{
+			result.pResponse->setStatus(Poco::Net::HTTPResponse::HTTP_NOT_FOUND);
+			return;
+		}
+		pHandler->handleRequest(request, *result.pResponse);
+	}
+	catch (Poco::ProtocolException&)
+	{
+		result.reset = PROTOCOL_ERROR;
+	}
+	catch (Poco::Exception&)
+	{
+		fail(result);
+	}
+	catch (std::exception&)
+	{
+		fail(result);
+	}
+}
+
+
+void Http2ServerSession::fail(Result& result)
+{
+	if (result.pResponse->sent())
+	{
+		result.reset = INTERNAL_ERROR;
+	}
+	else
+	{
+		result.pResponse = new BufferedServerResponse;
+		result.pResponse->setStatus(Poco::Net::HTTPResponse::HTTP_INTERNAL_SERVER_ERROR);
+	}
+}
+
+
+void Http2ServerSession::sendResponse(Poco::UInt32 streamId, const Poco::Net::HTTPResponse& response, const std::string& body, bool head)
+{
+	HPACKHeaderList headers;
+	headers.push_back(HPACKHeader(":status", Poco::NumberFormatter::format(static_cast<int>(response.getStatus()))));
+	for (Poco::Net::NameValueCollection::ConstIterator it = response.begin(); it != response.end(); ++it)
+	{
+		std::string name(Poco::toLower(it->first));
+		// connection-specific headers are not allowed in HTTP/2
+		if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" ||
+		    name == "upgrade" || name == "proxy-connection" || name == "content-length")
+			continue;
+		headers.push_back(HPACKHeader(name, it->second));
+	}
+	headers.push_back(HPACKHeader("content-length", Poco::NumberFormatter::format(body.size())));
+	// the response to a HEAD request has the headers of the GET
+	// response, but no body (RFC 9113, 8.1)
+	bool endStream = head || body.empty();
+	sendHeaders(streamId, headers, endStream);
+	if (!endStream) sendData(streamId, body, true);
+	closeStream(streamId);
+}
+
+
+void Http2ServerSession::sendStatus(Poco::UInt32 streamId, Poco::Net::HTTPResponse::HTTPStatus status)
+{
+	Poco::Net::HTTPResponse response(status);
+	sendResponse(streamId, response, "");
+}
@@ -0,0 +1,153 @@
+//
+// Http2ServerSession.h
+//
+// Definition of the Http2ServerSession and Http2ServerRequest classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef Http2ServerSession_INCLUDED
+#define Http2ServerSession_INCLUDED
+
+
+#include "Http2Session.h"
+#include "BufferedServerRequest.h"
+#include "Poco/Net/HTTPServerParams.h"
+#include "Poco/Net/HTTPRequestHandlerFactory.h"
+#include "Poco/ThreadPool.h"
+#include "Poco/RunnableAdapter.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Mutex.h"
+#include "Poco/Condition.h"
+#include <deque>
+#include <map>
+#include <set>
+
+
+class Http2ServerRequest: public BufferedServerRequest
+	/// An HTTP/2 request, presented to the request handlers like an
+	/// HTTP/1.1 request with a Content-Length body.
+{
+public:
+	Http2ServerRequest(const HPACKHeaderList& headers, const std::string& body, Poco::Net::StreamSocket& socket, const Poco::Net::HTTPServerParams& params, BufferedServerResponse& response);
+		/// Creates the request from the decoded header block. Throws a
+		/// Poco::ProtocolException if a required pseudo-header is missing.
+
+	~Http2ServerRequest();
+};
+
+
+class Http2ServerSession: public Http2Session
+	/// Serves one HTTP/2 connection with the same request handler
+	/// factory as the HTTP/1.1 server.
+	///
+	/// Any number of streams (up to MAX_CONCURRENT_STREAMS) may be open
+	/// at once; their frames can arrive interleaved. Each stream is
+	/// handed to a request handler as soon as its request is complete.
+	///
+	/// With a thread pool, up to MAX_HANDLERS streams of a connection
+	/// are handled at once on the pool's threads, so that a slow
+	/// handler does not hold up the other streams, and the responses
+	/// are sent in the order in which the handlers finish. The
+	/// connection's thread alone reads and writes the socket (and the
+	/// HPACK tables): while handlers are running, it waits for input
+	/// at most POLL_INTERVAL milliseconds at a time and sends the
+	/// finished responses in between. Without a pool, or while the
+	/// pool has no thread to spare, the streams are handled one at a
+	/// time on the connection's thread.
+	///
+	/// The session ends when the client closes the
+	/// connection or sends GOAWAY, when it is idle for longer than the
+	/// keep-alive timeout, or on a protocol error (answered with GOAWAY).
+{
+public:
+	enum
+	{
+		MAX_CONCURRENT_STREAMS = 100,
+		MAX_BODY_SIZE          = 1048576,
+		CONNECTION_WINDOW      = 4194304,
+		MAX_HANDLERS           = 8,
+		POLL_INTERVAL          = 2
+	};
+
+	Http2ServerSession(const Poco::Net::StreamSocket& socket, Poco::Net::HTTPServerParams::Ptr pParams, Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory, Poco::ThreadPool* pThreads = 0);
+		/// Creates the Http2ServerSession for a connection that has
+		/// negotiated "h2". The streams are handled on the threads of
+		/// the given pool, if any.
+
+	~Http2ServerSession();
+		/// Destroys the Http2ServerSession, after waiting for the
+		/// handlers that are still running.
+
+	void run();
+		/// Serves the connection until it ends.
+
+protected:
+	void onStreamFrame(const Http2Frame& frame, const HPACKHeaderList* pHeaders);
+
+private:
+	struct Stream
+	{
+		HPACKHeaderList headers;
+		std::string body;
+	};
+
+	struct Job
+	{
+		Poco::UInt32 streamId;
+		Stream stream;
+	};
+
+	enum
+	{
+		NO_RESET = -1
+	};
+
+	struct Result
+	{
+		Poco::UInt32 streamId;
+		Poco::SharedPtr<BufferedServerResponse> pResponse;
+		bool head;
+		int reset; // the error code to reset the stream with, or NO_RESET
+	};
+
+	typedef std::map<Poco::UInt32, Stream> StreamMap;
+
+	Http2ServerSession(const Http2ServerSession&);
+	Http2ServerSession& operator = (const Http2ServerSession&);
+
+	void dispatch();
+		/// Queues the completed streams for the handlers, starting
+		/// pool threads for them, or handles them on the calling
+		/// thread if no handler is running.
+
+	void work();
+		/// Handles queued streams until none is left.
+
+	void sendResults();
+		/// Sends the responses of the handlers that have finished.
+
+	void handleStream(Poco::UInt32 streamId, const Stream& stream, Result& result);
+	static void fail(Result& result);
+	void sendResponse(Poco::UInt32 streamId, const Poco::Net::HTTPResponse& response, const std::string& body, bool head = false);
+	void sendStatus(Poco::UInt32 streamId, Poco::Net::HTTPResponse::HTTPStatus status);
+
+	Poco::Net::HTTPServerParams::Ptr _pParams;
+	Poco::Net::HTTPRequestHandlerFactory::Ptr _pFactory;
+	Poco::ThreadPool* _pThreads;
+	Poco::RunnableAdapter<Http2ServerSession> _worker;
+	StreamMap _streams;
+	std::deque<Poco::UInt32> _ready;
+	std::set<Poco::UInt32> _handling;
+	Poco::UInt32 _lastClientStreamId;
+	std::deque<Job> _queued;
+	std::deque<Result> _results;
+	int _running;
+	bool _stopping;
+	Poco::FastMutex _mutex;
+	Poco::Condition _idle;
+};
+
+
+#endif // Http2ServerSession_INCLUDED
@@ -0,0 +1,526 @@
+//
+// Http2Session.cpp
+//
+// Implementation of the Http2Session and Http2ClientSession classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "Http2Session.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/NumberParser.h"
+#include "Poco/Exception.h"
+
+
+namespace
+{
+	enum Setting
+	{
+		SETTINGS_HEADER_TABLE_SIZE      = 0x1,
+		SETTINGS_ENABLE_PUSH            = 0x2,
+		SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+		SETTINGS_INITIAL_WINDOW_SIZE    = 0x4,
+		SETTINGS_MAX_FRAME_SIZE         = 0x5
+	};
+
+	const std::size_t MAX_HEADER_BLOCK_SIZE = 262144;
+	const std::size_t MAX_OUTPUT_BUFFER = 65536;
+
+	Poco::UInt32 get32(const std::string& s, std::size_t pos)
+	{
+		return (static_cast<Poco::UInt32>(static_cast<unsigned char>(s[pos])) << 24)
+		     | (static_cast<Poco::UInt32>(static_cast<unsigned char>(s[pos + 1])) << 16)
+		     | (static_cast<Poco::UInt32>(static_cast<unsigned char>(s[pos + 2])) << 8)
+		     |  static_cast<Poco::UInt32>(static_cast<unsigned char>(s[pos + 3]));
+	}
+
+	void put32(std::string& s, Poco::UInt32 value)
+	{
+		s += static_cast<char>(value >> 24);
+		s += static_cast<char>(value >> 16);
+		s += static_cast<char>(value >> 8);
+		s += static_cast<char>(value);
+	}
+
+	void putSetting(std::string& s, Poco::UInt16 id, Poco::UInt32 value)
+	{
+		s += static_cast<char>(id >> 8);
+		s += static_cast<char>(id);
+		put32(s, value);
+	}
+}
+
+
+//
+// Http2Session
+//
+
+
+const std::string Http2Session::PREFACE("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+
+
+Http2Session::Http2Session(const Poco::Net::StreamSocket& socket, int maxConcurrentStreams, int connectionWindow):
+	_socket(socket),
+	_inPos(0),
+	_maxConcurrentStreams(maxConcurrentStreams),
+	_connectionWindow(connectionWindow),
+	_connectionSendWindow(DEFAULT_WINDOW_SIZE),
+	_peerInitialWindow(DEFAULT_WINDOW_SIZE),
+	_peerMaxFrameSize(DEFAULT_FRAME_SIZE),
+	_peerMaxConcurrentStreams(0xffffffff),
+	_lastStreamId(0),
+	_goAwayReceived(false),
+	_settingsReceived(false)
+{
+}
+
+
+Http2Session::~Http2Session()
+{
+}
+
+
+void Http2Session::sendPreface()
+{
+	_out += PREFACE;
+}
+
+
+bool Http2Session::receivePreface()
+{
+	if (!fill(PREFACE.size())) return false;
+	if (_in.compare(_inPos, PREFACE.size(), PREFACE) != 0) throw Poco::ProtocolException("Not an HTTP/2 connection preface", PROTOCOL_ERROR);
+	_inPos += PREFACE.size();
+	return true;
+}
+
+
+void Http2Session::sendSettings()
+{
+	std::string settings;
+	putSetting(settings, SETTINGS_ENABLE_PUSH, 0);
+	if (_maxConcurrentStreams > 0) putSetting(settings, SETTINGS_MAX_CONCURRENT_STREAMS, _maxConcurrentStreams);
+	writeFrame(Http2Frame::SETTINGS, 0, 0, settings);
+	if (_connectionWindow > DEFAULT_WINDOW_SIZE)
+	{
+		std::string increment;
+		put32(increment, _connectionWindow - DEFAULT_WINDOW_SIZE);
+		writeFrame(Http2Frame::WINDOW_UPDATE, 0, 0, increment);
+	}
+}
+
+
+void Http2Session::flush()
+{
+	std::size_t pos = 0;
+	while (pos < _out.size())
+	{
+		int n = _socket.sendBytes(_out.data() + pos, static_cast<int>(_out.size() - pos));
+		if (n <= 0) throw Poco::Net::ConnectionResetException("HTTP/2 connection closed by peer");
+		pos += n;
+	}
+	_out.clear();
+}
+
+
+void Http2Session::goAway(int errorCode)
+{
+	std::string payload;
+	put32(payload, _lastStreamId);
+	put32(payload, errorCode);
+	writeFrame(Http2Frame::GOAWAY, 0, 0, payload);
+	flush();
+}
+
+
+bool Http2Session::fill(std::size_t n)
+{
+	if (_in.size() - _inPos >= n) return true;
+	_in.erase(0, _inPos);
+	_inPos = 0;
+	flush();
+	char buffer[DEFAULT_FRAME_SIZE];
+	while (_in.size() < n)
+	{
+		int rc = _socket.receiveBytes(buffer, sizeof(buffer));
+		if (rc <= 0) return false;
+		_in.append(buffer, rc);
+	}
+	return true;
+}
+
+
+bool Http2Session::waitForInput(const Poco::Timespan& timeout)
+{
+	if (_in.size() > _inPos) return true;
+	flush();
+	// available() includes the data that TLS has already decrypted,
+	// which poll() on the socket does not see
+	return _socket.available() > 0 || _socket.poll(timeout, Poco::Net::Socket::SELECT_READ);
+}
+
+
+bool Http2Session::readFrame(Http2Frame& frame)
+{
+	if (!fill(9)) return false;
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(_in.data() + _inPos);
+	std::size_t length = (static_cast<std::size_t>(p[0]) << 16) | (p[1] << 8) | p[2];
+	frame.type = p[3];
+	frame.flags = p[4];
+	frame.streamId = get32(_in, _inPos + 5) & 0x7fffffff;
+	if (length > DEFAULT_FRAME_SIZE) throw Poco::ProtocolException("HTTP/2 frame too large", FRAME_SIZE_ERROR);
+	if (!fill(9 + length)) throw Poco::ProtocolException("Truncated HTTP/2 frame", PROTOCOL_ERROR);
+	frame.payload.assign(_in, _inPos + 9, length);
+	_inPos += 9 + length;
+	return true;
+}
+
+
+void Http2Session::writeFrame(Poco::UInt8 type, Poco::UInt8 flags, Poco::UInt32 streamId, const std::string& payload)
+{
+	writeFrame(type, flags, streamId, payload.data(), payload.size());
+}
+
+
+void Http2Session::writeFrame(Poco::UInt8 type, Poco::UInt8 flags, Poco::UInt32 streamId, const char* payload, std::size_t length)
+{
+	_out += static_cast<char>(length >> 16);
+	_out += static_cast<char>(length >> 8);
+	_out += static_cast<char>(length);
+	_out += static_cast<char>(type);
+	_out += static_cast<char>(flags);
+	put32(_out, streamId);
+	_out.append(payload, length);
+	if (_out.size() > MAX_OUTPUT_BUFFER) flush();
+}
+
+
+bool Http2Session::processFrame()
+{
+	Http2Frame frame;
+	if (!readFrame(frame)) return false;
+
+	switch (frame.type)
+	{
+	case Http2Frame::SETTINGS:
+		handleSettings(frame);
+		break;
+	case Http2Frame::PING:
+		if (frame.streamId != 0) throw Poco::ProtocolException("PING on a stream", PROTOCOL_ERROR);
+		if (frame.payload.size() != 8) throw Poco::ProtocolException("Bad PING size", FRAME_SIZE_ERROR);
+		if (!(frame.flags & Http2Frame::FLAG_ACK)) writeFrame(Http2Frame::PING, Http2Frame::FLAG_ACK, 0, frame.payload);
+		break;
+	case Http2Frame::GOAWAY:
+		_goAwayReceived = true;
+		break;
+	case Http2Frame::WINDOW_UPDATE:
+		handleWindowUpdate(frame);
+		break;
+	case Http2Frame::DATA:
+		if (frame.streamId == 0) throw Poco::ProtocolException("DATA on stream 0", PROTOCOL_ERROR);
+		if (!frame.payload.empty())
+		{
+			// the data is buffered by the receiver, open the windows right away
+			std::string increment;
+			put32(increment, static_cast<Poco::UInt32>(frame.payload.size()));
+			writeFrame(Http2Frame::WINDOW_UPDATE, 0, 0, increment);
+			if (!(frame.flags & Http2Frame::FLAG_END_STREAM))
+				writeFrame(Http2Frame::WINDOW_UPDATE, 0, frame.streamId, increment);
+		}
+		stripPadding(frame);
+		onStreamFrame(frame, 0);
+		break;
+	case Http2Frame::HEADERS:
+		{
+			if (frame.streamId == 0) throw Poco::ProtocolException("HEADERS on stream 0", PROTOCOL_ERROR);
+			stripPadding(frame);
+			if (frame.flags & Http2Frame::FLAG_PRIORITY)
+			{
+				if (frame.payload.size() < 5) throw Poco::ProtocolException("Bad HEADERS priority", PROTOCOL_ERROR);
+				frame.payload.erase(0, 5);
+			}
+			while (!(frame.flags & Http2Frame::FLAG_END_HEADERS))
+			{
+				Http2Frame continuation;
+				if (!readFrame(continuation)) throw Poco::ProtocolException("Truncated header block", PROTOCOL_ERROR);
+				if (continuation.type != Http2Frame::CONTINUATION || continuation.streamId != frame.streamId)
+					throw Poco::ProtocolException("Expected CONTINUATION", PROTOCOL_ERROR);
+				frame.payload += continuation.payload;
+				frame.flags |= continuation.flags & Http2Frame::FLAG_END_HEADERS;
+				if (frame.payload.size() > MAX_HEADER_BLOCK_SIZE) throw Poco::ProtocolException("Header block too large", PROTOCOL_ERROR);
+			}
+			HPACKHeaderList headers;
+			try
+			{
+				_decoder.decode(frame.payload, headers);
+			}
+			catch (Poco::DataFormatException& exc)
+			{
+				throw Poco::ProtocolException(exc.message(), COMPRESSION_ERROR);
+			}
+			if (frame.streamId > _lastStreamId) _lastStreamId = frame.streamId;
+			onStreamFrame(frame, &headers);
+		}
+		break;
+	case Http2Frame::RST_STREAM:
+		if (frame.streamId == 0) throw Poco::ProtocolException("RST_STREAM on stream 0", PROTOCOL_ERROR);
+		if (frame.payload.size() != 4) throw Poco::ProtocolException("Bad RST_STREAM size", FRAME_SIZE_ERROR);
+		closeStream(frame.streamId);
+		onStreamFrame(frame, 0);
+		break;
+	case Http2Frame::PRIORITY:
+		if (frame.payload.size() != 5) throw Poco::ProtocolException("Bad PRIORITY size", FRAME_SIZE_ERROR);
+		onStreamFrame(frame, 0);
+		break;
+	case Http2Frame::PUSH_PROMISE:
+	case Http2Frame::CONTINUATION:
+		throw Poco::ProtocolException("Unexpected HTTP/2 frame", PROTOCOL_ERROR);
+	default:
+		// unknown frame types must be ignored
+		break;
+	}
+	return true;
+}
+
+
+void Http2Session::handleSettings(const Http2Frame& frame)
+{
+	if (frame.streamId != 0) throw Poco::ProtocolException("SETTINGS on a stream", PROTOCOL_ERROR);
+	if (frame.flags & Http2Frame::FLAG_ACK)
+	{
+		if (!frame.payload.empty()) throw Poco::ProtocolException("SETTINGS ACK with payload", FRAME_SIZE_ERROR);
+		return;
+	}
+	if (frame.payload.size() % 6) throw Poco::ProtocolException("Bad SETTINGS size", FRAME_SIZE_ERROR);
+
+	for (std::size_t pos = 0; pos < frame.payload.size(); pos += 6)
+	{
+		int id = (static_cast<unsigned char>(frame.payload[pos]) << 8) | static_cast<unsigned char>(frame.payload[pos + 1]);
+		Poco::UInt32 value = get32(frame.payload, pos + 2);
+		switch (id)
+		{
+		case SETTINGS_HEADER_TABLE_SIZE:
+			_encoder.setTableSize(value < HPACKTable::DEFAULT_SIZE ? value : HPACKTable::DEFAULT_SIZE);
+			break;
+		case SETTINGS_ENABLE_PUSH:
+			if (value > 1) throw Poco::ProtocolException("Bad SETTINGS_ENABLE_PUSH", PROTOCOL_ERROR);
+			break;
+		case SETTINGS_MAX_CONCURRENT_STREAMS:
+			_peerMaxConcurrentStreams = value;
+			break;
+		case SETTINGS_INITIAL_WINDOW_SIZE:
+			{
+				if (value > MAX_WINDOW_SIZE) throw Poco::ProtocolException("Bad SETTINGS_INITIAL_WINDOW_SIZE", FLOW_CONTROL_ERROR);
+				Poco::Int64 delta = static_cast<Poco::Int64>(value) - _peerInitialWindow;
+				for (std::map<Poco::UInt32, Poco::Int64>::iterator it = _streamSendWindows.begin(); it != _streamSendWindows.end(); ++it)
+				{
+					it->second += delta;
+				}
+				_peerInitialWindow = value;
+			}
+			break;
+		case SETTINGS_MAX_FRAME_SIZE:
+			if (value < DEFAULT_FRAME_SIZE || value > 0xffffff) throw Poco::ProtocolException("Bad SETTINGS_MAX_FRAME_SIZE", PROTOCOL_ERROR);
+			_peerMaxFrameSize = value;
+			break;
+		default:
+			break;
+		}
+	}
+	_settingsReceived = true;
+	writeFrame(Http2Frame::SETTINGS, Http2Frame::FLAG_ACK, 0, "");
+}
+
+
+void Http2Session::handleWindowUpdate(const Http2Frame& frame)
+{
+	if (frame.payload.size() != 4) throw Poco::ProtocolException("Bad WINDOW_UPDATE size", FRAME_SIZE_ERROR);
+	Poco::UInt32 increment = get32(frame.payload, 0) & 0x7fffffff;
+	if (frame.streamId == 0)
+	{
+		if (increment == 0) throw Poco::ProtocolException("Zero WINDOW_UPDATE", PROTOCOL_ERROR);
+		_connectionSendWindow += increment;
+		if (_connectionSendWindow > MAX_WINDOW_SIZE) throw Poco::ProtocolException("Connection window overflow", FLOW_CONTROL_ERROR);
+		return;
+	}
+
+	std::map<Poco::UInt32, Poco::Int64>::iterator it = _streamSendWindows.find(frame.streamId);
+	if (it == _streamSendWindows.end()) return; // closed or not yet used for sending
+	it->second += increment;
+	if (increment == 0 || it->second > MAX_WINDOW_SIZE)
+	{
+		closeStream(frame.streamId);
+		resetStream(frame.streamId, increment ? FLOW_CONTROL_ERROR : PROTOCOL_ERROR);
+	}
+}
+
+
+void Http2Session::stripPadding(Http2Frame& frame)
+{
+	if (!(frame.flags & Http2Frame::FLAG_PADDED)) return;
+	if (frame.payload.empty()) throw Poco::ProtocolException("Missing pad length", PROTOCOL_ERROR);
+	std::size_t padLength = static_cast<unsigned char>(frame.payload[0]);
+	if (padLength >= frame.payload.size()) throw Poco::ProtocolException("Padding exceeds frame", PROTOCOL_ERROR);
+	frame.payload = frame.payload.substr(1, frame.payload.size() - 1 - padLength);
+}
+
+
+Poco::Int64& Http2Session::sendWindow(Poco::UInt32 streamId)
+{
+	std::map<Poco::UInt32, Poco::Int64>::iterator it = _streamSendWindows.find(streamId);
+	if (it == _streamSendWindows.end())
+		it = _streamSendWindows.insert(std::make_pair(streamId, _peerInitialWindow)).first;
+	return it->second;
+}
+
+
+void Http2Session::sendHeaders(Poco::UInt32 streamId, const HPACKHeaderList& headers, bool endStream)
+{
+	std::string block(_encoder.encode(headers));
+	std::size_t pos = 0;
+	Poco::UInt8 type = Http2Frame::HEADERS;
+	Poco::UInt8 flags = endStream ? Http2Frame::FLAG_END_STREAM : 0;
+	do
+	{
+		std::size_t n = block.size() - pos;
+		if (n > _peerMaxFrameSize) n = _peerMaxFrameSize;
+		if (pos + n == block.size()) flags |= Http2Frame::FLAG_END_HEADERS;
+		writeFrame(type, flags, streamId, block.substr(pos, n));
+		pos += n;
+		type = Http2Frame::CONTINUATION;
+		flags = 0;
+	}
+	while (pos < block.size());
+	sendWindow(streamId);
+}
+
+
+void Http2Session::sendData(Poco::UInt32 streamId, const std::string& data, bool endStream)
+{
+	std::size_t pos = 0;
+	sendWindow(streamId);
+	while (pos < data.size())
+	{
+		std::map<Poco::UInt32, Poco::Int64>::iterator it = _streamSendWindows.find(streamId);
+		if (it == _streamSendWindows.end()) return; // reset by the peer
+		Poco::Int64 window = it->second < _connectionSendWindow ? it->second : _connectionSendWindow;
+		if (window <= 0)
+		{
+			if (!processFrame()) throw Poco::Net::ConnectionResetException("HTTP/2 connection closed by peer");
+			continue;
+		}
+		std::size_t n = data.size() - pos;
+		if (n > static_cast<std::size_t>(window)) n = static_cast<std::size_t>(window);
+		if (n > _peerMaxFrameSize) n = _peerMaxFrameSize;
+		bool last = pos + n == data.size();
+		writeFrame(Http2Frame::DATA, last && endStream ? Http2Frame::FLAG_END_STREAM : 0, streamId, data.data() + pos, n);
+		it->second -= n;
+		_connectionSendWindow -= n;
+		pos += n;
+	}
+	if (data.empty() && endStream) writeFrame(Http2Frame::DATA, Http2Frame::FLAG_END_STREAM, streamId, "");
+}
+
+
+void Http2Session::resetStream(Poco::UInt32 streamId, int errorCode)
+{
+	std::string payload;
+	put32(payload, errorCode);
+	writeFrame(Http2Frame::RST_STREAM, 0, streamId, payload);
+}
+
+
+void Http2Session::closeStream(Poco::UInt32 streamId)
+{
+	_streamSendWindows.erase(streamId);
+}
+
+
+//
+// Http2ClientSession
+//
+
+
+Http2ClientSession::Http2ClientSession(const Poco::Net::StreamSocket& socket):
+	Http2Session(socket, 0, 1 << 20),
+	_nextStreamId(1)
+{
+	sendPreface();
+	sendSettings();
+	while (!settingsReceived())
+	{
+		if (!processFrame()) throw Poco::Net::ConnectionResetException("HTTP/2 connection closed before SETTINGS");
+	}
+}
+
+
+Http2ClientSession::~Http2ClientSession()
+{
+}
+
+
+Poco::UInt32 Http2ClientSession::sendRequest(const HPACKHeaderList& headers, const std::string& body)
+{
+	Poco::UInt32 streamId = _nextStreamId;
+	_nextStreamId += 2;
+	_pending[streamId].streamId = streamId;
+	sendHeaders(streamId, headers, body.empty());
+	if (!body.empty()) sendData(streamId, body, true);
+	return streamId;
+}
+
+
+bool Http2ClientSession::receiveResponse(Response& response)
+{
+	while (_complete.empty())
+	{
+		if (_pending.empty() && goAwayReceived()) return false;
+		if (!processFrame()) return false;
+	}
+	response = _complete.front();
+	_complete.pop_front();
+	return true;
+}
+
+
+int Http2ClientSession::maxConcurrentStreams() const
+{
+	return peerMaxConcurrentStreams() > 0x7fffffff ? 0x7fffffff : static_cast<int>(peerMaxConcurrentStreams());
+}
+
+
+void Http2ClientSession::onStreamFrame(const Http2Frame& frame, const HPACKHeaderList* pHeaders)
+{
+	std::map<Poco::UInt32, Response>::iterator it = _pending.find(frame.streamId);
+	if (it == _pending.end()) return;
+
+	Response& response = it->second;
+	switch (frame.type)
+	{
+	case Http2Frame::HEADERS:
+		for (HPACKHeaderList::const_iterator itH = pHeaders->begin(); itH != pHeaders->end(); ++itH)
+		{
+			if (itH->first == ":status")
+				response.status = Poco::NumberParser::parse(itH->second);
+			else
+				response.headers.push_back(*itH);
+		}
+		break;
+	case Http2Frame::DATA:
+		response.body += frame.payload;
+		break;
+	case Http2Frame::RST_STREAM:
+		response.reset = true;
+		break;
+	default:
+		return;
+	}
+
+	if (response.reset || (frame.flags & Http2Frame::FLAG_END_STREAM))
+	{
+		_complete.push_back(response);
+		_pending.erase(it);
+		closeStream(frame.streamId);
+	}
+}
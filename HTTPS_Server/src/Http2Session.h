@@ -0,0 +1,270 @@
+//
+// Http2Session.h
+//
+// Definition of the Http2Session and Http2ClientSession classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef Http2Session_INCLUDED
+#define Http2Session_INCLUDED
+
+
+#include "HPACK.h"
+#include "Poco/Net/StreamSocket.h"
+#include "Poco/Timespan.h"
+#include "Poco/Types.h"
+#include <deque>
+#include <map>
+#include <string>
+
+
+struct Http2Frame
+	/// A received HTTP/2 frame (RFC 7540, section 4).
+{
+	enum Type
+	{
+		DATA          = 0x0,
+		HEADERS       = 0x1,
+		PRIORITY      = 0x2,
+		RST_STREAM    = 0x3,
+		SETTINGS      = 0x4,
+		PUSH_PROMISE  = 0x5,
+		PING          = 0x6,
+		GOAWAY        = 0x7,
+		WINDOW_UPDATE = 0x8,
+		CONTINUATION  = 0x9
+	};
+
+	enum Flags
+	{
+		FLAG_END_STREAM  = 0x01,
+		FLAG_ACK         = 0x01,
+		FLAG_END_HEADERS = 0x04,
+		FLAG_PADDED      = 0x08,
+		FLAG_PRIORITY    = 0x20
+	};
+
+	Poco::UInt8 type;
+	Poco::UInt8 flags;
+	Poco::UInt32 streamId;
+	std::string payload;
+};
+
+
+class Http2Session
+	/// The connection level part of HTTP/2 shared by the server and
+	/// the client side: framing, SETTINGS, PING, GOAWAY, HPACK header
+	/// blocks and flow control.
+	///
+	/// Received DATA is acknowledged with WINDOW_UPDATE frames as soon
+	/// as it has been read, so the peer's sending rate is limited only
+	/// by the window (and the session's buffering limits). Outgoing
+	/// DATA honours the peer's connection and stream windows; while
+	/// they are exhausted, incoming frames are processed until the
+	/// peer opens them again.
+	///
+	/// Frames are collected in an output buffer and written when the
+	/// session next waits for input or flush() is called.
+	///
+	/// Protocol violations throw a Poco::ProtocolException whose code
+	/// is the HTTP/2 error code; run loops answer them with GOAWAY.
+{
+public:
+	enum ErrorCode
+	{
+		NO_ERROR_CODE       = 0x0,
+		PROTOCOL_ERROR      = 0x1,
+		INTERNAL_ERROR      = 0x2,
+		FLOW_CONTROL_ERROR  = 0x3,
+		STREAM_CLOSED       = 0x5,
+		FRAME_SIZE_ERROR    = 0x6,
+		REFUSED_STREAM      = 0x7,
+		CANCEL              = 0x8,
+		COMPRESSION_ERROR   = 0x9
+	};
+
+	enum
+	{
+		DEFAULT_WINDOW_SIZE = 65535,
+		DEFAULT_FRAME_SIZE  = 16384,
+		MAX_WINDOW_SIZE     = 0x7fffffff
+	};
+
+	static const std::string PREFACE;
+		/// The client connection preface.
+
+	virtual ~Http2Session();
+		/// Destroys the Http2Session.
+
+	void flush();
+		/// Writes all buffered frames.
+
+	void goAway(int errorCode);
+		/// Sends GOAWAY with the given error code and flushes.
+
+protected:
+	Http2Session(const Poco::Net::StreamSocket& socket, int maxConcurrentStreams, int connectionWindow);
+		/// Creates the Http2Session. The local SETTINGS announce the
+		/// given stream limit (0 for none); the connection receive
+		/// window is raised to connectionWindow.
+
+	void sendPreface();
+		/// Queues the client connection preface.
+
+	bool receivePreface();
+		/// Reads the client connection preface. Returns false at end
+		/// of input; throws a Poco::ProtocolException if the input is
+		/// not HTTP/2.
+
+	void sendSettings();
+		/// Queues the local SETTINGS and the connection WINDOW_UPDATE.
+
+	bool processFrame();
+		/// Reads one frame and handles it, passing stream frames to
+		/// onStreamFrame(). Returns false at end of input.
+
+	bool waitForInput(const Poco::Timespan& timeout);
+		/// Writes the buffered frames and returns true if input is
+		/// buffered or arrives within the timeout, so that the next
+		/// processFrame() does not block for long.
+
+	void sendHeaders(Poco::UInt32 streamId, const HPACKHeaderList& headers, bool endStream);
+		/// Queues a header block as HEADERS and CONTINUATION frames.
+
+	void sendData(Poco::UInt32 streamId, const std::string& data, bool endStream);
+		/// Queues data as DATA frames within the peer's flow control
+		/// windows, processing incoming frames while they are closed.
+
+	void resetStream(Poco::UInt32 streamId, int errorCode);
+		/// Queues RST_STREAM.
+
+	void closeStream(Poco::UInt32 streamId);
+		/// Forgets the send window of a finished stream.
+
+	virtual void onStreamFrame(const Http2Frame& frame, const HPACKHeaderList* pHeaders) = 0;
+		/// Called for DATA, HEADERS (with the decoded header block,
+		/// CONTINUATION frames included), RST_STREAM and PRIORITY frames.
+		/// DATA and HEADERS payloads are stripped of padding.
+
+	bool goAwayReceived() const;
+		/// Returns true if the peer has sent GOAWAY.
+
+	bool settingsReceived() const;
+		/// Returns true once the peer's first SETTINGS have arrived.
+
+	Poco::UInt32 peerMaxConcurrentStreams() const;
+		/// Returns the peer's SETTINGS_MAX_CONCURRENT_STREAMS.
+
+	Poco::Net::StreamSocket& socket();
+		/// Returns the socket.
+
+private:
+	Http2Session(const Http2Session&);
+	Http2Session& operator = (const Http2Session&);
+
+	bool readFrame(Http2Frame& frame);
+	bool fill(std::size_t n);
+	void writeFrame(Poco::UInt8 type, Poco::UInt8 flags, Poco::UInt32 streamId, const std::string& payload);
+	void writeFrame(Poco::UInt8 type, Poco::UInt8 flags, Poco::UInt32 streamId, const char* payload, std::size_t length);
+	void handleSettings(const Http2Frame& frame);
+	void handleWindowUpdate(const Http2Frame& frame);
+	static void stripPadding(Http2Frame& frame);
+	Poco::Int64& sendWindow(Poco::UInt32 streamId);
+
+	Poco::Net::StreamSocket _socket;
+	std::string _in;
+	std::size_t _inPos;
+	std::string _out;
+	HPACKEncoder _encoder;
+	HPACKDecoder _decoder;
+	int _maxConcurrentStreams;
+	int _connectionWindow;
+	Poco::Int64 _connectionSendWindow;
+	std::map<Poco::UInt32, Poco::Int64> _streamSendWindows;
+	Poco::Int64 _peerInitialWindow;
+	Poco::UInt32 _peerMaxFrameSize;
+	Poco::UInt32 _peerMaxConcurrentStreams;
+	Poco::UInt32 _lastStreamId;
+	bool _goAwayReceived;
+	bool _settingsReceived;
+};
+
+
+class Http2ClientSession: public Http2Session
+	/// A minimal HTTP/2 client connection for the load generator:
+	/// requests on any number of concurrent streams, responses
+	/// collected as they complete.
+{
+public:
+	struct Response
+	{
+		Poco::UInt32 streamId;
+		int status;
+		HPACKHeaderList headers;
+		std::string body;
+		bool reset;
+
+		Response(): streamId(0), status(0), reset(false)
+		{
+		}
+	};
+
+	explicit Http2ClientSession(const Poco::Net::StreamSocket& socket);
+		/// Sends the connection preface and SETTINGS on a connected
+		/// socket (for TLS, one that negotiated "h2" with ALPN).
+
+	~Http2ClientSession();
+		/// Destroys the Http2ClientSession.
+
+	Poco::UInt32 sendRequest(const HPACKHeaderList& headers, const std::string& body);
+		/// Starts a request on a new stream and returns the stream id.
+		/// headers must include the pseudo-headers :method, :scheme,
+		/// :authority and :path.
+
+	bool receiveResponse(Response& response);
+		/// Waits until a response is complete and returns it. Returns
+		/// false if the connection was closed.
+
+	int maxConcurrentStreams() const;
+		/// Returns the number of streams the server allows.
+
+protected:
+	void onStreamFrame(const Http2Frame& frame, const HPACKHeaderList* pHeaders);
+
+private:
+	Poco::UInt32 _nextStreamId;
+	std::map<Poco::UInt32, Response> _pending;
+	std::deque<Response> _complete;
+};
+
+
+//
+// inlines
+//
+inline bool Http2Session::goAwayReceived() const
+{
+	return _goAwayReceived;
+}
+
+
+inline bool Http2Session::settingsReceived() const
+{
+	return _settingsReceived;
+}
+
+
+inline Poco::UInt32 Http2Session::peerMaxConcurrentStreams() const
+{
+	return _peerMaxConcurrentStreams;
+}
+
+
+inline Poco::Net::StreamSocket& Http2Session::socket()
+{
+	return _socket;
+}
+
+
+#endif // Http2Session_INCLUDED
@@ -0,0 +1,343 @@
+//
+// IngestPipeline.cpp
+//
+// Implementation of the IngestPipeline class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "IngestPipeline.h"
+#include "SignedBatch.h"
+#include "SeriesCodec.h"
+#include "Pipeline.h"
+#include "Poco/Net/SecureStreamSocket.h"
+#include "Poco/Net/X509Certificate.h"
+#include "Poco/Util/Application.h"
+#include "Poco/Exception.h"
+#include "Poco/DateTimeFormatter.h"
+#include "Poco/Timestamp.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+
+namespace
+{
+	struct Payload
+	{
+		IngestPipeline::Mode mode;
+		const std::string& deviceId;
+		const std::string& body;
+	};
+
+
+	class PayloadDecryptor
+		/// The cipher stage of the ingest flow: decrypts or verifies
+		/// a payload with the key of its mode, and passes on its
+		/// messages: one, or one per record of a signed batch, whose
+		/// signature is verified once, and that the ReplayGuard, if
+		/// any, has not seen before.
+	{
+	public:
+		explicit PayloadDecryptor(Keyring& keyring, ReplayGuard* pGuard = 0):
+			_keyring(keyring),
+			_pGuard(pGuard)
+		{
+		}
+
+		std::vector<std::string> operator () (const Payload& payload)
+		{
+			if (payload.mode != IngestPipeline::MODE_SIGN)
+				return std::vector<std::string>(1, decrypt(payload));
+
+			if (!_keyring.pSignatureKeys) throw Poco::InvalidAccessException("Device signature keys not loaded");
+			SignedBatch batch = SignedBatch::open(payload.deviceId, payload.body, *_keyring.pSignatureKeys->key(payload.deviceId));
+			std::vector<std::string> messages;
+			messages.reserve(batch.size());
+			for (std::vector<TelemetryRecord>::const_iterator it = batch.records().begin(); it != batch.records().end(); ++it)
+			{
+				if (!_pGuard || _pGuard->accept(payload.deviceId, it->sequence, it->timestamp))
+					messages.push_back(it->payload);
+			}
+			if (messages.empty() && batch.size() > 0) throw Poco::InvalidAccessException("Signed records replayed or out of time");
+			return messages;
+		}
+
+		std::string decrypt(const Payload& payload)
+			/// Decrypts a payload of one of the cipher modes.
+		{
+			switch (payload.mode)
+			{
+			case IngestPipeline::MODE_ECIES:
+				if (!_keyring.pECIES) throw Poco::InvalidAccessException("ECIES key not loaded");
+				return _keyring.pECIES->decryptString(payload.body);
+			case IngestPipeline::MODE_PSK:
+				if (!_keyring.pDeviceKeys) throw Poco::InvalidAccessException("Master key not loaded");
+				return _keyring.pDeviceKeys->decrypt(payload.deviceId, payload.body);
+			case IngestPipeline::MODE_SIGN:
+				throw Poco::InvalidAccessException("Signed payloads are not encrypted");
+			default:
+				return _keyring.pRSA->decryptString(payload.body);
+			}
+		}
+
+	private:
+		Keyring& _keyring;
+		ReplayGuard* _pGuard;
+	};
+
+
+	class DecryptedPrinter
+		/// The sink of the ingest flow. Prints every message with the
+		/// X-Sequence of its upload (and its index in a signed batch).
+	{
+	public:
+		explicit DecryptedPrinter(const std::string& tenant = std::string()):
+			_tenant(tenant)
+		{
+		}
+
+		void push(const SequenceReorderer::Delivery& delivery)
+		{
+			const std::vector<std::string>& messages = delivery.messages;
+			for (std::size_t i = 0; i < messages.size(); ++i)
+			{
+				print(messages[i], messages.size() > 1 ? tag(delivery.sequence, i, messages.size()) : tag(delivery.sequence));
+			}
+		}
+
+		void flush()
+		{
+		}
+
+	private:
+		void print(const std::string& text, const std::string& tag)
+		{
+			std::string printed(SeriesDecoder::isSeries(text) ? summarize(text) : text);
+			if (_tenant.empty())
+				std::cout << "\nDecrypted string" << tag << ": \n" << printed << std::endl;
+			else
+				std::cout << "\nDecrypted string for " << _tenant << tag << ": \n" << printed << std::endl;
+
+			std::cout << " " << std::endl;
+			std::cout << " " << std::endl;
+		}
+
+		static std::string tag(const std::string& sequence)
+		{
+			return sequence.empty() ? std::string() : " (sequence " + sequence + ")";
+		}
+
+		static std::string tag(const std::string& sequence, std::size_t index, std::size_t count)
+		{
+			std::ostringstream ostr;
+			ostr << " (sequence " << (sequence.empty() ? "-" : sequence) << ", record " << index + 1 << " of " << count << ")";
+			return ostr.str();
+		}
+
+		static std::string summarize(const std::string& text)
+			/// Returns a line describing a series message instead of its bits.
+		{
+			std::string channel;
+			std::vector<Poco::Int64> times;
+			std::vector<double> values;
+			try
+			{
+				SeriesDecoder::decode(text, channel, times, values);
+			}
+			catch (Poco::DataException& exc)
+			{
+				return "Invalid series: " + exc.displayText();
+			}
+			std::ostringstream ostr;
+			ostr << "Series " << channel << ": " << values.size() << " points";
+			if (!values.empty())
+			{
+				ostr << " from " << Poco::DateTimeFormatter::format(Poco::Timestamp(times.front()*1000), "%Y-%m-%dT%H:%M:%S.%iZ")
+				     << " to " << Poco::DateTimeFormatter::format(Poco::Timestamp(times.back()*1000), "%Y-%m-%dT%H:%M:%S.%iZ")
+				     << ", min " << *std::min_element(values.begin(), values.end())
+				     << ", max " << *std::max_element(values.begin(), values.end());
+			}
+			return ostr.str();
+		}
+
+		std::string _tenant;
+	};
+
+
+	template <class Next>
+	class Reorder
+		/// The reorder stage of the ingest flow: passes on the messages
+		/// of an upload, and those of the uploads of the same device
+		/// they release, in the order of their X-Sequence (see
+		/// SequenceReorderer). Without a SequenceReorderer the messages
+		/// are passed on at once.
+	{
+	public:
+		Reorder(SequenceReorderer* pReorderer, Poco::FastMutex& mutex, const std::string& device, const std::string& sequence, const Next& next = Next()):
+			_pReorderer(pReorderer),
+			_mutex(mutex),
+			_device(device),
+			_sequence(sequence),
+			_next(next)
+		{
+		}
+
+		void push(const std::vector<std::string>& messages)
+		{
+			SequenceReorderer::Delivery delivery;
+			delivery.sequence = _sequence;
+			delivery.messages = messages;
+			if (!_pReorderer)
+			{
+				_next.push(delivery);
+				return;
+			}
+			// the messages released by other threads must not be
+			// printed in between
+			SequenceReorderer::Deliveries released;
+			Poco::FastMutex::ScopedLock lock(_mutex);
+			_pReorderer->add(_device, _sequence, delivery.messages, released);
+			for (SequenceReorderer::Deliveries::const_iterator it = released.begin(); it != released.end(); ++it)
+			{
+				_next.push(*it);
+			}
+		}
+
+		void flush()
+		{
+			_next.flush();
+		}
+
+	private:
+		SequenceReorderer* _pReorderer;
+		Poco::FastMutex& _mutex;
+		std::string _device;
+		std::string _sequence;
+		Next _next;
+	};
+
+
+	typedef Transform<PayloadDecryptor, Reorder<DecryptedPrinter> > IngestFlow;
+		/// The server flow: decrypt, put back into order, then print.
+}
+
+
+const std::string IngestPipeline::ACKNOWLEDGEMENT("!!!! Hello from Server !!!!");
+
+
+IngestPipeline::IngestPipeline(const Keyring& keyring, const std::string& tenant, FleetStatus::Ptr pStatus):
+	_keyring(keyring),
+	_tenant(tenant),
+	_pStatus(pStatus),
+	_pReplayGuard(new ReplayGuard)
+{
+}
+
+
+IngestPipeline::~IngestPipeline()
+{
+	_timer.stop();
+}
+
+
+IngestPipeline::Mode IngestPipeline::mode(const std::string& encryption)
+{
+	return mode(encryption.data(), encryption.size());
+}
+
+
+IngestPipeline::Mode IngestPipeline::mode(const char* encryption, std::size_t length)
+{
+	if (length == 5 && std::memcmp(encryption, "ecies", 5) == 0)
+		return MODE_ECIES;
+	else if (length == 3 && std::memcmp(encryption, "psk", 3) == 0)
+		return MODE_PSK;
+	else if (length == 4 && std::memcmp(encryption, "sign", 4) == 0)
+		return MODE_SIGN;
+	else
+		return MODE_RSA;
+}
+
+
+void IngestPipeline::process(Mode mode, const std::string& deviceId, const std::string& sequence, const std::string& body, const Poco::Net::SocketAddress& clientAddress, Poco::Net::StreamSocket* pSocket)
+{
+	std::cout << "\nEncrypted data: \n" << body << std::endl;
+
+	std::cout << " " << std::endl;
+	std::cout << " " << std::endl;
+
+	// an id that the payload does not prove must not let a client
+	// take over the order or the table entry of another device
+	std::string verifiedId(authenticated(mode) ? deviceId : std::string());
+	std::string device(verifiedId.empty() ? clientAddress.host().toString() : verifiedId);
+	IngestFlow flow(PayloadDecryptor(_keyring, _pReplayGuard.get()), Reorder<DecryptedPrinter>(_pReorderer.get(), _outputMutex, device, sequence, DecryptedPrinter(_tenant)));
+	Payload payload = {mode, deviceId, body};
+	flow.push(payload);
+	if (_pStatus)
+		_pStatus->update(verifiedId, sequence, clientAddress);
+
+	Poco::Util::Application& app = Poco::Util::Application::instance();
+
+	std::string from(clientAddress.toString());
+	if (!_tenant.empty())
+		from += " for " + _tenant;
+	if (sequence.empty())
+		app.logger().information("Request from " + from);
+	else
+		app.logger().information("Request from " + from + ", sequence " + sequence);
+
+	if (pSocket)
+	{
+		Poco::Net::SecureStreamSocket secureSocket(*pSocket);
+		if (secureSocket.havePeerCertificate())
+		{
+			Poco::Net::X509Certificate cert = secureSocket.peerCertificate();
+			app.logger().information("Client certificate: " + cert.subjectName());
+		}
+		else
+		{
+			app.logger().information("No client certificate available.");
+		}
+	}
+	std::cout << " " << std::endl;
+	std::cout << " " << std::endl;
+}
+
+
+std::string IngestPipeline::decrypt(Mode mode, const std::string& deviceId, const std::string& body)
+{
+	Payload payload = {mode, deviceId, body};
+	return PayloadDecryptor(_keyring).decrypt(payload);
+}
+
+
+void IngestPipeline::setMaxSkew(long maxSkew)
+{
+	_pReplayGuard = new ReplayGuard(maxSkew);
+}
+
+
+void IngestPipeline::reorder(std::size_t window, long timeout)
+{
+	_pReorderer = new SequenceReorderer(window, timeout);
+	long interval = timeout/4 > 10 ? timeout/4 : 10;
+	_timer.setStartInterval(interval);
+	_timer.setPeriodicInterval(interval);
+	_timer.start(Poco::TimerCallback<IngestPipeline>(*this, &IngestPipeline::onTimer));
+}
+
+
+void IngestPipeline::onTimer(Poco::Timer& timer)
+{
+	Poco::FastMutex::ScopedLock lock(_outputMutex);
+	SequenceReorderer::Deliveries released;
+	_pReorderer->expire(released);
+	DecryptedPrinter printer(_tenant);
+	for (SequenceReorderer::Deliveries::const_iterator it = released.begin(); it != released.end(); ++it)
+	{
+		printer.push(*it);
+	}
+}
@@ -0,0 +1,152 @@
+//
+// IngestPipeline.h
+//
+// Definition of the IngestPipeline class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef IngestPipeline_INCLUDED
+#define IngestPipeline_INCLUDED
+
+
+#include "PerThreadRSACipher.h"
+#include "ECIESCipher.h"
+#include "DeviceKeyStore.h"
+#include "DeviceSignatureKeys.h"
+#include "FleetStatus.h"
+#include "SequenceReorderer.h"
+#include "ReplayGuard.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Net/StreamSocket.h"
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Timer.h"
+#include <string>
+
+
+struct Keyring
+	/// The payload decryption keys of the server. They are loaded
+	/// once at startup and shared by all request handler threads;
+	/// modes whose key is not configured are null.
+{
+	PerThreadRSACipher::Ptr pRSA;
+	Poco::SharedPtr<ECIESCipher> pECIES;
+	DeviceKeyStore::Ptr pDeviceKeys;
+	DeviceSignatureKeys::Ptr pSignatureKeys;
+};
+
+
+class IngestPipeline
+	/// Handles the payload of an ingest request (POST / with the
+	/// encrypted or signed message as body): decrypts or verifies it
+	/// with the key of its X-Encryption mode, prints it and logs the
+	/// client. The request handler (HTTP/1.1 and HTTP/2) and the
+	/// HTTP/1.1 fast path of Http1ServerSession both go through here.
+	///
+	/// The decryption and the output run as a pipeline of Pipeline.h
+	/// stages. With reorder(), a stage between them puts the messages
+	/// of each device back into the order of their X-Sequence.
+{
+public:
+	typedef Poco::SharedPtr<IngestPipeline> Ptr;
+
+	enum Mode
+	{
+		MODE_RSA,
+		MODE_ECIES,
+		MODE_PSK,
+		MODE_SIGN
+	};
+
+	static const std::string ACKNOWLEDGEMENT;
+		/// The response body sent for every message.
+
+	explicit IngestPipeline(const Keyring& keyring, const std::string& tenant = std::string(), FleetStatus::Ptr pStatus = FleetStatus::Ptr());
+		/// Creates the IngestPipeline. The name of the tenant, if
+		/// given, is added to the output and the log messages. Every
+		/// message processed is recorded in the FleetStatus, if given.
+
+	~IngestPipeline();
+		/// Destroys the IngestPipeline.
+
+	static Mode mode(const std::string& encryption);
+		/// Returns the mode for an X-Encryption header value. Unknown
+		/// values select RSA, the mode of clients that send none.
+
+	static Mode mode(const char* encryption, std::size_t length);
+		/// Returns the mode for an X-Encryption header value that is
+		/// not null terminated.
+
+	static bool authenticated(Mode mode);
+		/// Returns true if a payload of the mode that is decrypted or
+		/// verified proves the X-Device-Id it was sent with.
+
+	void process(Mode mode, const std::string& deviceId, const std::string& sequence, const std::string& body, const Poco::Net::SocketAddress& clientAddress, Poco::Net::StreamSocket* pSocket = 0);
+		/// Decrypts or verifies the body and reports its messages (one
+		/// per record of a signed batch). deviceId is
+		/// the X-Device-Id header and sequence the X-Sequence header,
+		/// either may be empty. The client certificate is logged if
+		/// the socket of the connection is given.
+		///
+		/// Only psk and sign mode prove the device id, with the key
+		/// derived or loaded for it; in RSA and ECIES mode anyone may
+		/// send any id. So the messages are ordered and recorded in
+		/// the FleetStatus per device id in those two modes only, and
+		/// per client host in the others (see authenticated()).
+		///
+		/// The records of a signed batch that the ReplayGuard refuses,
+		/// because they were sent before or their time is off by more
+		/// than the maximum skew, are dropped.
+		///
+		/// Throws a Poco::InvalidAccessException if the key of the mode
+		/// is not loaded, or if every record of a signed batch was
+		/// dropped; its message is the reason phrase for the 400
+		/// response. Decryption errors throw the cipher's exceptions.
+
+	std::string decrypt(Mode mode, const std::string& deviceId, const std::string& body);
+		/// Decrypts the body with the key of the mode and returns it,
+		/// without reporting it. Used for the chunks of file uploads.
+		/// Throws like process(), and a Poco::InvalidAccessException
+		/// in sign mode, which does not encrypt.
+
+	void setMaxSkew(long maxSkew);
+		/// Sets the maximum skew in milliseconds between the timestamp
+		/// of a signed record and the server's time (see ReplayGuard;
+		/// the default is 5 minutes). Must be called before the first
+		/// message.
+
+	void reorder(std::size_t window, long timeout);
+		/// Prints the messages of each device in the order of their
+		/// X-Sequence (see SequenceReorderer), holding up to window
+		/// uploads per device behind a gap for up to timeout
+		/// milliseconds. A timer skips the gaps that have timed out.
+		/// Must be called before the first message.
+
+private:
+	void onTimer(Poco::Timer& timer);
+
+	IngestPipeline(const IngestPipeline&);
+	IngestPipeline& operator = (const IngestPipeline&);
+
+	Keyring _keyring;
+	std::string _tenant;
+	FleetStatus::Ptr _pStatus;
+	ReplayGuard::Ptr _pReplayGuard;
+	Poco::SharedPtr<SequenceReorderer> _pReorderer;
+	Poco::FastMutex _outputMutex;
+	Poco::Timer _timer;
+};
+
+
+//
+// inlines
+//
+inline bool IngestPipeline::authenticated(Mode mode)
+{
+	return mode == MODE_PSK || mode == MODE_SIGN;
+}
+
+
+#endif // IngestPipeline_INCLUDED
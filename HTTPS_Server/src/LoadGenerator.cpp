@@ -0,0 +1,244 @@
+//
+// LoadGenerator.cpp
+//
+// Implementation of the LoadGenerator class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "LoadGenerator.h"
+#include "ALPN.h"
+#include "Http2Session.h"
+#include "Poco/Net/HTTPSClientSession.h"
+#include "Poco/Net/HTTPRequest.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/SecureStreamSocket.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Stopwatch.h"
+#include "Poco/Timestamp.h"
+#include "Poco/NullStream.h"
+#include "Poco/StreamCopier.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/String.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Exception.h"
+#include <iomanip>
+#include <map>
+#include <vector>
+
+
+class LoadWorker: public Poco::Runnable
+	/// Sends the requests of one connection.
+{
+public:
+	LoadWorker(LoadGenerator& generator, int requests, int streams):
+		_generator(generator),
+		_requests(requests),
+		_streams(streams),
+		_completed(0),
+		_errors(0),
+		_latencyMicros(0)
+	{
+	}
+
+	void run()
+	{
+		try
+		{
+			if (_streams > 0) runHttp2();
+			else runHttp1();
+		}
+		catch (Poco::Exception& exc)
+		{
+			_error = exc.displayText();
+		}
+		_errors += _requests - _completed - _errors;
+	}
+
+	int completed() const
+	{
+		return _completed;
+	}
+
+	int errors() const
+	{
+		return _errors;
+	}
+
+	Poco::Int64 latencyMicros() const
+	{
+		return _latencyMicros;
+	}
+
+	const std::string& error() const
+	{
+		return _error;
+	}
+
+private:
+	void runHttp1()
+	{
+		Poco::Net::HTTPSClientSession session(_generator._host, _generator._port, _generator._pHttp1Context);
+		session.setKeepAlive(true);
+		for (int i = 0; i < _requests; ++i)
+		{
+			Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_POST, "/", Poco::Net::HTTPMessage::HTTP_1_1);
+			for (Poco::Net::NameValueCollection::ConstIterator it = _generator._headers.begin(); it != _generator._headers.end(); ++it)
+			{
+				request.set(it->first, it->second);
+			}
+			request.setContentLength(static_cast<std::streamsize>(_generator._body.size()));
+			request.setKeepAlive(true);
+
+			Poco::Timestamp start;
+			session.sendRequest(request) << _generator._body;
+			Poco::Net::HTTPResponse response;
+			Poco::NullOutputStream nullStream;
+			Poco::StreamCopier::copyStream(session.receiveResponse(response), nullStream);
+			done(start, response.getStatus());
+		}
+	}
+
+	void runHttp2()
+	{
+		Poco::Net::SecureStreamSocket socket(Poco::Net::SocketAddress(_generator._host, _generator._port), _generator._pHttp2Context);
+		if (ALPN::negotiated(socket) != "h2") throw Poco::NotImplementedException("The server did not negotiate h2");
+		Http2ClientSession session(socket);
+
+		HPACKHeaderList headers;
+		headers.push_back(HPACKHeader(":method", "POST"));
+		headers.push_back(HPACKHeader(":scheme", "https"));
+		headers.push_back(HPACKHeader(":authority", _generator._host + ":" + Poco::NumberFormatter::format(_generator._port)));
+		headers.push_back(HPACKHeader(":path", "/"));
+		for (Poco::Net::NameValueCollection::ConstIterator it = _generator._headers.begin(); it != _generator._headers.end(); ++it)
+		{
+			headers.push_back(HPACKHeader(Poco::toLower(it->first), it->second));
+		}
+		headers.push_back(HPACKHeader("content-length", Poco::NumberFormatter::format(_generator._body.size())));
+
+		int window = _streams < session.maxConcurrentStreams() ? _streams : session.maxConcurrentStreams();
+		std::map<Poco::UInt32, Poco::Timestamp> started;
+		int sent = 0;
+		while (_completed + _errors < _requests)
+		{
+			while (sent < _requests && static_cast<int>(started.size()) < window)
+			{
+				started[session.sendRequest(headers, _generator._body)] = Poco::Timestamp();
+				++sent;
+			}
+			Http2ClientSession::Response response;
+			if (!session.receiveResponse(response)) throw Poco::IOException("HTTP/2 connection closed");
+			std::map<Poco::UInt32, Poco::Timestamp>::iterator it = started.find(response.streamId);
+			if (it == started.end()) continue;
+			done(it->second, response.reset ? 0 : response.status);
+			started.erase(it);
+		}
+		session.goAway(Http2Session::NO_ERROR_CODE);
+	}
+
+	void done(const Poco::Timestamp& start, int status)
+	{
+		if (status == Poco::Net::HTTPResponse::HTTP_OK)
+		{
+			++_completed;
+			_latencyMicros += start.elapsed();
+		}
+		else
+		{
+			++_errors;
+			if (_error.empty()) _error = "HTTP status " + Poco::NumberFormatter::format(status);
+		}
+	}
+
+	LoadGenerator& _generator;
+	int _requests;
+	int _streams;
+	int _completed;
+	int _errors;
+	Poco::Int64 _latencyMicros;
+	std::string _error;
+};
+
+
+LoadGenerator::LoadGenerator(const std::string& host, Poco::UInt16 port, const Poco::Net::NameValueCollection& headers, const std::string& body):
+	_host(host),
+	_port(port),
+	_headers(headers),
+	_body(body),
+	_pHttp1Context(new Poco::Net::Context(Poco::Net::Context::CLIENT_USE, "", Poco::Net::Context::VERIFY_NONE)),
+	_pHttp2Context(new Poco::Net::Context(Poco::Net::Context::CLIENT_USE, "", Poco::Net::Context::VERIFY_NONE))
+{
+	ALPN::enableClient(_pHttp2Context, std::string("\x02h2", 3));
+}
+
+
+LoadGenerator::~LoadGenerator()
+{
+}
+
+
+LoadGenerator::Result LoadGenerator::runHttp1(int connections, int requestsPerConnection)
+{
+	return run(connections, requestsPerConnection, 0);
+}
+
+
+LoadGenerator::Result LoadGenerator::runHttp2(int connections, int requestsPerConnection, int streams)
+{
+	return run(connections, requestsPerConnection, streams > 0 ? streams : 1);
+}
+
+
+LoadGenerator::Result LoadGenerator::run(int connections, int requestsPerConnection, int streams)
+{
+	std::vector<Poco::SharedPtr<LoadWorker> > workers;
+	std::vector<Poco::SharedPtr<Poco::Thread> > threads;
+	Poco::Stopwatch sw;
+	sw.start();
+	for (int i = 0; i < connections; ++i)
+	{
+		workers.push_back(new LoadWorker(*this, requestsPerConnection, streams));
+		threads.push_back(new Poco::Thread);
+		threads.back()->start(*workers.back());
+	}
+
+	Result result;
+	result.requests = 0;
+	result.errors = 0;
+	Poco::Int64 latency = 0;
+	for (int i = 0; i < connections; ++i)
+	{
+		threads[i]->join();
+		result.requests += workers[i]->completed();
+		result.errors += workers[i]->errors();
+		latency += workers[i]->latencyMicros();
+		if (result.error.empty()) result.error = workers[i]->error();
+	}
+	sw.stop();
+	result.seconds = sw.elapsed()/1e6;
+	result.averageLatencyMs = result.requests ? latency/1000.0/result.requests : 0;
+	return result;
+}
+
+
+void LoadGenerator::printHeader(std::ostream& ostr)
+{
+	ostr << "protocol  connections  streams   requests  errors     req/s  latency[ms]" << std::endl;
+}
+
+
+void LoadGenerator::print(std::ostream& ostr, const std::string& protocol, int connections, int streams, const Result& result)
+{
+	ostr << std::left << std::setw(8) << protocol << std::right
+	     << "  " << std::setw(11) << connections
+	     << "  " << std::setw(7) << streams
+	     << "  " << std::setw(9) << result.requests
+	     << "  " << std::setw(6) << result.errors
+	     << "  " << std::setw(8) << std::fixed << std::setprecision(0) << (result.seconds > 0 ? result.requests/result.seconds : 0)
+	     << "  " << std::setw(11) << std::setprecision(2) << result.averageLatencyMs
+	     << std::endl;
+	if (!result.error.empty()) ostr << "  first error: " << result.error << std::endl;
+}
@@ -0,0 +1,72 @@
+//
+// LoadGenerator.h
+//
+// Definition of the LoadGenerator class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef LoadGenerator_INCLUDED
+#define LoadGenerator_INCLUDED
+
+
+#include "Poco/Net/Context.h"
+#include "Poco/Net/NameValueCollection.h"
+#include "Poco/Types.h"
+#include <ostream>
+#include <string>
+
+
+class LoadGenerator
+	/// Posts the same request to the server over several TLS
+	/// connections, either as HTTP/1.1 keep-alive requests (one
+	/// outstanding request per connection) or as HTTP/2 requests
+	/// with up to a given number of concurrent streams per
+	/// connection, and measures throughput and latency.
+{
+public:
+	struct Result
+	{
+		int requests;
+		int errors;
+		double seconds;
+		double averageLatencyMs;
+		std::string error;  /// first error message, if any
+	};
+
+	LoadGenerator(const std::string& host, Poco::UInt16 port, const Poco::Net::NameValueCollection& headers, const std::string& body);
+		/// Creates the LoadGenerator for POST requests to "/" with the
+		/// given headers and body. Server certificates are not verified.
+
+	~LoadGenerator();
+		/// Destroys the LoadGenerator.
+
+	Result runHttp1(int connections, int requestsPerConnection);
+		/// Runs HTTP/1.1 keep-alive connections in parallel.
+
+	Result runHttp2(int connections, int requestsPerConnection, int streams);
+		/// Runs HTTP/2 connections in parallel, each keeping up to
+		/// streams requests in flight.
+
+	static void printHeader(std::ostream& ostr);
+		/// Writes the column headings for print().
+
+	static void print(std::ostream& ostr, const std::string& protocol, int connections, int streams, const Result& result);
+		/// Writes one result line.
+
+private:
+	friend class LoadWorker;
+
+	Result run(int connections, int requestsPerConnection, int streams);
+
+	std::string _host;
+	Poco::UInt16 _port;
+	Poco::Net::NameValueCollection _headers;
+	std::string _body;
+	Poco::Net::Context::Ptr _pHttp1Context;
+	Poco::Net::Context::Ptr _pHttp2Context;
+};
+
+
+#endif // LoadGenerator_INCLUDED
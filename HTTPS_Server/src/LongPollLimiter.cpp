@@ -0,0 +1,61 @@
+//
+// LongPollLimiter.cpp
+//
+// Implementation of the LongPollLimiter class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "LongPollLimiter.h"
+
+
+LongPollLimiter::Hold::Hold(LongPollLimiter* pLimiter):
+	_pLimiter(pLimiter),
+	_held(!pLimiter || pLimiter->acquire())
+{
+}
+
+
+LongPollLimiter::Hold::~Hold()
+{
+	if (_pLimiter && _held) _pLimiter->release();
+}
+
+
+LongPollLimiter::LongPollLimiter(Poco::Net::TCPServerParams::Ptr pParams, int maxHeld):
+	_pParams(pParams),
+	_threads(pParams->getMaxThreads()),
+	_maxHeld(maxHeld),
+	_held(0)
+{
+}
+
+
+LongPollLimiter::~LongPollLimiter()
+{
+}
+
+
+bool LongPollLimiter::acquire()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	if (_held >= _maxHeld) return false;
+	// the TCPServer reads the maximum for every connection it queues
+	_pParams->setMaxThreads(_threads + ++_held);
+	return true;
+}
+
+
+void LongPollLimiter::release()
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_pParams->setMaxThreads(_threads + --_held);
+}
+
+
+int LongPollLimiter::held() const
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _held;
+}
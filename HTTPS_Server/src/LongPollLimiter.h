@@ -0,0 +1,96 @@
+//
+// LongPollLimiter.h
+//
+// Definition of the LongPollLimiter class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef LongPollLimiter_INCLUDED
+#define LongPollLimiter_INCLUDED
+
+
+#include "Poco/Net/TCPServerParams.h"
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+
+
+class LongPollLimiter
+	/// Sizes the connection threads of the server from the long polls
+	/// it actually holds (GET /config and GET /commands). A held poll
+	/// keeps the thread of its connection waiting, so for every poll
+	/// held the server may start one more thread, and the maximum
+	/// number of threads of its TCPServerParams is always left for the
+	/// other requests. At most maxHeld polls are held; a poll beyond
+	/// that is answered at once, and told with Retry-After when to ask
+	/// again, instead of taking a thread.
+	///
+	/// The thread pool of the server must have room for the maximum
+	/// number of threads plus maxHeld.
+{
+public:
+	typedef Poco::SharedPtr<LongPollLimiter> Ptr;
+
+	class Hold
+		/// Holds a poll for the lifetime of the object, if the limit
+		/// allows it.
+	{
+	public:
+		explicit Hold(LongPollLimiter* pLimiter);
+			/// Tries to hold a poll. With a null limiter, every poll
+			/// is held.
+
+		~Hold();
+			/// Releases the poll, if it was held.
+
+		bool held() const;
+			/// Returns true if the poll may wait.
+
+	private:
+		Hold(const Hold&);
+		Hold& operator = (const Hold&);
+
+		LongPollLimiter* _pLimiter;
+		bool _held;
+	};
+
+	LongPollLimiter(Poco::Net::TCPServerParams::Ptr pParams, int maxHeld);
+		/// Creates the LongPollLimiter for the server with the given
+		/// parameters.
+
+	~LongPollLimiter();
+		/// Destroys the LongPollLimiter.
+
+	bool acquire();
+		/// Returns true, and raises the maximum number of threads by
+		/// one, if another poll may be held. It must be released.
+
+	void release();
+		/// Releases a poll held with acquire().
+
+	int held() const;
+		/// Returns the number of polls held.
+
+private:
+	LongPollLimiter(const LongPollLimiter&);
+	LongPollLimiter& operator = (const LongPollLimiter&);
+
+	Poco::Net::TCPServerParams::Ptr _pParams;
+	int _threads;
+	int _maxHeld;
+	int _held;
+	mutable Poco::FastMutex _mutex;
+};
+
+
+//
+// inlines
+//
+inline bool LongPollLimiter::Hold::held() const
+{
+	return _held;
+}
+
+
+#endif // LongPollLimiter_INCLUDED
@@ -0,0 +1,219 @@
+//
+// OpenSSLLocking.cpp
+//
+// Implementation of the OpenSSLLocking class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "OpenSSLLocking.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+#include <time.h>
+
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+
+
+namespace
+{
+	__thread Poco::UInt64 acquiredAt[CRYPTO_NUM_LOCKS];
+		/// Time the calling thread acquired each lock type in write mode.
+
+	struct MoreContended
+	{
+		MoreContended(const Poco::UInt64* pContended): _pContended(pContended)
+		{
+		}
+
+		bool operator () (int a, int b) const
+		{
+			return _pContended[a] > _pContended[b];
+		}
+
+		const Poco::UInt64* _pContended;
+	};
+}
+
+
+Poco::RWLock* OpenSSLLocking::_pLocks = 0;
+OpenSSLLocking::Stats* OpenSSLLocking::_pStats = 0;
+bool OpenSSLLocking::_sharedReadLocks = false;
+bool OpenSSLLocking::_profile = false;
+void (*OpenSSLLocking::_pPrevious)(int, int, const char*, int) = 0;
+Poco::Crypto::OpenSSLInitializer* OpenSSLLocking::_pInitializer = 0;
+
+
+void OpenSSLLocking::install(bool sharedReadLocks, bool profile)
+{
+	if (_pLocks) return;
+
+	// make sure Poco has initialized OpenSSL (and installed its own
+	// callback) first, so it will not overwrite ours later
+	_pInitializer = new Poco::Crypto::OpenSSLInitializer;
+
+	_sharedReadLocks = sharedReadLocks;
+	_profile = profile;
+	_pLocks = new Poco::RWLock[CRYPTO_NUM_LOCKS];
+	_pStats = new Stats[CRYPTO_NUM_LOCKS];
+	reset();
+	_pPrevious = CRYPTO_get_locking_callback();
+	CRYPTO_set_locking_callback(&OpenSSLLocking::lock);
+}
+
+
+void OpenSSLLocking::uninstall()
+{
+	if (!_pLocks) return;
+
+	CRYPTO_set_locking_callback(_pPrevious);
+	delete [] _pLocks;
+	delete [] _pStats;
+	_pLocks = 0;
+	_pStats = 0;
+	delete _pInitializer;
+	_pInitializer = 0;
+}
+
+
+bool OpenSSLLocking::isInstalled()
+{
+	return _pLocks != 0;
+}
+
+
+bool OpenSSLLocking::isProfiling()
+{
+	return _pLocks && _profile;
+}
+
+
+void OpenSSLLocking::report(std::ostream& ostr, int maxLines)
+{
+	if (!isProfiling())
+	{
+		ostr << "OpenSSL lock profiling is not enabled." << std::endl;
+		return;
+	}
+
+	Poco::UInt64 contended[CRYPTO_NUM_LOCKS];
+	std::vector<int> types;
+	for (int n = 0; n < CRYPTO_NUM_LOCKS; ++n)
+	{
+		contended[n] = _pStats[n].contended;
+		if (_pStats[n].acquisitions > 0) types.push_back(n);
+	}
+	std::stable_sort(types.begin(), types.end(), MoreContended(contended));
+	if (maxLines > 0 && types.size() > static_cast<std::size_t>(maxLines)) types.resize(maxLines);
+
+	ostr << "lock type             acquired   contended  wait[us]   hold[us]" << std::endl;
+	for (std::vector<int>::const_iterator it = types.begin(); it != types.end(); ++it)
+	{
+		const Stats& st = _pStats[*it];
+		const char* name = CRYPTO_get_lock_name(*it);
+		ostr << std::left << std::setw(20) << (name ? name : "?") << std::right
+		     << std::setw(11) << st.acquisitions
+		     << std::setw(12) << st.contended
+		     << std::setw(10) << st.waitNanos/1000
+		     << std::setw(11) << st.holdNanos/1000
+		     << std::endl;
+	}
+}
+
+
+void OpenSSLLocking::reset()
+{
+	if (!_pStats) return;
+
+	for (int n = 0; n < CRYPTO_NUM_LOCKS; ++n)
+	{
+		_pStats[n].acquisitions = 0;
+		_pStats[n].contended = 0;
+		_pStats[n].waitNanos = 0;
+		_pStats[n].holdNanos = 0;
+	}
+}
+
+
+void OpenSSLLocking::lock(int mode, int n, const char* /*file*/, int /*line*/)
+{
+	Poco::RWLock& rwl = _pLocks[n];
+	bool read = _sharedReadLocks && (mode & CRYPTO_READ);
+
+	if (!(mode & CRYPTO_LOCK))
+	{
+		if (_profile && !read)
+			__sync_fetch_and_add(&_pStats[n].holdNanos, now() - acquiredAt[n]);
+		rwl.unlock();
+		return;
+	}
+
+	if (!_profile)
+	{
+		if (read) rwl.readLock();
+		else rwl.writeLock();
+		return;
+	}
+
+	Stats& st = _pStats[n];
+	if (!(read ? rwl.tryReadLock() : rwl.tryWriteLock()))
+	{
+		Poco::UInt64 start = now();
+		if (read) rwl.readLock();
+		else rwl.writeLock();
+		__sync_fetch_and_add(&st.waitNanos, now() - start);
+		__sync_fetch_and_add(&st.contended, 1);
+	}
+	__sync_fetch_and_add(&st.acquisitions, 1);
+	if (!read) acquiredAt[n] = now();
+}
+
+
+Poco::UInt64 OpenSSLLocking::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<Poco::UInt64>(ts.tv_sec)*1000000000 + ts.tv_nsec;
+}
+
+
+#else // OpenSSL 1.1.0 and later lock internally
+
+
+void OpenSSLLocking::install(bool, bool)
+{
+}
+
+
+void OpenSSLLocking::uninstall()
+{
+}
+
+
+bool OpenSSLLocking::isInstalled()
+{
+	return false;
+}
+
+
+bool OpenSSLLocking::isProfiling()
+{
+	return false;
+}
+
+
+void OpenSSLLocking::report(std::ostream& ostr, int)
+{
+	ostr << "OpenSSL " << OPENSSL_VERSION_TEXT << " does its own locking, no lock statistics available." << std::endl;
+}
+
+
+void OpenSSLLocking::reset()
+{
+}
+
+
+#endif
@@ -0,0 +1,84 @@
+//
+// OpenSSLLocking.h
+//
+// Definition of the OpenSSLLocking class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef OpenSSLLocking_INCLUDED
+#define OpenSSLLocking_INCLUDED
+
+
+#include "Poco/Crypto/OpenSSLInitializer.h"
+#include "Poco/RWLock.h"
+#include "Poco/Types.h"
+#include <ostream>
+
+
+class OpenSSLLocking
+	/// Replaces the static locking callback that Poco's
+	/// OpenSSLInitializer installs for OpenSSL 1.0.x.
+	///
+	/// Poco guards every lock type with an exclusive FastMutex, even
+	/// when OpenSSL only asks for a read lock. Hot paths such as the
+	/// cached Montgomery context of RSA private key operations
+	/// (CRYPTO_LOCK_RSA), error state and X509 store lookups take read
+	/// locks on every call, so with many server threads they serialize
+	/// needlessly. With sharedReadLocks enabled each lock type is an
+	/// RWLock and read locks are shared.
+	///
+	/// With profiling enabled, acquisitions, contended acquisitions
+	/// (the lock was busy), wait time and write-lock hold time are
+	/// counted per lock type and can be reported by name.
+	///
+	/// OpenSSL 1.1.0 and later do their own locking; there install()
+	/// does nothing and report() says so.
+{
+public:
+	static void install(bool sharedReadLocks, bool profile);
+		/// Installs the locking callback. Must be called before any
+		/// other threads use OpenSSL.
+
+	static void uninstall();
+		/// Restores the previous locking callback.
+
+	static bool isInstalled();
+		/// Returns true if the callback is installed.
+
+	static bool isProfiling();
+		/// Returns true if lock statistics are collected.
+
+	static void report(std::ostream& ostr, int maxLines = 0);
+		/// Writes the statistics of all lock types that have been
+		/// acquired, most contended first. If maxLines > 0, at most
+		/// that many lock types are listed.
+
+	static void reset();
+		/// Clears the statistics.
+
+private:
+	OpenSSLLocking();
+
+	struct Stats
+	{
+		Poco::UInt64 acquisitions;
+		Poco::UInt64 contended;
+		Poco::UInt64 waitNanos;
+		Poco::UInt64 holdNanos;
+	};
+
+	static void lock(int mode, int n, const char* file, int line);
+	static Poco::UInt64 now();
+
+	static Poco::RWLock* _pLocks;
+	static Stats* _pStats;
+	static bool _sharedReadLocks;
+	static bool _profile;
+	static void (*_pPrevious)(int, int, const char*, int);
+	static Poco::Crypto::OpenSSLInitializer* _pInitializer;
+};
+
+
+#endif // OpenSSLLocking_INCLUDED
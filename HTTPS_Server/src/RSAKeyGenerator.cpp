@@ -0,0 +1,102 @@
+//
+// RSAKeyGenerator.cpp
+//
+// Implementation of the RSAKeyGenerator class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "RSAKeyGenerator.h"
+#include "Poco/Crypto/OpenSSLInitializer.h"
+#include "Poco/Exception.h"
+#include <openssl/rsa.h>
+#include <openssl/bn.h>
+#include <openssl/pem.h>
+#include <openssl/err.h>
+
+
+namespace
+{
+	void writeKey(const std::string& file, RSA* pRSA, bool isPrivate, const std::string& passphrase)
+	{
+		BIO* pBIO = BIO_new_file(file.c_str(), "w");
+		if (!pBIO) throw Poco::CreateFileException("Cannot create key file", file);
+
+		int rc = 0;
+		if (isPrivate)
+		{
+			unsigned char* pPass = reinterpret_cast<unsigned char*>(const_cast<char*>(passphrase.c_str()));
+			rc = PEM_write_bio_RSAPrivateKey(pBIO, pRSA, passphrase.empty() ? 0 : EVP_des_ede3_cbc(), pPass, static_cast<int>(passphrase.size()), 0, 0);
+		}
+		else
+		{
+			rc = PEM_write_bio_RSA_PUBKEY(pBIO, pRSA);
+		}
+		BIO_free(pBIO);
+		if (!rc) throw Poco::WriteFileException("Cannot write key file", file);
+	}
+}
+
+
+void RSAKeyGenerator::generate(int bits, int primes, const std::string& privateKeyFile, const std::string& publicKeyFile, const std::string& passphrase)
+{
+	Poco::Crypto::OpenSSLInitializer initializer;
+
+	if (primes < 2) throw Poco::InvalidArgumentException("An RSA key needs at least 2 primes");
+	if (primes > 2 && !supportsMultiPrime())
+		throw Poco::NotImplementedException("Multi-prime RSA keys require OpenSSL 1.1.1 or later", OPENSSL_VERSION_TEXT);
+
+	RSA* pRSA = RSA_new();
+	BIGNUM* pExp = BN_new();
+	if (!pRSA || !pExp || !BN_set_word(pExp, RSA_F4))
+	{
+		if (pRSA) RSA_free(pRSA);
+		if (pExp) BN_free(pExp);
+		throw Poco::OutOfMemoryException("RSA key generation");
+	}
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	int rc = RSA_generate_multi_prime_key(pRSA, bits, primes, pExp, 0);
+#else
+	int rc = RSA_generate_key_ex(pRSA, bits, pExp, 0);
+#endif
+	BN_free(pExp);
+	if (rc != 1)
+	{
+		RSA_free(pRSA);
+		throw Poco::IOException("RSA key generation failed", ERR_error_string(ERR_get_error(), 0));
+	}
+
+	try
+	{
+		writeKey(privateKeyFile, pRSA, true, passphrase);
+		if (!publicKeyFile.empty()) writeKey(publicKeyFile, pRSA, false, "");
+	}
+	catch (...)
+	{
+		RSA_free(pRSA);
+		throw;
+	}
+	RSA_free(pRSA);
+}
+
+
+int RSAKeyGenerator::primes(const Poco::Crypto::RSAKey& key)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	return 2 + RSA_get_multi_prime_extra_count(key.impl()->getRSA());
+#else
+	return 2;
+#endif
+}
+
+
+bool RSAKeyGenerator::supportsMultiPrime()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	return true;
+#else
+	return false;
+#endif
+}
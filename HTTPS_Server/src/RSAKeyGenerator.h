@@ -0,0 +1,53 @@
+//
+// RSAKeyGenerator.h
+//
+// Definition of the RSAKeyGenerator class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef RSAKeyGenerator_INCLUDED
+#define RSAKeyGenerator_INCLUDED
+
+
+#include "Poco/Crypto/RSAKey.h"
+#include <string>
+
+
+class RSAKeyGenerator
+	/// Generates the server's RSA private key, optionally with more
+	/// than two primes.
+	///
+	/// A k-prime key decrypts with k CRT exponentiations on 1/k-sized
+	/// moduli, which for the same modulus size is roughly 1.7x (3 primes)
+	/// to 2.5x (4 primes) faster than the standard 2-prime key. The
+	/// public key, and therefore the clients and the ciphertext format,
+	/// are unaffected.
+	///
+	/// Multi-prime keys need OpenSSL 1.1.1 or later at build time; with
+	/// older versions (such as the bundled 1.0.2) only 2-prime keys can
+	/// be generated. Loading goes through Poco::Crypto::RSAKey and accepts
+	/// multi-prime keys whenever the linked OpenSSL does.
+{
+public:
+	static void generate(int bits, int primes, const std::string& privateKeyFile, const std::string& publicKeyFile, const std::string& passphrase);
+		/// Generates a key with the given modulus size and number of primes
+		/// and writes the (passphrase-protected) private key and the public
+		/// key in PEM format. The public key file may be empty.
+		///
+		/// Throws a Poco::NotImplementedException if primes > 2 and the
+		/// OpenSSL library does not support multi-prime keys.
+
+	static int primes(const Poco::Crypto::RSAKey& key);
+		/// Returns the number of primes of the given private key.
+
+	static bool supportsMultiPrime();
+		/// Returns true if multi-prime keys can be generated.
+
+private:
+	RSAKeyGenerator();
+};
+
+
+#endif // RSAKeyGenerator_INCLUDED
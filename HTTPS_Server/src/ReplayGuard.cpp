@@ -0,0 +1,42 @@
+//
+// ReplayGuard.cpp
+//
+// Implementation of the ReplayGuard class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ReplayGuard.h"
+#include "Poco/Timestamp.h"
+
+
+ReplayGuard::ReplayGuard(long maxSkew):
+	_maxSkew(maxSkew)
+{
+}
+
+
+ReplayGuard::~ReplayGuard()
+{
+}
+
+
+bool ReplayGuard::accept(const std::string& deviceId, Poco::UInt64 sequence, Poco::UInt64 timestamp)
+{
+	Poco::Int64 now = Poco::Timestamp().epochMicroseconds()/1000;
+	Poco::Int64 skew = static_cast<Poco::Int64>(timestamp) - now;
+	if (skew > _maxSkew || skew < -_maxSkew) return false;
+
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	Device& device = _devices[deviceId];
+	if (sequence < device.floor) return false;
+	if (!device.seen.insert(sequence).second) return false;
+	if (device.seen.size() > MAX_SEEN)
+	{
+		// the lowest sequence is forgotten, and with it all below
+		device.seen.erase(device.seen.begin());
+		device.floor = *device.seen.begin();
+	}
+	return true;
+}
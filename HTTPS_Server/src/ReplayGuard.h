@@ -0,0 +1,94 @@
+//
+// ReplayGuard.h
+//
+// Definition of the ReplayGuard class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ReplayGuard_INCLUDED
+#define ReplayGuard_INCLUDED
+
+
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Types.h"
+#include <map>
+#include <set>
+#include <string>
+
+
+class ReplayGuard
+	/// Refuses the records of signed batches (see SignedBatch) that
+	/// are sent again, by the device or by anyone who has seen them.
+	///
+	/// A record is accepted once per device and sequence, and only if
+	/// its timestamp is within the maximum skew of the server's time,
+	/// like the command polls of a CommandQueue. The client numbers its
+	/// records with its time in milliseconds, made to grow with every
+	/// record, so that the numbers keep growing when it restarts.
+	///
+	/// Batches are sealed on several threads and uploaded over several
+	/// connections, so their records do not arrive in order. The guard
+	/// therefore keeps the last MAX_SEEN sequences accepted for each
+	/// device, and refuses a record whose sequence is one of them or
+	/// lower than all of them. Older records are refused by their
+	/// timestamp.
+{
+public:
+	typedef Poco::SharedPtr<ReplayGuard> Ptr;
+
+	enum
+	{
+		DEFAULT_MAX_SKEW = 300000,
+		MAX_SEEN         = 4096
+	};
+
+	explicit ReplayGuard(long maxSkew = DEFAULT_MAX_SKEW);
+		/// Creates the ReplayGuard, accepting timestamps up to maxSkew
+		/// milliseconds before or after the server's time.
+
+	~ReplayGuard();
+		/// Destroys the ReplayGuard.
+
+	bool accept(const std::string& deviceId, Poco::UInt64 sequence, Poco::UInt64 timestamp);
+		/// Returns true, and remembers the sequence, if the record has
+		/// not been accepted before and its timestamp (milliseconds
+		/// since the epoch) is within the maximum skew.
+
+	long maxSkew() const;
+		/// Returns the maximum skew in milliseconds.
+
+private:
+	struct Device
+	{
+		Poco::UInt64 floor;
+		std::set<Poco::UInt64> seen;
+
+		Device(): floor(0)
+		{
+		}
+	};
+
+	typedef std::map<std::string, Device> DeviceMap;
+
+	ReplayGuard(const ReplayGuard&);
+	ReplayGuard& operator = (const ReplayGuard&);
+
+	Poco::Int64 _maxSkew;
+	DeviceMap _devices;
+	Poco::FastMutex _mutex;
+};
+
+
+//
+// inlines
+//
+inline long ReplayGuard::maxSkew() const
+{
+	return static_cast<long>(_maxSkew);
+}
+
+
+#endif // ReplayGuard_INCLUDED
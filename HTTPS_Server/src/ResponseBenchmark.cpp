@@ -0,0 +1,220 @@
+//
+// ResponseBenchmark.cpp
+//
+// Implementation of the ResponseBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ResponseBenchmark.h"
+#include "Http1ServerSession.h"
+#include "IngestPipeline.h"
+#include "Poco/Net/ServerSocket.h"
+#include "Poco/Net/StreamSocketImpl.h"
+#include "Poco/Net/HTTPServerConnection.h"
+#include "Poco/Net/HTTPClientSession.h"
+#include "Poco/Net/HTTPRequest.h"
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/HTTPRequestHandler.h"
+#include "Poco/Net/HTTPServerRequest.h"
+#include "Poco/Net/HTTPServerResponse.h"
+#include "Poco/StreamCopier.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/Stopwatch.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Exception.h"
+#include <iomanip>
+#include <sys/socket.h>
+
+
+namespace
+{
+	class CountingSocketImpl: public Poco::Net::StreamSocketImpl
+		/// A connected socket that counts the writes made to it.
+	{
+	public:
+		explicit CountingSocketImpl(poco_socket_t sockfd):
+			Poco::Net::StreamSocketImpl(sockfd),
+			_writes(0),
+			_bytes(0)
+		{
+		}
+
+		int sendBytes(const void* buffer, int length, int flags)
+		{
+			int n = Poco::Net::StreamSocketImpl::sendBytes(buffer, length, flags);
+			++_writes;
+			_bytes += n;
+			return n;
+		}
+
+		int writes() const
+		{
+			return _writes;
+		}
+
+		Poco::UInt64 bytes() const
+		{
+			return _bytes;
+		}
+
+	private:
+		int _writes;
+		Poco::UInt64 _bytes;
+	};
+
+	class AckHandler: public Poco::Net::HTTPRequestHandler
+		/// Answers like TimeRequestHandler, with a Content-Length so
+		/// that Poco keeps the connection open.
+	{
+	public:
+		explicit AckHandler(const std::string& ack):
+			_ack(ack)
+		{
+		}
+
+		void handleRequest(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response)
+		{
+			std::string body;
+			Poco::StreamCopier::copyToString(request.stream(), body);
+			response.setContentLength(static_cast<std::streamsize>(_ack.size()));
+			std::ostream& ostr = response.send();
+			ostr << _ack;
+		}
+
+	private:
+		const std::string& _ack;
+	};
+
+	class AckHandlerFactory: public Poco::Net::HTTPRequestHandlerFactory
+	{
+	public:
+		explicit AckHandlerFactory(const std::string& ack):
+			_ack(ack)
+		{
+		}
+
+		Poco::Net::HTTPRequestHandler* createRequestHandler(const Poco::Net::HTTPServerRequest&)
+		{
+			return new AckHandler(_ack);
+		}
+
+	private:
+		std::string _ack;
+	};
+
+	class BenchmarkServer: public Poco::Runnable
+		/// Accepts one connection and serves it with the selected
+		/// connection class until the client closes it.
+	{
+	public:
+		BenchmarkServer(Poco::Net::ServerSocket& serverSocket, bool session, const std::string& ack):
+			_serverSocket(serverSocket),
+			_session(session),
+			_ack(ack),
+			_writes(0),
+			_bytes(0)
+		{
+		}
+
+		void run()
+		{
+			poco_socket_t sockfd = ::accept(_serverSocket.impl()->sockfd(), 0, 0);
+			if (sockfd == POCO_INVALID_SOCKET) return;
+			CountingSocketImpl* pImpl = new CountingSocketImpl(sockfd);
+			Poco::Net::StreamSocket socket(pImpl);
+			Poco::Net::HTTPServerParams::Ptr pParams = new Poco::Net::HTTPServerParams;
+			Poco::Net::HTTPRequestHandlerFactory::Ptr pFactory = new AckHandlerFactory(_ack);
+			if (_session)
+			{
+				Http1ServerSession session(socket, pParams, pFactory, IngestPipeline::Ptr());
+				session.run();
+			}
+			else
+			{
+				Poco::Net::HTTPServerConnection connection(socket, pParams, pFactory);
+				connection.run();
+			}
+			_writes = pImpl->writes();
+			_bytes = pImpl->bytes();
+		}
+
+		int writes() const
+		{
+			return _writes;
+		}
+
+		Poco::UInt64 bytes() const
+		{
+			return _bytes;
+		}
+
+	private:
+		Poco::Net::ServerSocket& _serverSocket;
+		bool _session;
+		std::string _ack;
+		int _writes;
+		Poco::UInt64 _bytes;
+	};
+}
+
+
+ResponseBenchmark::ResponseBenchmark(int requests, const std::string& message):
+	_requests(requests),
+	_message(message)
+{
+}
+
+
+ResponseBenchmark::~ResponseBenchmark()
+{
+}
+
+
+void ResponseBenchmark::run(std::ostream& ostr)
+{
+	std::string largeBody(LARGE_BODY_SIZE, 'x');
+	ostr << "connection             body  writes/resp  bytes/resp  us/request" << std::endl;
+	runConnection(ostr, "HTTPServerConnection", false, IngestPipeline::ACKNOWLEDGEMENT);
+	runConnection(ostr, "Http1ServerSession", true, IngestPipeline::ACKNOWLEDGEMENT);
+	runConnection(ostr, "HTTPServerConnection", false, largeBody);
+	runConnection(ostr, "Http1ServerSession", true, largeBody);
+}
+
+
+void ResponseBenchmark::runConnection(std::ostream& ostr, const std::string& name, bool session, const std::string& ack)
+{
+	Poco::Net::ServerSocket serverSocket(Poco::Net::SocketAddress("127.0.0.1", 0));
+	BenchmarkServer server(serverSocket, session, ack);
+	Poco::Thread thread;
+	thread.start(server);
+
+	Poco::Stopwatch sw;
+	sw.start();
+	{
+		Poco::Net::HTTPClientSession client(serverSocket.address());
+		client.setKeepAlive(true);
+		for (int i = 0; i < _requests; ++i)
+		{
+			Poco::Net::HTTPRequest request(Poco::Net::HTTPRequest::HTTP_POST, "/", Poco::Net::HTTPMessage::HTTP_1_1);
+			request.setContentLength(static_cast<std::streamsize>(_message.size()));
+			client.sendRequest(request) << _message;
+			Poco::Net::HTTPResponse response;
+			std::string body;
+			Poco::StreamCopier::copyToString(client.receiveResponse(response), body);
+			if (body != ack)
+				throw Poco::DataException("Unexpected benchmark response", name);
+		}
+	}
+	sw.stop();
+	thread.join();
+
+	ostr << std::left << std::setw(20) << name << std::right
+	     << std::setw(7) << ack.size()
+	     << std::setw(13) << Poco::NumberFormatter::format(static_cast<double>(server.writes())/_requests, 2)
+	     << std::setw(12) << Poco::NumberFormatter::format(static_cast<double>(server.bytes())/_requests, 0)
+	     << std::setw(12) << Poco::NumberFormatter::format(static_cast<double>(sw.elapsed())/_requests, 1)
+	     << std::endl;
+}
@@ -0,0 +1,57 @@
+//
+// ResponseBenchmark.h
+//
+// Definition of the ResponseBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ResponseBenchmark_INCLUDED
+#define ResponseBenchmark_INCLUDED
+
+
+#include <ostream>
+#include <string>
+
+
+class ResponseBenchmark
+	/// Counts the socket writes per response of Poco's
+	/// HTTPServerConnection and of Http1ServerSession, serving the
+	/// acknowledgement of the ingest handler, and a body of
+	/// LARGE_BODY_SIZE bytes, to keep-alive requests over a loopback
+	/// connection.
+	///
+	/// On a TLS socket every write is one SSL_write(), so the count is
+	/// also the number of TLS records and send system calls per
+	/// response (for responses of up to 16 KB). The connection runs
+	/// over plain TCP so that the writes can be counted below the
+	/// connection classes.
+{
+public:
+	enum
+	{
+		LARGE_BODY_SIZE = 12288
+	};
+
+	ResponseBenchmark(int requests, const std::string& message);
+		/// Creates the ResponseBenchmark. Each connection is sent the
+		/// given number of requests with the message as body.
+
+	~ResponseBenchmark();
+		/// Destroys the ResponseBenchmark.
+
+	void run(std::ostream& ostr);
+		/// Runs both connection classes with both bodies and writes one
+		/// line for each with the writes and bytes per response and the
+		/// wall clock time per request.
+
+private:
+	void runConnection(std::ostream& ostr, const std::string& name, bool session, const std::string& ack);
+
+	int _requests;
+	std::string _message;
+};
+
+
+#endif // ResponseBenchmark_INCLUDED
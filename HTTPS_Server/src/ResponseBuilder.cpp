@@ -0,0 +1,120 @@
+//
+// ResponseBuilder.cpp
+//
+// Implementation of the ResponseBuilder class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ResponseBuilder.h"
+#include "Poco/Net/NetException.h"
+#include "Poco/NumberFormatter.h"
+
+
+ResponseBuilder::ResponseBuilder():
+	_headerEnded(false)
+{
+	_buffer.reserve(INITIAL_CAPACITY);
+}
+
+
+ResponseBuilder::~ResponseBuilder()
+{
+}
+
+
+void ResponseBuilder::start(int status, const std::string& reason)
+{
+	_buffer.assign("HTTP/1.1 ");
+	Poco::NumberFormatter::append(_buffer, status);
+	_buffer += ' ';
+	_buffer += reason;
+	_buffer += "\r\n";
+	_headerEnded = false;
+}
+
+
+void ResponseBuilder::start(const Poco::Net::HTTPResponse& response)
+{
+	_buffer.assign(response.getVersion());
+	_buffer += ' ';
+	Poco::NumberFormatter::append(_buffer, static_cast<int>(response.getStatus()));
+	_buffer += ' ';
+	_buffer += response.getReason();
+	_buffer += "\r\n";
+	_headerEnded = false;
+	for (Poco::Net::NameValueCollection::ConstIterator it = response.begin(); it != response.end(); ++it)
+	{
+		header(it->first, it->second);
+	}
+}
+
+
+void ResponseBuilder::header(const std::string& name, const std::string& value)
+{
+	_buffer += name;
+	_buffer += ": ";
+	_buffer += value;
+	_buffer += "\r\n";
+}
+
+
+void ResponseBuilder::header(const std::string& name, std::size_t value)
+{
+	_buffer += name;
+	_buffer += ": ";
+	Poco::NumberFormatter::append(_buffer, value);
+	_buffer += "\r\n";
+}
+
+
+void ResponseBuilder::body(const std::string& body)
+{
+	endHeader();
+	_buffer += body;
+}
+
+
+void ResponseBuilder::send(Poco::Net::StreamSocket& socket)
+{
+	endHeader();
+	sendAll(socket, _buffer.data(), _buffer.size());
+}
+
+
+void ResponseBuilder::send(Poco::Net::StreamSocket& socket, const std::string& body)
+{
+	if (body.size() <= MAX_INLINE_BODY)
+	{
+		this->body(body);
+		send(socket);
+	}
+	else
+	{
+		send(socket);
+		sendAll(socket, body.data(), body.size());
+	}
+}
+
+
+void ResponseBuilder::sendAll(Poco::Net::StreamSocket& socket, const char* data, std::size_t length)
+{
+	while (length > 0)
+	{
+		int n = socket.sendBytes(data, static_cast<int>(length));
+		if (n <= 0) throw Poco::Net::ConnectionResetException("Connection closed by peer");
+		data += n;
+		length -= n;
+	}
+}
+
+
+void ResponseBuilder::endHeader()
+{
+	if (!_headerEnded)
+	{
+		_buffer += "\r\n";
+		_headerEnded = true;
+	}
+}
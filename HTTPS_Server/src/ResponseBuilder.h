@@ -0,0 +1,97 @@
+//
+// ResponseBuilder.h
+//
+// Definition of the ResponseBuilder class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ResponseBuilder_INCLUDED
+#define ResponseBuilder_INCLUDED
+
+
+#include "Poco/Net/HTTPResponse.h"
+#include "Poco/Net/StreamSocket.h"
+#include <string>
+
+
+class ResponseBuilder
+	/// Assembles an HTTP/1.1 response, status line, headers and body,
+	/// in one contiguous buffer that is sent with a single socket
+	/// write. On a TLS connection a response of up to 16 KB then costs
+	/// one TLS record and one system call. Poco's HTTPServerResponseImpl
+	/// writes through an 8 KB stream buffer, so responses that do not
+	/// fit into it, or that are sent without a Content-Length, take
+	/// several writes.
+	///
+	/// The buffer keeps its capacity, so a ResponseBuilder reused for
+	/// every response of a connection stops allocating once it has
+	/// grown to the largest response.
+{
+public:
+	enum
+	{
+		INITIAL_CAPACITY = 1024,
+		MAX_INLINE_BODY  = 16384
+			/// Larger bodies are not copied into the buffer by send().
+	};
+
+	ResponseBuilder();
+		/// Creates an empty ResponseBuilder.
+
+	~ResponseBuilder();
+		/// Destroys the ResponseBuilder.
+
+	void start(int status, const std::string& reason);
+		/// Discards the previous response and starts a new one with an
+		/// HTTP/1.1 status line.
+
+	void start(const Poco::Net::HTTPResponse& response);
+		/// Discards the previous response and starts a new one with
+		/// the status line and headers of the given response.
+
+	void header(const std::string& name, const std::string& value);
+		/// Appends a header.
+
+	void header(const std::string& name, std::size_t value);
+		/// Appends a header with a decimal value.
+
+	void body(const std::string& body);
+		/// Ends the header and appends the body.
+
+	void send(Poco::Net::StreamSocket& socket);
+		/// Ends the header if body() has not been called and writes the
+		/// response with one sendBytes() call (or more if the socket
+		/// accepts only part of it).
+
+	void send(Poco::Net::StreamSocket& socket, const std::string& body);
+		/// Ends the header and writes it together with the given body,
+		/// in one write if the body is not larger than MAX_INLINE_BODY
+		/// and in two otherwise.
+
+	const std::string& data() const;
+		/// Returns the response assembled so far.
+
+	static void sendAll(Poco::Net::StreamSocket& socket, const char* data, std::size_t length);
+		/// Writes all of the data, with as few sendBytes() calls as the
+		/// socket allows.
+
+private:
+	void endHeader();
+
+	std::string _buffer;
+	bool _headerEnded;
+};
+
+
+//
+// inlines
+//
+inline const std::string& ResponseBuilder::data() const
+{
+	return _buffer;
+}
+
+
+#endif // ResponseBuilder_INCLUDED
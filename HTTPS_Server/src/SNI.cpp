@@ -0,0 +1,80 @@
+//
+// SNI.cpp
+//
+// Implementation of the SNI class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SNI.h"
+#include "Poco/String.h"
+#include <openssl/ssl.h>
+
+
+SNI::ContextMap SNI::_contexts;
+SNI::NameMap SNI::_names;
+Poco::FastMutex SNI::_mutex;
+
+
+struct SNICallbacks
+{
+	static int serverName(SSL* pSSL, int* /*pAlert*/, void* /*pArg*/)
+	{
+		// OpenSSL calls this for every ClientHello, with or without a
+		// server name, so a stale name of a socket descriptor that was
+		// closed during its handshake is always replaced
+		const char* pName = SSL_get_servername(pSSL, TLSEXT_NAMETYPE_host_name);
+		std::string name;
+		if (pName)
+		{
+			SNI::ContextMap::const_iterator it = SNI::_contexts.find(Poco::toLower(std::string(pName)));
+			if (it != SNI::_contexts.end())
+			{
+				SSL_set_SSL_CTX(pSSL, it->second->sslContext());
+				name = it->first;
+			}
+		}
+		SNI::record(SSL_get_fd(pSSL), name);
+		return SSL_TLSEXT_ERR_OK;
+	}
+};
+
+
+void SNI::addContext(Poco::Net::Context::Ptr pDefaultContext, const std::string& serverName, Poco::Net::Context::Ptr pContext)
+{
+	_contexts[Poco::toLower(serverName)] = pContext;
+	SSL_CTX_set_tlsext_servername_callback(pDefaultContext->sslContext(), &SNICallbacks::serverName);
+}
+
+
+std::string SNI::selected(Poco::Net::SecureStreamSocket& socket)
+{
+	int fd = static_cast<int>(socket.impl()->sockfd());
+	std::string serverName;
+	try
+	{
+		socket.completeHandshake();
+	}
+	catch (...)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_names.erase(fd);
+		throw;
+	}
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	NameMap::iterator it = _names.find(fd);
+	if (it != _names.end())
+	{
+		serverName = it->second;
+		_names.erase(it);
+	}
+	return serverName;
+}
+
+
+void SNI::record(int fd, const std::string& serverName)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_names[fd] = serverName;
+}
@@ -0,0 +1,67 @@
+//
+// SNI.h
+//
+// Definition of the SNI class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SNI_INCLUDED
+#define SNI_INCLUDED
+
+
+#include "Poco/Net/Context.h"
+#include "Poco/Net/SecureStreamSocket.h"
+#include "Poco/Mutex.h"
+#include <map>
+#include <string>
+
+
+class SNI
+	/// Server Name Indication (RFC 6066) for Poco's server contexts:
+	/// one server socket serves several tenants, each with its own
+	/// certificate and private key.
+	///
+	/// The context of each tenant is added to the context of the
+	/// server socket with addContext(). During the handshake the
+	/// server name sent by the client selects the context, before the
+	/// certificate is sent; clients that send an unknown name, or
+	/// none, stay on the context of the server socket. Like ALPN, the
+	/// name selected is recorded per socket descriptor and picked up
+	/// with selected().
+	///
+	/// The contexts of the tenants must be set up like the context of
+	/// the server socket, including ALPN, since OpenSSL takes the
+	/// certificate, the key and the ALPN callbacks from the context
+	/// selected.
+{
+public:
+	static void addContext(Poco::Net::Context::Ptr pDefaultContext, const std::string& serverName, Poco::Net::Context::Ptr pContext);
+		/// Selects the given context for the clients asking for the
+		/// given server name (not case-sensitive) in handshakes on
+		/// sockets of the default context. All contexts must be added
+		/// before the server is started.
+
+	static std::string selected(Poco::Net::SecureStreamSocket& socket);
+		/// Completes the handshake and returns the server name whose
+		/// context was selected, in lower case, or an empty string if
+		/// the default context was used.
+
+private:
+	SNI();
+
+	static void record(int fd, const std::string& serverName);
+
+	typedef std::map<std::string, Poco::Net::Context::Ptr> ContextMap;
+	typedef std::map<int, std::string> NameMap;
+
+	static ContextMap _contexts;
+	static NameMap _names;
+	static Poco::FastMutex _mutex;
+
+	friend struct SNICallbacks;
+};
+
+
+#endif // SNI_INCLUDED
@@ -0,0 +1,128 @@
+//
+// SequenceReorderer.cpp
+//
+// Implementation of the SequenceReorderer class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SequenceReorderer.h"
+#include "Poco/NumberParser.h"
+
+
+SequenceReorderer::SequenceReorderer(std::size_t window, long timeout):
+	_window(window > 0 ? window : 1),
+	_timeout(static_cast<Poco::Clock::ClockDiff>(timeout)*1000)
+{
+}
+
+
+SequenceReorderer::~SequenceReorderer()
+{
+}
+
+
+void SequenceReorderer::add(const std::string& device, const std::string& sequence, std::vector<std::string>& messages, Deliveries& released)
+{
+	Poco::UInt64 value;
+	if (!Poco::NumberParser::tryParseUnsigned64(sequence, value))
+	{
+		released.push_back(Delivery());
+		released.back().sequence = sequence;
+		released.back().messages.swap(messages);
+		return;
+	}
+
+	DeviceMap::iterator it = _devices.find(device);
+	if (it == _devices.end())
+	{
+		Device newDevice;
+		newDevice.next = value;
+		it = _devices.insert(DeviceMap::value_type(device, newDevice)).first;
+	}
+	Device& d = it->second;
+	d.lastSeen.update();
+	if (value < d.next)
+	{
+		if (d.next - value <= RESTART_WINDOW)
+		{
+			// late, or sent again
+			released.push_back(Delivery());
+			released.back().sequence = sequence;
+			released.back().messages.swap(messages);
+			return;
+		}
+		release(d, ~static_cast<Poco::UInt64>(0), released);
+		d.next = value;
+	}
+	if (value - d.next >= _window)
+	{
+		release(d, value - _window + 1, released);
+	}
+	HeldMap::iterator held = d.held.find(value);
+	if (held != d.held.end())
+	{
+		released.push_back(Delivery());
+		released.back().sequence = sequence;
+		released.back().messages.swap(messages);
+		return;
+	}
+	Held& h = d.held[value];
+	h.sequence = sequence;
+	h.messages.swap(messages);
+	releaseReady(d, released);
+}
+
+
+void SequenceReorderer::expire(Deliveries& released)
+{
+	DeviceMap::iterator it = _devices.begin();
+	while (it != _devices.end())
+	{
+		Device& d = it->second;
+		for (;;)
+		{
+			// the gap is skipped when the upload waiting longest behind
+			// it has waited for the timeout
+			HeldMap::const_iterator oldest = d.held.begin();
+			for (HeldMap::const_iterator h = d.held.begin(); h != d.held.end(); ++h)
+			{
+				if (h->second.received < oldest->second.received) oldest = h;
+			}
+			if (oldest == d.held.end() || !oldest->second.received.isElapsed(_timeout)) break;
+			d.next = d.held.begin()->first;
+			releaseReady(d, released);
+		}
+		if (d.held.empty() && d.lastSeen.isElapsed(static_cast<Poco::Clock::ClockDiff>(IDLE_TIMEOUT)*1000))
+			_devices.erase(it++);
+		else
+			++it;
+	}
+}
+
+
+void SequenceReorderer::release(Device& device, Poco::UInt64 until, Deliveries& released)
+{
+	while (!device.held.empty() && device.held.begin()->first < until)
+	{
+		released.push_back(Delivery());
+		released.back().sequence.swap(device.held.begin()->second.sequence);
+		released.back().messages.swap(device.held.begin()->second.messages);
+		device.held.erase(device.held.begin());
+	}
+	if (device.next < until) device.next = until;
+}
+
+
+void SequenceReorderer::releaseReady(Device& device, Deliveries& released)
+{
+	while (!device.held.empty() && device.held.begin()->first == device.next)
+	{
+		released.push_back(Delivery());
+		released.back().sequence.swap(device.held.begin()->second.sequence);
+		released.back().messages.swap(device.held.begin()->second.messages);
+		device.held.erase(device.held.begin());
+		++device.next;
+	}
+}
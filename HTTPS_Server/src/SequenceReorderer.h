@@ -0,0 +1,129 @@
+//
+// SequenceReorderer.h
+//
+// Definition of the SequenceReorderer class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SequenceReorderer_INCLUDED
+#define SequenceReorderer_INCLUDED
+
+
+#include "Poco/Clock.h"
+#include "Poco/Types.h"
+#include <map>
+#include <string>
+#include <vector>
+
+
+class SequenceReorderer
+	/// Puts the messages of each device back into the order of their
+	/// X-Sequence. The async client numbers its uploads when it queues
+	/// them, one number per upload (a message or a signed batch), but
+	/// uploads them over several connections in its drain mode, so
+	/// they arrive out of order.
+	///
+	/// An upload whose sequence is the next one expected for its
+	/// device is released at once, together with the uploads held
+	/// behind it that follow without a gap. An upload with a higher
+	/// sequence is held until the gap before it is filled, but at most
+	/// for the timeout (see expire()), since the client drops messages
+	/// when its queue overflows, and at most window sequences ahead of
+	/// the next one expected; an upload further ahead releases the
+	/// uploads held before it, skipping the gaps.
+	///
+	/// An upload with a lower sequence than expected arrived after its
+	/// gap was skipped, or is sent again after a lost response, and is
+	/// released at once. A sequence lower by more than RESTART_WINDOW
+	/// means that the client has restarted its numbering: the uploads
+	/// held are released and the device starts over.
+	///
+	/// Not thread-safe; the IngestPipeline serializes the calls.
+{
+public:
+	struct Delivery
+	{
+		std::string sequence;
+		std::vector<std::string> messages;
+	};
+
+	typedef std::vector<Delivery> Deliveries;
+
+	enum
+	{
+		DEFAULT_WINDOW  = 256,
+		DEFAULT_TIMEOUT = 2000,
+		RESTART_WINDOW  = 1024,
+		IDLE_TIMEOUT    = 60000
+	};
+
+	explicit SequenceReorderer(std::size_t window = DEFAULT_WINDOW, long timeout = DEFAULT_TIMEOUT);
+		/// Creates the SequenceReorderer, holding at most window
+		/// uploads per device, each for at most timeout milliseconds.
+
+	~SequenceReorderer();
+		/// Destroys the SequenceReorderer.
+
+	void add(const std::string& device, const std::string& sequence, std::vector<std::string>& messages, Deliveries& released);
+		/// Adds the messages of an upload, swapping them out of the
+		/// given vector, and appends the uploads that can be released
+		/// now, in order, to released. Uploads without a sequence, or
+		/// with one that is not a number, are released at once.
+
+	void expire(Deliveries& released);
+		/// Releases the uploads held behind a gap for longer than the
+		/// timeout, and forgets the devices that have nothing held and
+		/// have sent nothing for IDLE_TIMEOUT milliseconds.
+
+	std::size_t window() const;
+		/// Returns the maximum number of uploads held per device.
+
+	long timeout() const;
+		/// Returns the timeout in milliseconds.
+
+private:
+	struct Held
+	{
+		std::string sequence;
+		std::vector<std::string> messages;
+		Poco::Clock received;
+	};
+
+	typedef std::map<Poco::UInt64, Held> HeldMap;
+
+	struct Device
+	{
+		Poco::UInt64 next;
+		HeldMap held;
+		Poco::Clock lastSeen;
+	};
+
+	typedef std::map<std::string, Device> DeviceMap;
+
+	static void release(Device& device, Poco::UInt64 until, Deliveries& released);
+	static void releaseReady(Device& device, Deliveries& released);
+
+	std::size_t _window;
+	Poco::Clock::ClockDiff _timeout;
+	DeviceMap _devices;
+};
+
+
+//
+// inlines
+//
+inline std::size_t SequenceReorderer::window() const
+{
+	return _window;
+}
+
+
+inline long SequenceReorderer::timeout() const
+{
+	return static_cast<long>(_timeout/1000);
+}
+
+
+#endif // SequenceReorderer_INCLUDED
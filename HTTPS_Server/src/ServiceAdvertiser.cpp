@@ -0,0 +1,54 @@
+//
+// ServiceAdvertiser.cpp
+//
+// Implementation of the ServiceAdvertiser class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ServiceAdvertiser.h"
+#include "Poco/DNSSD/Error.h"
+#include "Poco/Delegate.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/Util/Application.h"
+
+
+const std::string ServiceAdvertiser::DEFAULT_TYPE("_https-telemetry._tcp");
+
+
+ServiceAdvertiser::ServiceAdvertiser(const std::string& name, const std::string& type, Poco::UInt16 port, const Poco::DNSSD::Service::Properties& properties)
+{
+	_responder.serviceRegistered += Poco::delegate(this, &ServiceAdvertiser::onRegistered);
+	_responder.serviceRegistrationFailed += Poco::delegate(this, &ServiceAdvertiser::onFailed);
+	_responder.start();
+	Poco::DNSSD::Service service(0, name, "", type, "", "", port, properties);
+	_handle = _responder.registerService(service);
+}
+
+
+ServiceAdvertiser::~ServiceAdvertiser()
+{
+	try
+	{
+		_responder.unregisterService(_handle);
+		_responder.stop();
+	}
+	catch (Poco::Exception&)
+	{
+	}
+	_responder.serviceRegistered -= Poco::delegate(this, &ServiceAdvertiser::onRegistered);
+	_responder.serviceRegistrationFailed -= Poco::delegate(this, &ServiceAdvertiser::onFailed);
+}
+
+
+void ServiceAdvertiser::onRegistered(const void* pSender, const Poco::DNSSD::DNSSDResponder::ServiceEventArgs& args)
+{
+	Poco::Util::Application::instance().logger().information("Advertising " + args.service.name() + "." + args.service.type() + " on port " + Poco::NumberFormatter::format(args.service.port()));
+}
+
+
+void ServiceAdvertiser::onFailed(const void* pSender, const Poco::DNSSD::DNSSDResponder::ErrorEventArgs& args)
+{
+	Poco::Util::Application::instance().logger().error("Cannot advertise " + args.service.type() + ": " + args.error.message());
+}
@@ -0,0 +1,58 @@
+//
+// ServiceAdvertiser.h
+//
+// Definition of the ServiceAdvertiser class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ServiceAdvertiser_INCLUDED
+#define ServiceAdvertiser_INCLUDED
+
+
+#include "Poco/DNSSD/DNSSDResponder.h"
+#include "Poco/DNSSD/Service.h"
+#include "Poco/SharedPtr.h"
+#include <string>
+
+
+class ServiceAdvertiser
+	/// Announces the server on the local network with DNS-SD over
+	/// multicast DNS, through Avahi, so that the clients find it by
+	/// its service type instead of a configured address (see the
+	/// client's ServiceDiscovery).
+	///
+	/// The TXT record carries the host name the clients use for the
+	/// Host header and the TLS certificate ("host"), which may differ
+	/// from the name of the machine.
+{
+public:
+	typedef Poco::SharedPtr<ServiceAdvertiser> Ptr;
+
+	static const std::string DEFAULT_TYPE;
+		/// "_https-telemetry._tcp"
+
+	ServiceAdvertiser(const std::string& name, const std::string& type, Poco::UInt16 port, const Poco::DNSSD::Service::Properties& properties);
+		/// Registers the service. Registration completes in the
+		/// background and is logged; if the name is taken, Avahi
+		/// picks another one. An empty name uses the host name.
+		///
+		/// Poco::DNSSD::initializeDNSSD() must have been called.
+
+	~ServiceAdvertiser();
+		/// Withdraws the service.
+
+private:
+	void onRegistered(const void* pSender, const Poco::DNSSD::DNSSDResponder::ServiceEventArgs& args);
+	void onFailed(const void* pSender, const Poco::DNSSD::DNSSDResponder::ErrorEventArgs& args);
+
+	ServiceAdvertiser(const ServiceAdvertiser&);
+	ServiceAdvertiser& operator = (const ServiceAdvertiser&);
+
+	Poco::DNSSD::DNSSDResponder _responder;
+	Poco::DNSSD::ServiceHandle _handle;
+};
+
+
+#endif // ServiceAdvertiser_INCLUDED
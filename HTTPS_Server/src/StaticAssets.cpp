@@ -0,0 +1,177 @@
+//
+// StaticAssets.cpp
+//
+// Implementation of the StaticAssets class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "StaticAssets.h"
+#include "Poco/DeflatingStream.h"
+#include "Poco/DigestEngine.h"
+#include "Poco/MD5Engine.h"
+#include "Poco/File.h"
+#include "Poco/FileStream.h"
+#include "Poco/Path.h"
+#include "Poco/StreamCopier.h"
+#include "Poco/String.h"
+#include "Poco/StringTokenizer.h"
+#include "Poco/NumberFormatter.h"
+#include <sstream>
+
+
+StaticAssets::StaticAssets(const std::string& directory, int maxAge, long checkInterval):
+	_directory(directory),
+	_maxAge(maxAge),
+	_checkInterval(static_cast<Poco::Timestamp::TimeDiff>(checkInterval)*1000)
+{
+}
+
+
+StaticAssets::~StaticAssets()
+{
+}
+
+
+StaticAssets::AssetPtr StaticAssets::find(const std::string& path)
+{
+	std::string name(path);
+	if (name.empty() || name[name.size() - 1] == '/') name += "index.html";
+
+	Poco::Path filePath(_directory);
+	filePath.makeDirectory();
+	Poco::StringTokenizer segments(name, "/", Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = segments.begin(); it != segments.end(); ++it)
+	{
+		if (*it == "." || *it == ".." || it->find('\\') != std::string::npos) return AssetPtr();
+		filePath.pushDirectory(*it);
+	}
+	filePath.makeFile();
+	std::string fullPath(filePath.toString());
+
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	Poco::Timestamp now;
+	AssetMap::iterator it = _assets.find(fullPath);
+	if (it != _assets.end() && now - it->second.checked < _checkInterval)
+		return it->second.pAsset;
+
+	Poco::File file(fullPath);
+	if (!file.exists() || !file.isFile())
+	{
+		if (it != _assets.end()) _assets.erase(it);
+		return AssetPtr();
+	}
+	Poco::Timestamp modified(file.getLastModified());
+	if (it == _assets.end() || it->second.pAsset->lastModified != modified)
+	{
+		Entry& entry = _assets[fullPath];
+		entry.pAsset = load(fullPath, modified);
+		entry.checked = now;
+		return entry.pAsset;
+	}
+	it->second.checked = now;
+	return it->second.pAsset;
+}
+
+
+StaticAssets::AssetPtr StaticAssets::load(const std::string& path, const Poco::Timestamp& modified) const
+{
+	AssetPtr pAsset = new Asset;
+	pAsset->contentType = contentType(path);
+	if (pAsset->contentType == "text/html; charset=utf-8")
+		pAsset->cacheControl = "no-cache";
+	else
+		pAsset->cacheControl = "public, max-age=" + Poco::NumberFormatter::format(_maxAge);
+	pAsset->lastModified = modified;
+	pAsset->body = read(path);
+	pAsset->etag = etag(pAsset->body);
+
+	bool text = pAsset->contentType.compare(0, 5, "text/") == 0 || pAsset->contentType.find("javascript") != std::string::npos ||
+	            pAsset->contentType.find("json") != std::string::npos || pAsset->contentType.find("svg") != std::string::npos;
+	Poco::File gzipFile(path + ".gz");
+	if (gzipFile.exists() && gzipFile.getLastModified() >= modified)
+		pAsset->gzipBody = read(gzipFile.path());
+	else if (text && pAsset->body.size() >= MIN_COMPRESS_SIZE)
+		pAsset->gzipBody = compress(pAsset->body);
+	if (pAsset->gzipBody.size() >= pAsset->body.size())
+		pAsset->gzipBody.clear();
+	if (!pAsset->gzipBody.empty())
+		pAsset->gzipETag = etag(pAsset->gzipBody);
+	return pAsset;
+}
+
+
+std::string StaticAssets::read(const std::string& path)
+{
+	Poco::FileInputStream istr(path);
+	std::string data;
+	Poco::StreamCopier::copyToString(istr, data);
+	return data;
+}
+
+
+std::string StaticAssets::compress(const std::string& data)
+{
+	std::ostringstream ostr;
+	Poco::DeflatingOutputStream deflater(ostr, Poco::DeflatingStreamBuf::STREAM_GZIP, 9);
+	deflater.write(data.data(), static_cast<std::streamsize>(data.size()));
+	deflater.close();
+	return ostr.str();
+}
+
+
+std::string StaticAssets::etag(const std::string& data)
+{
+	Poco::MD5Engine md5;
+	md5.update(data);
+	return "\"" + Poco::DigestEngine::digestToHex(md5.digest()).substr(0, 20) + "\"";
+}
+
+
+std::string StaticAssets::contentType(const std::string& path)
+{
+	std::string extension(Poco::toLower(Poco::Path(path).getExtension()));
+	if (extension == "html" || extension == "htm") return "text/html; charset=utf-8";
+	else if (extension == "css") return "text/css; charset=utf-8";
+	else if (extension == "js") return "application/javascript; charset=utf-8";
+	else if (extension == "json" || extension == "map") return "application/json";
+	else if (extension == "txt") return "text/plain; charset=utf-8";
+	else if (extension == "svg") return "image/svg+xml";
+	else if (extension == "png") return "image/png";
+	else if (extension == "jpg" || extension == "jpeg") return "image/jpeg";
+	else if (extension == "ico") return "image/x-icon";
+	else if (extension == "woff2") return "font/woff2";
+	else return "application/octet-stream";
+}
+
+
+bool StaticAssets::matches(const std::string& ifNoneMatch, const std::string& etag)
+{
+	Poco::StringTokenizer tags(ifNoneMatch, ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = tags.begin(); it != tags.end(); ++it)
+	{
+		if (*it == "*" || *it == etag || (it->compare(0, 2, "W/") == 0 && it->compare(2, std::string::npos, etag) == 0))
+			return true;
+	}
+	return false;
+}
+
+
+bool StaticAssets::acceptsGzip(const std::string& acceptEncoding)
+{
+	Poco::StringTokenizer codings(acceptEncoding, ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = codings.begin(); it != codings.end(); ++it)
+	{
+		Poco::StringTokenizer parts(*it, ";", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+		if (parts.count() == 0 || (Poco::icompare(parts[0], "gzip") != 0 && parts[0] != "*")) continue;
+		for (std::size_t i = 1; i < parts.count(); ++i)
+		{
+			// "q=0", "q=0.0" and so on refuse the coding
+			if (parts[i].compare(0, 2, "q=") == 0 && parts[i].find_first_not_of("0.", 2) == std::string::npos)
+				return false;
+		}
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,108 @@
+//
+// StaticAssets.h
+//
+// Definition of the StaticAssets class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef StaticAssets_INCLUDED
+#define StaticAssets_INCLUDED
+
+
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Timestamp.h"
+#include <map>
+#include <string>
+
+
+class StaticAssets
+	/// Holds the files of the operator dashboard in memory, so that
+	/// serving one costs no file system access beyond a periodic check
+	/// for changes.
+	///
+	/// Each file is kept as read and, for text types, gzip-compressed:
+	/// from "<file>.gz" if there is an up-to-date one next to it, or
+	/// compressed once when the file is loaded. Both variants have a
+	/// strong ETag derived from the content, so a browser that has the
+	/// current version gets 304 Not Modified without a body.
+	///
+	/// HTML files are sent with "Cache-Control: no-cache", so that the
+	/// browser revalidates them on every load, and all other files with
+	/// a long max-age: assets that change should get a new name, for
+	/// example with a version or hash in it, referenced by the HTML.
+{
+public:
+	typedef Poco::SharedPtr<StaticAssets> Ptr;
+
+	struct Asset
+	{
+		std::string contentType;
+		std::string cacheControl;
+		Poco::Timestamp lastModified;
+		std::string body;
+		std::string etag;
+		std::string gzipBody;  /// empty if compression does not pay
+		std::string gzipETag;
+	};
+
+	typedef Poco::SharedPtr<Asset> AssetPtr;
+
+	StaticAssets(const std::string& directory, int maxAge, long checkInterval);
+		/// Creates the StaticAssets for the files in the given
+		/// directory. maxAge is the lifetime in seconds for files other
+		/// than HTML, and a file is checked for changes at most every
+		/// checkInterval milliseconds.
+
+	~StaticAssets();
+		/// Destroys the StaticAssets.
+
+	AssetPtr find(const std::string& path);
+		/// Returns the file for the path of a request, loading it if
+		/// it is not in memory or has changed, or null if there is no
+		/// such file. A path ending in "/" selects its "index.html";
+		/// paths with "." or ".." segments are not found.
+
+	static std::string contentType(const std::string& path);
+		/// Returns the media type for the extension of the path.
+
+	static bool matches(const std::string& ifNoneMatch, const std::string& etag);
+		/// Returns true if the If-None-Match header lists the ETag,
+		/// with weak comparison, or is "*".
+
+	static bool acceptsGzip(const std::string& acceptEncoding);
+		/// Returns true if the Accept-Encoding header allows gzip.
+
+	enum
+	{
+		MIN_COMPRESS_SIZE = 256
+	};
+
+private:
+	struct Entry
+	{
+		AssetPtr pAsset;
+		Poco::Timestamp checked;
+	};
+
+	typedef std::map<std::string, Entry> AssetMap;
+
+	AssetPtr load(const std::string& path, const Poco::Timestamp& modified) const;
+	static std::string read(const std::string& path);
+	static std::string compress(const std::string& data);
+	static std::string etag(const std::string& data);
+
+	StaticAssets(const StaticAssets&);
+	StaticAssets& operator = (const StaticAssets&);
+
+	std::string _directory;
+	int _maxAge;
+	Poco::Timestamp::TimeDiff _checkInterval;
+	AssetMap _assets;
+	Poco::FastMutex _mutex;
+};
+
+
+#endif // StaticAssets_INCLUDED
@@ -0,0 +1,267 @@
+//
+// UploadStore.cpp
+//
+// Implementation of the UploadStore class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "UploadStore.h"
+#include "ChunkedUpload.h"
+#include "Poco/Exception.h"
+#include "Poco/File.h"
+#include "Poco/NumberParser.h"
+#include "Poco/Path.h"
+#include <fstream>
+
+
+UploadStore::Status::Status():
+	size(0),
+	chunkSize(0),
+	complete(false)
+{
+}
+
+
+UploadStore::Upload::Upload():
+	verifying(false),
+	removed(false),
+	version(0),
+	saved(0)
+{
+}
+
+
+UploadStore::UploadStore(const std::string& directory, Poco::UInt64 maxSize):
+	_directory(directory),
+	_maxSize(maxSize)
+{
+	Poco::File(_directory).createDirectories();
+}
+
+
+UploadStore::~UploadStore()
+{
+}
+
+
+bool UploadStore::status(const std::string& id, Status& status)
+{
+	if (!ChunkedUpload::isValidId(id)) return false;
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	Upload::Ptr pUpload = find(id);
+	if (!pUpload) return false;
+	status = pUpload->status;
+	return true;
+}
+
+
+void UploadStore::check(Poco::UInt64 size, std::size_t chunkSize) const
+{
+	if (size > _maxSize)
+		throw Poco::InvalidArgumentException("Upload too large");
+	if (chunkSize < ChunkedUpload::MIN_CHUNK_SIZE || chunkSize > ChunkedUpload::MAX_CHUNK_SIZE)
+		throw Poco::InvalidArgumentException("Invalid chunk size");
+}
+
+
+UploadStore::Status UploadStore::store(const std::string& id, Poco::UInt64 size, std::size_t chunkSize, const std::string& fileHash, std::size_t index, const std::string& chunk)
+{
+	if (!ChunkedUpload::isValidId(id))
+		throw Poco::InvalidArgumentException("Invalid upload id", id);
+	if (fileHash.size() != 64 || fileHash.find_first_not_of("0123456789abcdef") != std::string::npos)
+		throw Poco::InvalidArgumentException("Invalid file hash");
+	check(size, chunkSize);
+	if (index >= ChunkedUpload::chunks(size, chunkSize))
+		throw Poco::InvalidArgumentException("Chunk index out of range");
+	if (chunk.size() != ChunkedUpload::chunkLength(size, chunkSize, index))
+		throw Poco::InvalidArgumentException("Wrong chunk length");
+
+	Upload::Ptr pUpload;
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		pUpload = find(id);
+		if (!pUpload)
+		{
+			pUpload = new Upload;
+			pUpload->status.size = size;
+			pUpload->status.chunkSize = chunkSize;
+			pUpload->status.fileHash = fileHash;
+			pUpload->status.received.assign(ChunkedUpload::chunks(size, chunkSize), false);
+			pUpload->writing.assign(pUpload->status.received.size(), false);
+			_uploads[id] = pUpload;
+			std::ofstream create(path(id, ".part").c_str(), std::ios::binary | std::ios::trunc);
+		}
+		else if (pUpload->status.size != size || pUpload->status.chunkSize != chunkSize || pUpload->status.fileHash != fileHash)
+		{
+			throw Poco::InvalidArgumentException("Upload parameters differ from the first chunk", id);
+		}
+		if (pUpload->status.complete || pUpload->status.received[index] || pUpload->writing[index]) return pUpload->status;
+		pUpload->writing[index] = true;
+	}
+
+	try
+	{
+		write(id, chunkSize, index, chunk);
+	}
+	catch (...)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		pUpload->writing[index] = false;
+		throw;
+	}
+
+	Status status;
+	Poco::UInt64 version;
+	bool verify = false;
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		pUpload->writing[index] = false;
+		pUpload->status.received[index] = true;
+		bool complete = true;
+		for (std::vector<bool>::const_iterator it = pUpload->status.received.begin(); it != pUpload->status.received.end() && complete; ++it)
+		{
+			complete = *it;
+		}
+		if (complete && !pUpload->verifying)
+		{
+			pUpload->verifying = true;
+			verify = true;
+		}
+		status = pUpload->status;
+		version = ++pUpload->version;
+	}
+	save(id, pUpload, status, version);
+	if (verify && !this->verify(id, pUpload, status))
+		throw Poco::DataException("File hash mismatch, upload restarted", id);
+	return status;
+}
+
+
+UploadStore::Upload::Ptr UploadStore::find(const std::string& id)
+{
+	std::map<std::string, Upload::Ptr>::iterator it = _uploads.find(id);
+	if (it != _uploads.end()) return it->second;
+
+	// an upload from before a restart
+	std::ifstream istr(path(id, ".state").c_str());
+	if (!istr) return 0;
+	std::string size, chunkSize, fileHash, ranges, state;
+	std::getline(istr, size);
+	std::getline(istr, chunkSize);
+	std::getline(istr, fileHash);
+	std::getline(istr, ranges);
+	std::getline(istr, state);
+	try
+	{
+		Upload::Ptr pUpload = new Upload;
+		Status& status = pUpload->status;
+		status.size = Poco::NumberParser::parseUnsigned64(size);
+		status.chunkSize = Poco::NumberParser::parseUnsigned(chunkSize);
+		if (status.size > _maxSize || status.chunkSize < ChunkedUpload::MIN_CHUNK_SIZE || status.chunkSize > ChunkedUpload::MAX_CHUNK_SIZE) return 0;
+		status.fileHash = fileHash;
+		status.received = ChunkedUpload::parseRanges(ranges, ChunkedUpload::chunks(status.size, status.chunkSize));
+		status.complete = state == "complete";
+		pUpload->writing.assign(status.received.size(), false);
+		return _uploads[id] = pUpload;
+	}
+	catch (Poco::SyntaxException&)
+	{
+		return 0;
+	}
+}
+
+
+void UploadStore::write(const std::string& id, std::size_t chunkSize, std::size_t index, const std::string& chunk)
+{
+	// chunks of the same upload go to different offsets of the file,
+	// each through its own stream
+	std::string partPath(path(id, ".part"));
+	std::fstream ostr(partPath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!ostr) throw Poco::OpenFileException(partPath);
+	ostr.seekp(static_cast<std::streamoff>(static_cast<Poco::UInt64>(index)*chunkSize));
+	ostr.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+	ostr.flush();
+	if (!ostr) throw Poco::WriteFileException(partPath);
+}
+
+
+bool UploadStore::verify(const std::string& id, Upload::Ptr pUpload, Status& status)
+{
+	std::string partPath(path(id, ".part"));
+	std::string fileHash;
+	try
+	{
+		fileHash = ChunkedUpload::sha256File(partPath);
+	}
+	catch (Poco::Exception&)
+	{
+		// an unreadable file starts over like a wrong one
+	}
+	if (fileHash == status.fileHash)
+	{
+		{
+			Poco::FastMutex::ScopedLock fileLock(pUpload->mutex);
+			Poco::File(partPath).renameTo(path(id, ""));
+		}
+		Poco::UInt64 version;
+		{
+			Poco::FastMutex::ScopedLock lock(_mutex);
+			pUpload->status.complete = true;
+			pUpload->verifying = false;
+			status = pUpload->status;
+			version = ++pUpload->version;
+		}
+		save(id, pUpload, status, version);
+		return true;
+	}
+
+	// forget the upload first, so that it starts over even if a file
+	// cannot be removed; a single chunk upload may have no state file
+	// yet. The files are removed before the store is unlocked, so that
+	// they cannot be those of a new upload with the same id.
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	std::map<std::string, Upload::Ptr>::iterator it = _uploads.find(id);
+	if (it != _uploads.end() && it->second == pUpload) _uploads.erase(it);
+	Poco::FastMutex::ScopedLock fileLock(pUpload->mutex);
+	pUpload->removed = true;
+	Poco::File part(partPath);
+	if (part.exists()) part.remove();
+	Poco::File state(path(id, ".state"));
+	if (state.exists()) state.remove();
+	return false;
+}
+
+
+void UploadStore::save(const std::string& id, Upload::Ptr pUpload, const Status& status, Poco::UInt64 version)
+{
+	// chunks written in parallel save their states in any order, so
+	// a state older than the one saved last is skipped
+	Poco::FastMutex::ScopedLock fileLock(pUpload->mutex);
+	if (pUpload->removed || version <= pUpload->saved) return;
+
+	// write a new state file and rename it, so that a crash leaves
+	// the old one or the new one
+	std::string statePath(path(id, ".state"));
+	{
+		std::ofstream ostr((statePath + ".tmp").c_str(), std::ios::trunc);
+		ostr << status.size << "\n"
+		     << status.chunkSize << "\n"
+		     << status.fileHash << "\n"
+		     << ChunkedUpload::formatRanges(status.received) << "\n"
+		     << (status.complete ? "complete" : "partial") << "\n";
+		if (!ostr) throw Poco::WriteFileException(statePath);
+	}
+	Poco::File(statePath + ".tmp").renameTo(statePath);
+	pUpload->saved = version;
+}
+
+
+std::string UploadStore::path(const std::string& id, const std::string& extension) const
+{
+	Poco::Path p(_directory);
+	p.makeDirectory();
+	p.setFileName(id + extension);
+	return p.toString();
+}
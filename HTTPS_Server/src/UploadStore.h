@@ -0,0 +1,128 @@
+//
+// UploadStore.h
+//
+// Definition of the UploadStore class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef UploadStore_INCLUDED
+#define UploadStore_INCLUDED
+
+
+#include "Poco/Mutex.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Types.h"
+#include <map>
+#include <string>
+#include <vector>
+
+
+class UploadStore
+	/// Keeps the files uploaded in chunks (see ChunkedUpload) in a
+	/// directory, together with the chunks received so far, so that an
+	/// upload interrupted by the network or by a restart of the server
+	/// resumes with the missing chunks.
+	///
+	/// An upload in progress is kept as <id>.part, with the chunks
+	/// written at their offsets, and <id>.state, which holds the file
+	/// size, chunk size, file hash and the received chunks and is
+	/// rewritten after every chunk. A complete upload whose hash
+	/// matches is renamed to <id>.
+	///
+	/// Chunks of the same upload may arrive in parallel over several
+	/// connections. The store is locked only to look up and update
+	/// the status of an upload; chunks are written with a chunk
+	/// marked as being written and no lock held, and the hash of a
+	/// complete file is computed outside the lock, so a large file
+	/// does not hold up the chunks of other uploads.
+	///
+	/// The file size is limited, and the chunk size must lie between
+	/// ChunkedUpload::MIN_CHUNK_SIZE and ChunkedUpload::MAX_CHUNK_SIZE,
+	/// so that a request cannot make the server allocate the list of
+	/// received chunks for an arbitrary size.
+{
+public:
+	typedef Poco::SharedPtr<UploadStore> Ptr;
+
+	struct Status
+	{
+		Status();
+
+		Poco::UInt64 size;
+		std::size_t chunkSize;
+		std::string fileHash;
+		std::vector<bool> received;
+		bool complete;
+	};
+
+	enum
+	{
+		DEFAULT_MAX_SIZE = 1024*1024*1024
+	};
+
+	explicit UploadStore(const std::string& directory, Poco::UInt64 maxSize = DEFAULT_MAX_SIZE);
+		/// Creates the UploadStore in the given directory, which is
+		/// created if necessary, for files of at most maxSize bytes.
+
+	~UploadStore();
+		/// Destroys the UploadStore.
+
+	bool status(const std::string& id, Status& status);
+		/// Returns the status of an upload, or false if it is not
+		/// known.
+
+	void check(Poco::UInt64 size, std::size_t chunkSize) const;
+		/// Throws a Poco::InvalidArgumentException if the file size
+		/// exceeds the maximum or the chunk size is out of range.
+
+	Status store(const std::string& id, Poco::UInt64 size, std::size_t chunkSize, const std::string& fileHash, std::size_t index, const std::string& chunk);
+		/// Stores a chunk and returns the status of the upload, which
+		/// is created with its first chunk. A chunk that is there
+		/// already is not written again.
+		///
+		/// Throws a Poco::InvalidArgumentException if the id, the
+		/// index or the chunk length are invalid, size or chunk size
+		/// fail check(), or size, chunk size
+		/// or file hash differ from those of the upload, and a
+		/// Poco::DataException if the complete file does not match
+		/// its hash; the upload then starts over.
+		///
+		/// A chunk that is being written by another request is not
+		/// written again either; the status returned does not include
+		/// it yet.
+
+private:
+	struct Upload
+		/// An upload in progress. The status and the chunks being
+		/// written are guarded by the store's mutex, the files by
+		/// the upload's own mutex.
+	{
+		typedef Poco::SharedPtr<Upload> Ptr;
+
+		Upload();
+
+		Status status;
+		std::vector<bool> writing;
+		bool verifying;
+		bool removed;
+		Poco::UInt64 version;
+		Poco::UInt64 saved;
+		Poco::FastMutex mutex;
+	};
+
+	Upload::Ptr find(const std::string& id);
+	void write(const std::string& id, std::size_t chunkSize, std::size_t index, const std::string& chunk);
+	bool verify(const std::string& id, Upload::Ptr pUpload, Status& status);
+	void save(const std::string& id, Upload::Ptr pUpload, const Status& status, Poco::UInt64 version);
+	std::string path(const std::string& id, const std::string& extension) const;
+
+	std::string _directory;
+	Poco::UInt64 _maxSize;
+	std::map<std::string, Upload::Ptr> _uploads;
+	Poco::FastMutex _mutex;
+};
+
+
+#endif // UploadStore_INCLUDED
@@ -0,0 +1,178 @@
+//
+// SeriesCodecCheck.cpp
+//
+// Checks that SeriesDecoder returns what SeriesEncoder encoded, bit
+// for bit, also for the timestamps whose delta of deltas takes 64 bits
+// and the values whose XOR has 64 meaningful bits, and that it refuses
+// truncated messages.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SeriesCodec.h"
+#include "Poco/Exception.h"
+#include <cmath>
+#include <iostream>
+#include <string.h>
+
+
+namespace
+{
+	int failures = 0;
+
+
+	void check(bool condition, const std::string& what)
+	{
+		std::cout << (condition ? "ok      " : "FAILED  ") << what << std::endl;
+		if (!condition) ++failures;
+	}
+
+
+	double valueOf(Poco::UInt64 bits)
+	{
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+
+	struct Series
+	{
+		std::vector<Poco::Int64> times;
+		std::vector<double> values;
+
+		void add(Poco::Int64 time, double value)
+		{
+			times.push_back(time);
+			values.push_back(value);
+		}
+
+		void add(Poco::Int64 time, Poco::UInt64 bits)
+		{
+			add(time, valueOf(bits));
+		}
+	};
+
+
+	std::string encode(const Series& series, const std::string& channel)
+	{
+		SeriesEncoder encoder;
+		for (std::size_t i = 0; i < series.times.size(); ++i)
+		{
+			encoder.append(series.times[i], series.values[i]);
+		}
+		return encoder.finish(channel);
+	}
+
+
+	void checkRoundTrip(const std::string& what, const Series& series)
+	{
+		std::string message(encode(series, "ch1"));
+		std::string channel;
+		Series decoded;
+		bool same = false;
+		try
+		{
+			SeriesDecoder::decode(message, channel, decoded.times, decoded.values);
+			// values are compared as bits, so that NaNs and -0.0 count
+			same = SeriesDecoder::isSeries(message)
+				&& channel == "ch1"
+				&& decoded.times == series.times
+				&& decoded.values.size() == series.values.size()
+				&& (series.values.empty() || memcmp(&decoded.values[0], &series.values[0], series.values.size()*sizeof(double)) == 0);
+		}
+		catch (Poco::Exception&)
+		{
+		}
+		check(same, what);
+	}
+}
+
+
+int main()
+{
+	Series empty;
+	checkRoundTrip("empty series", empty);
+
+	Series one;
+	one.add(1700000000000LL, 21.5);
+	checkRoundTrip("one point", one);
+
+	// a reading sampled every second with some jitter, as the clients
+	// send it
+	Series sensor;
+	for (int i = 0; i < 1000; ++i)
+	{
+		sensor.add(1700000000000LL + i*1000 + (i % 7 == 0 ? i % 5 : 0), std::floor((20 + 5*std::sin(i/50.0))*10)/10);
+	}
+	checkRoundTrip("sampled reading", sensor);
+
+	// deltas of deltas at the edges of the 7, 9 and 12 bit codes
+	Series edges;
+	Poco::Int64 time = 0;
+	Poco::Int64 delta = 0;
+	const Poco::Int64 dods[] = {63, 64, -64, -65, 255, 256, -256, -257, 2047, 2048, -2048, -2049};
+	edges.add(time, 1.0);
+	for (std::size_t i = 0; i < sizeof(dods)/sizeof(dods[0]); ++i)
+	{
+		delta += dods[i];
+		time += delta;
+		edges.add(time, 1.0);
+	}
+	checkRoundTrip("delta of deltas at the edges of the short codes", edges);
+
+	// deltas of deltas that take the 64-bit code
+	Series jumps;
+	jumps.add(0, 1.0);
+	jumps.add(1000, 1.0);
+	jumps.add(1LL << 40, 1.0);
+	jumps.add(-(1LL << 40), 1.0);
+	jumps.add(1LL << 61, 1.0);
+	jumps.add(-(1LL << 61), 1.0);
+	jumps.add(-(1LL << 61) + 1, 1.0);
+	checkRoundTrip("delta of deltas of 64 bits", jumps);
+
+	// an XOR with 64 meaningful bits, whose length does not fit into 6
+	// bits, first with its own window, then in the window of the last
+	Series full;
+	full.add(0, Poco::UInt64(0));
+	full.add(1000, Poco::UInt64(0x8000000000000001ULL));
+	full.add(2000, Poco::UInt64(0));
+	full.add(3000, Poco::UInt64(0xC000000000000003ULL));
+	checkRoundTrip("XOR of length 64", full);
+
+	// an XOR with more than 31 leading zeros, which the 5 bits cannot
+	// hold, and an XOR that fits into the window of the one before
+	Series narrow;
+	narrow.add(0, Poco::UInt64(0));
+	narrow.add(1000, Poco::UInt64(1));
+	narrow.add(2000, Poco::UInt64(0x100000000ULL));
+	narrow.add(3000, Poco::UInt64(0x100000001ULL));
+	checkRoundTrip("XOR with more than 31 leading zeros", narrow);
+
+	Series special;
+	special.add(0, -0.0);
+	special.add(1000, 0.0);
+	special.add(2000, valueOf(0x7FF8000000000001ULL));
+	special.add(3000, valueOf(0xFFF0000000000000ULL));
+	checkRoundTrip("negative zero, NaN and infinity", special);
+
+	std::string message(encode(sensor, "ch1"));
+	bool refused = false;
+	try
+	{
+		std::string channel;
+		Series decoded;
+		SeriesDecoder::decode(message.substr(0, message.size()/2), channel, decoded.times, decoded.values);
+	}
+	catch (Poco::DataException&)
+	{
+		refused = true;
+	}
+	check(refused, "truncated series is refused");
+	check(!SeriesDecoder::isSeries("temp=21.5"), "text message is not a series");
+
+	std::cout << (failures ? "SeriesCodec checks FAILED" : "SeriesCodec checks passed") << std::endl;
+	return failures ? 1 : 0;
+}
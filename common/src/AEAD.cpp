@@ -0,0 +1,218 @@
+//
+// AEAD.cpp
+//
+// Implementation of the AEAD class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "AEAD.h"
+#include "Poco/Exception.h"
+#include "Poco/Buffer.h"
+#include "Poco/FileStream.h"
+#include "Poco/HexBinaryDecoder.h"
+#include "Poco/HexBinaryEncoder.h"
+#include "Poco/StreamCopier.h"
+#include <sstream>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/err.h>
+
+
+namespace
+{
+	void throwError(const std::string& what)
+	{
+		unsigned long err = ERR_get_error();
+		std::string msg(what);
+		if (err)
+		{
+			msg += ": ";
+			msg += ERR_error_string(err, 0);
+		}
+		throw Poco::IOException(msg);
+	}
+
+
+	class CipherContext
+		/// Frees the EVP_CIPHER_CTX when leaving scope.
+	{
+	public:
+		CipherContext(): _pCtx(EVP_CIPHER_CTX_new())
+		{
+			if (!_pCtx) throwError("EVP_CIPHER_CTX_new");
+		}
+
+		~CipherContext()
+		{
+			EVP_CIPHER_CTX_free(_pCtx);
+		}
+
+		EVP_CIPHER_CTX* get()
+		{
+			return _pCtx;
+		}
+
+	private:
+		EVP_CIPHER_CTX* _pCtx;
+	};
+
+
+	unsigned char* bytes(const std::string& str)
+	{
+		return reinterpret_cast<unsigned char*>(const_cast<char*>(str.data()));
+	}
+}
+
+
+std::string AEAD::seal(const std::string& key, const std::string& plain, const std::string& aad)
+{
+	if (key.size() != KEY_SIZE) throw Poco::InvalidArgumentException("AEAD key must be 32 bytes");
+
+	std::string iv(random(IV_SIZE));
+	Poco::Buffer<unsigned char> out(plain.size() + TAG_SIZE);
+	int len = 0;
+	int total = 0;
+
+	CipherContext ctx;
+	if (EVP_EncryptInit_ex(ctx.get(), EVP_aes_256_gcm(), 0, 0, 0) != 1
+	 || EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, IV_SIZE, 0) != 1
+	 || EVP_EncryptInit_ex(ctx.get(), 0, 0, bytes(key), bytes(iv)) != 1)
+		throwError("AES-GCM init");
+	if (!aad.empty() && EVP_EncryptUpdate(ctx.get(), 0, &len, bytes(aad), static_cast<int>(aad.size())) != 1)
+		throwError("AES-GCM aad");
+	if (EVP_EncryptUpdate(ctx.get(), out.begin(), &len, bytes(plain), static_cast<int>(plain.size())) != 1)
+		throwError("AES-GCM encrypt");
+	total = len;
+	if (EVP_EncryptFinal_ex(ctx.get(), out.begin() + total, &len) != 1)
+		throwError("AES-GCM final");
+	total += len;
+	if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_GET_TAG, TAG_SIZE, out.begin() + total) != 1)
+		throwError("AES-GCM tag");
+	total += TAG_SIZE;
+
+	iv.append(reinterpret_cast<const char*>(out.begin()), total);
+	return iv;
+}
+
+
+std::string AEAD::open(const std::string& key, const std::string& sealed, const std::string& aad)
+{
+	if (key.size() != KEY_SIZE) throw Poco::InvalidArgumentException("AEAD key must be 32 bytes");
+	if (sealed.size() < IV_SIZE + TAG_SIZE) throw Poco::DataFormatException("AEAD message truncated");
+
+	std::size_t cipherLen = sealed.size() - IV_SIZE - TAG_SIZE;
+	unsigned char* pIV = bytes(sealed);
+	unsigned char* pCipher = pIV + IV_SIZE;
+	unsigned char* pTag = pCipher + cipherLen;
+	Poco::Buffer<unsigned char> out(cipherLen + 1);
+	int len = 0;
+	int total = 0;
+
+	CipherContext ctx;
+	if (EVP_DecryptInit_ex(ctx.get(), EVP_aes_256_gcm(), 0, 0, 0) != 1
+	 || EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, IV_SIZE, 0) != 1
+	 || EVP_DecryptInit_ex(ctx.get(), 0, 0, bytes(key), pIV) != 1)
+		throwError("AES-GCM init");
+	if (!aad.empty() && EVP_DecryptUpdate(ctx.get(), 0, &len, bytes(aad), static_cast<int>(aad.size())) != 1)
+		throwError("AES-GCM aad");
+	if (EVP_DecryptUpdate(ctx.get(), out.begin(), &len, pCipher, static_cast<int>(cipherLen)) != 1)
+		throwError("AES-GCM decrypt");
+	total = len;
+	if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, TAG_SIZE, pTag) != 1)
+		throwError("AES-GCM tag");
+	if (EVP_DecryptFinal_ex(ctx.get(), out.begin() + total, &len) != 1)
+	{
+		ERR_clear_error();
+		throw Poco::DataFormatException("AEAD authentication failed");
+	}
+	total += len;
+
+	return std::string(reinterpret_cast<const char*>(out.begin()), total);
+}
+
+
+std::string AEAD::hmac(const std::string& key, const std::string& data)
+{
+	unsigned char mac[EVP_MAX_MD_SIZE];
+	unsigned int macLen = 0;
+	if (!HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()), bytes(data), data.size(), mac, &macLen))
+		throwError("HMAC");
+	return std::string(reinterpret_cast<const char*>(mac), macLen);
+}
+
+
+bool AEAD::equal(const std::string& a, const std::string& b)
+{
+	unsigned char diff = a.size() != b.size();
+	for (std::string::size_type i = 0; i < b.size(); ++i)
+	{
+		diff |= static_cast<unsigned char>(b[i] ^ (i < a.size() ? a[i] : 0));
+	}
+	return diff == 0;
+}
+
+
+std::string AEAD::hkdf(const std::string& ikm, const std::string& salt, const std::string& info, std::size_t length)
+{
+	const std::size_t hashLen = 32;
+	if (length > 255*hashLen) throw Poco::InvalidArgumentException("HKDF output too long");
+
+	// extract: PRK = HMAC(salt, IKM), an empty salt is a string of zeros
+	std::string saltKey(salt.empty() ? std::string(hashLen, '\0') : salt);
+	unsigned char prk[EVP_MAX_MD_SIZE];
+	unsigned int prkLen = 0;
+	if (!HMAC(EVP_sha256(), saltKey.data(), static_cast<int>(saltKey.size()), bytes(ikm), ikm.size(), prk, &prkLen))
+		throwError("HKDF extract");
+
+	// expand: T(i) = HMAC(PRK, T(i-1) || info || i)
+	std::string okm;
+	std::string block;
+	unsigned char t[EVP_MAX_MD_SIZE];
+	unsigned int tLen = 0;
+	for (unsigned char i = 1; okm.size() < length; ++i)
+	{
+		std::string input(block);
+		input += info;
+		input += static_cast<char>(i);
+		if (!HMAC(EVP_sha256(), prk, prkLen, bytes(input), input.size(), t, &tLen))
+			throwError("HKDF expand");
+		block.assign(reinterpret_cast<const char*>(t), tLen);
+		okm += block;
+	}
+	okm.resize(length);
+	return okm;
+}
+
+
+std::string AEAD::random(std::size_t length)
+{
+	std::string result(length, '\0');
+	if (length > 0 && RAND_bytes(bytes(result), static_cast<int>(length)) != 1)
+		throwError("RAND_bytes");
+	return result;
+}
+
+
+std::string AEAD::readKeyFile(const std::string& path)
+{
+	Poco::FileInputStream istr(path);
+	Poco::HexBinaryDecoder decoder(istr);
+	std::string key;
+	Poco::StreamCopier::copyToString(decoder, key);
+	if (key.size() != KEY_SIZE) throw Poco::DataFormatException("Key file must contain 32 hex-encoded bytes", path);
+	return key;
+}
+
+
+std::string AEAD::toHex(const std::string& key)
+{
+	std::ostringstream ostr;
+	Poco::HexBinaryEncoder encoder(ostr);
+	encoder.rdbuf()->setLineLength(0);
+	encoder << key;
+	encoder.close();
+	return ostr.str();
+}
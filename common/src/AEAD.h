@@ -0,0 +1,70 @@
+//
+// AEAD.h
+//
+// Definition of the AEAD class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef AEAD_INCLUDED
+#define AEAD_INCLUDED
+
+
+#include <string>
+#include <cstddef>
+
+
+class AEAD
+	/// Authenticated encryption (AES-256-GCM) and key derivation
+	/// (HKDF-SHA256, RFC 5869) built directly on OpenSSL's EVP and
+	/// HMAC interfaces, since Poco::Crypto 1.7 supports neither.
+	///
+	/// All buffers are binary strings. A sealed message has the
+	/// layout IV (12 bytes) || ciphertext || tag (16 bytes).
+{
+public:
+	enum
+	{
+		KEY_SIZE = 32,
+		IV_SIZE  = 12,
+		TAG_SIZE = 16
+	};
+
+	static std::string seal(const std::string& key, const std::string& plain, const std::string& aad = "");
+		/// Encrypts and authenticates plain (and aad) with the given
+		/// 32-byte key under a fresh random IV.
+
+	static std::string open(const std::string& key, const std::string& sealed, const std::string& aad = "");
+		/// Verifies and decrypts a message created by seal().
+		///
+		/// Throws a Poco::DataFormatException if the message is truncated
+		/// or fails authentication.
+
+	static std::string hkdf(const std::string& ikm, const std::string& salt, const std::string& info, std::size_t length = KEY_SIZE);
+		/// Derives length bytes of key material from ikm using
+		/// HKDF-SHA256 with the given salt and context info.
+
+	static std::string hmac(const std::string& key, const std::string& data);
+		/// Returns the HMAC-SHA256 of data with the given key.
+
+	static bool equal(const std::string& a, const std::string& b);
+		/// Compares two strings in a time that does not depend on
+		/// where they differ, for comparing MACs and tokens.
+
+	static std::string random(std::size_t length);
+		/// Returns length bytes from OpenSSL's CSPRNG.
+
+	static std::string readKeyFile(const std::string& path);
+		/// Reads a 32-byte key stored hex-encoded in the given file,
+		/// e.g. one created with "openssl rand -hex 32".
+
+	static std::string toHex(const std::string& key);
+		/// Returns the hex encoding of key, as expected by readKeyFile().
+
+private:
+	AEAD();
+};
+
+
+#endif // AEAD_INCLUDED
@@ -0,0 +1,139 @@
+//
+// ChunkedUpload.cpp
+//
+// Implementation of the ChunkedUpload class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ChunkedUpload.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberParser.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/StringTokenizer.h"
+#include <openssl/sha.h>
+#include <fstream>
+
+
+namespace
+{
+	std::string hex(const unsigned char* data, std::size_t length)
+	{
+		static const char DIGITS[] = "0123456789abcdef";
+		std::string result;
+		result.reserve(2*length);
+		for (std::size_t i = 0; i < length; ++i)
+		{
+			result += DIGITS[data[i] >> 4];
+			result += DIGITS[data[i] & 0x0F];
+		}
+		return result;
+	}
+}
+
+
+const std::string ChunkedUpload::PATH("/uploads/");
+
+
+std::string ChunkedUpload::sha256(const std::string& data)
+{
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), md);
+	return hex(md, sizeof(md));
+}
+
+
+std::string ChunkedUpload::sha256File(const std::string& path)
+{
+	std::ifstream istr(path.c_str(), std::ios::binary);
+	if (!istr) throw Poco::OpenFileException(path);
+	SHA256_CTX ctx;
+	SHA256_Init(&ctx);
+	std::vector<char> buffer(DEFAULT_CHUNK_SIZE);
+	while (istr)
+	{
+		istr.read(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+		if (istr.gcount() > 0) SHA256_Update(&ctx, &buffer[0], static_cast<std::size_t>(istr.gcount()));
+	}
+	if (istr.bad()) throw Poco::ReadFileException(path);
+	unsigned char md[SHA256_DIGEST_LENGTH];
+	SHA256_Final(md, &ctx);
+	return hex(md, sizeof(md));
+}
+
+
+std::string ChunkedUpload::id(const std::string& deviceId, const std::string& fileHash)
+{
+	return deviceId + "-" + fileHash.substr(0, 16);
+}
+
+
+bool ChunkedUpload::isValidId(const std::string& id)
+{
+	if (id.empty() || id[0] == '.') return false;
+	for (std::string::const_iterator it = id.begin(); it != id.end(); ++it)
+	{
+		char c = *it;
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.'))
+			return false;
+	}
+	return true;
+}
+
+
+std::size_t ChunkedUpload::chunks(Poco::UInt64 size, std::size_t chunkSize)
+{
+	// size + chunkSize - 1 could overflow
+	if (size == 0) return 1;
+	return static_cast<std::size_t>(size/chunkSize + (size % chunkSize != 0 ? 1 : 0));
+}
+
+
+std::size_t ChunkedUpload::chunkLength(Poco::UInt64 size, std::size_t chunkSize, std::size_t index)
+{
+	Poco::UInt64 offset = static_cast<Poco::UInt64>(index)*chunkSize;
+	if (offset >= size) return 0;
+	return size - offset < chunkSize ? static_cast<std::size_t>(size - offset) : chunkSize;
+}
+
+
+std::string ChunkedUpload::formatRanges(const std::vector<bool>& received)
+{
+	std::string result;
+	std::size_t i = 0;
+	while (i < received.size())
+	{
+		if (!received[i])
+		{
+			++i;
+			continue;
+		}
+		std::size_t first = i;
+		while (i < received.size() && received[i]) ++i;
+		if (!result.empty()) result += ',';
+		result += Poco::NumberFormatter::format(first);
+		if (i - 1 > first)
+		{
+			result += '-';
+			result += Poco::NumberFormatter::format(i - 1);
+		}
+	}
+	return result;
+}
+
+
+std::vector<bool> ChunkedUpload::parseRanges(const std::string& ranges, std::size_t chunks)
+{
+	std::vector<bool> received(chunks, false);
+	Poco::StringTokenizer tok(ranges, ",", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator it = tok.begin(); it != tok.end(); ++it)
+	{
+		std::string::size_type pos = it->find('-');
+		unsigned first = Poco::NumberParser::parseUnsigned(it->substr(0, pos));
+		unsigned last = pos == std::string::npos ? first : Poco::NumberParser::parseUnsigned(it->substr(pos + 1));
+		if (first > last || last >= chunks) throw Poco::SyntaxException("Chunk range out of bounds", *it);
+		for (unsigned i = first; i <= last; ++i) received[i] = true;
+	}
+	return received;
+}
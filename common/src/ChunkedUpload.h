@@ -0,0 +1,91 @@
+//
+// ChunkedUpload.h
+//
+// Definition of the ChunkedUpload class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ChunkedUpload_INCLUDED
+#define ChunkedUpload_INCLUDED
+
+
+#include "Poco/Types.h"
+#include <string>
+#include <vector>
+
+
+class ChunkedUpload
+	/// The protocol of resumable file uploads, shared by the client
+	/// (FileUploader) and the server (UploadStore).
+	///
+	/// A file is split into chunks of a fixed size between
+	/// MIN_CHUNK_SIZE and MAX_CHUNK_SIZE (the last one may be
+	/// shorter). Each chunk is encrypted like a message, with the
+	/// X-Encryption mode of the client (ecies or psk; rsa would
+	/// encrypt every chunk block by block with the public key and is
+	/// refused), and sent with
+	///
+	///     PUT /uploads/<id>/<index>
+	///     X-Upload-Size: <file size>
+	///     X-Chunk-Size: <chunk size>
+	///     X-File-Hash: <SHA-256 of the file, hex>
+	///     X-Chunk-Hash: <SHA-256 of the chunk before encryption, hex>
+	///
+	/// The server checks the chunk hash after decrypting, stores the
+	/// chunk and answers with X-Upload-Size, X-Chunk-Size and the
+	/// chunks it has in X-Received, for example "0-4,7". GET
+	/// /uploads/<id> returns the same headers (404 if the upload is
+	/// unknown), so an interrupted upload sends only the missing
+	/// chunks, with the chunk size it was started with. When all
+	/// chunks are there, the server checks the file hash and sets
+	/// X-Upload-Complete: true.
+	///
+	/// The id is "<device id>-<first 16 hex digits of the file hash>",
+	/// so uploading the same file again resumes the same upload.
+{
+public:
+	enum
+	{
+		MIN_CHUNK_SIZE     = 1024,
+		DEFAULT_CHUNK_SIZE = 65536,
+		MAX_CHUNK_SIZE     = 262144
+	};
+
+	static const std::string PATH;
+		/// The path prefix of uploads, "/uploads/".
+
+	static std::string sha256(const std::string& data);
+		/// Returns the SHA-256 of the data in hex.
+
+	static std::string sha256File(const std::string& path);
+		/// Returns the SHA-256 of the file in hex. Throws a
+		/// Poco::OpenFileException if it cannot be read.
+
+	static std::string id(const std::string& deviceId, const std::string& fileHash);
+		/// Returns the upload id of a file.
+
+	static bool isValidId(const std::string& id);
+		/// Returns true if the id is not empty and consists only of
+		/// letters, digits, '-', '_' and '.', and does not start
+		/// with '.', so it can be used as a file name.
+
+	static std::size_t chunks(Poco::UInt64 size, std::size_t chunkSize);
+		/// Returns the number of chunks of a file. An empty file has
+		/// one empty chunk.
+
+	static std::size_t chunkLength(Poco::UInt64 size, std::size_t chunkSize, std::size_t index);
+		/// Returns the length of the chunk with the given index.
+
+	static std::string formatRanges(const std::vector<bool>& received);
+		/// Returns the indexes of the received chunks as a list of
+		/// ranges, like "0-4,7". Empty if there are none.
+
+	static std::vector<bool> parseRanges(const std::string& ranges, std::size_t chunks);
+		/// Parses a list of ranges. Throws a Poco::SyntaxException if
+		/// it is malformed or an index is out of range.
+};
+
+
+#endif // ChunkedUpload_INCLUDED
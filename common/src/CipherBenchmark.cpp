@@ -0,0 +1,388 @@
+//
+// CipherBenchmark.cpp
+//
+// Implementation of the CipherBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "CipherBenchmark.h"
+#include "ECIESCipher.h"
+#include "AEAD.h"
+#include "Poco/Crypto/CipherFactory.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/Exception.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Stopwatch.h"
+#include <ctime>
+#include <iomanip>
+
+
+namespace
+{
+	class UnprotectWorker: public Poco::Runnable
+		/// Calls unprotect() of a case a given number of times.
+	{
+	public:
+		UnprotectWorker(BenchmarkCase& bc, const std::string& data, int iterations):
+			_bc(bc),
+			_data(data),
+			_iterations(iterations),
+			_failed(false)
+		{
+		}
+
+		void run()
+		{
+			try
+			{
+				for (int i = 0; i < _iterations; ++i)
+				{
+					_bc.unprotect(_data);
+				}
+			}
+			catch (...)
+			{
+				_failed = true;
+			}
+		}
+
+		bool failed() const
+		{
+			return _failed;
+		}
+
+	private:
+		BenchmarkCase& _bc;
+		std::string _data;
+		int _iterations;
+		bool _failed;
+	};
+}
+
+
+BenchmarkCase::~BenchmarkCase()
+{
+}
+
+
+int BenchmarkCase::messagesPerCall() const
+{
+	return 1;
+}
+
+
+RSABenchmarkCase::RSABenchmarkCase(const Poco::Crypto::RSAKey& key, bool hasPrivateKey, const std::string& name, bool perThread):
+	_cipher(key, hasPrivateKey && perThread),
+	_hasPrivateKey(hasPrivateKey),
+	_name(name)
+{
+}
+
+
+RSABenchmarkCase::~RSABenchmarkCase()
+{
+}
+
+
+std::string RSABenchmarkCase::name() const
+{
+	return _name;
+}
+
+
+std::string RSABenchmarkCase::protect(const std::string& message)
+{
+	return _cipher.encryptString(message);
+}
+
+
+std::string RSABenchmarkCase::unprotect(const std::string& data)
+{
+	return _cipher.decryptString(data);
+}
+
+
+bool RSABenchmarkCase::canUnprotect() const
+{
+	return _hasPrivateKey;
+}
+
+
+RSAReloadBenchmarkCase::RSAReloadBenchmarkCase(const std::string& privateKeyFile, const std::string& passphrase):
+	_privateKeyFile(privateKeyFile),
+	_passphrase(passphrase),
+	_pCipher(Poco::Crypto::CipherFactory::defaultFactory().createCipher(Poco::Crypto::RSAKey("", privateKeyFile, passphrase), RSA_PADDING_PKCS1))
+{
+}
+
+
+RSAReloadBenchmarkCase::~RSAReloadBenchmarkCase()
+{
+	delete _pCipher;
+}
+
+
+std::string RSAReloadBenchmarkCase::name() const
+{
+	return "rsa-reload";
+}
+
+
+std::string RSAReloadBenchmarkCase::protect(const std::string& message)
+{
+	return _pCipher->encryptString(message);
+}
+
+
+std::string RSAReloadBenchmarkCase::unprotect(const std::string& data)
+{
+	Poco::Crypto::Cipher* pCipher = Poco::Crypto::CipherFactory::defaultFactory().createCipher(Poco::Crypto::RSAKey("", _privateKeyFile, _passphrase), RSA_PADDING_PKCS1);
+	std::string result;
+	try
+	{
+		result = pCipher->decryptString(data);
+	}
+	catch (...)
+	{
+		delete pCipher;
+		throw;
+	}
+	delete pCipher;
+	return result;
+}
+
+
+bool RSAReloadBenchmarkCase::canUnprotect() const
+{
+	return true;
+}
+
+
+ECIESBenchmarkCase::ECIESBenchmarkCase(const Poco::SharedPtr<ECIESCipher>& pCipher):
+	_pCipher(pCipher)
+{
+}
+
+
+ECIESBenchmarkCase::~ECIESBenchmarkCase()
+{
+}
+
+
+std::string ECIESBenchmarkCase::name() const
+{
+	return "ecies";
+}
+
+
+std::string ECIESBenchmarkCase::protect(const std::string& message)
+{
+	return _pCipher->encryptString(message);
+}
+
+
+std::string ECIESBenchmarkCase::unprotect(const std::string& data)
+{
+	return _pCipher->decryptString(data);
+}
+
+
+bool ECIESBenchmarkCase::canUnprotect() const
+{
+	return _pCipher->hasPrivateKey();
+}
+
+
+PSKBenchmarkCase::PSKBenchmarkCase(const std::string& deviceId, const std::string& deviceKey):
+	_deviceId(deviceId),
+	_deviceKey(deviceKey)
+{
+}
+
+
+PSKBenchmarkCase::~PSKBenchmarkCase()
+{
+}
+
+
+std::string PSKBenchmarkCase::name() const
+{
+	return "psk";
+}
+
+
+std::string PSKBenchmarkCase::protect(const std::string& message)
+{
+	return AEAD::seal(_deviceKey, message, _deviceId);
+}
+
+
+std::string PSKBenchmarkCase::unprotect(const std::string& data)
+{
+	return AEAD::open(_deviceKey, data, _deviceId);
+}
+
+
+bool PSKBenchmarkCase::canUnprotect() const
+{
+	return true;
+}
+
+
+SignBenchmarkCase::SignBenchmarkCase(const std::string& deviceId, const ECDSAKey::Ptr& pSigningKey, const ECDSAKey::Ptr& pVerifyingKey, int batchSize):
+	_deviceId(deviceId),
+	_pSigningKey(pSigningKey),
+	_pVerifyingKey(pVerifyingKey),
+	_batchSize(batchSize > 0 ? batchSize : 1)
+{
+}
+
+
+SignBenchmarkCase::~SignBenchmarkCase()
+{
+}
+
+
+std::string SignBenchmarkCase::name() const
+{
+	return "sign-" + Poco::NumberFormatter::format(_batchSize);
+}
+
+
+std::string SignBenchmarkCase::protect(const std::string& message)
+{
+	SignedBatch batch;
+	TelemetryRecord record;
+	record.payload = message;
+	for (int i = 0; i < _batchSize; ++i)
+	{
+		record.sequence = i;
+		record.timestamp = 1000*i;
+		batch.add(record);
+	}
+	return batch.seal(_deviceId, *_pSigningKey);
+}
+
+
+std::string SignBenchmarkCase::unprotect(const std::string& data)
+{
+	SignedBatch batch = SignedBatch::open(_deviceId, data, *_pVerifyingKey);
+	return batch.records().front().payload;
+}
+
+
+bool SignBenchmarkCase::canUnprotect() const
+{
+	return !_pVerifyingKey.isNull();
+}
+
+
+int SignBenchmarkCase::messagesPerCall() const
+{
+	return _batchSize;
+}
+
+
+CipherBenchmark::CipherBenchmark(int iterations, const std::string& message):
+	_iterations(iterations > 0 ? iterations : 1),
+	_message(message)
+{
+}
+
+
+CipherBenchmark::~CipherBenchmark()
+{
+}
+
+
+void CipherBenchmark::add(const BenchmarkCase::Ptr& pCase)
+{
+	_cases.push_back(pCase);
+}
+
+
+void CipherBenchmark::run(std::ostream& ostr)
+{
+	ostr << "mode         protect[us]  unprotect[us]  bytes" << std::endl;
+	for (std::vector<BenchmarkCase::Ptr>::iterator it = _cases.begin(); it != _cases.end(); ++it)
+	{
+		BenchmarkCase& bc = **it;
+		std::string data;
+
+		std::clock_t start = std::clock();
+		for (int i = 0; i < _iterations; ++i)
+		{
+			data = bc.protect(_message);
+		}
+		double protectMicros = cpuMicros(std::clock() - start, _iterations*bc.messagesPerCall());
+
+		std::string unprotectText("-");
+		if (bc.canUnprotect())
+		{
+			start = std::clock();
+			for (int i = 0; i < _iterations; ++i)
+			{
+				if (bc.unprotect(data) != _message)
+					throw Poco::DataException("Benchmark round trip failed", bc.name());
+			}
+			unprotectText = Poco::NumberFormatter::format(cpuMicros(std::clock() - start, _iterations*bc.messagesPerCall()), 1);
+		}
+
+		ostr << std::left << std::setw(13) << bc.name() << std::right
+		     << std::setw(11) << Poco::NumberFormatter::format(protectMicros, 1)
+		     << "  " << std::setw(13) << unprotectText
+		     << "  " << std::setw(5) << data.size()/bc.messagesPerCall()
+		     << std::endl;
+	}
+}
+
+
+void CipherBenchmark::runScaling(std::ostream& ostr, const std::vector<int>& threadCounts, RunCallback afterRun)
+{
+	ostr << "mode         threads      msgs/s" << std::endl;
+	for (std::vector<BenchmarkCase::Ptr>::iterator it = _cases.begin(); it != _cases.end(); ++it)
+	{
+		BenchmarkCase& bc = **it;
+		if (!bc.canUnprotect()) continue;
+
+		std::string data(bc.protect(_message));
+		for (std::vector<int>::const_iterator itN = threadCounts.begin(); itN != threadCounts.end(); ++itN)
+		{
+			int n = *itN;
+			std::vector<Poco::SharedPtr<UnprotectWorker> > workers;
+			std::vector<Poco::SharedPtr<Poco::Thread> > threads;
+			for (int i = 0; i < n; ++i)
+			{
+				workers.push_back(new UnprotectWorker(bc, data, _iterations));
+				threads.push_back(new Poco::Thread);
+			}
+
+			Poco::Stopwatch sw;
+			sw.start();
+			for (int i = 0; i < n; ++i) threads[i]->start(*workers[i]);
+			for (int i = 0; i < n; ++i) threads[i]->join();
+			sw.stop();
+
+			for (int i = 0; i < n; ++i)
+			{
+				if (workers[i]->failed()) throw Poco::DataException("Benchmark worker failed", bc.name());
+			}
+
+			double perSecond = sw.elapsed() > 0 ? static_cast<double>(n)*_iterations*bc.messagesPerCall()*1e6/sw.elapsed() : 0;
+			ostr << std::left << std::setw(13) << bc.name() << std::right
+			     << std::setw(7) << n
+			     << std::setw(12) << Poco::NumberFormatter::format(perSecond, 0)
+			     << std::endl;
+			if (afterRun) afterRun(ostr);
+		}
+	}
+}
+
+
+double CipherBenchmark::cpuMicros(long clocks, int iterations)
+{
+	return 1e6*static_cast<double>(clocks)/CLOCKS_PER_SEC/iterations;
+}
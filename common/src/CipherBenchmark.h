@@ -0,0 +1,199 @@
+//
+// CipherBenchmark.h
+//
+// Definition of the CipherBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef CipherBenchmark_INCLUDED
+#define CipherBenchmark_INCLUDED
+
+
+#include "Poco/Crypto/Cipher.h"
+#include "Poco/Crypto/RSAKey.h"
+#include "Poco/SharedPtr.h"
+#include "PerThreadRSACipher.h"
+#include "SignedBatch.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+class ECIESCipher;
+
+
+class BenchmarkCase
+	/// A payload protection mode measured by CipherBenchmark.
+	///
+	/// protect() is the sending (client) side operation, unprotect()
+	/// the receiving (server) side operation.
+{
+public:
+	typedef Poco::SharedPtr<BenchmarkCase> Ptr;
+
+	virtual ~BenchmarkCase();
+
+	virtual std::string name() const = 0;
+		/// Returns the name printed in the report.
+
+	virtual std::string protect(const std::string& message) = 0;
+		/// Encrypts (or signs) the message.
+
+	virtual std::string unprotect(const std::string& data) = 0;
+		/// Decrypts (or verifies) data created by protect().
+
+	virtual bool canUnprotect() const = 0;
+		/// Returns true if the key material for unprotect() is available.
+		///
+		/// unprotect() must be thread-safe for runScaling().
+
+	virtual int messagesPerCall() const;
+		/// Returns the number of messages handled by one protect() or
+		/// unprotect() call, for cases that work on batches. The
+		/// default is 1.
+};
+
+
+class RSABenchmarkCase: public BenchmarkCase
+	/// The existing RSACipherImpl path, with the key loaded once and
+	/// either shared by all threads or copied per thread (see
+	/// PerThreadRSACipher).
+{
+public:
+	RSABenchmarkCase(const Poco::Crypto::RSAKey& key, bool hasPrivateKey, const std::string& name = "rsa", bool perThread = false);
+	~RSABenchmarkCase();
+
+	std::string name() const;
+	std::string protect(const std::string& message);
+	std::string unprotect(const std::string& data);
+	bool canUnprotect() const;
+
+private:
+	PerThreadRSACipher _cipher;
+	bool _hasPrivateKey;
+	std::string _name;
+};
+
+
+class RSAReloadBenchmarkCase: public BenchmarkCase
+	/// The RSACipherImpl path with the private key read from its
+	/// (passphrase-protected) PEM file for every message.
+{
+public:
+	RSAReloadBenchmarkCase(const std::string& privateKeyFile, const std::string& passphrase);
+	~RSAReloadBenchmarkCase();
+
+	std::string name() const;
+	std::string protect(const std::string& message);
+	std::string unprotect(const std::string& data);
+	bool canUnprotect() const;
+
+private:
+	std::string _privateKeyFile;
+	std::string _passphrase;
+	Poco::Crypto::Cipher* _pCipher;
+};
+
+
+class ECIESBenchmarkCase: public BenchmarkCase
+	/// The ECIES (P-256 + AES-GCM) path.
+{
+public:
+	explicit ECIESBenchmarkCase(const Poco::SharedPtr<ECIESCipher>& pCipher);
+	~ECIESBenchmarkCase();
+
+	std::string name() const;
+	std::string protect(const std::string& message);
+	std::string unprotect(const std::string& data);
+	bool canUnprotect() const;
+
+private:
+	Poco::SharedPtr<ECIESCipher> _pCipher;
+};
+
+
+class PSKBenchmarkCase: public BenchmarkCase
+	/// The per-device key (HKDF + AES-GCM) path. Unprotecting opens
+	/// the payload with the device key; the server measures the lookup
+	/// in its DeviceKeyStore too, with a subclass.
+{
+public:
+	PSKBenchmarkCase(const std::string& deviceId, const std::string& deviceKey);
+	~PSKBenchmarkCase();
+
+	std::string name() const;
+	std::string protect(const std::string& message);
+	std::string unprotect(const std::string& data);
+	bool canUnprotect() const;
+
+private:
+	std::string _deviceId;
+	std::string _deviceKey;
+};
+
+
+class SignBenchmarkCase: public BenchmarkCase
+	/// The sign-only path: batches of telemetry records signed once
+	/// with ECDSA. Costs are reported per record.
+{
+public:
+	SignBenchmarkCase(const std::string& deviceId, const ECDSAKey::Ptr& pSigningKey, const ECDSAKey::Ptr& pVerifyingKey, int batchSize);
+	~SignBenchmarkCase();
+
+	std::string name() const;
+	std::string protect(const std::string& message);
+	std::string unprotect(const std::string& data);
+	bool canUnprotect() const;
+	int messagesPerCall() const;
+
+private:
+	std::string _deviceId;
+	ECDSAKey::Ptr _pSigningKey;
+	ECDSAKey::Ptr _pVerifyingKey;
+	int _batchSize;
+};
+
+
+class CipherBenchmark
+	/// Measures the per-message CPU time of each registered
+	/// BenchmarkCase on the machine it runs on, so that the
+	/// encryption modes can be compared on both the Pi (protect)
+	/// and the server (unprotect).
+{
+public:
+	CipherBenchmark(int iterations, const std::string& message);
+		/// Creates the CipherBenchmark. Each case is run the given
+		/// number of times on the given message.
+
+	~CipherBenchmark();
+		/// Destroys the CipherBenchmark.
+
+	void add(const BenchmarkCase::Ptr& pCase);
+		/// Registers a case.
+
+	void run(std::ostream& ostr);
+		/// Runs all cases and writes one line per case with the
+		/// average CPU microseconds per message for each side and the
+		/// size of the protected message (per message for batches).
+
+	typedef void (*RunCallback)(std::ostream& ostr);
+
+	void runScaling(std::ostream& ostr, const std::vector<int>& threadCounts, RunCallback afterRun = 0);
+		/// Runs unprotect() of all cases concurrently in each of the
+		/// given numbers of threads, each thread doing the configured
+		/// number of iterations, and writes the aggregate throughput
+		/// in messages per second. If given, afterRun is called after
+		/// every run, e.g. to report lock statistics.
+
+private:
+	static double cpuMicros(long clocks, int iterations);
+
+	int _iterations;
+	std::string _message;
+	std::vector<BenchmarkCase::Ptr> _cases;
+};
+
+
+#endif // CipherBenchmark_INCLUDED
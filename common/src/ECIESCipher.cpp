@@ -0,0 +1,159 @@
+//
+// ECIESCipher.cpp
+//
+// Implementation of the ECIESCipher class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "ECIESCipher.h"
+#include "AEAD.h"
+#include "Poco/Exception.h"
+#include <openssl/ecdh.h>
+#include <openssl/obj_mac.h>
+#include <openssl/pem.h>
+#include <openssl/err.h>
+
+
+namespace
+{
+	const std::string KDF_INFO("ECIES-P256-HKDF-SHA256-AES256GCM");
+
+
+	class ECKeyHolder
+		/// Frees an EC_KEY when leaving scope.
+	{
+	public:
+		explicit ECKeyHolder(EC_KEY* pKey): _pKey(pKey)
+		{
+		}
+
+		~ECKeyHolder()
+		{
+			if (_pKey) EC_KEY_free(_pKey);
+		}
+
+		EC_KEY* get() const
+		{
+			return _pKey;
+		}
+
+	private:
+		EC_KEY* _pKey;
+	};
+
+
+	class ECPointHolder
+		/// Frees an EC_POINT when leaving scope.
+	{
+	public:
+		explicit ECPointHolder(EC_POINT* pPoint): _pPoint(pPoint)
+		{
+		}
+
+		~ECPointHolder()
+		{
+			if (_pPoint) EC_POINT_free(_pPoint);
+		}
+
+		EC_POINT* get() const
+		{
+			return _pPoint;
+		}
+
+	private:
+		EC_POINT* _pPoint;
+	};
+
+
+	EC_KEY* readKey(const std::string& file, bool isPrivate, const std::string& passphrase)
+	{
+		BIO* pBIO = BIO_new_file(file.c_str(), "r");
+		if (!pBIO) throw Poco::OpenFileException("ECIES key file", file);
+
+		EC_KEY* pKey = 0;
+		if (isPrivate)
+			pKey = PEM_read_bio_ECPrivateKey(pBIO, 0, 0, passphrase.empty() ? 0 : const_cast<char*>(passphrase.c_str()));
+		else
+			pKey = PEM_read_bio_EC_PUBKEY(pBIO, 0, 0, 0);
+		BIO_free(pBIO);
+
+		if (!pKey) throw Poco::ReadFileException("Cannot read ECIES key", file);
+		return pKey;
+	}
+}
+
+
+ECIESCipher::ECIESCipher(const std::string& publicKeyFile, const std::string& privateKeyFile, const std::string& privateKeyPassphrase):
+	_pKey(0),
+	_hasPrivateKey(!privateKeyFile.empty())
+{
+	if (_hasPrivateKey)
+		_pKey = readKey(privateKeyFile, true, privateKeyPassphrase);
+	else
+		_pKey = readKey(publicKeyFile, false, "");
+
+	const EC_GROUP* pGroup = EC_KEY_get0_group(_pKey);
+	if (!pGroup || EC_GROUP_get_curve_name(pGroup) != NID_X9_62_prime256v1)
+	{
+		EC_KEY_free(_pKey);
+		throw Poco::InvalidArgumentException("ECIES key must be on curve prime256v1");
+	}
+}
+
+
+ECIESCipher::~ECIESCipher()
+{
+	EC_KEY_free(_pKey);
+}
+
+
+std::string ECIESCipher::encryptString(const std::string& str) const
+{
+	const EC_GROUP* pGroup = EC_KEY_get0_group(_pKey);
+	ECKeyHolder ephemeral(EC_KEY_new());
+	if (!ephemeral.get() || EC_KEY_set_group(ephemeral.get(), pGroup) != 1 || EC_KEY_generate_key(ephemeral.get()) != 1)
+		throw Poco::IOException("Cannot generate ephemeral ECIES key", ERR_error_string(ERR_get_error(), 0));
+
+	unsigned char point[POINT_SIZE];
+	if (EC_POINT_point2oct(pGroup, EC_KEY_get0_public_key(ephemeral.get()), POINT_CONVERSION_UNCOMPRESSED, point, POINT_SIZE, 0) != POINT_SIZE)
+		throw Poco::IOException("Cannot encode ephemeral ECIES key");
+	std::string result(reinterpret_cast<const char*>(point), POINT_SIZE);
+
+	std::string key(deriveKey(ephemeral.get(), EC_KEY_get0_public_key(_pKey), result));
+	result += AEAD::seal(key, str, result);
+	return result;
+}
+
+
+std::string ECIESCipher::decryptString(const std::string& str) const
+{
+	if (!_hasPrivateKey) throw Poco::IllegalStateException("ECIES decryption requires the private key");
+	if (str.size() < POINT_SIZE) throw Poco::DataFormatException("ECIES message truncated");
+
+	const EC_GROUP* pGroup = EC_KEY_get0_group(_pKey);
+	std::string ephemeral(str, 0, POINT_SIZE);
+	ECPointHolder peer(EC_POINT_new(pGroup));
+	if (!peer.get() || EC_POINT_oct2point(pGroup, peer.get(), reinterpret_cast<const unsigned char*>(ephemeral.data()), POINT_SIZE, 0) != 1)
+	{
+		ERR_clear_error();
+		throw Poco::DataFormatException("Invalid ECIES ephemeral key");
+	}
+
+	std::string key(deriveKey(_pKey, peer.get(), ephemeral));
+	return AEAD::open(key, str.substr(POINT_SIZE), ephemeral);
+}
+
+
+std::string ECIESCipher::deriveKey(const EC_KEY* pPrivate, const EC_POINT* pPeer, const std::string& ephemeral)
+{
+	unsigned char secret[32];
+	int len = ECDH_compute_key(secret, sizeof(secret), pPeer, const_cast<EC_KEY*>(pPrivate), 0);
+	if (len <= 0)
+	{
+		ERR_clear_error();
+		throw Poco::DataFormatException("ECIES key agreement failed");
+	}
+	return AEAD::hkdf(std::string(reinterpret_cast<const char*>(secret), len), ephemeral, KDF_INFO);
+}
@@ -0,0 +1,88 @@
+//
+// ECIESCipher.h
+//
+// Definition of the ECIESCipher class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef ECIESCipher_INCLUDED
+#define ECIESCipher_INCLUDED
+
+
+#include "Poco/Crypto/OpenSSLInitializer.h"
+#include <openssl/ec.h>
+#include <string>
+
+
+class ECIESCipher
+	/// Stateless per-message hybrid encryption against a static
+	/// elliptic curve key, as a cheaper alternative to encrypting
+	/// every message with RSA.
+	///
+	/// For each message the sender generates an ephemeral P-256 key,
+	/// performs ECDH with the recipient's static public key, derives
+	/// an AES-256 key with HKDF-SHA256 and seals the payload with
+	/// AES-GCM (see AEAD). The wire format is
+	///
+	///     ephemeral public point (65 bytes, uncompressed) || AEAD message
+	///
+	/// The bundled OpenSSL 1.0.2 has no X25519, so NIST P-256 is used
+	/// for the key agreement.
+	///
+	/// Encryption only needs the public key (EccPublik.pem on the
+	/// client), decryption requires the private key (ecc.pem on the
+	/// server). An ECIESCipher is immutable after construction and
+	/// can be shared between threads.
+{
+public:
+	enum
+	{
+		POINT_SIZE = 65
+	};
+
+	ECIESCipher(const std::string& publicKeyFile, const std::string& privateKeyFile = "", const std::string& privateKeyPassphrase = "");
+		/// Creates the ECIESCipher, reading the public key and/or the
+		/// private key from the given PEM files.
+		///
+		/// If a private key is given, the public key file may be empty.
+
+	~ECIESCipher();
+		/// Destroys the ECIESCipher.
+
+	std::string encryptString(const std::string& str) const;
+		/// Encrypts the given message for the holder of the private key.
+
+	std::string decryptString(const std::string& str) const;
+		/// Decrypts a message created by encryptString().
+		///
+		/// Throws a Poco::IllegalStateException if no private key is
+		/// available and a Poco::DataFormatException if the message is
+		/// malformed or fails authentication.
+
+	bool hasPrivateKey() const;
+		/// Returns true if the cipher can decrypt.
+
+private:
+	ECIESCipher(const ECIESCipher&);
+	ECIESCipher& operator = (const ECIESCipher&);
+
+	static std::string deriveKey(const EC_KEY* pPrivate, const EC_POINT* pPeer, const std::string& ephemeral);
+
+	EC_KEY* _pKey;
+	bool _hasPrivateKey;
+	Poco::Crypto::OpenSSLInitializer _openSSLInitializer;
+};
+
+
+//
+// inlines
+//
+inline bool ECIESCipher::hasPrivateKey() const
+{
+	return _hasPrivateKey;
+}
+
+
+#endif // ECIESCipher_INCLUDED
@@ -0,0 +1,438 @@
+//
+// FaultProxy.cpp
+//
+// Implementation of the FaultProxy class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "FaultProxy.h"
+#include "Poco/Net/Socket.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberParser.h"
+#include "Poco/StringTokenizer.h"
+#include <algorithm>
+#include <errno.h>
+
+
+namespace
+{
+	bool contains(const Poco::Net::Socket::SocketList& list, const Poco::Net::Socket& socket)
+	{
+		return std::find(list.begin(), list.end(), socket) != list.end();
+	}
+
+
+	void abort(Poco::Net::StreamSocket& socket)
+		/// Closes the socket with RST instead of FIN.
+	{
+		try
+		{
+			socket.setLinger(true, 0);
+			socket.close();
+		}
+		catch (Poco::Exception&)
+		{
+		}
+	}
+}
+
+
+FaultProxy::Faults::Faults():
+	latency(0),
+	jitter(0),
+	bandwidth(0),
+	loss(0),
+	rto(200),
+	reset(0),
+	drop(0),
+	down(false),
+	stall(false)
+{
+}
+
+
+FaultProxy::Direction::Direction():
+	queued(0),
+	eof(false)
+{
+}
+
+
+FaultProxy::Script FaultProxy::parse(const std::string& script)
+{
+	Script result;
+	Poco::StringTokenizer phases(script, ";", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+	for (Poco::StringTokenizer::Iterator itPhase = phases.begin(); itPhase != phases.end(); ++itPhase)
+	{
+		Phase phase;
+		phase.duration = Poco::Timespan(10, 0);
+		Poco::StringTokenizer items(*itPhase, " \t", Poco::StringTokenizer::TOK_TRIM | Poco::StringTokenizer::TOK_IGNORE_EMPTY);
+		for (Poco::StringTokenizer::Iterator it = items.begin(); it != items.end(); ++it)
+		{
+			std::string::size_type pos = it->find('=');
+			std::string key(it->substr(0, pos));
+			std::string value(pos == std::string::npos ? std::string() : it->substr(pos + 1));
+			if (key == "down" && value.empty())
+				phase.faults.down = true;
+			else if (key == "stall" && value.empty())
+				phase.faults.stall = true;
+			else if (value.empty())
+				throw Poco::SyntaxException("Fault without a value", *it);
+			else if (key == "for")
+				phase.duration = Poco::Timespan(static_cast<Poco::Timespan::TimeDiff>(Poco::NumberParser::parseFloat(value)*Poco::Timespan::SECONDS));
+			else if (key == "latency")
+				phase.faults.latency = Poco::NumberParser::parse(value);
+			else if (key == "jitter")
+				phase.faults.jitter = Poco::NumberParser::parse(value);
+			else if (key == "bandwidth")
+				phase.faults.bandwidth = Poco::NumberParser::parse(value);
+			else if (key == "loss")
+				phase.faults.loss = Poco::NumberParser::parseFloat(value);
+			else if (key == "rto")
+				phase.faults.rto = Poco::NumberParser::parse(value);
+			else if (key == "reset")
+				phase.faults.reset = Poco::NumberParser::parseFloat(value);
+			else if (key == "drop")
+				phase.faults.drop = Poco::NumberParser::parse(value);
+			else
+				throw Poco::SyntaxException("Unknown fault", key);
+		}
+		result.push_back(phase);
+	}
+	return result;
+}
+
+
+FaultProxy::FaultProxy(const Poco::Net::SocketAddress& address, const Poco::Net::SocketAddress& target):
+	_socket(address),
+	_target(target),
+	_nextDrop(0),
+	_stopped(false),
+	_accepted(0),
+	_resets(0)
+{
+	_random.seed();
+}
+
+
+FaultProxy::~FaultProxy()
+{
+	try
+	{
+		stop();
+	}
+	catch (...)
+	{
+		poco_unexpected();
+	}
+}
+
+
+void FaultProxy::start()
+{
+	_stopped = false;
+	_thread.start(*this);
+}
+
+
+void FaultProxy::stop()
+{
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		_stopped = true;
+	}
+	if (_thread.isRunning()) _thread.join();
+}
+
+
+Poco::Net::SocketAddress FaultProxy::address() const
+{
+	return _socket.address();
+}
+
+
+void FaultProxy::setFaults(const Faults& faults)
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	_faults = faults;
+}
+
+
+FaultProxy::Faults FaultProxy::getFaults() const
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _faults;
+}
+
+
+void FaultProxy::play(const Script& script)
+{
+	for (Script::const_iterator it = script.begin(); it != script.end(); ++it)
+	{
+		setFaults(it->faults);
+		Poco::Thread::sleep(static_cast<long>(it->duration.totalMilliseconds()));
+	}
+	setFaults(Faults());
+}
+
+
+int FaultProxy::connections() const
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _accepted;
+}
+
+
+int FaultProxy::resets() const
+{
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	return _resets;
+}
+
+
+void FaultProxy::run()
+{
+	for (;;)
+	{
+		Faults faults;
+		{
+			Poco::FastMutex::ScopedLock lock(_mutex);
+			if (_stopped) break;
+			faults = _faults;
+		}
+
+		Poco::Timestamp now;
+		if (faults.down) resetAll();
+		if (faults.drop <= 0)
+		{
+			_nextDrop = 0;
+		}
+		else if (_nextDrop == 0)
+		{
+			_nextDrop = now + static_cast<Poco::Timestamp::TimeDiff>(faults.drop)*Poco::Timespan::SECONDS;
+		}
+		else if (_nextDrop <= now)
+		{
+			resetAll();
+			_nextDrop = now + static_cast<Poco::Timestamp::TimeDiff>(faults.drop)*Poco::Timespan::SECONDS;
+		}
+
+		// wait for the sockets that can take or give data, or for
+		// the next segment that becomes due
+		Poco::Net::Socket::SocketList readList;
+		Poco::Net::Socket::SocketList writeList;
+		Poco::Net::Socket::SocketList exceptList;
+		Poco::Timestamp::TimeDiff wait = 50*Poco::Timespan::MILLISECONDS;
+		readList.push_back(_socket);
+		for (std::vector<Connection*>::iterator it = _connections.begin(); it != _connections.end(); ++it)
+		{
+			Connection& c = **it;
+			if (c.connecting)
+			{
+				writeList.push_back(c.server);
+				continue;
+			}
+			if (!c.up.eof && c.up.queued < MAX_QUEUED) readList.push_back(c.client);
+			if (!c.down.eof && c.down.queued < MAX_QUEUED) readList.push_back(c.server);
+			if (!c.up.segments.empty())
+			{
+				if (c.up.segments.front().due <= now) writeList.push_back(c.server);
+				else wait = std::min(wait, c.up.segments.front().due - now);
+			}
+			if (!c.down.segments.empty() && !faults.stall)
+			{
+				if (c.down.segments.front().due <= now) writeList.push_back(c.client);
+				else wait = std::min(wait, c.down.segments.front().due - now);
+			}
+		}
+		Poco::Net::Socket::select(readList, writeList, exceptList, Poco::Timespan(wait));
+
+		if (contains(readList, _socket)) accept(faults);
+		std::vector<Connection*>::iterator it = _connections.begin();
+		while (it != _connections.end())
+		{
+			Connection& c = **it;
+			bool ok = true;
+			if (c.connecting)
+			{
+				if (contains(writeList, c.server))
+				{
+					ok = c.server.impl()->socketError() == 0;
+					if (ok) connected(c);
+				}
+			}
+			else
+			{
+				if (ok && contains(readList, c.client)) ok = receive(c.client, c.up, faults);
+				if (ok && contains(readList, c.server)) ok = receive(c.server, c.down, faults);
+				if (ok && contains(writeList, c.server)) ok = send(c.server, c.up);
+				if (ok && contains(writeList, c.client)) ok = send(c.client, c.down);
+			}
+			if (!ok)
+			{
+				reset(c);
+				it = _connections.erase(it);
+			}
+			else if ((c.up.eof && c.up.segments.empty()) || (c.down.eof && c.down.segments.empty()))
+			{
+				// one side has closed and all it sent is delivered
+				close(c);
+				it = _connections.erase(it);
+			}
+			else ++it;
+		}
+	}
+	resetAll();
+}
+
+
+void FaultProxy::accept(const Faults& faults)
+{
+	Poco::Net::StreamSocket client(_socket.acceptConnection());
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		++_accepted;
+	}
+	if (faults.down)
+	{
+		Poco::FastMutex::ScopedLock lock(_mutex);
+		abort(client);
+		++_resets;
+		return;
+	}
+	Connection* pConnection = new Connection;
+	pConnection->client = client;
+	pConnection->client.setBlocking(false);
+	pConnection->client.setNoDelay(true);
+	pConnection->connecting = true;
+	try
+	{
+		pConnection->server.connectNB(_target);
+	}
+	catch (Poco::Exception&)
+	{
+		reset(*pConnection);
+		return;
+	}
+	_connections.push_back(pConnection);
+}
+
+
+void FaultProxy::connected(Connection& connection)
+{
+	connection.connecting = false;
+	connection.server.setNoDelay(true);
+}
+
+
+bool FaultProxy::receive(Poco::Net::StreamSocket& socket, Direction& direction, const Faults& faults)
+{
+	char buffer[BUFFER_SIZE];
+	int n;
+	try
+	{
+		n = socket.receiveBytes(buffer, sizeof(buffer));
+	}
+	catch (Poco::Exception&)
+	{
+		return false;
+	}
+	if (n < 0) return true;
+	if (n == 0)
+	{
+		direction.eof = true;
+		return true;
+	}
+	if (faults.reset > 0 && _random.nextDouble() < faults.reset) return false;
+
+	Poco::Timestamp start;
+	if (faults.bandwidth > 0)
+	{
+		// the segment leaves when the link has sent the ones before
+		// and itself
+		if (direction.free > start) start = direction.free;
+		direction.free = start + static_cast<Poco::Timestamp::TimeDiff>(n)*Poco::Timespan::SECONDS/faults.bandwidth;
+		start = direction.free;
+	}
+	Poco::Timestamp::TimeDiff delay = static_cast<Poco::Timestamp::TimeDiff>(faults.latency)*Poco::Timespan::MILLISECONDS;
+	if (faults.jitter > 0)
+		delay += static_cast<Poco::Timestamp::TimeDiff>(_random.next(faults.jitter + 1))*Poco::Timespan::MILLISECONDS;
+	if (faults.loss > 0 && _random.nextDouble() < faults.loss)
+		delay += static_cast<Poco::Timestamp::TimeDiff>(faults.rto)*Poco::Timespan::MILLISECONDS;
+
+	Segment segment;
+	segment.data.assign(buffer, n);
+	segment.due = start + delay;
+	// a stream delivers in order, so a segment cannot overtake one
+	// that has been delayed more
+	if (segment.due < direction.last) segment.due = direction.last;
+	direction.last = segment.due;
+	direction.queued += n;
+	direction.segments.push_back(segment);
+	return true;
+}
+
+
+bool FaultProxy::send(Poco::Net::StreamSocket& socket, Direction& direction)
+{
+	Poco::Timestamp now;
+	while (!direction.segments.empty() && direction.segments.front().due <= now)
+	{
+		Segment& segment = direction.segments.front();
+		int n;
+		try
+		{
+			n = socket.sendBytes(segment.data.data(), static_cast<int>(segment.data.size()));
+		}
+		catch (Poco::IOException& exc)
+		{
+			if (exc.code() == EAGAIN || exc.code() == EWOULDBLOCK) return true;
+			return false;
+		}
+		if (n <= 0) return true;
+		direction.queued -= n;
+		if (static_cast<std::size_t>(n) < segment.data.size())
+		{
+			segment.data.erase(0, n);
+			return true;
+		}
+		direction.segments.pop_front();
+	}
+	return true;
+}
+
+
+void FaultProxy::reset(Connection& connection)
+{
+	abort(connection.client);
+	abort(connection.server);
+	delete &connection;
+	Poco::FastMutex::ScopedLock lock(_mutex);
+	++_resets;
+}
+
+
+void FaultProxy::close(Connection& connection)
+{
+	try
+	{
+		connection.client.close();
+		connection.server.close();
+	}
+	catch (Poco::Exception&)
+	{
+	}
+	delete &connection;
+}
+
+
+void FaultProxy::resetAll()
+{
+	for (std::vector<Connection*>::iterator it = _connections.begin(); it != _connections.end(); ++it)
+	{
+		reset(**it);
+	}
+	_connections.clear();
+}
@@ -0,0 +1,172 @@
+//
+// FaultProxy.h
+//
+// Definition of the FaultProxy class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef FaultProxy_INCLUDED
+#define FaultProxy_INCLUDED
+
+
+#include "Poco/Net/ServerSocket.h"
+#include "Poco/Net/StreamSocket.h"
+#include "Poco/Net/SocketAddress.h"
+#include "Poco/Runnable.h"
+#include "Poco/Thread.h"
+#include "Poco/Mutex.h"
+#include "Poco/Random.h"
+#include "Poco/Timespan.h"
+#include "Poco/Timestamp.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+
+class FaultProxy: public Poco::Runnable
+	/// A TCP proxy for loopback tests that forwards connections to a
+	/// target address and makes the network between them worse on
+	/// purpose: it delays, paces, holds and resets the data it
+	/// forwards, so that reconnect, retry and batching behavior can be
+	/// measured against the same bad network again and again.
+	///
+	/// The proxy works on the segments it reads from the sockets, not
+	/// on packets: a "lost" segment is delivered late, as TCP would
+	/// after a retransmission, and a reset closes both sides of the
+	/// connection with RST. TLS passes through unchanged.
+	///
+	/// The faults can be changed at any time with setFaults(), or
+	/// played from a Script, a list of phases of the form
+	///
+	///     latency=80 jitter=40 for=20; down for=10; for=5
+	///
+	/// Each phase is a list of key=value pairs or flags and lasts for
+	/// "for" seconds (default 10). The keys are the members of Faults:
+	/// latency, jitter, rto (milliseconds), bandwidth (bytes per
+	/// second), loss, reset (probability per segment), drop (seconds),
+	/// and the flags down and stall. A phase without faults is a
+	/// clean network.
+{
+public:
+	struct Faults
+	{
+		Faults();
+
+		int latency;       /// milliseconds added to every segment
+		int jitter;        /// up to this many milliseconds more, at random
+		int bandwidth;     /// bytes per second in each direction, 0 for unlimited
+		double loss;       /// probability that a segment is held for rto milliseconds
+		int rto;           /// the retransmission timeout of a lost segment
+		double reset;      /// probability that a segment resets its connection
+		int drop;          /// seconds between resets of all connections, 0 for never
+		bool down;         /// connections are reset as soon as they are accepted
+		bool stall;        /// data from the target is held until the stall ends
+	};
+
+	struct Phase
+	{
+		Faults faults;
+		Poco::Timespan duration;
+	};
+
+	typedef std::vector<Phase> Script;
+
+	static Script parse(const std::string& script);
+		/// Parses a script. Throws a Poco::SyntaxException if it
+		/// is malformed.
+
+	FaultProxy(const Poco::Net::SocketAddress& address, const Poco::Net::SocketAddress& target);
+		/// Creates the FaultProxy, listening on the given address
+		/// (port 0 for any free port) and forwarding to the target.
+
+	~FaultProxy();
+		/// Stops and destroys the FaultProxy.
+
+	void start();
+		/// Starts forwarding on a thread of its own.
+
+	void stop();
+		/// Resets all connections and stops the thread.
+
+	Poco::Net::SocketAddress address() const;
+		/// Returns the address the proxy listens on.
+
+	void setFaults(const Faults& faults);
+		/// Sets the faults applied from now on.
+
+	Faults getFaults() const;
+		/// Returns the faults applied now.
+
+	void play(const Script& script);
+		/// Sets the faults of each phase in turn and waits for the
+		/// phase to end, then sets a clean network.
+
+	int connections() const;
+		/// Returns the number of connections accepted so far.
+
+	int resets() const;
+		/// Returns the number of connections reset so far.
+
+	void run();
+		/// Forwards until stop() is called. Called on the proxy's
+		/// own thread.
+
+private:
+	enum
+	{
+		BUFFER_SIZE = 4096,
+		MAX_QUEUED  = 256*1024
+	};
+
+	struct Segment
+	{
+		std::string data;
+		Poco::Timestamp due;
+	};
+
+	struct Direction
+		/// The segments on their way from one socket to the other.
+	{
+		Direction();
+
+		std::deque<Segment> segments;
+		std::size_t queued;
+		Poco::Timestamp free;   /// when the paced link is free again
+		Poco::Timestamp last;   /// when the last segment is due
+		bool eof;
+	};
+
+	struct Connection
+	{
+		Poco::Net::StreamSocket client;
+		Poco::Net::StreamSocket server;
+		bool connecting;
+		Direction up;           /// client to target
+		Direction down;         /// target to client
+	};
+
+	void accept(const Faults& faults);
+	void connected(Connection& connection);
+	bool receive(Poco::Net::StreamSocket& socket, Direction& direction, const Faults& faults);
+	bool send(Poco::Net::StreamSocket& socket, Direction& direction);
+	void reset(Connection& connection);
+	void close(Connection& connection);
+	void resetAll();
+
+	Poco::Net::ServerSocket _socket;
+	Poco::Net::SocketAddress _target;
+	std::vector<Connection*> _connections;
+	Poco::Random _random;
+	Poco::Timestamp _nextDrop;
+	bool _stopped;
+	int _accepted;
+	int _resets;
+	Faults _faults;
+	Poco::Thread _thread;
+	mutable Poco::FastMutex _mutex;
+};
+
+
+#endif // FaultProxy_INCLUDED
@@ -0,0 +1,57 @@
+//
+// PerThreadRSACipher.cpp
+//
+// Implementation of the PerThreadRSACipher class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "PerThreadRSACipher.h"
+#include "Poco/Crypto/CipherFactory.h"
+#include <sstream>
+
+
+PerThreadRSACipher::PerThreadRSACipher(const Poco::Crypto::RSAKey& key, bool perThread):
+	_perThread(perThread),
+	_pShared(Poco::Crypto::CipherFactory::defaultFactory().createCipher(key, RSA_PADDING_PKCS1))
+{
+	if (_perThread)
+	{
+		std::ostringstream privateKey;
+		Poco::Crypto::RSAKey copy(key);
+		copy.save(0, &privateKey);
+		_privateKeyPEM = privateKey.str();
+	}
+}
+
+
+PerThreadRSACipher::~PerThreadRSACipher()
+{
+}
+
+
+std::string PerThreadRSACipher::encryptString(const std::string& str)
+{
+	return _pShared->encryptString(str);
+}
+
+
+std::string PerThreadRSACipher::decryptString(const std::string& str)
+{
+	return cipher().decryptString(str);
+}
+
+
+Poco::Crypto::Cipher& PerThreadRSACipher::cipher()
+{
+	if (!_perThread) return *_pShared;
+
+	Poco::SharedPtr<Poco::Crypto::Cipher>& pLocal = *_local;
+	if (!pLocal)
+	{
+		std::istringstream privateKey(_privateKeyPEM);
+		pLocal = Poco::Crypto::CipherFactory::defaultFactory().createCipher(Poco::Crypto::RSAKey(0, &privateKey), RSA_PADDING_PKCS1);
+	}
+	return *pLocal;
+}
@@ -0,0 +1,64 @@
+//
+// PerThreadRSACipher.h
+//
+// Definition of the PerThreadRSACipher class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef PerThreadRSACipher_INCLUDED
+#define PerThreadRSACipher_INCLUDED
+
+
+#include "Poco/Crypto/Cipher.h"
+#include "Poco/Crypto/RSAKey.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/ThreadLocal.h"
+#include <string>
+
+
+class PerThreadRSACipher
+	/// RSA payload decryption with a private copy of the key for every
+	/// thread that uses it.
+	///
+	/// OpenSSL 1.0.x creates the blinding factor of an RSA key for the
+	/// first thread using it; every other thread goes through the shared
+	/// blinding under CRYPTO_LOCK_RSA_BLINDING. With one key copy per
+	/// thread each thread owns its blinding and private key operations
+	/// from different threads no longer contend. A copy is created from
+	/// the in-memory PEM encoding of the key the first time a thread
+	/// decrypts.
+	///
+	/// Alternatively, with perThread = false, all threads share a single
+	/// Cipher, as the server did before.
+{
+public:
+	typedef Poco::SharedPtr<PerThreadRSACipher> Ptr;
+
+	PerThreadRSACipher(const Poco::Crypto::RSAKey& key, bool perThread = true);
+		/// Creates the PerThreadRSACipher for the given private key.
+
+	~PerThreadRSACipher();
+		/// Destroys the PerThreadRSACipher.
+
+	std::string encryptString(const std::string& str);
+		/// Encrypts str with the public key.
+
+	std::string decryptString(const std::string& str);
+		/// Decrypts str with the calling thread's copy of the private key.
+
+private:
+	PerThreadRSACipher(const PerThreadRSACipher&);
+	PerThreadRSACipher& operator = (const PerThreadRSACipher&);
+
+	Poco::Crypto::Cipher& cipher();
+
+	std::string _privateKeyPEM;
+	bool _perThread;
+	Poco::SharedPtr<Poco::Crypto::Cipher> _pShared;
+	Poco::ThreadLocal<Poco::SharedPtr<Poco::Crypto::Cipher> > _local;
+};
+
+
+#endif // PerThreadRSACipher_INCLUDED
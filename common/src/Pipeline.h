@@ -0,0 +1,296 @@
+//
+// Pipeline.h
+//
+// Definition of the pipeline stage templates.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef Pipeline_INCLUDED
+#define Pipeline_INCLUDED
+
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+//
+// A pipeline is a chain of stages composed at compile time: every
+// stage is a template on the type of the next stage, holds it by
+// value and passes events on with a non-virtual push(), so the whole
+// chain is one type the compiler can inline into the caller:
+//
+//     typedef Filter<IsState, Debounce<char, Transform<Codec, Sink> > > Flow;
+//
+//     Flow flow(Filter<...>(IsState(), Debounce<...>(Transform<...>(Codec(), Sink()))));
+//     flow.push(c);
+//
+// The source is whatever calls push(); the policies (predicates,
+// codecs, ciphers) are function objects. flush() passes buffered
+// events on at the end of the input.
+//
+
+
+class NullSink
+	/// A sink that discards the events.
+{
+public:
+	template <class Event>
+	void push(const Event&)
+	{
+	}
+
+	void flush()
+	{
+	}
+};
+
+
+template <class Function>
+class FunctionSink
+	/// A sink that calls a function object for every event.
+{
+public:
+	explicit FunctionSink(const Function& function = Function()):
+		_function(function)
+	{
+	}
+
+	template <class Event>
+	void push(const Event& event)
+	{
+		_function(event);
+	}
+
+	void flush()
+	{
+	}
+
+	Function& function()
+	{
+		return _function;
+	}
+
+private:
+	Function _function;
+};
+
+
+template <class Predicate, class Next>
+class Filter
+	/// Passes on the events for which the predicate is true.
+{
+public:
+	explicit Filter(const Predicate& predicate = Predicate(), const Next& next = Next()):
+		_predicate(predicate),
+		_next(next)
+	{
+	}
+
+	template <class Event>
+	void push(const Event& event)
+	{
+		if (_predicate(event)) _next.push(event);
+	}
+
+	void flush()
+	{
+		_next.flush();
+	}
+
+	Next& next()
+	{
+		return _next;
+	}
+
+private:
+	Predicate _predicate;
+	Next _next;
+};
+
+
+template <class Event, class Next>
+class Debounce
+	/// Passes on an event only if it differs from the one before, so
+	/// that a state repeated by the source is reported once.
+{
+public:
+	explicit Debounce(const Next& next = Next()):
+		_next(next),
+		_hasLast(false),
+		_last()
+	{
+	}
+
+	void push(const Event& event)
+	{
+		if (!_hasLast || !(event == _last))
+		{
+			_last = event;
+			_hasLast = true;
+			_next.push(event);
+		}
+	}
+
+	void flush()
+	{
+		_next.flush();
+	}
+
+	void reset()
+		/// Forgets the last event, so that the next one is passed on.
+	{
+		_hasLast = false;
+	}
+
+	Next& next()
+	{
+		return _next;
+	}
+
+private:
+	Next _next;
+	bool _hasLast;
+	Event _last;
+};
+
+
+template <class Function, class Next>
+class Transform
+	/// Passes on the result of the function object for every event.
+	/// Codecs (decoding a source value into a message) and ciphers
+	/// (encrypting, decrypting or signing a message) are transforms.
+{
+public:
+	explicit Transform(const Function& function = Function(), const Next& next = Next()):
+		_function(function),
+		_next(next)
+	{
+	}
+
+	template <class Event>
+	void push(const Event& event)
+	{
+		_next.push(_function(event));
+	}
+
+	void flush()
+	{
+		_next.flush();
+	}
+
+	Next& next()
+	{
+		return _next;
+	}
+
+private:
+	Function _function;
+	Next _next;
+};
+
+
+template <class Next>
+class Framer
+	/// Collects characters into frames that end with a delimiter and
+	/// passes on each frame, without the delimiter, as a std::string.
+{
+public:
+	explicit Framer(char delimiter = '\n', const Next& next = Next()):
+		_delimiter(delimiter),
+		_next(next)
+	{
+	}
+
+	void push(char c)
+	{
+		if (c == _delimiter)
+		{
+			_next.push(_frame);
+			_frame.clear();
+		}
+		else _frame += c;
+	}
+
+	void push(const char* data, std::size_t length)
+	{
+		for (std::size_t i = 0; i < length; ++i) push(data[i]);
+	}
+
+	void push(const std::string& data)
+	{
+		push(data.data(), data.size());
+	}
+
+	void flush()
+		/// Passes on an unterminated last frame.
+	{
+		if (!_frame.empty())
+		{
+			_next.push(_frame);
+			_frame.clear();
+		}
+		_next.flush();
+	}
+
+	Next& next()
+	{
+		return _next;
+	}
+
+private:
+	char _delimiter;
+	std::string _frame;
+	Next _next;
+};
+
+
+template <class Event, class Next>
+class Batcher
+	/// Collects events into batches of a given size and passes on
+	/// each batch as a const std::vector<Event>&.
+{
+public:
+	explicit Batcher(std::size_t size = 1, const Next& next = Next()):
+		_size(size > 0 ? size : 1),
+		_next(next)
+	{
+		_batch.reserve(_size);
+	}
+
+	void push(const Event& event)
+	{
+		_batch.push_back(event);
+		if (_batch.size() >= _size)
+		{
+			_next.push(_batch);
+			_batch.clear();
+		}
+	}
+
+	void flush()
+		/// Passes on an incomplete last batch.
+	{
+		if (!_batch.empty())
+		{
+			_next.push(_batch);
+			_batch.clear();
+		}
+		_next.flush();
+	}
+
+	Next& next()
+	{
+		return _next;
+	}
+
+private:
+	std::size_t _size;
+	std::vector<Event> _batch;
+	Next _next;
+};
+
+
+#endif // Pipeline_INCLUDED
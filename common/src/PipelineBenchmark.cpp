@@ -0,0 +1,496 @@
+//
+// PipelineBenchmark.cpp
+//
+// Implementation of the PipelineBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "PipelineBenchmark.h"
+#include "Pipeline.h"
+#include "Poco/Exception.h"
+#include "Poco/NumberFormatter.h"
+#include "Poco/Stopwatch.h"
+#include "Poco/Timestamp.h"
+#include "Poco/Types.h"
+#include <iomanip>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	const std::size_t INPUT_SIZE = 4096;
+	const std::size_t BATCH_SIZE = 16;
+	const std::string MESSAGE_ON("!!!!...REMOTE SYNC TROUBLE...!!!!");
+	const std::string MESSAGE_OFF("!!!!...REMOTE SYNC TROUBLE CLEARED..!!!!");
+
+
+	//
+	// The policies, shared by all variants.
+	//
+
+	struct IsState
+	{
+		bool operator () (unsigned char c) const
+		{
+			return c == '1' || c == '0';
+		}
+	};
+
+
+	struct Decode
+	{
+		const std::string& operator () (unsigned char c) const
+		{
+			return c == '1' ? MESSAGE_ON : MESSAGE_OFF;
+		}
+	};
+
+
+	struct Checksum
+		/// Stands in for the cipher, at a constant cost of a few
+		/// instructions.
+	{
+		Poco::UInt32 operator () (const std::string& message) const
+		{
+			return (static_cast<Poco::UInt32>(message.size()) << 16) ^ (static_cast<unsigned char>(message[0]) << 8) ^ static_cast<unsigned char>(message[message.size() - 1]);
+		}
+	};
+
+
+	struct Length
+	{
+		std::size_t operator () (const std::string& frame) const
+		{
+			return frame.size();
+		}
+	};
+
+
+	class Total
+		/// The sink: adds up what it receives.
+	{
+	public:
+		explicit Total(Poco::UInt64* pTotal = 0):
+			_pTotal(pTotal)
+		{
+		}
+
+		void push(std::size_t value)
+		{
+			*_pTotal += value;
+		}
+
+		void push(const std::vector<Poco::UInt32>& batch)
+		{
+			for (std::vector<Poco::UInt32>::const_iterator it = batch.begin(); it != batch.end(); ++it)
+			{
+				*_pTotal += *it;
+			}
+		}
+
+		void flush()
+		{
+		}
+
+	private:
+		Poco::UInt64* _pTotal;
+	};
+
+
+	//
+	// The same stages with virtual calls.
+	//
+
+	template <class Event>
+	class Consumer
+	{
+	public:
+		virtual ~Consumer()
+		{
+		}
+
+		virtual void push(const Event& event) = 0;
+		virtual void flush() = 0;
+	};
+
+
+	class VirtualFilter: public Consumer<unsigned char>
+	{
+	public:
+		explicit VirtualFilter(Consumer<unsigned char>* pNext): _pNext(pNext)
+		{
+		}
+
+		void push(const unsigned char& c)
+		{
+			if (IsState()(c)) _pNext->push(c);
+		}
+
+		void flush()
+		{
+			_pNext->flush();
+		}
+
+	private:
+		Consumer<unsigned char>* _pNext;
+	};
+
+
+	class VirtualDebounce: public Consumer<unsigned char>
+	{
+	public:
+		explicit VirtualDebounce(Consumer<unsigned char>* pNext): _pNext(pNext), _hasLast(false), _last(0)
+		{
+		}
+
+		void push(const unsigned char& c)
+		{
+			if (!_hasLast || c != _last)
+			{
+				_last = c;
+				_hasLast = true;
+				_pNext->push(c);
+			}
+		}
+
+		void flush()
+		{
+			_pNext->flush();
+		}
+
+	private:
+		Consumer<unsigned char>* _pNext;
+		bool _hasLast;
+		unsigned char _last;
+	};
+
+
+	class VirtualDecode: public Consumer<unsigned char>
+	{
+	public:
+		explicit VirtualDecode(Consumer<std::string>* pNext): _pNext(pNext)
+		{
+		}
+
+		void push(const unsigned char& c)
+		{
+			_pNext->push(Decode()(c));
+		}
+
+		void flush()
+		{
+			_pNext->flush();
+		}
+
+	private:
+		Consumer<std::string>* _pNext;
+	};
+
+
+	class VirtualChecksum: public Consumer<std::string>
+	{
+	public:
+		explicit VirtualChecksum(Consumer<Poco::UInt32>* pNext): _pNext(pNext)
+		{
+		}
+
+		void push(const std::string& message)
+		{
+			_pNext->push(Checksum()(message));
+		}
+
+		void flush()
+		{
+			_pNext->flush();
+		}
+
+	private:
+		Consumer<Poco::UInt32>* _pNext;
+	};
+
+
+	class VirtualBatcher: public Consumer<Poco::UInt32>
+	{
+	public:
+		explicit VirtualBatcher(Consumer<std::vector<Poco::UInt32> >* pNext): _pNext(pNext)
+		{
+			_batch.reserve(BATCH_SIZE);
+		}
+
+		void push(const Poco::UInt32& value)
+		{
+			_batch.push_back(value);
+			if (_batch.size() >= BATCH_SIZE)
+			{
+				_pNext->push(_batch);
+				_batch.clear();
+			}
+		}
+
+		void flush()
+		{
+			if (!_batch.empty())
+			{
+				_pNext->push(_batch);
+				_batch.clear();
+			}
+			_pNext->flush();
+		}
+
+	private:
+		Consumer<std::vector<Poco::UInt32> >* _pNext;
+		std::vector<Poco::UInt32> _batch;
+	};
+
+
+	class VirtualFramer: public Consumer<unsigned char>
+	{
+	public:
+		explicit VirtualFramer(Consumer<std::string>* pNext): _pNext(pNext)
+		{
+		}
+
+		void push(const unsigned char& c)
+		{
+			if (c == '\n')
+			{
+				_pNext->push(_frame);
+				_frame.clear();
+			}
+			else _frame += static_cast<char>(c);
+		}
+
+		void flush()
+		{
+			if (!_frame.empty())
+			{
+				_pNext->push(_frame);
+				_frame.clear();
+			}
+			_pNext->flush();
+		}
+
+	private:
+		Consumer<std::string>* _pNext;
+		std::string _frame;
+	};
+
+
+	class VirtualLength: public Consumer<std::string>
+	{
+	public:
+		explicit VirtualLength(Consumer<std::size_t>* pNext): _pNext(pNext)
+		{
+		}
+
+		void push(const std::string& frame)
+		{
+			_pNext->push(frame.size());
+		}
+
+		void flush()
+		{
+			_pNext->flush();
+		}
+
+	private:
+		Consumer<std::size_t>* _pNext;
+	};
+
+
+	class VirtualTotal: public Consumer<std::size_t>, public Consumer<std::vector<Poco::UInt32> >
+	{
+	public:
+		explicit VirtualTotal(Poco::UInt64* pTotal): _total(pTotal)
+		{
+		}
+
+		void push(const std::size_t& value)
+		{
+			_total.push(value);
+		}
+
+		void push(const std::vector<Poco::UInt32>& batch)
+		{
+			_total.push(batch);
+		}
+
+		void flush()
+		{
+		}
+
+	private:
+		Total _total;
+	};
+
+
+	//
+	// The pipelines.
+	//
+
+	typedef Filter<IsState, Debounce<unsigned char, Transform<Decode, Transform<Checksum, Batcher<Poco::UInt32, Total> > > > > SerialPipeline;
+	typedef Framer<Transform<Length, Total> > FramingPipeline;
+
+
+	void printResult(std::ostream& ostr, const std::string& flow, const std::string& variant, Poco::Timestamp::TimeDiff elapsed, int events)
+	{
+		ostr << std::left << std::setw(10) << flow << std::setw(14) << variant << std::right
+		     << std::setw(10) << Poco::NumberFormatter::format(static_cast<double>(elapsed)*1000/events, 2)
+		     << std::endl;
+	}
+}
+
+
+PipelineBenchmark::PipelineBenchmark(int events):
+	_events(events)
+{
+}
+
+
+PipelineBenchmark::~PipelineBenchmark()
+{
+}
+
+
+void PipelineBenchmark::run(std::ostream& ostr)
+{
+	// states with repeats and noise, and an end of line now and then
+	std::vector<unsigned char> input(INPUT_SIZE);
+	Poco::UInt32 seed = 12345;
+	for (std::size_t i = 0; i < INPUT_SIZE; ++i)
+	{
+		seed = seed*1103515245U + 12345U;
+		unsigned r = (seed >> 16) % 16;
+		input[i] = r < 5 ? '1' : r < 10 ? '0' : r < 15 ? 'x' : '\n';
+	}
+
+	ostr << "flow      variant          ns/byte" << std::endl;
+	Poco::Stopwatch sw;
+
+	// The virtual chains are called through a volatile pointer, so
+	// that the compiler cannot resolve the calls as it could for a
+	// chain built in another translation unit.
+
+	// serial flow
+	Poco::UInt64 handTotal = 0;
+	sw.restart();
+	{
+		bool hasLast = false;
+		unsigned char last = 0;
+		std::vector<Poco::UInt32> batch;
+		batch.reserve(BATCH_SIZE);
+		for (int i = 0; i < _events; ++i)
+		{
+			unsigned char c = input[i % INPUT_SIZE];
+			if ((c == '1' || c == '0') && (!hasLast || c != last))
+			{
+				last = c;
+				hasLast = true;
+				const std::string& message = c == '1' ? MESSAGE_ON : MESSAGE_OFF;
+				batch.push_back((static_cast<Poco::UInt32>(message.size()) << 16) ^ (static_cast<unsigned char>(message[0]) << 8) ^ static_cast<unsigned char>(message[message.size() - 1]));
+				if (batch.size() >= BATCH_SIZE)
+				{
+					for (std::size_t k = 0; k < batch.size(); ++k) handTotal += batch[k];
+					batch.clear();
+				}
+			}
+		}
+		for (std::size_t k = 0; k < batch.size(); ++k) handTotal += batch[k];
+	}
+	sw.stop();
+	printResult(ostr, "serial", "hand-written", sw.elapsed(), _events);
+
+	Poco::UInt64 staticTotal = 0;
+	sw.restart();
+	{
+		SerialPipeline pipeline(IsState(),
+			Debounce<unsigned char, Transform<Decode, Transform<Checksum, Batcher<Poco::UInt32, Total> > > >(
+				Transform<Decode, Transform<Checksum, Batcher<Poco::UInt32, Total> > >(Decode(),
+					Transform<Checksum, Batcher<Poco::UInt32, Total> >(Checksum(),
+						Batcher<Poco::UInt32, Total>(BATCH_SIZE, Total(&staticTotal))))));
+		for (int i = 0; i < _events; ++i)
+		{
+			pipeline.push(input[i % INPUT_SIZE]);
+		}
+		pipeline.flush();
+	}
+	sw.stop();
+	printResult(ostr, "serial", "static", sw.elapsed(), _events);
+
+	Poco::UInt64 virtualTotal = 0;
+	sw.restart();
+	{
+		VirtualTotal total(&virtualTotal);
+		VirtualBatcher batcher(&total);
+		VirtualChecksum checksum(&batcher);
+		VirtualDecode decode(&checksum);
+		VirtualDebounce debounce(&decode);
+		VirtualFilter filter(&debounce);
+		Consumer<unsigned char>* volatile pPipeline = &filter;
+		for (int i = 0; i < _events; ++i)
+		{
+			pPipeline->push(input[i % INPUT_SIZE]);
+		}
+		pPipeline->flush();
+	}
+	sw.stop();
+	printResult(ostr, "serial", "virtual", sw.elapsed(), _events);
+
+	if (staticTotal != handTotal || virtualTotal != handTotal)
+		throw Poco::DataException("Pipeline benchmark variants disagree", "serial");
+
+	// framing flow
+	handTotal = 0;
+	sw.restart();
+	{
+		std::string frame;
+		for (int i = 0; i < _events; ++i)
+		{
+			unsigned char c = input[i % INPUT_SIZE];
+			if (c == '\n')
+			{
+				handTotal += frame.size();
+				frame.clear();
+			}
+			else frame += static_cast<char>(c);
+		}
+		handTotal += frame.size();
+	}
+	sw.stop();
+	printResult(ostr, "framing", "hand-written", sw.elapsed(), _events);
+
+	staticTotal = 0;
+	sw.restart();
+	{
+		FramingPipeline pipeline('\n', Transform<Length, Total>(Length(), Total(&staticTotal)));
+		for (int i = 0; i < _events; ++i)
+		{
+			pipeline.push(static_cast<char>(input[i % INPUT_SIZE]));
+		}
+		pipeline.flush();
+	}
+	sw.stop();
+	printResult(ostr, "framing", "static", sw.elapsed(), _events);
+
+	virtualTotal = 0;
+	sw.restart();
+	{
+		VirtualTotal total(&virtualTotal);
+		VirtualLength length(&total);
+		VirtualFramer framer(&length);
+		Consumer<unsigned char>* volatile pPipeline = &framer;
+		for (int i = 0; i < _events; ++i)
+		{
+			pPipeline->push(input[i % INPUT_SIZE]);
+		}
+		pPipeline->flush();
+	}
+	sw.stop();
+	printResult(ostr, "framing", "virtual", sw.elapsed(), _events);
+
+	if (staticTotal != handTotal || virtualTotal != handTotal)
+		throw Poco::DataException("Pipeline benchmark variants disagree", "framing");
+}
@@ -0,0 +1,48 @@
+//
+// PipelineBenchmark.h
+//
+// Definition of the PipelineBenchmark class.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef PipelineBenchmark_INCLUDED
+#define PipelineBenchmark_INCLUDED
+
+
+#include <ostream>
+
+
+class PipelineBenchmark
+	/// Measures the per-event overhead of the stages in Pipeline.h on
+	/// two flows, each written three ways: as a pipeline composed at
+	/// compile time, as the same stages chained through virtual
+	/// push() calls, and by hand as one loop.
+	///
+	/// The "serial" flow is the shape of the client flow: bytes are
+	/// filtered, debounced, decoded into a message, checksummed in
+	/// place of the cipher and batched. The "framing" flow splits
+	/// bytes into lines and measures their length. The checksum costs
+	/// a few instructions, so the numbers are about the stages and
+	/// not about a cipher.
+{
+public:
+	PipelineBenchmark(int events);
+		/// Creates the PipelineBenchmark. Each variant processes
+		/// the given number of input bytes.
+
+	~PipelineBenchmark();
+		/// Destroys the PipelineBenchmark.
+
+	void run(std::ostream& ostr);
+		/// Runs all variants and writes the time per input byte.
+		/// Throws a Poco::DataException if the variants of a flow do
+		/// not compute the same result.
+
+private:
+	int _events;
+};
+
+
+#endif // PipelineBenchmark_INCLUDED
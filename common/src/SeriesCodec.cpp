@@ -0,0 +1,314 @@
+//
+// SeriesCodec.cpp
+//
+// Implementation of the SeriesEncoder and SeriesDecoder classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SeriesCodec.h"
+#include "Poco/Exception.h"
+#include <string.h>
+
+
+namespace
+{
+	Poco::UInt64 bitsOf(double value)
+	{
+		Poco::UInt64 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+
+	double valueOf(Poco::UInt64 bits)
+	{
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+
+	Poco::Int64 signExtend(Poco::UInt64 value, int bits)
+	{
+		return static_cast<Poco::Int64>(value << (64 - bits)) >> (64 - bits);
+	}
+
+
+	class BitReader
+		/// Reads a bit stream through a 64-bit buffer whose most
+		/// significant bits are the next ones.
+	{
+	public:
+		BitReader(const unsigned char* begin, const unsigned char* end):
+			_p(begin),
+			_end(end),
+			_buffer(0),
+			_available(0)
+		{
+		}
+
+		Poco::UInt64 peek(int bits)
+			/// Returns the next bits (at most 32) without consuming
+			/// them; missing bits at the end of the stream are 0.
+		{
+			if (_available < bits) refill();
+			return _buffer >> (64 - bits);
+		}
+
+		void skip(int bits)
+		{
+			if (_available < bits) throw Poco::DataException("Truncated series");
+			_buffer <<= bits;
+			_available -= bits;
+		}
+
+		Poco::UInt64 read(int bits)
+			/// Reads 1 to 64 bits.
+		{
+			if (bits > 32)
+			{
+				Poco::UInt64 high = read(bits - 32);
+				return (high << 32) | read(32);
+			}
+			Poco::UInt64 value = peek(bits);
+			skip(bits);
+			return value;
+		}
+
+	private:
+		void refill()
+		{
+			while (_available <= 56 && _p < _end)
+			{
+				_buffer |= static_cast<Poco::UInt64>(*_p++) << (56 - _available);
+				_available += 8;
+			}
+		}
+
+		const unsigned char* _p;
+		const unsigned char* _end;
+		Poco::UInt64 _buffer;
+		int _available;
+	};
+
+
+	struct TimeCode
+		/// The control bits of a timestamp and the bits that follow.
+	{
+		int length;
+		int bits;
+	};
+
+
+	// indexed by the next 4 bits of the stream
+	const TimeCode TIME_CODES[16] =
+	{
+		{1, 0}, {1, 0}, {1, 0}, {1, 0}, {1, 0}, {1, 0}, {1, 0}, {1, 0},
+		{2, 7}, {2, 7}, {2, 7}, {2, 7},
+		{3, 9}, {3, 9},
+		{4, 12},
+		{4, 64}
+	};
+}
+
+
+const std::string SeriesEncoder::PREFIX("SERIES ");
+
+
+SeriesEncoder::SeriesEncoder():
+	_bits(0),
+	_used(0),
+	_count(0),
+	_time(0),
+	_delta(0),
+	_value(0),
+	_leading(-1),
+	_trailing(0)
+{
+}
+
+
+SeriesEncoder::~SeriesEncoder()
+{
+}
+
+
+void SeriesEncoder::append(Poco::Int64 time, double value)
+{
+	Poco::UInt64 bits = bitsOf(value);
+	if (_count++ == 0)
+	{
+		write(static_cast<Poco::UInt64>(time), 64);
+		write(bits, 64);
+		_time = time;
+		_value = bits;
+		return;
+	}
+
+	Poco::Int64 delta = time - _time;
+	Poco::Int64 dod = delta - _delta;
+	if (dod == 0)
+		write(0, 1);
+	else if (dod >= -64 && dod <= 63)
+	{
+		write(2, 2);
+		write(static_cast<Poco::UInt64>(dod), 7);
+	}
+	else if (dod >= -256 && dod <= 255)
+	{
+		write(6, 3);
+		write(static_cast<Poco::UInt64>(dod), 9);
+	}
+	else if (dod >= -2048 && dod <= 2047)
+	{
+		write(14, 4);
+		write(static_cast<Poco::UInt64>(dod), 12);
+	}
+	else
+	{
+		write(15, 4);
+		write(static_cast<Poco::UInt64>(dod), 64);
+	}
+	_time = time;
+	_delta = delta;
+
+	Poco::UInt64 x = bits ^ _value;
+	_value = bits;
+	if (x == 0)
+	{
+		write(0, 1);
+		return;
+	}
+	int leading = __builtin_clzll(x);
+	int trailing = __builtin_ctzll(x);
+	if (leading > 31) leading = 31;
+	if (_leading >= 0 && leading >= _leading && trailing >= _trailing)
+	{
+		write(2, 2);
+		write(x >> _trailing, 64 - _leading - _trailing);
+	}
+	else
+	{
+		int length = 64 - leading - trailing;
+		write(3, 2);
+		write(leading, 5);
+		write(length & 63, 6);
+		write(x >> trailing, length);
+		_leading = leading;
+		_trailing = trailing;
+	}
+}
+
+
+std::string SeriesEncoder::finish(const std::string& channel)
+{
+	std::string message(PREFIX);
+	message += channel;
+	message += '\n';
+	message += static_cast<char>(MAGIC);
+	message += static_cast<char>(VERSION);
+	Poco::UInt32 count = static_cast<Poco::UInt32>(_count);
+	message += static_cast<char>(count >> 24);
+	message += static_cast<char>(count >> 16);
+	message += static_cast<char>(count >> 8);
+	message += static_cast<char>(count);
+	message += _data;
+	if (_used > 0)
+		message += static_cast<char>(_bits << (8 - _used));
+
+	_data.clear();
+	_bits = 0;
+	_used = 0;
+	_count = 0;
+	_delta = 0;
+	_leading = -1;
+	_trailing = 0;
+	return message;
+}
+
+
+void SeriesEncoder::write(Poco::UInt64 value, int bits)
+{
+	while (bits > 0)
+	{
+		int take = bits > 32 ? 32 : bits;
+		bits -= take;
+		_bits = (_bits << take) | ((value >> bits) & ((Poco::UInt64(1) << take) - 1));
+		_used += take;
+		while (_used >= 8)
+		{
+			_used -= 8;
+			_data += static_cast<char>(_bits >> _used);
+		}
+		_bits &= (Poco::UInt64(1) << _used) - 1;
+	}
+}
+
+
+bool SeriesDecoder::isSeries(const std::string& message)
+{
+	return message.compare(0, SeriesEncoder::PREFIX.size(), SeriesEncoder::PREFIX) == 0;
+}
+
+
+void SeriesDecoder::decode(const std::string& message, std::string& channel, std::vector<Poco::Int64>& times, std::vector<double>& values)
+{
+	std::string::size_type newline = message.find('\n');
+	if (!isSeries(message) || newline == std::string::npos || message.size() < newline + 7)
+		throw Poco::DataException("Not a series");
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(message.data()) + newline + 1;
+	const unsigned char* end = reinterpret_cast<const unsigned char*>(message.data()) + message.size();
+	if (p[0] != SeriesEncoder::MAGIC || p[1] != SeriesEncoder::VERSION)
+		throw Poco::DataException("Unknown series format");
+	std::size_t count = (static_cast<std::size_t>(p[2]) << 24) | (p[3] << 16) | (p[4] << 8) | p[5];
+	// every point after the first takes at least two bits
+	if (count > 0 && static_cast<std::size_t>(end - p - 6) < 16 + (count - 1)/4)
+		throw Poco::DataException("Truncated series");
+	channel.assign(message, SeriesEncoder::PREFIX.size(), newline - SeriesEncoder::PREFIX.size());
+	times.resize(count);
+	values.resize(count);
+	if (count == 0) return;
+
+	BitReader reader(p + 6, end);
+	Poco::Int64* pTime = &times[0];
+	double* pValue = &values[0];
+	Poco::Int64 time = static_cast<Poco::Int64>(reader.read(64));
+	Poco::UInt64 value = reader.read(64);
+	Poco::Int64 delta = 0;
+	int leading = 0;
+	int length = 0;
+	int trailing = 0;
+	pTime[0] = time;
+	pValue[0] = valueOf(value);
+	for (std::size_t i = 1; i < count; ++i)
+	{
+		const TimeCode& code = TIME_CODES[reader.peek(4)];
+		reader.skip(code.length);
+		if (code.bits != 0)
+			delta += code.bits == 64 ? static_cast<Poco::Int64>(reader.read(64)) : signExtend(reader.read(code.bits), code.bits);
+		time += delta;
+		pTime[i] = time;
+
+		Poco::UInt64 control = reader.peek(2);
+		if (control < 2)
+			reader.skip(1);
+		else
+		{
+			reader.skip(2);
+			if (control == 3)
+			{
+				leading = static_cast<int>(reader.read(5));
+				length = static_cast<int>(reader.read(6));
+				if (length == 0) length = 64;
+				if (leading + length > 64) throw Poco::DataException("Corrupt series");
+				trailing = 64 - leading - length;
+			}
+			else if (length == 0)
+				throw Poco::DataException("Corrupt series");
+			value ^= reader.read(length) << trailing;
+		}
+		pValue[i] = valueOf(value);
+	}
+}
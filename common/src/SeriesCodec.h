@@ -0,0 +1,120 @@
+//
+// SeriesCodec.h
+//
+// Definition of the SeriesEncoder and SeriesDecoder classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SeriesCodec_INCLUDED
+#define SeriesCodec_INCLUDED
+
+
+#include "Poco/Types.h"
+#include <string>
+#include <vector>
+
+
+class SeriesEncoder
+	/// Compresses a series of numeric readings of one channel, each a
+	/// timestamp in milliseconds and a double, as in Facebook's Gorilla:
+	///
+	///   - the first point is stored as is (64 + 64 bits);
+	///   - a timestamp is stored as the difference between its delta
+	///     and the delta before: '0' if it is the same, else '10',
+	///     '110' or '1110' and 7, 9 or 12 bits, or '1111' and 64 bits;
+	///   - a value is XORed with the one before: '0' if it is the same,
+	///     '10' and the meaningful bits if they fit into the window of
+	///     leading and trailing zeros of the last '11', else '11', 5
+	///     bits of leading zeros, 6 bits of length and the bits.
+	///
+	/// A regularly sampled, slowly changing reading takes a few bits
+	/// per point instead of the 20 to 30 bytes of a text line.
+	///
+	/// The series is uploaded as a message of its own:
+	///
+	///     SERIES <channel>\n<'G'><version><count, 4 bytes><bits>
+	///
+	/// The same file is used by the server's decoder.
+{
+public:
+	static const std::string PREFIX;
+		/// "SERIES ", the start of a series message.
+
+	enum
+	{
+		MAGIC = 'G',
+		VERSION = 1
+	};
+
+	SeriesEncoder();
+		/// Creates an empty SeriesEncoder.
+
+	~SeriesEncoder();
+		/// Destroys the SeriesEncoder.
+
+	void append(Poco::Int64 time, double value);
+		/// Appends a point.
+
+	std::size_t size() const;
+		/// Returns the number of points appended.
+
+	std::size_t bytes() const;
+		/// Returns the size of the encoded points so far.
+
+	std::string finish(const std::string& channel);
+		/// Returns the series message and starts a new series.
+
+private:
+	void write(Poco::UInt64 value, int bits);
+
+	std::string _data;
+	Poco::UInt64 _bits;
+	int _used;
+	std::size_t _count;
+	Poco::Int64 _time;
+	Poco::Int64 _delta;
+	Poco::UInt64 _value;
+	int _leading;
+	int _trailing;
+};
+
+
+class SeriesDecoder
+	/// Decodes the series messages of a SeriesEncoder.
+	///
+	/// The decoder reads the bit stream from a 64-bit buffer refilled a
+	/// byte at a time, dispatches the control bits of a timestamp with
+	/// one table lookup, and writes the points into arrays sized from
+	/// the count in the header, so that a point takes a few
+	/// instructions. The bits of a point depend on the point before,
+	/// so they are decoded one after the other.
+{
+public:
+	static bool isSeries(const std::string& message);
+		/// Returns true if the message is a series message.
+
+	static void decode(const std::string& message, std::string& channel, std::vector<Poco::Int64>& times, std::vector<double>& values);
+		/// Decodes a series message into its channel and the timestamps
+		/// and values of its points. Throws a Poco::DataException if the
+		/// message is malformed or truncated.
+};
+
+
+//
+// inlines
+//
+inline std::size_t SeriesEncoder::size() const
+{
+	return _count;
+}
+
+
+inline std::size_t SeriesEncoder::bytes() const
+{
+	return _data.size() + (_used + 7)/8;
+}
+
+
+#endif // SeriesCodec_INCLUDED
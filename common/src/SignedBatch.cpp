@@ -0,0 +1,180 @@
+//
+// SignedBatch.cpp
+//
+// Implementation of the ECDSAKey and SignedBatch classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#include "SignedBatch.h"
+#include "Poco/BinaryWriter.h"
+#include "Poco/BinaryReader.h"
+#include "Poco/Buffer.h"
+#include "Poco/Exception.h"
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <openssl/pem.h>
+#include <openssl/sha.h>
+#include <openssl/err.h>
+#include <sstream>
+
+
+namespace
+{
+	std::string digest(const std::string& data)
+	{
+		unsigned char md[SHA256_DIGEST_LENGTH];
+		SHA256(reinterpret_cast<const unsigned char*>(data.data()), data.size(), md);
+		return std::string(reinterpret_cast<const char*>(md), sizeof(md));
+	}
+
+
+	void readString(Poco::BinaryReader& reader, std::istringstream& istr, std::size_t total, std::string& value)
+		/// Reads a length-prefixed string, refusing lengths beyond the end of the data.
+	{
+		Poco::UInt32 length = 0;
+		reader.read7BitEncoded(length);
+		std::streamoff pos = istr.tellg();
+		if (!reader.good() || pos < 0 || length > total - static_cast<std::size_t>(pos))
+			throw Poco::DataFormatException("Signed batch truncated");
+		reader.readRaw(length, value);
+	}
+}
+
+
+ECDSAKey::ECDSAKey(const std::string& publicKeyFile, const std::string& privateKeyFile, const std::string& privateKeyPassphrase):
+	_pKey(0),
+	_hasPrivateKey(!privateKeyFile.empty())
+{
+	const std::string& file = _hasPrivateKey ? privateKeyFile : publicKeyFile;
+	BIO* pBIO = BIO_new_file(file.c_str(), "r");
+	if (!pBIO) throw Poco::OpenFileException("ECDSA key file", file);
+	if (_hasPrivateKey)
+		_pKey = PEM_read_bio_ECPrivateKey(pBIO, 0, 0, privateKeyPassphrase.empty() ? 0 : const_cast<char*>(privateKeyPassphrase.c_str()));
+	else
+		_pKey = PEM_read_bio_EC_PUBKEY(pBIO, 0, 0, 0);
+	BIO_free(pBIO);
+	if (!_pKey) throw Poco::ReadFileException("Cannot read ECDSA key", file);
+
+	const EC_GROUP* pGroup = EC_KEY_get0_group(_pKey);
+	if (!pGroup || EC_GROUP_get_curve_name(pGroup) != NID_X9_62_prime256v1)
+	{
+		EC_KEY_free(_pKey);
+		throw Poco::InvalidArgumentException("ECDSA key must be on curve prime256v1", file);
+	}
+}
+
+
+ECDSAKey::~ECDSAKey()
+{
+	EC_KEY_free(_pKey);
+}
+
+
+std::string ECDSAKey::sign(const std::string& data) const
+{
+	if (!_hasPrivateKey) throw Poco::IllegalStateException("Signing requires the private key");
+
+	std::string md(digest(data));
+	Poco::Buffer<unsigned char> sig(ECDSA_size(_pKey));
+	unsigned int sigLen = 0;
+	if (ECDSA_sign(0, reinterpret_cast<const unsigned char*>(md.data()), static_cast<int>(md.size()), sig.begin(), &sigLen, _pKey) != 1)
+		throw Poco::IOException("ECDSA signing failed", ERR_error_string(ERR_get_error(), 0));
+	return std::string(reinterpret_cast<const char*>(sig.begin()), sigLen);
+}
+
+
+bool ECDSAKey::verify(const std::string& data, const std::string& signature) const
+{
+	std::string md(digest(data));
+	int rc = ECDSA_verify(0, reinterpret_cast<const unsigned char*>(md.data()), static_cast<int>(md.size()),
+		reinterpret_cast<const unsigned char*>(signature.data()), static_cast<int>(signature.size()), _pKey);
+	if (rc != 1) ERR_clear_error();
+	return rc == 1;
+}
+
+
+SignedBatch::SignedBatch()
+{
+}
+
+
+SignedBatch::~SignedBatch()
+{
+}
+
+
+void SignedBatch::add(const TelemetryRecord& record)
+{
+	_records.push_back(record);
+}
+
+
+void SignedBatch::clear()
+{
+	_records.clear();
+}
+
+
+std::string SignedBatch::seal(const std::string& deviceId, const ECDSAKey& key) const
+{
+	std::string records(encodeRecords());
+	std::string signature(key.sign(deviceId + records));
+
+	std::ostringstream ostr;
+	Poco::BinaryWriter writer(ostr, Poco::BinaryWriter::NETWORK_BYTE_ORDER);
+	writer << signature;
+	writer.writeRaw(records);
+	writer.flush();
+	return ostr.str();
+}
+
+
+SignedBatch SignedBatch::open(const std::string& deviceId, const std::string& data, const ECDSAKey& key)
+{
+	std::istringstream istr(data);
+	Poco::BinaryReader reader(istr, Poco::BinaryReader::NETWORK_BYTE_ORDER);
+	std::string signature;
+	readString(reader, istr, data.size(), signature);
+
+	std::string records(data, static_cast<std::size_t>(istr.tellg()));
+	if (!key.verify(deviceId + records, signature)) throw Poco::DataFormatException("Signed batch signature invalid", deviceId);
+
+	Poco::UInt32 count = 0;
+	reader.read7BitEncoded(count);
+	if (!reader.good() || count > MAX_RECORDS) throw Poco::DataFormatException("Signed batch record count invalid");
+
+	SignedBatch batch;
+	Poco::UInt64 timestamp = 0;
+	for (Poco::UInt32 i = 0; i < count; ++i)
+	{
+		TelemetryRecord record;
+		Poco::UInt64 delta = 0;
+		reader.read7BitEncoded(record.sequence);
+		reader.read7BitEncoded(delta);
+		readString(reader, istr, data.size(), record.payload);
+		timestamp += delta;
+		record.timestamp = timestamp;
+		batch.add(record);
+	}
+	return batch;
+}
+
+
+std::string SignedBatch::encodeRecords() const
+{
+	std::ostringstream ostr;
+	Poco::BinaryWriter writer(ostr, Poco::BinaryWriter::NETWORK_BYTE_ORDER);
+	writer.write7BitEncoded(static_cast<Poco::UInt32>(_records.size()));
+	Poco::UInt64 timestamp = 0;
+	for (std::vector<TelemetryRecord>::const_iterator it = _records.begin(); it != _records.end(); ++it)
+	{
+		writer.write7BitEncoded(it->sequence);
+		writer.write7BitEncoded(static_cast<Poco::UInt64>(it->timestamp - timestamp));
+		writer << it->payload;
+		timestamp = it->timestamp;
+	}
+	writer.flush();
+	return ostr.str();
+}
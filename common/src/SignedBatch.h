@@ -0,0 +1,145 @@
+//
+// SignedBatch.h
+//
+// Definition of the ECDSAKey and SignedBatch classes.
+//
+// SPDX-License-Identifier:	BSL-1.0
+//
+
+
+#ifndef SignedBatch_INCLUDED
+#define SignedBatch_INCLUDED
+
+
+#include "Poco/Crypto/OpenSSLInitializer.h"
+#include "Poco/SharedPtr.h"
+#include "Poco/Types.h"
+#include <openssl/ec.h>
+#include <string>
+#include <vector>
+
+
+class ECDSAKey
+	/// An ECDSA P-256 key pair used to sign telemetry that needs
+	/// authenticity but no confidentiality ("sign" mode).
+	///
+	/// The bundled OpenSSL 1.0.2 has no Ed25519, so ECDSA over P-256
+	/// with SHA-256 is used. Signing requires the private key (kept on
+	/// the device), verifying only the public key. An ECDSAKey is
+	/// immutable after construction and can be shared between threads.
+{
+public:
+	typedef Poco::SharedPtr<ECDSAKey> Ptr;
+
+	ECDSAKey(const std::string& publicKeyFile, const std::string& privateKeyFile = "", const std::string& privateKeyPassphrase = "");
+		/// Reads the public key and/or the private key from the given
+		/// PEM files. If a private key is given, the public key file
+		/// may be empty.
+
+	~ECDSAKey();
+		/// Destroys the ECDSAKey.
+
+	std::string sign(const std::string& data) const;
+		/// Returns the DER-encoded signature of the SHA-256 digest of data.
+
+	bool verify(const std::string& data, const std::string& signature) const;
+		/// Returns true if signature is a valid signature of data.
+
+private:
+	ECDSAKey(const ECDSAKey&);
+	ECDSAKey& operator = (const ECDSAKey&);
+
+	EC_KEY* _pKey;
+	bool _hasPrivateKey;
+	Poco::Crypto::OpenSSLInitializer _openSSLInitializer;
+};
+
+
+struct TelemetryRecord
+	/// A compact telemetry event.
+{
+	Poco::UInt64 sequence;   /// grows with every record of the device
+	Poco::UInt64 timestamp;  /// milliseconds since the epoch
+	std::string payload;
+
+	TelemetryRecord(): sequence(0), timestamp(0)
+	{
+	}
+};
+
+
+class SignedBatch
+	/// A batch of telemetry records protected by a single signature,
+	/// so that the signing cost on the device and the verification
+	/// cost on the server are paid once per batch instead of once per
+	/// event.
+	///
+	/// Wire format (integers 7-bit encoded, see Poco::BinaryWriter):
+	///
+	///     signature length, signature,
+	///     record count, { sequence, timestamp delta, payload length, payload }
+	///
+	/// Timestamps are encoded as the difference to the previous record
+	/// (the first one to 0). The signature covers the device id
+	/// followed by everything after the signature. The signature does
+	/// not keep a batch from being sent again; the server refuses the
+	/// records it has seen by their sequence and timestamp (see
+	/// ReplayGuard).
+{
+public:
+	enum
+	{
+		MAX_RECORDS = 10000
+	};
+
+	SignedBatch();
+		/// Creates an empty SignedBatch.
+
+	~SignedBatch();
+		/// Destroys the SignedBatch.
+
+	void add(const TelemetryRecord& record);
+		/// Appends a record. Adding records in timestamp order keeps
+		/// the encoding compact.
+
+	void clear();
+		/// Removes all records.
+
+	std::size_t size() const;
+		/// Returns the number of records.
+
+	const std::vector<TelemetryRecord>& records() const;
+		/// Returns the records.
+
+	std::string seal(const std::string& deviceId, const ECDSAKey& key) const;
+		/// Encodes and signs the batch.
+
+	static SignedBatch open(const std::string& deviceId, const std::string& data, const ECDSAKey& key);
+		/// Verifies and decodes a batch created by seal().
+		///
+		/// Throws a Poco::DataFormatException if the data is malformed
+		/// or the signature does not verify.
+
+private:
+	std::string encodeRecords() const;
+
+	std::vector<TelemetryRecord> _records;
+};
+
+
+//
+// inlines
+//
+inline std::size_t SignedBatch::size() const
+{
+	return _records.size();
+}
+
+
+inline const std::vector<TelemetryRecord>& SignedBatch::records() const
+{
+	return _records;
+}
+
+
+#endif // SignedBatch_INCLUDED